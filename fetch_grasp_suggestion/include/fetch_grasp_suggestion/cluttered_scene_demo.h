@@ -16,6 +16,7 @@
 #include <pcl_ros/point_cloud.h>
 #include <pcl_ros/transforms.h>
 #include <rail_manipulation_msgs/SegmentedObjectList.h>
+#include <rail_segmentation_tools/TablePlaneEstimator.h>
 #include <ros/ros.h>
 #include <std_msgs/Empty.h>
 #include <std_srvs/Empty.h>
@@ -24,9 +25,7 @@
 // PCL
 #include <pcl/common/common.h>
 #include <pcl/filters/crop_box.h>
-#include <pcl/filters/extract_indices.h>
 #include <pcl/point_types.h>
-#include <pcl/segmentation/sac_segmentation.h>
 
 // Grasp Suggestion
 #include <fetch_grasp_suggestion/point_cloud_manipulation.h>
@@ -85,6 +84,9 @@ private:
 
   tf::TransformListener tf_listener_;
 
+  // seeded from the previous scene's table, so RANSAC only runs when the table is lost
+  TablePlaneEstimator table_estimator_;
+
   boost::mutex cloud_mutex_;
 
   bool debug_;
@@ -3,6 +3,7 @@
 
 // Boost
 #include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
 
 // ROS
 #include <actionlib/client/simple_action_client.h>
@@ -16,10 +17,14 @@
 #include <fetch_grasp_suggestion/ExecuteGraspAction.h>
 #include <fetch_grasp_suggestion/PresetMoveAction.h>
 #include <fetch_grasp_suggestion/PresetJointsMoveAction.h>
+#include <fetch_grasp_suggestion/UpdateObjects.h>
 #include <geometry_msgs/TwistStamped.h>
 #include <manipulation_actions/AttachArbitraryObject.h>
+#include <manipulation_actions/ConvexHullGenerator.h>
 #include <manipulation_actions/LinearMoveAction.h>
+#include <manipulation_actions/ParallelPlanner.h>
 #include <manipulation_actions/ToggleGripperCollisions.h>
+#include <moveit_msgs/ApplyPlanningScene.h>
 #include <moveit_msgs/GetCartesianPath.h>
 #include <moveit_msgs/GetPlanningScene.h>
 #include <moveit_msgs/RobotTrajectory.h>
@@ -29,6 +34,7 @@
 #include <moveit/planning_scene_monitor/planning_scene_monitor.h>
 #include <moveit/robot_state/conversions.h>
 #include <pcl_ros/point_cloud.h>
+#include <pcl_ros/transforms.h>
 #include <ros/ros.h>
 #include <std_msgs/Empty.h>
 #include <std_srvs/Empty.h>
@@ -44,6 +50,10 @@
 #include <pcl/point_types.h>
 #include <pcl/point_cloud.h>
 
+// C++
+#include <map>
+#include <set>
+
 /**
  * @brief Grasp execution, integrating with MoveIt!, in a single action call.
  */
@@ -82,6 +92,48 @@ private:
    */
   void presetPosition(const fetch_grasp_suggestion::PresetJointsMoveGoalConstPtr &goal);
 
+  /**
+   * @brief Plan and move to a joint configuration, reusing the cached path to a recurring goal while it stays valid.
+   * @param joints goal joint positions
+   * @param goal_id trajectory cache name of the goal
+   * @param velocity_scaling_factor velocity scaling of the motion
+   * @return MoveIt! error code of planning or execution
+   */
+  int moveToJoints(const sensor_msgs::JointState &joints, const std::string &goal_id, double velocity_scaling_factor);
+
+  /**
+   * @brief Execute a plan, for running an execution in a separate thread.
+   * @param plan plan to execute
+   * @param error_code set to the MoveIt! error code of the execution
+   */
+  void executePlan(const moveit::planning_interface::MoveGroupInterface::Plan &plan, int *error_code);
+
+  /**
+   * @brief Plan the grasp motion from the state the approach plan ends in, while the approach is still executing.
+   * @param approach_plan approach plan being executed
+   * @param grasp_pose wrist pose to grasp at
+   * @param velocity_scaling_factor velocity scaling of the motion
+   * @param grasp_plan resulting grasp plan
+   * @return true if a grasp plan passing the joint error check was found
+   */
+  bool planGraspAhead(const moveit::planning_interface::MoveGroupInterface::Plan &approach_plan,
+      const geometry_msgs::PoseStamped &grasp_pose, double velocity_scaling_factor,
+      moveit::planning_interface::MoveGroupInterface::Plan &grasp_plan);
+
+  /**
+   * @brief Check whether the arm ended where a plan predicted, within the pipeline tolerance.
+   * @param plan executed plan
+   * @return true if every joint is within tolerance of the plan's final point
+   */
+  bool reachedPlanEnd(const moveit::planning_interface::MoveGroupInterface::Plan &plan);
+
+  /**
+   * @brief Summed joint displacement between the start and middle of a plan, large for roundabout plans.
+   * @param plan plan to check
+   * @return joint displacement, in radians
+   */
+  static double midpointJointError(const moveit::planning_interface::MoveGroupInterface::Plan &plan);
+
   /**
    * @brief Use the toggle_gripper_collisions service to allow/disallow collisions
    * with a specified object
@@ -99,6 +151,39 @@ private:
    */
   bool addObject(fetch_grasp_suggestion::AddObject::Request &req, fetch_grasp_suggestion::AddObject::Response &res);
 
+  /**
+   * @brief Synchronize the segmented collision objects in the MoveIt! planning scene with a new set of objects.
+   *
+   * Collision objects are keyed by object tracker id.  New and changed objects are added (replacing the old shape),
+   * unchanged objects are left alone, and removed objects are removed, all in a single planning scene diff.  Objects
+   * removed for a grasp stay out of the scene until the tracker reports them changed or removed.
+   * @param req tracked objects currently in the scene, and ids of objects that have left it
+   * @param res counts of added, updated, and removed collision objects
+   * @return true on service call success
+   */
+  bool updateObjects(fetch_grasp_suggestion::UpdateObjects::Request &req,
+      fetch_grasp_suggestion::UpdateObjects::Response &res);
+
+  /**
+   * @brief Apply collision object operations to the MoveIt! planning scene as one diff.
+   * @param collision_objects collision object operations
+   * @return true if the planning scene accepted the diff
+   */
+  bool applyCollisionObjects(const std::vector<moveit_msgs::CollisionObject> &collision_objects);
+
+  /**
+   * @brief Remove the segmented collision object being grasped, so it does not collide with the object attached to
+   * the gripper.
+   * @param grasp_pose grasp pose on the object
+   * @return true if an object was found near the grasp pose and removed
+   */
+  bool removeGraspedObject(const geometry_msgs::PoseStamped &grasp_pose);
+
+  /**
+   * @brief Remove all segmented collision objects from the MoveIt! planning scene.
+   */
+  void removeSceneObjects();
+
   /**
    * @brief Clear all added objects from the MoveIt! planning scene (service callback).
    * @param req empty request
@@ -130,8 +215,10 @@ private:
 
   //services
   ros::ServiceServer add_object_server_;
+  ros::ServiceServer update_objects_server_;
   ros::ServiceServer clear_objects_server_;
   ros::ServiceServer drop_object_server_;
+  ros::ServiceClient apply_planning_scene_client_;
   ros::ServiceClient compute_cartesian_path_client_;
   ros::ServiceClient detach_objects_client_;
   ros::ServiceClient toggle_gripper_collisions_client_;
@@ -148,8 +235,18 @@ private:
 
   boost::mutex object_mutex_;
 
+  //bounding boxes of the collision objects added from segmentation, keyed by object tracker id
+  boost::mutex scene_objects_mutex_;
+  std::map<uint32_t, fetch_grasp_suggestion::BoundingBox> scene_boxes_;
+  std::set<uint32_t> grasped_ids_;  // removed for a grasp, kept out until the tracker reports them changed
+  std::string fixed_frame_;  // frame the tracker decides changes in, so unchanged objects stay put as the base moves
+  double grasped_object_distance_;
+  bool use_convex_hulls_;
+  ConvexHullGenerator hull_generator_;
+
   //MoveIt interfaces
   moveit::planning_interface::MoveGroupInterface *arm_group_;
+  ParallelPlanner *planner_;
 
   tf2_ros::TransformBroadcaster tf_broadcaster_;
   tf2_ros::Buffer tf_buffer_;
@@ -161,6 +258,8 @@ private:
   std::vector<std::string> gripper_names_;
 
   bool plan_mode_;
+  bool pipeline_mode_;  // plan the grasp while the approach executes
+  double pipeline_tolerance_;  // largest joint deviation from the predicted approach end that keeps the grasp plan
 };
 
 #endif  // FETCH_GRASP_SUGGESTION_EXECUTOR_H
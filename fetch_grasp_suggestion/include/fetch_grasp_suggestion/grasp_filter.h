@@ -0,0 +1,117 @@
+#ifndef FETCH_GRASP_SUGGESTION_GRASP_FILTER_H
+#define FETCH_GRASP_SUGGESTION_GRASP_FILTER_H
+
+// C++
+#include <string>
+#include <vector>
+
+// Eigen
+#include <Eigen/Geometry>
+
+// ROS
+#include <eigen_stl_containers/eigen_stl_vector_container.h>
+#include <fetch_grasp_suggestion/RankedGraspList.h>
+#include <geometry_msgs/PoseArray.h>
+#include <geometry_msgs/PoseStamped.h>
+#include <moveit/kinematics_base/kinematics_base.h>
+#include <moveit/planning_scene/planning_scene.h>
+#include <moveit/planning_scene_monitor/planning_scene_monitor.h>
+#include <moveit/robot_model_loader/robot_model_loader.h>
+#include <moveit_msgs/MoveItErrorCodes.h>
+#include <ros/ros.h>
+#include <tf2_ros/buffer.h>
+#include <tf2_ros/transform_listener.h>
+
+/**
+ * @brief Kinematic validation of ranked grasps against the current MoveIt! planning scene.
+ *
+ * For every grasp, the two wrist poses the executor moves to are checked for an inverse kinematics solution that is
+ * valid in the planning scene: the approach pose, backed off along the grasp's x axis, and the grasp pose itself.
+ * The grasp pose is seeded from the approach solution and checked with the gripper allowed to touch the scene, as it
+ * is during execution.  Grasps are split across worker threads that each own an IK solver instance, and the robot
+ * model is loaded once, at construction.  Failing grasps are dropped or moved behind the valid ones, keeping the
+ * ranked order within each group.
+ */
+class GraspFilter
+{
+
+public:
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+  enum Validity
+  {
+    VALID = 0,
+    GRASP_INVALID = 1,  /// approach pose reachable, grasp pose not
+    APPROACH_INVALID = 2
+  };
+
+  /**
+   * @brief Load the robot model and IK solvers.
+   * @param pnh private node handle of the owning node, for the grasp filter parameters
+   */
+  GraspFilter(ros::NodeHandle &pnh);
+
+  /**
+   * @return false if the robot model or IK solvers could not be loaded, in which case grasps are left as they are
+   */
+  bool isReady() const { return !solvers_.empty(); }
+
+  /**
+   * @brief Demote (or drop) grasps that cannot be reached without collision.
+   * @param grasps ranked gripper_link grasp poses, reordered in place
+   */
+  void filter(geometry_msgs::PoseArray &grasps);
+
+  /**
+   * @brief Demote (or drop) grasps that cannot be reached without collision.
+   * @param grasps ranked grasps, reordered in place
+   */
+  void filter(fetch_grasp_suggestion::RankedGraspList &grasps);
+
+  /**
+   * @brief Check the approach and grasp poses of a set of grasps in parallel.
+   * @param grasps gripper_link grasp poses
+   * @param validity result for each grasp
+   * @return false if the planning scene or the grasp frames were unavailable
+   */
+  bool validate(const std::vector<geometry_msgs::PoseStamped> &grasps, std::vector<Validity> &validity);
+
+private:
+  /**
+   * @brief Grasp indices in their new order, valid grasps first.
+   */
+  std::vector<size_t> order(const std::vector<Validity> &validity) const;
+
+  void validateRange(size_t worker, size_t stride, const planning_scene::PlanningScene *scene,
+      const planning_scene::PlanningScene *grasp_scene, const EigenSTL::vector_Affine3d *approach_poses,
+      const EigenSTL::vector_Affine3d *grasp_poses, std::vector<Validity> *validity);
+
+  /**
+   * @brief Solve IK for the solver tip, seeded from and written back to state.
+   */
+  bool solveIK(const kinematics::KinematicsBasePtr &solver, robot_state::RobotState &state,
+      const Eigen::Affine3d &tip_pose, const planning_scene::PlanningScene &scene) const;
+
+  void checkSolution(robot_state::RobotState &state, const planning_scene::PlanningScene &scene,
+      const geometry_msgs::Pose &ik_pose, const std::vector<double> &solution,
+      moveit_msgs::MoveItErrorCodes &error_code) const;
+
+  robot_model_loader::RobotModelLoaderPtr robot_model_loader_;
+  planning_scene_monitor::PlanningSceneMonitorPtr planning_scene_monitor_;
+  const robot_model::JointModelGroup *group_;
+  std::vector<kinematics::KinematicsBasePtr> solvers_;  /// one per worker thread
+  std::string base_frame_;  /// IK solver base link
+  std::string tip_link_;  /// IK solver tip link
+  Eigen::Affine3d gripper_to_tip_;
+
+  tf2_ros::Buffer tf_buffer_;
+  tf2_ros::TransformListener tf_listener_;
+
+  std::vector<std::string> gripper_names_;
+  std::string group_name_;
+  double approach_distance_;
+  double ik_timeout_;
+  bool drop_invalid_;
+};
+
+#endif  // FETCH_GRASP_SUGGESTION_GRASP_FILTER_H
@@ -9,6 +9,7 @@
 #include <actionlib/server/simple_action_server.h>
 #include <eigen_conversions/eigen_msg.h>
 #include <fetch_grasp_suggestion/common.h>
+#include <fetch_grasp_suggestion/grasp_filter.h>
 #include <fetch_grasp_suggestion/RetrieveGrasps.h>
 #include <pcl_ros/point_cloud.h>
 #include <pcl_ros/transforms.h>
@@ -86,6 +87,9 @@ private:
     // Point Cloud
     std::string cloud_topic_;
 
+    // Kinematic validation of the ranked grasps, NULL if disabled
+    GraspFilter *grasp_filter_;
+
     // Params that can be set
     double min_grasp_depth_, max_grasp_depth_;
     std::string desired_grasp_frame_;
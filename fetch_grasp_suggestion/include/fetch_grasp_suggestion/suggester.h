@@ -12,10 +12,11 @@
 #include <actionlib/client/simple_action_client.h>
 #include <actionlib/server/simple_action_server.h>
 #include <eigen_conversions/eigen_msg.h>
-#include <fetch_grasp_suggestion/AddObject.h>
 #include <fetch_grasp_suggestion/common.h>
+#include <fetch_grasp_suggestion/grasp_filter.h>
 #include <fetch_grasp_suggestion/ClassifyAll.h>
 #include <fetch_grasp_suggestion/SuggestGraspsAction.h>
+#include <fetch_grasp_suggestion/UpdateObjects.h>
 #include <rail_manipulation_msgs/PairwiseRank.h>
 
 
@@ -26,6 +27,7 @@
 #include <rail_manipulation_msgs/GraspFeedback.h>
 #include <rail_manipulation_msgs/SegmentedObjectList.h>
 #include <rail_manipulation_msgs/SuggestGrasps.h>
+#include <rail_segmentation_tools/TrackedObjectList.h>
 #include <ros/ros.h>
 #include <std_srvs/Empty.h>
 #include <tf_conversions/tf_eigen.h>
@@ -77,6 +79,12 @@ private:
    */
   void objectsCallback(const rail_manipulation_msgs::SegmentedObjectList &list);
 
+  /**
+   * @brief Synchronize the executor's collision objects with the objects reported by the object tracker.
+   * @param list tracked objects, with their ids and what changed since the last report
+   */
+  void trackedObjectsCallback(const rail_segmentation_tools::TrackedObjectList &list);
+
   /**
    * @brief Calculate grasp suggestions given a segmented point cloud.
    * @param req input point cloud
@@ -239,11 +247,11 @@ private:
   // topics
   ros::Publisher grasps_publisher_;
   ros::Subscriber objects_subscriber_;
+  ros::Subscriber tracked_objects_subscriber_;
   ros::Subscriber grasp_feedback_subscriber_;
 
   // services
-  ros::ServiceClient clear_objects_client_;
-  ros::ServiceClient add_object_client_;
+  ros::ServiceClient update_objects_client_;
   ros::ServiceClient classify_all_client_;
   ros::ServiceServer suggest_grasps_service_;
   ros::ServiceServer suggest_grasps_baseline_service_;
@@ -261,6 +269,8 @@ private:
 
   tf::TransformListener tf_listener_;
 
+  GraspFilter *grasp_filter_;  /// kinematic validation of ranked grasps, NULL if disabled
+
   boost::mutex stored_grasp_mutex_;  /// mutex for suggested grasp list (service workflow)
   boost::mutex object_list_mutex_;  /// mutex for segmented object list (actionlib workflow)
 
@@ -82,34 +82,18 @@ void ClutteredSceneDemo::runCallback(const std_msgs::Empty &msg)
       crop_box.filter(*cropped_cloud);
 
       // detect table
-      pcl::SACSegmentation<pcl::PointXYZRGB> plane_seg;
-      pcl::ModelCoefficients::Ptr table_coefficients(new pcl::ModelCoefficients);
-      pcl::PointIndices::Ptr table_inliers(new pcl::PointIndices);
-      // segmentation parameters
-      plane_seg.setOptimizeCoefficients(true);
-      plane_seg.setModelType(pcl::SACMODEL_PERPENDICULAR_PLANE);
-      plane_seg.setAxis(Eigen::Vector3f(0, 0, 1));
-      plane_seg.setEpsAngle(0.15);
-      plane_seg.setMethodType(pcl::SAC_RANSAC);
-      plane_seg.setMaxIterations(100);
-      plane_seg.setDistanceThreshold(0.01);
-      // segmentation
-      plane_seg.setInputCloud(cropped_cloud);
-      plane_seg.segment(*table_inliers, *table_coefficients);
-      // extract table
-      pcl::ExtractIndices<pcl::PointXYZRGB> extract_table;
-      pcl::PointCloud<pcl::PointXYZRGB>::Ptr table_cloud(new pcl::PointCloud<pcl::PointXYZRGB>);
-      extract_table.setInputCloud(cropped_cloud);
-      extract_table.setIndices(table_inliers);
-      extract_table.setNegative(false);
-      extract_table.filter(*table_cloud);
-      // get table height
-      pcl::PointXYZRGB min_table, max_table;
-      pcl::getMinMax3D(*table_cloud, min_table, max_table);
+      TablePlaneEstimator::Plane table_plane;
+      if (!table_estimator_.estimate(*cropped_cloud, Eigen::Affine3f::Identity(), table_plane))
+      {
+        ROS_INFO("Could not find the table, stopping execution.");
+        return;
+      }
+      ROS_INFO("Found table at height %f (%s).", table_plane.center.z(),
+               table_plane.warm_started ? "refined previous plane" : "RANSAC");
 
       // re-crop above table
       pcl::PointCloud<pcl::PointXYZRGB>::Ptr table_cropped_cloud(new pcl::PointCloud<pcl::PointXYZRGB>);
-      min_point[2] = max_table.z + .001f;
+      min_point[2] = table_plane.center.z() + TablePlaneEstimator::DEFAULT_DISTANCE_THRESHOLD + .001f;
       crop_box.setMin(min_point);
       crop_box.filter(*table_cropped_cloud);
 
@@ -10,6 +10,9 @@ const float MAX_VELOCITY_SCALING_FACTOR = 0.3;
 // Default max velocity for velocities sent to the /cmd_vel topic
 const float CARTESIAN_MOVE_VELOCITY = 0.7;
 
+// Largest midpoint joint error accepted for a grasp plan
+const double GRASP_JOINT_ERROR_THRESHOLD = 0.75;  // TODO: this may need tuning to be more lenient in accepting plans
+
 Executor::Executor() :
     pnh_("~"),
     tf_listener_(tf_buffer_),
@@ -20,7 +23,15 @@ Executor::Executor() :
     drop_pose_server_(pnh_, "drop_position", boost::bind(&Executor::dropPosition, this, _1), false),
     preset_pose_server_(pnh_, "preset_position", boost::bind(&Executor::presetPosition, this, _1), false)
 {
+  int max_hull_triangles;
   pnh_.param("plan_final_execution", plan_mode_, false);
+  pnh_.param("pipeline_grasp_planning", pipeline_mode_, false);
+  pnh_.param("pipeline_tolerance", pipeline_tolerance_, 0.01);
+  pnh_.param("grasped_object_distance", grasped_object_distance_, 0.05);
+  pnh_.param("use_convex_hulls", use_convex_hulls_, true);
+  pnh_.param<std::string>("fixed_frame", fixed_frame_, "odom");
+  pnh_.param("max_hull_triangles", max_hull_triangles, ConvexHullGenerator::DEFAULT_MAX_TRIANGLES);
+  hull_generator_ = ConvexHullGenerator(max_hull_triangles);
 
   gripper_names_.push_back("gripper_link");
   gripper_names_.push_back("l_gripper_finger_link");
@@ -54,12 +65,14 @@ Executor::Executor() :
   arm_group_ = new moveit::planning_interface::MoveGroupInterface("arm");
   arm_group_->startStateMonitor();
   arm_group_->setMaxVelocityScalingFactor(MAX_VELOCITY_SCALING_FACTOR);
+  planner_ = new ParallelPlanner(pnh_);
 
   test1_ = pnh_.advertise<geometry_msgs::PoseStamped>("pose1", 1);
   test2_ = pnh_.advertise<geometry_msgs::PoseStamped>("pose2", 1);
 
   cartesian_pub_ = n_.advertise<geometry_msgs::TwistStamped>("/arm_controller/cartesian_twist/command", 10);
 
+  apply_planning_scene_client_ = n_.serviceClient<moveit_msgs::ApplyPlanningScene>("/apply_planning_scene");
   compute_cartesian_path_client_ = n_.serviceClient<moveit_msgs::GetCartesianPath>("/compute_cartesian_path");
   detach_objects_client_ = n_.serviceClient<std_srvs::Empty>("/collision_scene_manager/detach_objects");
   toggle_gripper_collisions_client_ = n_.serviceClient<manipulation_actions::ToggleGripperCollisions>
@@ -68,6 +81,7 @@ Executor::Executor() :
   attach_arbitrary_object_client_ = n_.serviceClient<manipulation_actions::AttachArbitraryObject>
       ("/collision_scene_manager/attach_arbitrary_object");
   add_object_server_ = pnh_.advertiseService("add_object", &Executor::addObject, this);
+  update_objects_server_ = pnh_.advertiseService("update_objects", &Executor::updateObjects, this);
   clear_objects_server_ = pnh_.advertiseService("clear_objects", &Executor::clearObjects, this);
   drop_object_server_ = pnh_.advertiseService("drop_object", &Executor::dropObjectCallback, this);
 
@@ -83,11 +97,6 @@ void Executor::prepareRobot(const fetch_grasp_suggestion::PresetMoveGoalConstPtr
 
   ROS_INFO("Preparing robot for exciting grasp action...");
 
-  arm_group_->setPlannerId("arm[RRTConnectkConfigDefault]");
-  arm_group_->setPlanningTime(1.5);
-  arm_group_->setStartStateToCurrentState();
-  arm_group_->setJointValueTarget(ready_pose_);
-
   // Plan and execute while checking for preempts
   if (prepare_robot_server_.isPreemptRequested())
   {
@@ -95,7 +104,7 @@ void Executor::prepareRobot(const fetch_grasp_suggestion::PresetMoveGoalConstPtr
     result.success = false;
     prepare_robot_server_.setPreempted(result);
   }
-  result.error_code = arm_group_->move().val;
+  result.error_code = moveToJoints(ready_pose_, "ready_pose", MAX_VELOCITY_SCALING_FACTOR);
   if (result.error_code == moveit_msgs::MoveItErrorCodes::PREEMPTED)
   {
     ROS_INFO("Preempted from MoveIt! while moving to ready pose. Aborting");
@@ -122,18 +131,13 @@ void Executor::dropPosition(const fetch_grasp_suggestion::PresetMoveGoalConstPtr
 
   ROS_INFO("Preparing robot for object dropoff...");
 
-  arm_group_->setPlannerId("arm[RRTConnectkConfigDefault]");
-  arm_group_->setPlanningTime(1.5);
-  arm_group_->setStartStateToCurrentState();
-  arm_group_->setJointValueTarget(drop_pose_);
-
   if (drop_pose_server_.isPreemptRequested())
   {
     ROS_INFO("Preempted while moving to ready pose.");
     result.success = false;
     prepare_robot_server_.setPreempted(result);
   }
-  result.error_code = arm_group_->move().val;
+  result.error_code = moveToJoints(drop_pose_, "drop_pose", MAX_VELOCITY_SCALING_FACTOR);
   if (result.error_code == moveit_msgs::MoveItErrorCodes::SUCCESS)
   {
     ROS_INFO("Ready to drop object!");
@@ -164,13 +168,20 @@ void Executor::presetPosition(const fetch_grasp_suggestion::PresetJointsMoveGoal
   preset_pose.name = goal->name;
   preset_pose.position = goal->position;
 
-  arm_group_->setPlannerId("arm[RRTConnectkConfigDefault]");
-  arm_group_->setPlanningTime(1.5);
-  arm_group_->setStartStateToCurrentState();
-  arm_group_->setJointValueTarget(preset_pose);
+  double velocity_scaling_factor = MAX_VELOCITY_SCALING_FACTOR;
   if (goal->max_velocity_scaling_factor > 0)
   {
     arm_group_->setMaxVelocityScalingFactor(goal->max_velocity_scaling_factor);
+    velocity_scaling_factor = goal->max_velocity_scaling_factor;
+  }
+
+  // presets are named by their joint values, so each one gets its own cached path
+  stringstream goal_id;
+  goal_id << "preset";
+  goal_id.precision(3);
+  for (size_t i = 0; i < preset_pose.position.size(); i ++)
+  {
+    goal_id << "_" << std::fixed << preset_pose.position[i];
   }
 
   if (preset_pose_server_.isPreemptRequested())
@@ -181,7 +192,7 @@ void Executor::presetPosition(const fetch_grasp_suggestion::PresetJointsMoveGoal
     arm_group_->setMaxVelocityScalingFactor(MAX_VELOCITY_SCALING_FACTOR);
     return;
   }
-  result.error_code = arm_group_->move().val;
+  result.error_code = moveToJoints(preset_pose, goal_id.str(), velocity_scaling_factor);
   if (result.error_code != moveit_msgs::MoveItErrorCodes::SUCCESS)
   {
     ROS_INFO("Failed to move to preset pose.");
@@ -199,6 +210,115 @@ void Executor::presetPosition(const fetch_grasp_suggestion::PresetJointsMoveGoal
   arm_group_->setMaxVelocityScalingFactor(MAX_VELOCITY_SCALING_FACTOR);
 }
 
+int Executor::moveToJoints(const sensor_msgs::JointState &joints, const string &goal_id,
+    double velocity_scaling_factor)
+{
+  if (planner_->isReady())
+  {
+    moveit::planning_interface::MoveGroupInterface::Plan joints_plan;
+    moveit::planning_interface::MoveItErrorCode error_code = planner_->plan(joints, joints_plan, 1.5,
+                                                                             velocity_scaling_factor, goal_id);
+    if (error_code.val != moveit_msgs::MoveItErrorCodes::SUCCESS)
+    {
+      return error_code.val;
+    }
+    return arm_group_->execute(joints_plan).val;
+  }
+
+  arm_group_->setPlannerId("arm[RRTConnectkConfigDefault]");
+  arm_group_->setPlanningTime(1.5);
+  arm_group_->setStartStateToCurrentState();
+  arm_group_->setJointValueTarget(joints);
+  return arm_group_->move().val;
+}
+
+void Executor::executePlan(const moveit::planning_interface::MoveGroupInterface::Plan &plan, int *error_code)
+{
+  *error_code = arm_group_->execute(plan).val;
+}
+
+bool Executor::planGraspAhead(const moveit::planning_interface::MoveGroupInterface::Plan &approach_plan,
+    const geometry_msgs::PoseStamped &grasp_pose, double velocity_scaling_factor,
+    moveit::planning_interface::MoveGroupInterface::Plan &grasp_plan)
+{
+  const trajectory_msgs::JointTrajectory &approach = approach_plan.trajectory_.joint_trajectory;
+  if (approach.points.empty())
+  {
+    return false;
+  }
+
+  //the approach leaves everything but the arm where it is now
+  moveit_msgs::RobotState predicted_state;
+  predicted_state.is_diff = true;
+  predicted_state.joint_state.name = approach.joint_names;
+  predicted_state.joint_state.position = approach.points.back().positions;
+
+  planner_->setStartState(predicted_state);
+  moveit::planning_interface::MoveItErrorCode plan_result = planner_->plan(grasp_pose, "wrist_roll_link",
+                                                                           grasp_plan, 1.5, velocity_scaling_factor);
+  planner_->setStartStateToCurrentState();
+  if (plan_result.val != moveit::planning_interface::MoveItErrorCode::SUCCESS)
+  {
+    ROS_INFO("Could not plan the grasp during the approach, will plan it afterwards.");
+    return false;
+  }
+
+  double joint_error_check = midpointJointError(grasp_plan);
+  if (joint_error_check > GRASP_JOINT_ERROR_THRESHOLD)
+  {
+    ROS_INFO("Grasp planned during the approach failed the joint error check (%f), will plan it afterwards.",
+             joint_error_check);
+    return false;
+  }
+  return true;
+}
+
+bool Executor::reachedPlanEnd(const moveit::planning_interface::MoveGroupInterface::Plan &plan)
+{
+  robot_state::RobotStatePtr current_state = arm_group_->getCurrentState();
+  const trajectory_msgs::JointTrajectory &trajectory = plan.trajectory_.joint_trajectory;
+  if (!current_state || trajectory.points.empty())
+  {
+    return false;
+  }
+
+  for (size_t i = 0; i < trajectory.joint_names.size(); i++)
+  {
+    const robot_model::JointModel *joint = current_state->getJointModel(trajectory.joint_names[i]);
+    if (joint == NULL || joint->getVariableCount() != 1)
+    {
+      continue;
+    }
+    double predicted = trajectory.points.back().positions[i];
+    double actual = current_state->getVariablePosition(trajectory.joint_names[i]);
+    double deviation = joint->distance(&predicted, &actual);
+    if (deviation > pipeline_tolerance_)
+    {
+      ROS_INFO("Approach ended %f from its plan at %s, replanning the grasp.", deviation,
+               trajectory.joint_names[i].c_str());
+      return false;
+    }
+  }
+  return true;
+}
+
+double Executor::midpointJointError(const moveit::planning_interface::MoveGroupInterface::Plan &plan)
+{
+  const trajectory_msgs::JointTrajectory &trajectory = plan.trajectory_.joint_trajectory;
+  if (trajectory.points.empty())
+  {
+    return 0.0;
+  }
+
+  size_t check_index = static_cast<size_t>(trajectory.points.size() / 2.0);
+  double joint_error_check = 0.0;
+  for (size_t i = 0; i < trajectory.joint_names.size(); i++)
+  {
+    joint_error_check += fabs(trajectory.points[0].positions[i] - trajectory.points[check_index].positions[i]);
+  }
+  return joint_error_check;
+}
+
 void Executor::executeGrasp(const fetch_grasp_suggestion::ExecuteGraspGoalConstPtr &goal)
 {
   boost::mutex::scoped_lock lock(object_mutex_);
@@ -267,9 +387,11 @@ void Executor::executeGrasp(const fetch_grasp_suggestion::ExecuteGraspGoalConstP
   arm_group_->setPlanningTime(1.5);
   arm_group_->setStartStateToCurrentState();
   arm_group_->setPoseTarget(transformed_approach_pose, "wrist_roll_link");
+  double velocity_scaling_factor = MAX_VELOCITY_SCALING_FACTOR;
   if (goal->max_velocity_scaling_factor > 0)
   {
     arm_group_->setMaxVelocityScalingFactor(goal->max_velocity_scaling_factor);
+    velocity_scaling_factor = goal->max_velocity_scaling_factor;
   }
 
   //send the goal, and also check for preempts
@@ -282,7 +404,53 @@ void Executor::executeGrasp(const fetch_grasp_suggestion::ExecuteGraspGoalConstP
     execute_grasp_server_.setPreempted(result);
     return;
   }
-  result.error_code = arm_group_->move().val;
+  moveit::planning_interface::MoveGroupInterface::Plan grasp_plan;
+  bool grasp_planned_ahead = false;
+  if (planner_->isReady())
+  {
+    moveit::planning_interface::MoveGroupInterface::Plan approach_plan;
+    result.error_code = planner_->plan(transformed_approach_pose, "wrist_roll_link", approach_plan, 1.5,
+                                       velocity_scaling_factor).val;
+    if (result.error_code == moveit_msgs::MoveItErrorCodes::SUCCESS && pipeline_mode_ && plan_mode_)
+    {
+      //plan the grasp from the end of the approach while the arm is still moving there
+      boost::thread approach_execution(boost::bind(&Executor::executePlan, this, boost::cref(approach_plan),
+                                                   &result.error_code));
+      toggleGripperCollisions(
+          goal->index >= 0
+          ? manipulation_actions::ToggleGripperCollisions::Request::ALL_OBJECTS_NAME
+          : manipulation_actions::ToggleGripperCollisions::Request::OCTOMAP_NAME,
+          true
+      );
+      grasp_planned_ahead = planGraspAhead(approach_plan, transformed_grasp_pose, velocity_scaling_factor,
+                                           grasp_plan);
+      approach_execution.join();
+
+      if (result.error_code != moveit_msgs::MoveItErrorCodes::SUCCESS)
+      {
+        //the approach may be retried below, which must not ignore gripper collisions
+        toggleGripperCollisions(
+            goal->index >= 0
+            ? manipulation_actions::ToggleGripperCollisions::Request::ALL_OBJECTS_NAME
+            : manipulation_actions::ToggleGripperCollisions::Request::OCTOMAP_NAME,
+            false
+        );
+        grasp_planned_ahead = false;
+      }
+      else if (grasp_planned_ahead && !reachedPlanEnd(approach_plan))
+      {
+        grasp_planned_ahead = false;
+      }
+    }
+    else if (result.error_code == moveit_msgs::MoveItErrorCodes::SUCCESS)
+    {
+      result.error_code = arm_group_->execute(approach_plan).val;
+    }
+  }
+  else
+  {
+    result.error_code = arm_group_->move().val;
+  }
   if (result.error_code == moveit_msgs::MoveItErrorCodes::PREEMPTED)
   {
     ROS_INFO("Preempted from MoveIt! while moving to approach pose. Aborting");
@@ -346,25 +514,38 @@ void Executor::executeGrasp(const fetch_grasp_suggestion::ExecuteGraspGoalConstP
     //linear plan to grasp pose
     test1_.publish(transformed_grasp_pose);
 
+    if (grasp_planned_ahead)
+    {
+      ROS_INFO("Using the grasp plan computed during the approach.");
+    }
+
     // Try planning and replanning a few times before failing
     int max_planning_attempts = 3;
-    moveit::planning_interface::MoveGroupInterface::Plan grasp_plan;
-    for (int num_attempts = 0; num_attempts < max_planning_attempts; num_attempts++)
+    for (int num_attempts = 0; num_attempts < max_planning_attempts && !grasp_planned_ahead; num_attempts++)
     {
       ROS_INFO("Attempting to plan path to grasp. Attempt: %d/%d",
                num_attempts + 1, max_planning_attempts);
 
       // calculate short-distance plan to final grasp pose
-      arm_group_->setPlannerId("arm[RRTConnectkConfigDefault]");
-      arm_group_->setPlanningTime(1.5);
-      arm_group_->setStartStateToCurrentState();
-      arm_group_->setPoseTarget(transformed_grasp_pose, "wrist_roll_link");
-      if (goal->max_velocity_scaling_factor > 0)
+      moveit::planning_interface::MoveItErrorCode plan_result;
+      if (planner_->isReady())
       {
-        arm_group_->setMaxVelocityScalingFactor(goal->max_velocity_scaling_factor);
+        plan_result = planner_->plan(transformed_grasp_pose, "wrist_roll_link", grasp_plan, 1.5,
+                                     velocity_scaling_factor);
+      }
+      else
+      {
+        arm_group_->setPlannerId("arm[RRTConnectkConfigDefault]");
+        arm_group_->setPlanningTime(1.5);
+        arm_group_->setStartStateToCurrentState();
+        arm_group_->setPoseTarget(transformed_grasp_pose, "wrist_roll_link");
+        if (goal->max_velocity_scaling_factor > 0)
+        {
+          arm_group_->setMaxVelocityScalingFactor(goal->max_velocity_scaling_factor);
+        }
+
+        plan_result = arm_group_->plan(grasp_plan);
       }
-
-      moveit::planning_interface::MoveItErrorCode plan_result = arm_group_->plan(grasp_plan);
       if (execute_grasp_server_.isPreemptRequested())
       {
         toggleGripperCollisions(
@@ -403,14 +584,7 @@ void Executor::executeGrasp(const fetch_grasp_suggestion::ExecuteGraspGoalConstP
       }
 
       // make sure the plan doesn't do some roundabout RRT thing...
-      size_t check_index = static_cast<size_t>(grasp_plan.trajectory_.joint_trajectory.points.size() / 2.0);
-      double joint_error_check = 0.0;
-      double joint_error_thresh = 0.75;  // TODO: this may need tuning to be more lenient in accepting plans
-      for (size_t i = 0; i < grasp_plan.trajectory_.joint_trajectory.joint_names.size(); i++)
-      {
-        joint_error_check += fabs(grasp_plan.trajectory_.joint_trajectory.points[0].positions[i]
-                                  - grasp_plan.trajectory_.joint_trajectory.points[check_index].positions[i]);
-      }
+      double joint_error_check = midpointJointError(grasp_plan);
       ROS_INFO("Joint error check on final grasp trajectory: %f", joint_error_check);
 
       if (execute_grasp_server_.isPreemptRequested())
@@ -428,7 +602,7 @@ void Executor::executeGrasp(const fetch_grasp_suggestion::ExecuteGraspGoalConstP
         result.failure_point = fetch_grasp_suggestion::ExecuteGraspResult::GRASP_PLAN;
         execute_grasp_server_.setPreempted(result);
         return;
-      } else if (joint_error_check > joint_error_thresh && num_attempts >= max_planning_attempts - 1)
+      } else if (joint_error_check > GRASP_JOINT_ERROR_THRESHOLD && num_attempts >= max_planning_attempts - 1)
       {
         toggleGripperCollisions(
             goal->index >= 0
@@ -443,7 +617,7 @@ void Executor::executeGrasp(const fetch_grasp_suggestion::ExecuteGraspGoalConstP
         result.failure_point = fetch_grasp_suggestion::ExecuteGraspResult::GRASP_PLAN;
         execute_grasp_server_.setAborted(result);
         return;
-      } else if (joint_error_check <= joint_error_thresh)
+      } else if (joint_error_check <= GRASP_JOINT_ERROR_THRESHOLD)
       {
         // This is valid. Exit the loop!
         break;
@@ -690,6 +864,9 @@ void Executor::executeGrasp(const fetch_grasp_suggestion::ExecuteGraspGoalConstP
     return;
   }
 
+  //the grasped object's segment would collide with the object attached below, so take it out of the scene
+  removeGraspedObject(grasp_pose);
+
   if (plan_mode_)
   {
     //reenable collisions on the gripper
@@ -792,9 +969,6 @@ void Executor::executeGrasp(const fetch_grasp_suggestion::ExecuteGraspGoalConstP
     }
   }
 
-  //sleep to allow the attachments to propagate
-  ros::Duration(0.2).sleep();
-
   // Linear planned move upwards. Replaced by the unplanned move above
 //  //linear move to post grasp pose
 //  moveit_msgs::GetCartesianPath lift_path;
@@ -953,16 +1127,238 @@ bool Executor::addObject(fetch_grasp_suggestion::AddObject::Request &req,
 
   // planning_scene_interface_->addCollisionObjects(collision_objects);
 
-  // NOTE: For Fetchit, the CollisionSceneManager will have made this redundant
-  ROS_INFO("NOOP: CollisionSceneManager will have updated the objects in the scene");
+  // NOTE: For Fetchit, segmented objects are kept in the scene by update_objects from the object tracker
+  ROS_INFO("NOOP: update_objects keeps the segmented objects in the scene");
+
+  return true;
+}
+
+bool Executor::updateObjects(fetch_grasp_suggestion::UpdateObjects::Request &req,
+    fetch_grasp_suggestion::UpdateObjects::Response &res)
+{
+  if (req.ids.size() != req.point_clouds.size() || req.changed.size() != req.point_clouds.size())
+  {
+    ROS_ERROR("Object update has %lu ids and %lu changed flags for %lu point clouds!", req.ids.size(),
+        req.changed.size(), req.point_clouds.size());
+    return false;
+  }
+
+  boost::mutex::scoped_lock lock(scene_objects_mutex_);
+
+  vector<moveit_msgs::CollisionObject> diff;
+  std::map<uint32_t, fetch_grasp_suggestion::BoundingBox> updated_boxes = scene_boxes_;
+  res.added = 0;
+  res.updated = 0;
+  res.removed = 0;
+
+  for (size_t i = 0; i < req.ids.size(); i ++)
+  {
+    //unchanged objects cost nothing, and a grasped object stays out until it is put down somewhere
+    bool known = scene_boxes_.count(req.ids[i]) > 0;
+    if (!req.changed[i] && (known || grasped_ids_.count(req.ids[i]) > 0))
+      continue;
+
+    //objects are placed in the tracker's fixed frame, since unchanged ones are never re-added as the base moves
+    sensor_msgs::PointCloud2 cloud;
+    try
+    {
+      geometry_msgs::TransformStamped cloud_transform = tf_buffer_.lookupTransform(fixed_frame_,
+          req.point_clouds[i].header.frame_id, req.point_clouds[i].header.stamp, ros::Duration(0.5));
+      Eigen::Affine3d cloud_to_fixed;
+      tf::transformMsgToEigen(cloud_transform.transform, cloud_to_fixed);
+      pcl_ros::transformPointCloud(cloud_to_fixed.matrix().cast<float>(), req.point_clouds[i], cloud);
+      cloud.header.frame_id = fixed_frame_;
+    }
+    catch (tf2::TransformException &ex)
+    {
+      ROS_WARN("Could not transform object %u to %s, skipping it this update: %s", req.ids[i], fixed_frame_.c_str(),
+          ex.what());
+      continue;
+    }
+
+    fetch_grasp_suggestion::BoundingBox box = BoundingBoxCalculator::computeBoundingBox(cloud);
+
+    //adding an existing id replaces its shape and pose
+    moveit_msgs::CollisionObject obj;
+    obj.header.frame_id = box.pose.header.frame_id;
+    stringstream ss;
+    ss << "segmented_object" << req.ids[i];
+    obj.id = ss.str();
+    obj.operation = moveit_msgs::CollisionObject::ADD;
+
+    //set object shape, falling back to the bounding box for flat or sparse clouds
+    shape_msgs::Mesh hull;
+    geometry_msgs::Pose hull_pose;
+    if (use_convex_hulls_ && hull_generator_.generate(cloud, hull, hull_pose))
+    {
+      obj.meshes.push_back(hull);
+      obj.mesh_poses.push_back(hull_pose);
+    }
+    else
+    {
+      shape_msgs::SolidPrimitive bounding_volume;
+      bounding_volume.type = shape_msgs::SolidPrimitive::BOX;
+      bounding_volume.dimensions.resize(3);
+      bounding_volume.dimensions[shape_msgs::SolidPrimitive::BOX_X] = box.dimensions.x;
+      bounding_volume.dimensions[shape_msgs::SolidPrimitive::BOX_Y] = box.dimensions.y;
+      bounding_volume.dimensions[shape_msgs::SolidPrimitive::BOX_Z] = box.dimensions.z;
+      obj.primitives.push_back(bounding_volume);
+      obj.primitive_poses.push_back(box.pose.pose);
+    }
+    diff.push_back(obj);
+
+    if (known)
+      res.updated ++;
+    else
+      res.added ++;
+    updated_boxes[req.ids[i]] = box;
+  }
+
+  for (size_t i = 0; i < req.removed_ids.size(); i ++)
+  {
+    std::map<uint32_t, fetch_grasp_suggestion::BoundingBox>::iterator it = updated_boxes.find(req.removed_ids[i]);
+    if (it == updated_boxes.end())
+      continue;
+
+    moveit_msgs::CollisionObject obj;
+    obj.header.frame_id = it->second.pose.header.frame_id;
+    stringstream ss;
+    ss << "segmented_object" << it->first;
+    obj.id = ss.str();
+    obj.operation = moveit_msgs::CollisionObject::REMOVE;
+    diff.push_back(obj);
+    res.removed ++;
+    updated_boxes.erase(it);
+  }
+
+  //grasped objects that have changed were added back above, and removed ones are gone for good
+  for (size_t i = 0; i < req.ids.size(); i ++)
+  {
+    if (req.changed[i])
+      grasped_ids_.erase(req.ids[i]);
+  }
+  for (size_t i = 0; i < req.removed_ids.size(); i ++)
+  {
+    grasped_ids_.erase(req.removed_ids[i]);
+  }
+
+  if (diff.empty())
+    return true;
+
+  if (!applyCollisionObjects(diff))
+  {
+    //the scene is unknown now, so everything is re-added on the next update
+    ROS_WARN("Could not apply the segmented object diff to the planning scene!");
+    removeSceneObjects();
+    return false;
+  }
+
+  scene_boxes_.swap(updated_boxes);
+  ROS_INFO("Updated planning scene objects: %d added, %d updated, %d removed, %lu in the scene.", res.added,
+      res.updated, res.removed, scene_boxes_.size());
+  return true;
+}
+
+bool Executor::applyCollisionObjects(const vector<moveit_msgs::CollisionObject> &collision_objects)
+{
+  moveit_msgs::ApplyPlanningScene apply_planning_scene;
+  apply_planning_scene.request.scene.is_diff = true;
+  apply_planning_scene.request.scene.robot_state.is_diff = true;
+  apply_planning_scene.request.scene.world.collision_objects = collision_objects;
+  return apply_planning_scene_client_.call(apply_planning_scene) && apply_planning_scene.response.success;
+}
+
+bool Executor::removeGraspedObject(const geometry_msgs::PoseStamped &grasp_pose)
+{
+  boost::mutex::scoped_lock lock(scene_objects_mutex_);
+
+  geometry_msgs::PoseStamped latest_grasp_pose = grasp_pose;
+  latest_grasp_pose.header.stamp = ros::Time(0);
+
+  //find the object whose bounding box is closest to the grasp point
+  std::map<uint32_t, fetch_grasp_suggestion::BoundingBox>::iterator grasped = scene_boxes_.end();
+  double min_distance = grasped_object_distance_;
+  for (std::map<uint32_t, fetch_grasp_suggestion::BoundingBox>::iterator it = scene_boxes_.begin();
+       it != scene_boxes_.end(); it ++)
+  {
+    geometry_msgs::PoseStamped box_grasp_pose;
+    try
+    {
+      tf_buffer_.transform(latest_grasp_pose, box_grasp_pose, it->second.pose.header.frame_id, ros::Duration(0.5));
+    }
+    catch (tf2::TransformException &ex)
+    {
+      ROS_WARN("%s", ex.what());
+      continue;
+    }
+
+    //distance from the grasp point to the oriented box, zero inside it
+    Eigen::Affine3d box_transform;
+    Eigen::Vector3d grasp_point;
+    tf::poseMsgToEigen(it->second.pose.pose, box_transform);
+    tf::pointMsgToEigen(box_grasp_pose.pose.position, grasp_point);
+    Eigen::Vector3d half_dimensions(it->second.dimensions.x/2.0, it->second.dimensions.y/2.0,
+                                    it->second.dimensions.z/2.0);
+    double distance = ((box_transform.inverse()*grasp_point).cwiseAbs() - half_dimensions).cwiseMax(0.0).norm();
+    if (distance <= min_distance)
+    {
+      min_distance = distance;
+      grasped = it;
+    }
+  }
+
+  if (grasped == scene_boxes_.end())
+    return false;
+
+  moveit_msgs::CollisionObject obj;
+  obj.header.frame_id = grasped->second.pose.header.frame_id;
+  stringstream ss;
+  ss << "segmented_object" << grasped->first;
+  obj.id = ss.str();
+  obj.operation = moveit_msgs::CollisionObject::REMOVE;
+  if (!applyCollisionObjects(vector<moveit_msgs::CollisionObject>(1, obj)))
+  {
+    ROS_WARN("Could not remove the grasped object %s from the planning scene!", obj.id.c_str());
+    return false;
+  }
 
+  ROS_INFO("Removed the grasped object %s from the planning scene.", obj.id.c_str());
+  grasped_ids_.insert(grasped->first);
+  scene_boxes_.erase(grasped);
   return true;
 }
 
+void Executor::removeSceneObjects()
+{
+  if (scene_boxes_.empty())
+    return;
+
+  vector<moveit_msgs::CollisionObject> collision_objects;
+  for (std::map<uint32_t, fetch_grasp_suggestion::BoundingBox>::const_iterator it = scene_boxes_.begin();
+       it != scene_boxes_.end(); it ++)
+  {
+    moveit_msgs::CollisionObject obj;
+    obj.header.frame_id = it->second.pose.header.frame_id;
+    stringstream ss;
+    ss << "segmented_object" << it->first;
+    obj.id = ss.str();
+    obj.operation = moveit_msgs::CollisionObject::REMOVE;
+    collision_objects.push_back(obj);
+  }
+  applyCollisionObjects(collision_objects);
+  scene_boxes_.clear();
+}
+
 bool Executor::clearObjects(std_srvs::Empty::Request &req, std_srvs::Empty::Response &res)
 {
   boost::mutex::scoped_lock lock(object_mutex_);
 
+  {
+    boost::mutex::scoped_lock scene_lock(scene_objects_mutex_);
+    removeSceneObjects();
+    grasped_ids_.clear();
+  }
+
   return this->clearAll();
 }
 
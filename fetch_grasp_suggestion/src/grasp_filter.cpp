@@ -0,0 +1,255 @@
+#include <fetch_grasp_suggestion/grasp_filter.h>
+
+// Boost
+#include <boost/thread/thread.hpp>
+
+// C++
+#include <algorithm>
+#include <map>
+
+// ROS
+#include <eigen_conversions/eigen_msg.h>
+#include <tf2_geometry_msgs/tf2_geometry_msgs.h>
+
+using std::map;
+using std::string;
+using std::vector;
+
+GraspFilter::GraspFilter(ros::NodeHandle &pnh) :
+    group_(NULL),
+    tf_listener_(tf_buffer_)
+{
+  int threads = std::max(1, static_cast<int>(boost::thread::hardware_concurrency()));
+  pnh.param<string>("grasp_filter_group", group_name_, "arm");
+  pnh.param<double>("grasp_filter_approach_distance", approach_distance_, 0.12);
+  pnh.param<double>("grasp_filter_ik_timeout", ik_timeout_, 0.05);
+  pnh.param<int>("grasp_filter_threads", threads, threads);
+  pnh.param<bool>("drop_invalid_grasps", drop_invalid_, false);
+
+  gripper_names_.push_back("gripper_link");
+  gripper_names_.push_back("l_gripper_finger_link");
+  gripper_names_.push_back("r_gripper_finger_link");
+
+  robot_model_loader_.reset(new robot_model_loader::RobotModelLoader("robot_description"));
+  robot_model::RobotModelConstPtr robot_model = robot_model_loader_->getModel();
+  if (!robot_model || !robot_model->hasJointModelGroup(group_name_) || !robot_model->hasLinkModel("gripper_link"))
+  {
+    ROS_WARN("Could not load group %s from the robot model, grasps will not be filtered.", group_name_.c_str());
+    return;
+  }
+  group_ = robot_model->getJointModelGroup(group_name_);
+
+  // the loader only hands out a cached solver that nobody else holds, so each worker gets its own instance
+  robot_model::SolverAllocatorFn allocator = robot_model_loader_->getKinematicsPluginLoader()->getLoaderFunction();
+  for (int i = 0; i < threads; i ++)
+  {
+    kinematics::KinematicsBasePtr solver = allocator(group_);
+    if (!solver)
+      break;
+    solvers_.push_back(solver);
+  }
+  if (solvers_.empty())
+  {
+    ROS_WARN("No IK solver for group %s, grasps will not be filtered.", group_name_.c_str());
+    return;
+  }
+
+  base_frame_ = solvers_[0]->getBaseFrame();
+  tip_link_ = solvers_[0]->getTipFrame();
+  if (!base_frame_.empty() && base_frame_[0] == '/')
+    base_frame_.erase(0, 1);
+  if (!tip_link_.empty() && tip_link_[0] == '/')
+    tip_link_.erase(0, 1);
+
+  // grasps are gripper_link poses, the solver works on its tip link, which is rigidly attached to the gripper
+  robot_state::RobotState state(robot_model);
+  state.setToDefaultValues();
+  state.update();
+  gripper_to_tip_ = state.getGlobalLinkTransform("gripper_link").inverse() * state.getGlobalLinkTransform(tip_link_);
+
+  planning_scene_monitor_.reset(new planning_scene_monitor::PlanningSceneMonitor(robot_model_loader_));
+}
+
+void GraspFilter::filter(geometry_msgs::PoseArray &grasps)
+{
+  vector<geometry_msgs::PoseStamped> poses(grasps.poses.size());
+  for (size_t i = 0; i < grasps.poses.size(); i ++)
+  {
+    poses[i].header = grasps.header;
+    poses[i].pose = grasps.poses[i];
+  }
+
+  vector<Validity> validity;
+  if (!validate(poses, validity))
+    return;
+
+  vector<size_t> indices = order(validity);
+  vector<geometry_msgs::Pose> filtered(indices.size());
+  for (size_t i = 0; i < indices.size(); i ++)
+  {
+    filtered[i] = grasps.poses[indices[i]];
+  }
+  grasps.poses.swap(filtered);
+}
+
+void GraspFilter::filter(fetch_grasp_suggestion::RankedGraspList &grasps)
+{
+  vector<geometry_msgs::PoseStamped> poses(grasps.grasps.size());
+  for (size_t i = 0; i < grasps.grasps.size(); i ++)
+  {
+    poses[i] = grasps.grasps[i].pose;
+  }
+
+  vector<Validity> validity;
+  if (!validate(poses, validity))
+    return;
+
+  vector<size_t> indices = order(validity);
+  vector<fetch_grasp_suggestion::RankedGrasp> filtered(indices.size());
+  for (size_t i = 0; i < indices.size(); i ++)
+  {
+    filtered[i] = grasps.grasps[indices[i]];
+  }
+  grasps.grasps.swap(filtered);
+}
+
+bool GraspFilter::validate(const vector<geometry_msgs::PoseStamped> &grasps, vector<Validity> &validity)
+{
+  if (!isReady() || grasps.empty())
+    return false;
+
+  ros::WallTime start_time = ros::WallTime::now();
+
+  if (!planning_scene_monitor_->requestPlanningSceneState())
+  {
+    ROS_WARN("Could not get the planning scene, grasps will not be filtered.");
+    return false;
+  }
+  planning_scene_monitor::LockedPlanningSceneRO locked_scene(planning_scene_monitor_);
+  planning_scene::PlanningSceneConstPtr scene = locked_scene;
+
+  // the executor lets the gripper touch objects and the octomap once it closes in from the approach pose
+  planning_scene::PlanningScenePtr grasp_scene = scene->diff();
+  vector<string> world_names = grasp_scene->getWorld()->getObjectIds();
+  world_names.push_back(planning_scene::PlanningScene::OCTOMAP_NS);
+  grasp_scene->getAllowedCollisionMatrixNonConst().setEntry(world_names, gripper_names_, true);
+
+  // solver tip poses in the planning frame
+  EigenSTL::vector_Affine3d approach_poses(grasps.size());
+  EigenSTL::vector_Affine3d grasp_poses(grasps.size());
+  map<string, geometry_msgs::TransformStamped> transforms;
+  for (size_t i = 0; i < grasps.size(); i ++)
+  {
+    const string &frame = grasps[i].header.frame_id;
+    if (transforms.find(frame) == transforms.end())
+    {
+      try
+      {
+        transforms[frame] = tf_buffer_.lookupTransform(scene->getPlanningFrame(), frame, ros::Time(0),
+                                                       ros::Duration(1.0));
+      }
+      catch (tf2::TransformException &ex)
+      {
+        ROS_WARN("Could not transform grasps to the planning frame, grasps will not be filtered: %s", ex.what());
+        return false;
+      }
+    }
+    geometry_msgs::PoseStamped grasp_pose;
+    tf2::doTransform(grasps[i], grasp_pose, transforms[frame]);
+
+    Eigen::Affine3d grasp_frame;
+    tf::poseMsgToEigen(grasp_pose.pose, grasp_frame);
+    approach_poses[i] = grasp_frame * Eigen::Translation3d(-approach_distance_, 0, 0) * gripper_to_tip_;
+    grasp_poses[i] = grasp_frame * gripper_to_tip_;
+  }
+
+  validity.assign(grasps.size(), APPROACH_INVALID);
+  size_t workers = std::min(solvers_.size(), grasps.size());
+  boost::thread_group threads;
+  for (size_t i = 0; i < workers; i ++)
+  {
+    threads.create_thread(boost::bind(&GraspFilter::validateRange, this, i, workers, scene.get(),
+                                      grasp_scene.get(), &approach_poses, &grasp_poses, &validity));
+  }
+  threads.join_all();
+
+  size_t valid = std::count(validity.begin(), validity.end(), VALID);
+  size_t grasp_invalid = std::count(validity.begin(), validity.end(), GRASP_INVALID);
+  ROS_INFO("Grasp filter: %lu of %lu grasps reachable, %lu reachable only at approach (%.3f s, %lu threads).",
+           valid, grasps.size(), grasp_invalid, (ros::WallTime::now() - start_time).toSec(), workers);
+  return true;
+}
+
+vector<size_t> GraspFilter::order(const vector<Validity> &validity) const
+{
+  // stable, so the ranking is kept within each validity level
+  vector<size_t> indices;
+  for (int level = VALID; level <= APPROACH_INVALID; level ++)
+  {
+    if (drop_invalid_ && level != VALID)
+      break;
+    for (size_t i = 0; i < validity.size(); i ++)
+    {
+      if (validity[i] == level)
+        indices.push_back(i);
+    }
+  }
+  return indices;
+}
+
+void GraspFilter::validateRange(size_t worker, size_t stride, const planning_scene::PlanningScene *scene,
+    const planning_scene::PlanningScene *grasp_scene, const EigenSTL::vector_Affine3d *approach_poses,
+    const EigenSTL::vector_Affine3d *grasp_poses, vector<Validity> *validity)
+{
+  const kinematics::KinematicsBasePtr &solver = solvers_[worker];
+  robot_state::RobotState state(scene->getCurrentState());
+  vector<double> current_positions;
+  state.copyJointGroupPositions(group_, current_positions);
+
+  for (size_t i = worker; i < validity->size(); i += stride)
+  {
+    state.setJointGroupPositions(group_, current_positions);
+    if (!solveIK(solver, state, (*approach_poses)[i], *scene))
+      continue;
+
+    // seeded from the approach solution, since the executor moves straight in from there
+    (*validity)[i] = solveIK(solver, state, (*grasp_poses)[i], *grasp_scene) ? VALID : GRASP_INVALID;
+  }
+}
+
+bool GraspFilter::solveIK(const kinematics::KinematicsBasePtr &solver, robot_state::RobotState &state,
+    const Eigen::Affine3d &tip_pose, const planning_scene::PlanningScene &scene) const
+{
+  geometry_msgs::Pose ik_pose;
+  tf::poseEigenToMsg(state.getGlobalLinkTransform(base_frame_).inverse() * tip_pose, ik_pose);
+
+  vector<double> seed, solution;
+  state.copyJointGroupPositions(group_, seed);
+  moveit_msgs::MoveItErrorCodes error_code;
+  if (!solver->searchPositionIK(ik_pose, seed, ik_timeout_, solution,
+                                boost::bind(&GraspFilter::checkSolution, this, boost::ref(state), boost::cref(scene),
+                                            _1, _2, _3),
+                                error_code))
+  {
+    return false;
+  }
+
+  state.setJointGroupPositions(group_, solution);
+  state.update();
+  return true;
+}
+
+void GraspFilter::checkSolution(robot_state::RobotState &state, const planning_scene::PlanningScene &scene,
+    const geometry_msgs::Pose &ik_pose, const vector<double> &solution, moveit_msgs::MoveItErrorCodes &error_code) const
+{
+  state.setJointGroupPositions(group_, solution);
+  state.update();
+  if (scene.isStateValid(state, group_name_))
+  {
+    error_code.val = moveit_msgs::MoveItErrorCodes::SUCCESS;
+  }
+  else
+  {
+    error_code.val = moveit_msgs::MoveItErrorCodes::GOAL_IN_COLLISION;
+  }
+}
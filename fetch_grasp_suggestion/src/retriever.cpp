@@ -16,6 +16,10 @@ Retriever::Retriever() :
   pn_.param<double>("max_grasp_depth", max_grasp_depth_, 0.03);
   pn_.param<bool>("debug", debug_, true);
 
+  bool filter_grasps;
+  pn_.param<bool>("filter_grasps", filter_grasps, true);
+  grasp_filter_ = filter_grasps ? new GraspFilter(pn_) : NULL;
+
   debug_pub_ = pn_.advertise<geometry_msgs::PoseArray>("debug_poses", 10);
   pose_pub_ = pn_.advertise<geometry_msgs::PoseStamped>("debug_center_pose", 1);
 //  pose2_pub_ = pn_.advertise<geometry_msgs::PoseStamped>("debug_center_pose2", 1);
@@ -79,6 +83,12 @@ bool Retriever::retrieveGraspsCallback(fetch_grasp_suggestion::RetrieveGrasps::R
   }
   ROS_INFO("%lu grasps remain after collision checking", res.grasp_list.poses.size());
 
+  // Move grasps the arm can't reach behind the rest (or drop them)
+  if (grasp_filter_)
+  {
+    grasp_filter_->filter(res.grasp_list);
+  }
+
   // get the current point cloud (for collision checking)
   ros::Time request_time = ros::Time::now();
   ros::Time point_cloud_time = request_time - ros::Duration(0.1);
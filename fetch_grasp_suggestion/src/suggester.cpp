@@ -15,22 +15,29 @@ Suggester::Suggester() :
     suggest_grasps_server_(pnh_, "get_grasp_suggestions", boost::bind(&Suggester::getGraspSuggestions, this, _1), false)
 {
   string segmentation_topic;
+  string tracked_objects_topic;
   pnh_.param<string>("segmentation_topic", segmentation_topic, "rail_segmentation/segmented_objects");
+  pnh_.param<string>("tracked_objects_topic", tracked_objects_topic, "object_tracker/tracked_objects");
   pnh_.param<string>("cloud_topic", cloud_topic_, "head_camera/depth_registered/points");
   pnh_.param<string>("file_name", filename_, "grasp_data");
   pnh_.param<double>("min_grasp_depth", min_grasp_depth_, -0.03);
   pnh_.param<double>("max_grasp_depth", max_grasp_depth_, 0.03);
 
+  bool filter_grasps;
+  pnh_.param<bool>("filter_grasps", filter_grasps, true);
+  grasp_filter_ = filter_grasps ? new GraspFilter(pnh_) : NULL;
+
   stringstream ss;
   ss << filename_ << ".csv";
   filename_ = ss.str();
 
-  clear_objects_client_ = n_.serviceClient<std_srvs::Empty>("executor/clear_objects");
-  add_object_client_ = n_.serviceClient<fetch_grasp_suggestion::AddObject>("executor/add_object");
+  update_objects_client_ = n_.serviceClient<fetch_grasp_suggestion::UpdateObjects>("executor/update_objects");
   classify_all_client_ = n_.serviceClient<fetch_grasp_suggestion::ClassifyAll>("classify_all");
 
   grasps_publisher_ = pnh_.advertise<fetch_grasp_suggestion::RankedGraspList>("grasps", 1);
   objects_subscriber_ = n_.subscribe(segmentation_topic, 1, &Suggester::objectsCallback, this);
+  //every report carries removals, so none can be dropped
+  tracked_objects_subscriber_ = n_.subscribe(tracked_objects_topic, 10, &Suggester::trackedObjectsCallback, this);
   grasp_feedback_subscriber_ = pnh_.subscribe("grasp_feedback", 1, &Suggester::graspFeedbackCallback, this);
 
   suggest_grasps_service_ = pnh_.advertiseService("suggest_grasps", &Suggester::suggestGraspsCallback, this);
@@ -128,6 +135,10 @@ bool Suggester::pairwiseRankCallback(rail_manipulation_msgs::PairwiseRank::Reque
 //  std::cout << end_time - start_time << std::endl;
 
   res.grasp_list = classify.response.grasp_list;
+  if (grasp_filter_)
+  {
+    grasp_filter_->filter(res.grasp_list);
+  }
 
   // TODO: this is moved here only for competition optimization
   // iteratively calculate grasp depth
@@ -213,6 +224,10 @@ bool Suggester::pairwiseRankSceneCallback(rail_manipulation_msgs::PairwiseRank::
   }
 
   res.grasp_list = classify.response.grasp_list;
+  if (grasp_filter_)
+  {
+    grasp_filter_->filter(res.grasp_list);
+  }
 
   return true;
 }
@@ -794,6 +809,11 @@ void Suggester::getGraspSuggestions(const fetch_grasp_suggestion::SuggestGraspsG
       }
     }
 
+    if (grasp_filter_)
+    {
+      grasp_filter_->filter(result.grasp_list);
+    }
+
     grasps_publisher_.publish(result.grasp_list);
   }
   else
@@ -1143,22 +1163,27 @@ bool Suggester::isInCollision(geometry_msgs::PoseStamped grasp, pcl::PointCloud<
 
 void Suggester::objectsCallback(const rail_manipulation_msgs::SegmentedObjectList &list)
 {
-  boost::mutex::scoped_lock lock(object_list_mutex_);
-
-  object_list_ = list;
-
-  //set up MoveIt collision objects
-  std_srvs::Empty clear;
-  clear_objects_client_.call(clear);
+  {
+    boost::mutex::scoped_lock lock(object_list_mutex_);
+    object_list_ = list;
+  }
+}
 
-  fetch_grasp_suggestion::AddObject add;
+void Suggester::trackedObjectsCallback(const rail_segmentation_tools::TrackedObjectList &list)
+{
+  //update MoveIt collision objects, the executor only applies what the tracker reports as changed or removed
+  fetch_grasp_suggestion::UpdateObjects update;
+  update.request.ids = list.ids;
+  update.request.changed = list.changed;
   for (size_t i = 0; i < list.objects.size(); i ++)
   {
-    add.request.centroids.push_back(list.objects[i].centroid);
-    add.request.point_clouds.push_back(list.objects[i].point_cloud);
-    add.request.indices.push_back(i);
+    update.request.point_clouds.push_back(list.objects[i].point_cloud);
+  }
+  update.request.removed_ids = list.removed_ids;
+  if (!update_objects_client_.call(update))
+  {
+    ROS_WARN("Could not update the collision objects in the planning scene.");
   }
-  add_object_client_.call(add);
 }
 
 int main(int argc, char **argv)
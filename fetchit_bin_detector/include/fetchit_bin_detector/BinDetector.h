@@ -4,6 +4,9 @@
 #include <pcl_conversions/pcl_conversions.h>
 #include <sensor_msgs/PointCloud2.h>
 #include <std_srvs/Empty.h>
+#include <nav_msgs/Odometry.h>
+#include <sensor_msgs/JointState.h>
+#include <ros/callback_queue.h>
 
 #include <tf2_ros/static_transform_broadcaster.h>
 #include <tf2_ros/transform_broadcaster.h>
@@ -16,19 +19,37 @@
 
 #include <vector>
 #include <utility>
+#include <algorithm>
+
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/recursive_mutex.hpp>
+#include <Eigen/StdVector>
 
 #include "rail_manipulation_msgs/ProcessSegmentedObjects.h"
 #include "rail_manipulation_msgs/SegmentObjects.h"
+#include "rail_segmentation_tools/TablePlane.h"
 #include "fetchit_bin_detector/GetBinPose.h"
 #include "ApproxMVBB/ComputeApproxMVBB.hpp"
 #include "manipulation_actions/AttachToBase.h"
-#include "fetchit_icp/TemplateMatch.h"
+#include "fetchit_icp/MultiTemplateMatch.h"
+
 
+// bin candidate from the parallel per-object shape evaluation
+struct BinCandidate {
+    int index;              // index into the segmented object list
+    bool valid;             // passed the volume and shape checks
+    double score;           // similarity to the nominal bin shape, higher is better
+    ApproxMVBB::OOBB oobb;  // bounding box with z shortest and the bottom at table height
+
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+};
 
 class BinDetector {
     public:
         BinDetector(ros::NodeHandle& nh, const std::string& seg_node, const std::string& seg_frame,
                          const std::string& kit_icp_node, bool viz);
+        ~BinDetector();
         // gets the index of the minimum extent for the bounding box (i.e. shortest side)
         void minExtent(ApproxMVBB::OOBB& bb, ApproxMVBB::Vector3::Index& i);
         // sets z-axis as the minimum extent of the bounding box
@@ -45,8 +66,47 @@ class BinDetector {
         ApproxMVBB::Vector3 get_box_top_in_bin(ApproxMVBB::OOBB& bb);
         // gets pose of the TOP of the bounding box in meters in the world frame
         ApproxMVBB::Vector3 get_box_top_in_world(ApproxMVBB::OOBB& bb);
+        // evaluates every stride-th candidate starting at first, run on several threads
+        void evaluate_bin_candidates(const rail_manipulation_msgs::SegmentedObjectList& segmented_objects,
+                                     std::vector<BinCandidate, Eigen::aligned_allocator<BinCandidate> >& candidates,
+                                     unsigned int first, unsigned int stride);
+        // computes the bounding box and shape score of one object, returns false if it fails the bin checks
+        bool evaluate_bin_candidate(const rail_manipulation_msgs::SegmentedObject& object, BinCandidate& candidate);
+        // fits the minimum area rectangle on the table plane (convex hull + rotating calipers) with height from the
+        // table, returns false if the object does not look like a box resting flat on the table
+        bool fit_planar_box(const pcl::PointCloud<pcl::PointXYZRGB>& cloud, ApproxMVBB::OOBB& bb);
+        // z component of (a - o) x (b - o)
+        static double hull_cross(const std::pair<double, double>& o, const std::pair<double, double>& a,
+                                 const std::pair<double, double>& b);
         // bin pose detection service handler
         bool handle_bin_pose_service(fetchit_bin_detector::GetBinPose::Request& req, fetchit_bin_detector::GetBinPose::Response& res);
+        // segments, evaluates and refines bins on the table, spinning queue while waiting for table info
+        bool detect_table_bins(ros::CallbackQueue* queue, std::vector<geometry_msgs::PoseStamped>& bin_poses,
+                               geometry_msgs::TransformStamped& bin_transform,
+                               rail_manipulation_msgs::SegmentedObject& attach_object, bool& detected);
+        // evaluates and refines bins among already segmented objects, with table info taken after segmentation_start
+        bool detect_bins_in_objects(ros::CallbackQueue* queue, const ros::Time& segmentation_start,
+                                    const rail_manipulation_msgs::SegmentedObjectList& segmented_objects,
+                                    std::vector<geometry_msgs::PoseStamped>& bin_poses,
+                                    geometry_msgs::TransformStamped& bin_transform,
+                                    rail_manipulation_msgs::SegmentedObject& attach_object, bool& detected);
+        // replaces the base collision object with the detected bin
+        void attach_bin(const rail_manipulation_msgs::SegmentedObject& attach_object);
+        // answers the request from the background estimate if it is fresh and confident enough
+        bool use_background_estimate(const fetchit_bin_detector::GetBinPose::Request& req,
+                                     fetchit_bin_detector::GetBinPose::Response& res);
+        // stores a new estimate, raising confidence when it agrees with the previous one
+        void update_estimate(const ros::Time& detection_start, const std::vector<geometry_msgs::PoseStamped>& bin_poses,
+                             const geometry_msgs::TransformStamped& bin_transform,
+                             const rail_manipulation_msgs::SegmentedObject& attach_object);
+        // keeps the estimate while its objects are still the cached segmentation, without raising its confidence
+        void refresh_estimate(const ros::Time& check_start);
+        // drops the estimate, e.g. when the camera or the segmentation frame moved
+        void invalidate_estimate();
+        // true when the base, head and arm have not moved for stationary_time
+        bool is_stationary();
+        // keeps the bin estimate fresh from the cached segmentation while the robot is stationary
+        void background_detection_loop();
         // gets the bin orientation
         bool get_bin_pose(ApproxMVBB::OOBB& bb, sensor_msgs::PointCloud2& cloud, geometry_msgs::Pose& bin_pose);
         // gets bin handle's slope in segmentation frame
@@ -59,13 +119,15 @@ class BinDetector {
         void visualize_bb(int id, geometry_msgs::Pose bin_pose);
         // publish the transform for the best (closest) bin
         void publish_bin_tf();
-        // refines the bin pose estimate using ICP
-        bool icp_refined_pose(sensor_msgs::PointCloud2 icp_cloud_msg, geometry_msgs::Pose& initial, geometry_msgs::Pose& final, double& matching_error);
+        // refines every candidate bin pose with one template matching call, sharing the target preprocessing
+        bool icp_refined_poses(sensor_msgs::PointCloud2 icp_cloud_msg, const std::vector<geometry_msgs::Pose>& initial,
+                               std::vector<double>& matching_errors);
 
 
     protected:
         ros::NodeHandle nh_, pnh_;
         ros::ServiceClient seg_client_;
+        ros::ServiceClient cached_objects_client_;
         ros::ServiceClient merge_client_;
         ros::ServiceClient attach_base_client_;
         ros::ServiceClient detach_base_client_;
@@ -73,6 +135,9 @@ class BinDetector {
         ros::ServiceServer pose_srv_;
         ros::Publisher vis_pub_;
         ros::Subscriber table_sub_;
+        ros::Subscriber odom_sub_;
+        ros::Subscriber joint_states_sub_;
+        ros::Publisher background_pose_pub_;
         std::string seg_frame_;
         bool visualize_;
 
@@ -84,9 +149,55 @@ class BinDetector {
         tf2_ros::TransformBroadcaster tf_broadcaster_;
         //ros::Publisher pub2_; //TODO DEBUG
 
-        double table_height_;
-        bool table_received_;
+        double table_height_;               // table height used by the current detection
+        double latest_table_height_;        // last received table height, guarded by table_mutex_
+        ros::Time table_stamp_;
+        ros::Duration max_table_age_;       // how long before segmentation the table info may have been taken
+        boost::mutex table_mutex_;
         bool debug_;
+        bool planar_box_fit_;
+        std::string kit_template_name_;     // name of the bin template in the kit template matcher
+
+        // background estimation
+        bool background_detection_;
+        double background_period_;
+        double max_estimate_age_;
+        double min_estimate_confidence_;
+        double estimate_position_tolerance_;
+        double estimate_yaw_tolerance_;
+        double stationary_linear_velocity_;
+        double stationary_angular_velocity_;
+        double stationary_joint_velocity_;
+        std::vector<std::string> stationary_joints_;  // head, torso and arm joints that move the camera or the view
+        double stationary_time_;
+        boost::thread background_thread_;
+        ros::NodeHandle background_nh_;
+        ros::CallbackQueue background_queue_;
+        ros::Subscriber background_table_sub_;
+        boost::recursive_mutex detection_mutex_;  // serializes segmentation and ICP between service and background
+
+        // background estimate, guarded by estimate_mutex_
+        boost::mutex estimate_mutex_;
+        bool estimate_valid_;
+        ros::Time estimate_stamp_;
+        double estimate_confidence_;
+        int estimate_agreements_;
+        std::vector<geometry_msgs::PoseStamped> estimate_bin_poses_;
+        geometry_msgs::TransformStamped estimate_bin_transform_;
+        rail_manipulation_msgs::SegmentedObject estimate_attach_object_;
+        bool odom_received_;
+        bool joint_states_received_;
+        ros::Time last_motion_time_;
+
+        // bins found in the cached segmentation the background last refined, only used by the background thread
+        ros::Time background_objects_stamp_;
+        std::vector<geometry_msgs::PoseStamped> background_bin_poses_;
+        geometry_msgs::TransformStamped background_bin_transform_;
+        rail_manipulation_msgs::SegmentedObject background_attach_object_;
+        bool background_detected_;
 
         void table_callback(const rail_manipulation_msgs::SegmentedObject &msg);
+        void table_plane_callback(const rail_segmentation_tools::TablePlane &msg);
+        void odom_callback(const nav_msgs::Odometry::ConstPtr& msg);
+        void joint_states_callback(const sensor_msgs::JointState::ConstPtr& msg);
 };
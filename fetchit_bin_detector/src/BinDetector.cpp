@@ -10,6 +10,8 @@ BinDetector::BinDetector(ros::NodeHandle& nh, const std::string& seg_node, const
     visualize_ = viz;
 
     pnh_.param("debug", debug_, false);
+    pnh_.param("planar_box_fit", planar_box_fit_, true);
+    pnh_.param<std::string>("kit_template_name", kit_template_name_, "bin");
 
     base_right_bin_transform_.header.frame_id = seg_frame_;       // NOTE: The hard-coded values only work for "base_link"
     base_right_bin_transform_.child_frame_id = "kit_frame";
@@ -26,24 +28,116 @@ BinDetector::BinDetector(ros::NodeHandle& nh, const std::string& seg_node, const
     bin_detected_ = false;
     best_bin_transform_ = base_right_bin_transform_;
 
-    table_received_ = false;
+    table_height_ = 0;
+    latest_table_height_ = 0;
 
-    table_sub_ = nh_.subscribe(seg_node+"/segmented_table", 1, &BinDetector::table_callback, this);
+    // the latched table plane is usually already current, the segmented table only arrives after segmenting
+    std::string table_plane_topic;
+    double max_table_age;
+    pnh_.param<std::string>("table_plane_topic", table_plane_topic, "");
+    pnh_.param("max_table_age", max_table_age, 1.0);
+    max_table_age_ = table_plane_topic.empty() ? ros::Duration(0) : ros::Duration(max_table_age);
+    if (table_plane_topic.empty())
+    {
+        table_sub_ = nh_.subscribe(seg_node+"/segmented_table", 1, &BinDetector::table_callback, this);
+    }
+    else
+    {
+        table_sub_ = nh_.subscribe(table_plane_topic, 1, &BinDetector::table_plane_callback, this);
+    }
 
     seg_client_ = nh_.serviceClient<rail_manipulation_msgs::SegmentObjects>(seg_node+"/segment_objects");
     merge_client_ = nh_.serviceClient<rail_manipulation_msgs::ProcessSegmentedObjects>("merger/merge_objects");
     attach_base_client_ = nh_.serviceClient<manipulation_actions::AttachToBase>("collision_scene_manager/attach_to_base");
     detach_base_client_ = nh_.serviceClient<std_srvs::Empty>("collision_scene_manager/detach_all_from_base");
-    icp_client_ = nh_.serviceClient<fetchit_icp::TemplateMatch>(kit_icp_node+"/match_template");
+    icp_client_ = nh_.serviceClient<fetchit_icp::MultiTemplateMatch>(kit_icp_node+"/match_templates");
     pose_srv_ = nh_.advertiseService("detect_bins", &BinDetector::handle_bin_pose_service, this);
 
+    // background mode keeps a bin estimate fresh from the cached segmentation while the robot is stationary
+    pnh_.param("background_detection", background_detection_, false);
+    pnh_.param("background_period", background_period_, 1.0);
+    pnh_.param("max_estimate_age", max_estimate_age_, 5.0);
+    pnh_.param("min_estimate_confidence", min_estimate_confidence_, 0.5);
+    pnh_.param("estimate_position_tolerance", estimate_position_tolerance_, 0.01);
+    pnh_.param("estimate_yaw_tolerance", estimate_yaw_tolerance_, 0.1);
+    pnh_.param("stationary_linear_velocity", stationary_linear_velocity_, 0.01);
+    pnh_.param("stationary_angular_velocity", stationary_angular_velocity_, 0.02);
+    pnh_.param("stationary_joint_velocity", stationary_joint_velocity_, 0.02);
+    std::vector<std::string> default_stationary_joints = {"torso_lift_joint", "head_pan_joint", "head_tilt_joint",
+                                                          "shoulder_pan_joint", "shoulder_lift_joint",
+                                                          "upperarm_roll_joint", "elbow_flex_joint",
+                                                          "forearm_roll_joint", "wrist_flex_joint",
+                                                          "wrist_roll_joint"};
+    pnh_.param("stationary_joints", stationary_joints_, default_stationary_joints);
+    pnh_.param("stationary_time", stationary_time_, 1.0);
+    std::string odom_topic, joint_states_topic, segmentation_cache_node;
+    pnh_.param<std::string>("odom_topic", odom_topic, "/odom");
+    pnh_.param<std::string>("joint_states_topic", joint_states_topic, "/joint_states");
+    pnh_.param<std::string>("segmentation_cache_node", segmentation_cache_node, "segmentation_cache");
+
+    estimate_valid_ = false;
+    estimate_confidence_ = 0;
+    estimate_agreements_ = 0;
+    odom_received_ = false;
+    joint_states_received_ = false;
+    background_detected_ = false;
+    last_motion_time_ = ros::Time::now();
+
+    if (background_detection_)
+    {
+        odom_sub_ = nh_.subscribe(odom_topic, 1, &BinDetector::odom_callback, this);
+        joint_states_sub_ = nh_.subscribe(joint_states_topic, 1, &BinDetector::joint_states_callback, this);
+
+        // the background only reads the cache, so it never segments, merges or publishes segmented objects itself
+        cached_objects_client_ = nh_.serviceClient<rail_manipulation_msgs::SegmentObjects>(
+                segmentation_cache_node+"/cached_objects");
+        background_pose_pub_ = pnh_.advertise<geometry_msgs::PoseStamped>("background_bin_pose", 1, true);
+
+        // the background thread waits for table info on its own queue so it never depends on the main spin loop
+        background_nh_.setCallbackQueue(&background_queue_);
+        if (table_plane_topic.empty())
+        {
+            background_table_sub_ = background_nh_.subscribe(seg_node+"/segmented_table", 1,
+                                                             &BinDetector::table_callback, this);
+        }
+        else
+        {
+            background_table_sub_ = background_nh_.subscribe(table_plane_topic, 1, &BinDetector::table_plane_callback,
+                                                             this);
+        }
+        background_thread_ = boost::thread(&BinDetector::background_detection_loop, this);
+    }
+
     //pub2_ = nh_.advertise<sensor_msgs::PointCloud2>("wall_points",0); // TODO DEBUG
 }
 
+BinDetector::~BinDetector()
+{
+    if (background_thread_.joinable())
+    {
+        background_thread_.interrupt();
+        background_thread_.join();
+    }
+}
+
 void BinDetector::table_callback(const rail_manipulation_msgs::SegmentedObject &msg)
 {
-    table_height_ = msg.center.z;
-    table_received_ = true;
+    boost::mutex::scoped_lock table_lock(table_mutex_);
+    latest_table_height_ = msg.center.z;
+    table_stamp_ = ros::Time::now();
+}
+
+void BinDetector::table_plane_callback(const rail_segmentation_tools::TablePlane &msg)
+{
+    if (msg.header.frame_id != seg_frame_)
+    {
+        ROS_WARN_THROTTLE(5.0, "Ignoring table plane in %s, bins are detected in %s", msg.header.frame_id.c_str(),
+                          seg_frame_.c_str());
+        return;
+    }
+    boost::mutex::scoped_lock table_lock(table_mutex_);
+    latest_table_height_ = msg.center.z;
+    table_stamp_ = msg.header.stamp;
 }
 
 bool BinDetector::handle_bin_pose_service(fetchit_bin_detector::GetBinPose::Request& req, fetchit_bin_detector::GetBinPose::Response& res)
@@ -77,14 +171,64 @@ bool BinDetector::handle_bin_pose_service(fetchit_bin_detector::GetBinPose::Requ
         return true;
     }
 
-    // initialize the bin pose array temporary pose variable
+    // returns the background estimate when it is fresh and confident enough
+    if (use_background_estimate(req, res))
+    {
+        return true;
+    }
+
+    // the blocking path spins the global queue while it waits for table info, so the lock must be recursive
+    boost::recursive_mutex::scoped_lock detection_lock(detection_mutex_);
+
+    // the background thread may have finished an estimate while this request was waiting
+    if (use_background_estimate(req, res))
+    {
+        return true;
+    }
+
     std::vector<geometry_msgs::PoseStamped> bin_poses;
-    geometry_msgs::PoseStamped new_bin_pose;
-    new_bin_pose.header.frame_id = seg_frame_;
+    geometry_msgs::TransformStamped bin_transform;
+    rail_manipulation_msgs::SegmentedObject attach_object;
+    bool detected;
+    ros::Time detection_start = ros::Time::now();
+    if (!detect_table_bins(ros::getGlobalCallbackQueue(), bin_poses, bin_transform, attach_object, detected))
+    {
+        return false;
+    }
+
+    bin_detected_ = detected;
+    if (bin_detected_)
+    {
+        best_bin_transform_ = bin_transform;
+        if (background_detection_)
+        {
+            update_estimate(detection_start, bin_poses, bin_transform, attach_object);
+        }
+        if (req.attach_collision_object)
+        {
+            attach_bin(attach_object);
+        }
+    }
+
+    res.bin_poses = bin_poses;
+    res.estimate_stamp = detection_start;
+    res.confidence = bin_detected_ ? 1.0 : 0.0;
+    if (debug_)
+    {
+        std::cout << "run duration:  " << ros::Time::now() - begin << std::endl;
+    }
+    return true;
+}
+
+bool BinDetector::detect_table_bins(ros::CallbackQueue* queue, std::vector<geometry_msgs::PoseStamped>& bin_poses,
+                                    geometry_msgs::TransformStamped& bin_transform,
+                                    rail_manipulation_msgs::SegmentedObject& attach_object, bool& detected)
+{
+    detected = false;
 
     // gets initial segmentation
     rail_manipulation_msgs::SegmentObjects seg_srv;
-    table_received_ = false;
+    ros::Time segmentation_start = ros::Time::now();
     if (!seg_client_.call(seg_srv))
     {
         ROS_ERROR("Failed to call segmentation service segment_objects");
@@ -98,20 +242,6 @@ bool BinDetector::handle_bin_pose_service(fetchit_bin_detector::GetBinPose::Requ
         return true;
     }
 
-    // wait a couple seconds for table height info
-    ros::Rate wait_rate(100);
-    ros::Time wait_start = ros::Time::now();
-    while (!table_received_ && ros::Time::now() - wait_start < ros::Duration(2.0))
-    {
-        ros::spinOnce();
-        wait_rate.sleep();
-    }
-    if (!table_received_)
-    {
-        ROS_ERROR("Did not receive table info, couldn't set bin z bounds!");
-        return false;
-    }
-
     rail_manipulation_msgs::SegmentedObjectList segmented_objects = seg_srv.response.segmented_objects;
     rail_manipulation_msgs::ProcessSegmentedObjects merge_srv;
     merge_srv.request.segmented_objects = seg_srv.response.segmented_objects;
@@ -124,107 +254,94 @@ bool BinDetector::handle_bin_pose_service(fetchit_bin_detector::GetBinPose::Requ
     }
     ROS_INFO("Number segmented objects after merging: %lu", segmented_objects.objects.size());
 
-    pcl::PointCloud<pcl::PointXYZRGB> object_pcl_cloud;
-    double min_sqr_dst = std::numeric_limits<double>::infinity();  // for selecting the best (closest) bin to consider
-    bin_detected_ = false;
-    rail_manipulation_msgs::SegmentedObject attach_object;
-
-    std::random_shuffle(segmented_objects.objects.begin(), segmented_objects.objects.end());
-
-    for (int i = 0; i < segmented_objects.objects.size(); i++)
-    {
-        // converts point cloud to asr library compatible type
-        pcl::fromROSMsg(segmented_objects.objects[i].point_cloud, object_pcl_cloud);
-        ApproxMVBB::Matrix3Dyn points(3, object_pcl_cloud.size());
-        for (int j = 0; j < object_pcl_cloud.size(); j++)
-        {
-            points(0, j) = object_pcl_cloud[j].x;
-            points(1, j) = object_pcl_cloud[j].y;
-            points(2, j) = object_pcl_cloud[j].z;
-        }
-
-        // gets the min vol b
-        double tolerance = 0.001;
-        ApproxMVBB::OOBB oobb = ApproxMVBB::approximateMVBB(points, tolerance, 200, 3, 0, 1);
-
-        if (debug_)
-        {
-            ROS_INFO("XXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXX");
-        }
+    return detect_bins_in_objects(queue, segmentation_start, segmented_objects, bin_poses, bin_transform,
+                                  attach_object, detected);
+}
 
-        // re-orients bin coordinate frame so z axis is the shortest
-        setZAxisShortest(oobb);
+bool BinDetector::detect_bins_in_objects(ros::CallbackQueue* queue, const ros::Time& segmentation_start,
+                                         const rail_manipulation_msgs::SegmentedObjectList& segmented_objects,
+                                         std::vector<geometry_msgs::PoseStamped>& bin_poses,
+                                         geometry_msgs::TransformStamped& bin_transform,
+                                         rail_manipulation_msgs::SegmentedObject& attach_object, bool& detected)
+{
+    detected = false;
+    bin_transform.header.frame_id = seg_frame_;
+    bin_transform.child_frame_id = base_right_bin_transform_.child_frame_id;
+    bin_transform.transform.rotation.w = 1.0;
 
-        // set z-min to table height (the bottom of the bin)
-        ApproxMVBB::Vector3 table_point = oobb.m_q_KI * oobb.m_minPoint;
-        if (debug_)
-        {
-            ROS_INFO("min point in baselink frame: %f,%f,%f", table_point.x(), table_point.y(), table_point.z());
-        }
-        table_point.z() = table_height_;
-        if (debug_)
-        {
-            ROS_INFO("table z height: %f", table_height_);
-        }
-        table_point = oobb.m_q_KI.inverse() * table_point;
-        if (debug_)
-        {
-            ROS_INFO("table min point in bin frame: %f,%f,%f", table_point.x(), table_point.y(), table_point.z());
-            ROS_INFO("bb min point in bin frame: %f,%f,%f", oobb.m_minPoint.x(), oobb.m_minPoint.y(),
-                     oobb.m_minPoint.z());
-        }
+    // initialize the bin pose array temporary pose variable
+    geometry_msgs::PoseStamped new_bin_pose;
+    new_bin_pose.header.frame_id = seg_frame_;
 
-        oobb.m_minPoint[2] = table_point.z();
+    if (segmented_objects.objects.empty())
+    {
+        return true;
+    }
 
-        // checks inverted z-axis case, and flips if needed
-        if (debug_)
-        {
-            ROS_INFO("z before invert: %f", oobb.getDirection(2).z());
-        }
-        if (oobb.getDirection(2).z() < 0)
+    // wait a couple seconds for table height info
+    ros::Rate wait_rate(100);
+    ros::Time wait_start = ros::Time::now();
+    bool table_received = false;
+    while (ros::Time::now() - wait_start < ros::Duration(2.0))
+    {
+        queue->callAvailable();
         {
-            invertZAxis(oobb);
-            if (debug_)
+            boost::mutex::scoped_lock table_lock(table_mutex_);
+            if (table_stamp_ >= segmentation_start - max_table_age_)
             {
-                ROS_INFO("z after invert: %f", oobb.getDirection(2).z());
+                table_height_ = latest_table_height_;
+                table_received = true;
+                break;
             }
         }
+        wait_rate.sleep();
+    }
+    if (!table_received)
+    {
+        ROS_ERROR("Did not receive table info, couldn't set bin z bounds!");
+        return false;
+    }
 
-        // volume check (avg 0.0059183, std 0.0002650, 12 trials)
-        if (debug_)
-        {
-            ROS_INFO("********************************************");
-            ROS_INFO("volume: %f", oobb.volume());
-        }
-        if ((oobb.volume() < 0.005) || (0.01 < oobb.volume()))
+    double min_sqr_dst = std::numeric_limits<double>::infinity();  // for selecting the best (closest) bin to consider
+    // evaluates every candidate's bounding box and shape in parallel
+    std::vector<BinCandidate, Eigen::aligned_allocator<BinCandidate> > candidates(segmented_objects.objects.size());
+    unsigned int num_threads = std::max(1u, std::min(boost::thread::hardware_concurrency(),
+                                                     static_cast<unsigned int>(candidates.size())));
+    boost::thread_group evaluation_threads;
+    for (unsigned int t = 0; t < num_threads; t++)
+    {
+        evaluation_threads.create_thread(boost::bind(&BinDetector::evaluate_bin_candidates, this,
+                                                     boost::cref(segmented_objects), boost::ref(candidates), t,
+                                                     num_threads));
+    }
+    evaluation_threads.join_all();
+
+    // refines candidates in order of descending shape score
+    std::vector<BinCandidate*> ranked_candidates;
+    for (size_t i = 0; i < candidates.size(); i++)
+    {
+        if (candidates[i].valid)
         {
-            continue;
+            ranked_candidates.push_back(&candidates[i]);
         }
+    }
+    std::sort(ranked_candidates.begin(), ranked_candidates.end(),
+              [](const BinCandidate* a, const BinCandidate* b) { return a->score > b->score; });
+    ROS_INFO("Number bin candidates after shape checks: %lu", ranked_candidates.size());
 
-        // shape check (side: avg 0.228, std 0.005; height: avg 0.133 std 0.013)
-        ApproxMVBB::Vector3 bb_shape = get_box_scale(oobb);
+    for (size_t c = 0; c < ranked_candidates.size(); c++)
+    {
+        BinCandidate& candidate = *ranked_candidates[c];
+        int i = candidate.index;
         if (debug_)
         {
-            ROS_INFO("shape x: %f", bb_shape.x());
-            ROS_INFO("shape y: %f", bb_shape.y());
-            ROS_INFO("shape z: %f", bb_shape.z());
-            ROS_INFO("********************************************");
-        }
-        if ((bb_shape.x() < 0.2) || (0.27 < bb_shape.x()))
-        { // checks one side
-            continue;
-        }
-        if ((bb_shape.y() < 0.2) || (0.27 < bb_shape.y()))
-        { // checks other side
-            continue;
+            ROS_INFO("XXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXX");
+            ROS_INFO("refining candidate %d with score %f", i, candidate.score);
         }
-        //if ( (bb_shape.z() < 0.05) || (0.175 < bb_shape.z()) ) { // checks height
-        //    continue;
-        //}
 
         // get absolute orientation
         geometry_msgs::Pose bin_pose_initial;
-        bool pose_extraction_success = get_bin_pose(oobb, segmented_objects.objects[i].point_cloud, new_bin_pose.pose);
+        bool pose_extraction_success = get_bin_pose(candidate.oobb, segmented_objects.objects[i].point_cloud, new_bin_pose.pose);
         if (pose_extraction_success)
         {
             bin_poses.push_back(new_bin_pose);
@@ -238,17 +355,13 @@ bool BinDetector::handle_bin_pose_service(fetchit_bin_detector::GetBinPose::Requ
 
         if (sqr_dst < min_sqr_dst)
         {
-            bin_detected_ = true;
+            detected = true;
             min_sqr_dst = sqr_dst;
-            best_bin_transform_.transform.translation.x = new_bin_pose.pose.position.x;
-            best_bin_transform_.transform.translation.y = new_bin_pose.pose.position.y;
-            best_bin_transform_.transform.translation.z = new_bin_pose.pose.position.z;
-            best_bin_transform_.transform.rotation = new_bin_pose.pose.orientation;
-
-            if (req.attach_collision_object)
-            {
-                attach_object = segmented_objects.objects[i];
-            }
+            bin_transform.transform.translation.x = new_bin_pose.pose.position.x;
+            bin_transform.transform.translation.y = new_bin_pose.pose.position.y;
+            bin_transform.transform.translation.z = new_bin_pose.pose.position.z;
+            bin_transform.transform.rotation = new_bin_pose.pose.orientation;
+            attach_object = segmented_objects.objects[i];
         }
 
         if (debug_)
@@ -268,79 +381,508 @@ bool BinDetector::handle_bin_pose_service(fetchit_bin_detector::GetBinPose::Requ
       }
     }
 
-    if (bin_detected_ && req.attach_collision_object)
+    // small angle adjustments to align bin pose with gravity vector
+    if (detected)
     {
-        std_srvs::Empty empty_srv;
-        if (!detach_base_client_.call(empty_srv))
+        tf2::Quaternion bin_rot(bin_transform.transform.rotation.x, bin_transform.transform.rotation.y,
+                                bin_transform.transform.rotation.z, bin_transform.transform.rotation.w);
+        tf2::Matrix3x3 bin_rot_m(bin_rot);
+        double roll, pitch, yaw;
+        bin_rot_m.getRPY(roll, pitch, yaw);
+        tf2::Quaternion corrected_bin_rot;
+        corrected_bin_rot.setRPY(0, 0, yaw);
+        bin_transform.transform.rotation.x = corrected_bin_rot.x();
+        bin_transform.transform.rotation.y = corrected_bin_rot.y();
+        bin_transform.transform.rotation.z = corrected_bin_rot.z();
+        bin_transform.transform.rotation.w = corrected_bin_rot.w();
+    }
+
+    return true;
+}
+
+void BinDetector::attach_bin(const rail_manipulation_msgs::SegmentedObject& attach_object)
+{
+    std_srvs::Empty empty_srv;
+    if (!detach_base_client_.call(empty_srv))
+    {
+        ROS_ERROR("Couldn't call detach from base collision service!  Continuing execution anyway...");
+    }
+
+    manipulation_actions::AttachToBase attach_srv;
+    attach_srv.request.segmented_object = attach_object;
+    if (!attach_base_client_.call(attach_srv))
+    {
+        ROS_ERROR("Couldn't call attach to base collision service!  Continuing execution anyway...");
+    }
+}
+
+bool BinDetector::use_background_estimate(const fetchit_bin_detector::GetBinPose::Request& req,
+                                          fetchit_bin_detector::GetBinPose::Response& res)
+{
+    if (!background_detection_)
+    {
+        return false;
+    }
+
+    geometry_msgs::TransformStamped bin_transform;
+    rail_manipulation_msgs::SegmentedObject attach_object;
+    {
+        boost::mutex::scoped_lock estimate_lock(estimate_mutex_);
+        if (!estimate_valid_ || ros::Time::now() - estimate_stamp_ > ros::Duration(max_estimate_age_)
+            || estimate_confidence_ < min_estimate_confidence_)
         {
-            ROS_ERROR("Couldn't call detach from base collision service!  Continuing execution anyway...");
+            return false;
         }
+        res.bin_poses = estimate_bin_poses_;
+        res.estimate_stamp = estimate_stamp_;
+        res.confidence = estimate_confidence_;
+        bin_transform = estimate_bin_transform_;
+        if (req.attach_collision_object)
+        {
+            attach_object = estimate_attach_object_;
+        }
+    }
+    ROS_INFO("Using background bin estimate from %f s ago (confidence %f)",
+             (ros::Time::now() - res.estimate_stamp).toSec(), res.confidence);
 
-        manipulation_actions::AttachToBase attach_srv;
-        attach_srv.request.segmented_object = attach_object;
-        if (!attach_base_client_.call(attach_srv))
+    bin_detected_ = true;
+    best_bin_transform_ = bin_transform;
+    if (req.attach_collision_object)
+    {
+        attach_bin(attach_object);
+    }
+    return true;
+}
+
+void BinDetector::update_estimate(const ros::Time& detection_start,
+                                  const std::vector<geometry_msgs::PoseStamped>& bin_poses,
+                                  const geometry_msgs::TransformStamped& bin_transform,
+                                  const rail_manipulation_msgs::SegmentedObject& attach_object)
+{
+    boost::mutex::scoped_lock estimate_lock(estimate_mutex_);
+
+    // the base moved during detection, so the estimate may be from a different view
+    if (last_motion_time_ >= detection_start)
+    {
+        return;
+    }
+
+    // confidence grows with each consecutive estimate that agrees with the previous one
+    if (estimate_valid_)
+    {
+        double dx = bin_transform.transform.translation.x - estimate_bin_transform_.transform.translation.x;
+        double dy = bin_transform.transform.translation.y - estimate_bin_transform_.transform.translation.y;
+        double dz = bin_transform.transform.translation.z - estimate_bin_transform_.transform.translation.z;
+        tf2::Quaternion rot, estimate_rot;
+        tf2::fromMsg(bin_transform.transform.rotation, rot);
+        tf2::fromMsg(estimate_bin_transform_.transform.rotation, estimate_rot);
+        double yaw_difference = rot.angleShortestPath(estimate_rot);
+        if (sqrt(dx*dx + dy*dy + dz*dz) <= estimate_position_tolerance_ && yaw_difference <= estimate_yaw_tolerance_)
+        {
+            estimate_agreements_++;
+        } else
         {
-            ROS_ERROR("Couldn't call attach to base collision service!  Continuing execution anyway...");
+            estimate_agreements_ = 1;
         }
+    } else
+    {
+        estimate_agreements_ = 1;
     }
 
-    // small angle adjustments to align bin pose with gravity vector
-    if (bin_detected_)
+    estimate_valid_ = true;
+    estimate_stamp_ = detection_start;
+    estimate_confidence_ = 1.0 - pow(0.5, estimate_agreements_);
+    estimate_bin_poses_ = bin_poses;
+    estimate_bin_transform_ = bin_transform;
+    estimate_attach_object_ = attach_object;
+}
+
+void BinDetector::refresh_estimate(const ros::Time& check_start)
+{
+    boost::mutex::scoped_lock estimate_lock(estimate_mutex_);
+    if (estimate_valid_ && last_motion_time_ < check_start)
     {
-        tf2::Quaternion bin_rot(best_bin_transform_.transform.rotation.x, best_bin_transform_.transform.rotation.y,
-                                best_bin_transform_.transform.rotation.z, best_bin_transform_.transform.rotation.w);
-        tf2::Matrix3x3 bin_rot_m(bin_rot);
-        double roll, pitch, yaw;
-        bin_rot_m.getRPY(roll, pitch, yaw);
-        tf2::Quaternion corrected_bin_rot;
-        corrected_bin_rot.setRPY(0, 0, yaw);
-        best_bin_transform_.transform.rotation.x = corrected_bin_rot.x();
-        best_bin_transform_.transform.rotation.y = corrected_bin_rot.y();
-        best_bin_transform_.transform.rotation.z = corrected_bin_rot.z();
-        best_bin_transform_.transform.rotation.w = corrected_bin_rot.w();
+        estimate_stamp_ = check_start;
+    }
+}
+
+void BinDetector::invalidate_estimate()
+{
+    boost::mutex::scoped_lock estimate_lock(estimate_mutex_);
+    estimate_valid_ = false;
+    estimate_agreements_ = 0;
+}
+
+bool BinDetector::is_stationary()
+{
+    boost::mutex::scoped_lock estimate_lock(estimate_mutex_);
+    return odom_received_ && joint_states_received_
+           && ros::Time::now() - last_motion_time_ > ros::Duration(stationary_time_);
+}
+
+void BinDetector::odom_callback(const nav_msgs::Odometry::ConstPtr& msg)
+{
+    boost::mutex::scoped_lock estimate_lock(estimate_mutex_);
+    odom_received_ = true;
+    if (fabs(msg->twist.twist.linear.x) > stationary_linear_velocity_
+        || fabs(msg->twist.twist.linear.y) > stationary_linear_velocity_
+        || fabs(msg->twist.twist.angular.z) > stationary_angular_velocity_)
+    {
+        // estimates are in the segmentation frame, which moves with the base
+        last_motion_time_ = ros::Time::now();
+        estimate_valid_ = false;
+        estimate_agreements_ = 0;
+    }
+}
 
-        best_bin_transform_;
+void BinDetector::joint_states_callback(const sensor_msgs::JointState::ConstPtr& msg)
+{
+    // the gripper publishes its own joint states without the camera or arm joints
+    if (msg->velocity.size() != msg->name.size())
+    {
+        return;
     }
 
+    bool moving = false;
+    bool has_joints = false;
+    for (size_t i = 0; i < msg->name.size(); i++)
+    {
+        if (std::find(stationary_joints_.begin(), stationary_joints_.end(), msg->name[i]) != stationary_joints_.end())
+        {
+            has_joints = true;
+            moving = moving || fabs(msg->velocity[i]) > stationary_joint_velocity_;
+        }
+    }
+    if (!has_joints)
+    {
+        return;
+    }
 
-    res.bin_poses = bin_poses;
+    boost::mutex::scoped_lock estimate_lock(estimate_mutex_);
+    joint_states_received_ = true;
+    if (moving)
+    {
+        // a moving head changes the view and a moving arm changes the scene, so the estimate is re-derived after
+        last_motion_time_ = ros::Time::now();
+        estimate_valid_ = false;
+        estimate_agreements_ = 0;
+    }
+}
+
+void BinDetector::background_detection_loop()
+{
+    try
+    {
+        while (ros::ok())
+        {
+            boost::this_thread::sleep(boost::posix_time::milliseconds(static_cast<long>(background_period_*1000)));
+            background_queue_.callAvailable();
+            if (!is_stationary())
+            {
+                continue;
+            }
+
+            // fails when nothing is cached yet or the scene changed, in which case the next request re-segments
+            rail_manipulation_msgs::SegmentObjects cached_srv;
+            ros::Time detection_start = ros::Time::now();
+            if (!cached_objects_client_.call(cached_srv))
+            {
+                continue;
+            }
+
+            // the same cached segmentation gives the same bins, so only a new one is refined again
+            const rail_manipulation_msgs::SegmentedObjectList& segmented_objects = cached_srv.response.segmented_objects;
+            ros::Time objects_stamp = segmented_objects.header.stamp;
+            if (objects_stamp.isZero() || objects_stamp != background_objects_stamp_)
+            {
+                boost::recursive_mutex::scoped_lock detection_lock(detection_mutex_);
+                background_bin_poses_.clear();
+                // a failure here usually means no table is in view
+                if (!detect_bins_in_objects(&background_queue_, objects_stamp.isZero() ? detection_start : objects_stamp,
+                                            segmented_objects, background_bin_poses_, background_bin_transform_,
+                                            background_attach_object_, background_detected_))
+                {
+                    continue;
+                }
+                background_objects_stamp_ = objects_stamp;
+            } else
+            {
+                bool estimate_valid;
+                {
+                    boost::mutex::scoped_lock estimate_lock(estimate_mutex_);
+                    estimate_valid = estimate_valid_;
+                }
+                if (estimate_valid)
+                {
+                    refresh_estimate(detection_start);
+                    continue;
+                }
+            }
+
+            if (!background_detected_)
+            {
+                invalidate_estimate();
+                continue;
+            }
+            update_estimate(detection_start, background_bin_poses_, background_bin_transform_,
+                            background_attach_object_);
+
+            geometry_msgs::PoseStamped bin_pose;
+            bin_pose.header.frame_id = background_bin_transform_.header.frame_id;
+            bin_pose.header.stamp = detection_start;
+            bin_pose.pose.position.x = background_bin_transform_.transform.translation.x;
+            bin_pose.pose.position.y = background_bin_transform_.transform.translation.y;
+            bin_pose.pose.position.z = background_bin_transform_.transform.translation.z;
+            bin_pose.pose.orientation = background_bin_transform_.transform.rotation;
+            background_pose_pub_.publish(bin_pose);
+        }
+    }
+    catch (boost::thread_interrupted&)
+    {
+    }
+}
+
+void BinDetector::evaluate_bin_candidates(const rail_manipulation_msgs::SegmentedObjectList& segmented_objects,
+                                          std::vector<BinCandidate, Eigen::aligned_allocator<BinCandidate> >& candidates,
+                                          unsigned int first, unsigned int stride)
+{
+    for (size_t i = first; i < candidates.size(); i += stride)
+    {
+        candidates[i].index = static_cast<int>(i);
+        candidates[i].valid = evaluate_bin_candidate(segmented_objects.objects[i], candidates[i]);
+    }
+}
+
+bool BinDetector::evaluate_bin_candidate(const rail_manipulation_msgs::SegmentedObject& object, BinCandidate& candidate)
+{
+    candidate.score = -std::numeric_limits<double>::infinity();
+
+    // converts point cloud to asr library compatible type
+    pcl::PointCloud<pcl::PointXYZRGB> object_pcl_cloud;
+    pcl::fromROSMsg(object.point_cloud, object_pcl_cloud);
+    if (object_pcl_cloud.empty())
+    {
+        return false;
+    }
+    ApproxMVBB::OOBB& oobb = candidate.oobb;
+
+    // bins rest flat on the table, so an exact 2D fit on the table plane is tried first
+    if (!planar_box_fit_ || !fit_planar_box(object_pcl_cloud, oobb))
+    {
+        ApproxMVBB::Matrix3Dyn points(3, object_pcl_cloud.size());
+        for (int j = 0; j < object_pcl_cloud.size(); j++)
+        {
+            points(0, j) = object_pcl_cloud[j].x;
+            points(1, j) = object_pcl_cloud[j].y;
+            points(2, j) = object_pcl_cloud[j].z;
+        }
+
+        // gets the min vol b
+        double tolerance = 0.001;
+        oobb = ApproxMVBB::approximateMVBB(points, tolerance, 200, 3, 0, 1);
+
+        // re-orients bin coordinate frame so z axis is the shortest
+        setZAxisShortest(oobb);
+
+        // set z-min to table height (the bottom of the bin)
+        ApproxMVBB::Vector3 table_point = oobb.m_q_KI * oobb.m_minPoint;
+        table_point.z() = table_height_;
+        table_point = oobb.m_q_KI.inverse() * table_point;
+        oobb.m_minPoint[2] = table_point.z();
+
+        // checks inverted z-axis case, and flips if needed
+        if (oobb.getDirection(2).z() < 0)
+        {
+            invertZAxis(oobb);
+        }
+    }
+
+    // volume check (avg 0.0059183, std 0.0002650, 12 trials)
+    ApproxMVBB::Vector3 bb_shape = get_box_scale(oobb);
     if (debug_)
     {
-        std::cout << "run duration:  " << ros::Time::now() - begin << std::endl;
+        ROS_INFO("object %d volume: %f, shape: %f, %f, %f", candidate.index, oobb.volume(), bb_shape.x(),
+                 bb_shape.y(), bb_shape.z());
+    }
+    if ((oobb.volume() < 0.005) || (0.01 < oobb.volume()))
+    {
+        return false;
     }
+
+    // shape check (side: avg 0.228, std 0.005; height: avg 0.133 std 0.013)
+    if ((bb_shape.x() < 0.2) || (0.27 < bb_shape.x()))
+    { // checks one side
+        return false;
+    }
+    if ((bb_shape.y() < 0.2) || (0.27 < bb_shape.y()))
+    { // checks other side
+        return false;
+    }
+    //if ( (bb_shape.z() < 0.05) || (0.175 < bb_shape.z()) ) { // checks height
+    //    return false;
+    //}
+
+    // scores closeness to the measured bin statistics above (negated squared z-scores)
+    double z_volume = (oobb.volume() - 0.0059183)/0.0002650;
+    double z_side_x = (bb_shape.x() - 0.228)/0.005;
+    double z_side_y = (bb_shape.y() - 0.228)/0.005;
+    candidate.score = -(z_volume*z_volume + z_side_x*z_side_x + z_side_y*z_side_y);
     return true;
 }
 
-bool BinDetector::icp_refined_pose(sensor_msgs::PointCloud2 icp_cloud_msg, geometry_msgs::Pose& initial,
-                                   geometry_msgs::Pose& final, double& matching_error) {
-    geometry_msgs::Transform icp_initial_estimate;
-    icp_initial_estimate.translation.x = initial.position.x;
-    icp_initial_estimate.translation.y = initial.position.y;
-    icp_initial_estimate.translation.z = initial.position.z;
-    icp_initial_estimate.rotation.x = initial.orientation.x;
-    icp_initial_estimate.rotation.y = initial.orientation.y;
-    icp_initial_estimate.rotation.z = initial.orientation.z;
-    icp_initial_estimate.rotation.w = initial.orientation.w;
+bool BinDetector::fit_planar_box(const pcl::PointCloud<pcl::PointXYZRGB>& cloud, ApproxMVBB::OOBB& bb)
+{
+    // projects onto the table plane (the table normal is the z axis of the segmentation frame)
+    std::vector<std::pair<double, double> > pts(cloud.size());
+    double max_z = -std::numeric_limits<double>::infinity();
+    for (size_t i = 0; i < cloud.size(); i++)
+    {
+        pts[i] = std::make_pair(static_cast<double>(cloud[i].x), static_cast<double>(cloud[i].y));
+        max_z = std::max(max_z, static_cast<double>(cloud[i].z));
+    }
+    double height = max_z - table_height_;
+    if (height <= 0)
+    {
+        return false;
+    }
 
-    // gets initial segmentation
-    fetchit_icp::TemplateMatch icp_srv;
-    icp_srv.request.initial_estimate = icp_initial_estimate;
+    // convex hull (monotone chain), counter-clockwise without collinear points
+    std::sort(pts.begin(), pts.end());
+    pts.erase(std::unique(pts.begin(), pts.end()), pts.end());
+    if (pts.size() < 3)
+    {
+        return false;
+    }
+    std::vector<std::pair<double, double> > hull(2*pts.size());
+    size_t k = 0;
+    for (size_t i = 0; i < pts.size(); i++)
+    {
+        while (k >= 2 && hull_cross(hull[k - 2], hull[k - 1], pts[i]) <= 0)
+        {
+            k--;
+        }
+        hull[k++] = pts[i];
+    }
+    for (size_t i = pts.size() - 1, lower = k + 1; i > 0; i--)
+    {
+        while (k >= lower && hull_cross(hull[k - 2], hull[k - 1], pts[i - 1]) <= 0)
+        {
+            k--;
+        }
+        hull[k++] = pts[i - 1];
+    }
+    hull.resize(k - 1);
+    size_t h = hull.size();
+    if (h < 3)
+    {
+        return false;
+    }
+
+    // minimum area rectangle with rotating calipers, one side of the rectangle is collinear with a hull edge
+    double min_area = std::numeric_limits<double>::infinity();
+    double best_ux = 1, best_uy = 0;
+    double best_min_u = 0, best_max_u = 0, best_min_v = 0, best_max_v = 0;
+    size_t right = 1, top = 1, left = 1;
+    for (size_t i = 0; i < h; i++)
+    {
+        const std::pair<double, double>& a = hull[i];
+        const std::pair<double, double>& b = hull[(i + 1) % h];
+        double length = hypot(b.first - a.first, b.second - a.second);
+        double ux = (b.first - a.first)/length;
+        double uy = (b.second - a.second)/length;
+
+        // calipers only ever advance, giving linear time over the hull
+        while (ux*hull[(right + 1) % h].first + uy*hull[(right + 1) % h].second
+               > ux*hull[right % h].first + uy*hull[right % h].second)
+        {
+            right++;
+        }
+        if (i == 0)
+        {
+            top = right;
+        }
+        while (-uy*hull[(top + 1) % h].first + ux*hull[(top + 1) % h].second
+               > -uy*hull[top % h].first + ux*hull[top % h].second)
+        {
+            top++;
+        }
+        if (i == 0)
+        {
+            left = top;
+        }
+        while (ux*hull[(left + 1) % h].first + uy*hull[(left + 1) % h].second
+               < ux*hull[left % h].first + uy*hull[left % h].second)
+        {
+            left++;
+        }
+
+        double min_u = ux*hull[left % h].first + uy*hull[left % h].second;
+        double max_u = ux*hull[right % h].first + uy*hull[right % h].second;
+        double min_v = -uy*a.first + ux*a.second;
+        double max_v = -uy*hull[top % h].first + ux*hull[top % h].second;
+        double area = (max_u - min_u)*(max_v - min_v);
+        if (area < min_area)
+        {
+            min_area = area;
+            best_ux = ux;
+            best_uy = uy;
+            best_min_u = min_u;
+            best_max_u = max_u;
+            best_min_v = min_v;
+            best_max_v = max_v;
+        }
+    }
+
+    // a box taller than it is wide is not resting flat, leave it to the 3D fit
+    if (height >= std::min(best_max_u - best_min_u, best_max_v - best_min_v))
+    {
+        return false;
+    }
+
+    // bin frame: x along the rectangle edge, z along the table normal, bottom on the table
+    bb = ApproxMVBB::OOBB();
+    bb.m_q_KI = ApproxMVBB::Quaternion(Eigen::AngleAxisd(atan2(best_uy, best_ux), Eigen::Vector3d::UnitZ()));
+    bb.m_minPoint = ApproxMVBB::Vector3(best_min_u, best_min_v, table_height_);
+    bb.m_maxPoint = ApproxMVBB::Vector3(best_max_u, best_max_v, max_z);
+    return true;
+}
+
+double BinDetector::hull_cross(const std::pair<double, double>& o, const std::pair<double, double>& a,
+                               const std::pair<double, double>& b)
+{
+    return (a.first - o.first)*(b.second - o.second) - (a.second - o.second)*(b.first - o.first);
+}
+
+bool BinDetector::icp_refined_poses(sensor_msgs::PointCloud2 icp_cloud_msg,
+                                    const std::vector<geometry_msgs::Pose>& initial,
+                                    std::vector<double>& matching_errors) {
+    // matches the bin template once per candidate, the target is fetched and preprocessed only once
+    fetchit_icp::MultiTemplateMatch icp_srv;
+    for (unsigned i=0; i<initial.size(); i++) {
+        geometry_msgs::Transform icp_initial_estimate;
+        icp_initial_estimate.translation.x = initial[i].position.x;
+        icp_initial_estimate.translation.y = initial[i].position.y;
+        icp_initial_estimate.translation.z = initial[i].position.z;
+        icp_initial_estimate.rotation = initial[i].orientation;
+        icp_srv.request.template_names.push_back(kit_template_name_);
+        icp_srv.request.initial_estimates.push_back(icp_initial_estimate);
+    }
     icp_srv.request.target_cloud = icp_cloud_msg;
     if (!icp_client_.call(icp_srv))
     {
         ROS_ERROR("Failed to call template matching service.");
         return false;
-    } else {
-        final.position.x = icp_srv.response.template_pose.transform.translation.x;
-        final.position.y = icp_srv.response.template_pose.transform.translation.y;
-        final.position.z = icp_srv.response.template_pose.transform.translation.z;
-        final.orientation.x = icp_srv.response.template_pose.transform.rotation.x;
-        final.orientation.y = icp_srv.response.template_pose.transform.rotation.y;
-        final.orientation.z = icp_srv.response.template_pose.transform.rotation.z;
-        final.orientation.w = icp_srv.response.template_pose.transform.rotation.w;
-        matching_error = icp_srv.response.match_error;
-        return true;
     }
+
+    matching_errors.resize(initial.size());
+    for (unsigned i=0; i<initial.size(); i++) {
+        if (!icp_srv.response.results[i].success) {
+            ROS_ERROR("Template matching failed for bin candidate orientation %u.", i);
+            return false;
+        }
+        matching_errors[i] = icp_srv.response.results[i].match_error;
+    }
+    return true;
 }
 
 bool BinDetector::get_bin_pose(ApproxMVBB::OOBB& bb, sensor_msgs::PointCloud2 & cloud, geometry_msgs::Pose& bin_pose) {
@@ -357,12 +899,12 @@ bool BinDetector::get_bin_pose(ApproxMVBB::OOBB& bb, sensor_msgs::PointCloud2 &
     adjust_orientations.push_back(ApproxMVBB::Quaternion(0,0,0,1)); // 180 yaw adjustment
     adjust_orientations.push_back(ApproxMVBB::Quaternion(-0.7071068,0,0,0.7071068)); // 270 yaw adjustment
 
-    // iteratively calls icp on point cloud and selects the orientation with smallest yaw, pitch, roll changes
+    // makes the candidate poses
+    std::vector<ApproxMVBB::Quaternion> candidate_orientations;
+    std::vector<geometry_msgs::Pose> candidate_poses;
     for (unsigned i=0; i<adjust_orientations.size(); i++) {
-        // makes candidate pose
         ApproxMVBB::Quaternion candidate_orientation = bin_orientation * adjust_orientations[i];
         geometry_msgs::Pose candidate_pose;
-        geometry_msgs::Pose output_pose;
         candidate_pose.position.x = bin_position.x();
         candidate_pose.position.y = bin_position.y();
         candidate_pose.position.z = bin_position.z();
@@ -370,18 +912,21 @@ bool BinDetector::get_bin_pose(ApproxMVBB::OOBB& bb, sensor_msgs::PointCloud2 &
         candidate_pose.orientation.y = candidate_orientation.y();
         candidate_pose.orientation.z = candidate_orientation.z();
         candidate_pose.orientation.w = candidate_orientation.w();
-        double match_error;
+        candidate_orientations.push_back(candidate_orientation);
+        candidate_poses.push_back(candidate_pose);
+    }
 
-        // allows ICP to refine the candidate pose
-        bool success = icp_refined_pose(cloud,candidate_pose,output_pose,match_error);
-        if (!success) {
-            return false;
-        }
+    // allows ICP to refine every candidate pose at once
+    std::vector<double> match_errors;
+    if (!icp_refined_poses(cloud,candidate_poses,match_errors)) {
+        return false;
+    }
 
-        // stores lowest ICP match error adjust_orientation as the best_orientation
-        if (match_error < best_match_error) {
-            best_match_error = match_error;
-            best_orientation = candidate_orientation;
+    // stores lowest ICP match error adjust_orientation as the best_orientation
+    for (unsigned i=0; i<candidate_orientations.size(); i++) {
+        if (match_errors[i] < best_match_error) {
+            best_match_error = match_errors[i];
+            best_orientation = candidate_orientations[i];
         }
     }
 
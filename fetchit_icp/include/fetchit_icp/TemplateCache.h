@@ -0,0 +1,91 @@
+#ifndef FETCHIT_ICP_TEMPLATE_CACHE_H
+#define FETCHIT_ICP_TEMPLATE_CACHE_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include <pcl/point_cloud.h>
+#include <pcl/point_types.h>
+
+// on-disk layout of a template cache (.tcache), all values little-endian and 8-byte aligned
+struct TemplateCacheHeader {
+    char magic[8];              // "FITTCACH"
+    uint32_t version;
+    uint32_t num_levels;
+    uint64_t source_size;       // size of the .pcd the cache was built from
+    int64_t source_mtime;       // modification time of the .pcd the cache was built from
+};
+
+struct TemplateCacheLevelHeader {
+    float leaf_size;            // voxel size of this pyramid level (0 means the unfiltered template)
+    uint32_t num_points;
+    uint64_t points_offset;     // xyz floats, stored in implicit kd-tree node order
+    uint64_t normals_offset;    // xyz floats, same order as points
+    uint64_t split_dims_offset; // one byte per kd-tree node giving its split axis
+};
+
+// read-only view of one pyramid level, points live in the mapped cache
+class TemplateLevel {
+    public:
+        float leaf_size;
+        uint32_t num_points;
+        const float* points;
+        const float* normals;
+        const uint8_t* split_dims;
+
+        // nearest template point to query within sqrt(max_dist_sqr), returns -1 if none
+        int nearest(const float* query, float max_dist_sqr, float& dist_sqr) const;
+
+        // copies the level into a point cloud (kd-tree order)
+        void toCloud(pcl::PointCloud<pcl::PointXYZRGB>& cloud) const;
+
+    protected:
+        void nearest(uint32_t lo, uint32_t hi, const float* query, int& best, float& best_dist_sqr) const;
+};
+
+class TemplateCache {
+    public:
+        static const uint32_t VERSION = 1;
+
+        TemplateCache();
+        ~TemplateCache();
+
+        // builds the full cache (voxel pyramid, normals, kd-tree order) into a byte buffer
+        static void build(const pcl::PointCloud<pcl::PointXYZ>& cloud, const std::vector<float>& leaf_sizes,
+                          uint64_t source_size, int64_t source_mtime, std::vector<char>& buffer);
+
+        // writes a built cache buffer to disk
+        static bool write(const std::string& cache_file, const std::vector<char>& buffer);
+
+        // reads size and mtime of a template source file, used to detect stale caches
+        static bool sourceStamp(const std::string& source_file, uint64_t& size, int64_t& mtime);
+
+        // default pyramid used by the cache builder and the in-memory fallback
+        static std::vector<float> defaultLeafSizes();
+
+        // memory maps a cache file, fails if the file is missing, corrupt or stale w.r.t. the source stamp
+        bool map(const std::string& cache_file, uint64_t source_size, int64_t source_mtime);
+
+        // takes ownership of an in-memory buffer produced by build()
+        bool adopt(std::vector<char>& buffer);
+
+        bool isMapped() const { return mapped_data_ != NULL; }
+        size_t numLevels() const { return levels_.size(); }
+        const TemplateLevel& level(size_t i) const { return levels_[i]; }
+
+    protected:
+        void release();
+        bool parse(const char* data, size_t size, uint64_t source_size, int64_t source_mtime, bool check_stamp);
+
+        void* mapped_data_;
+        size_t mapped_size_;
+        std::vector<char> owned_data_;
+        std::vector<TemplateLevel> levels_;
+
+    private:
+        TemplateCache(const TemplateCache&);
+        TemplateCache& operator=(const TemplateCache&);
+};
+
+#endif
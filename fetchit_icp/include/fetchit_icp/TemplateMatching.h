@@ -1,26 +1,77 @@
 #include <ros/package.h>
 #include <ros/time.h>
 #include <pcl/io/ply_io.h>
+#include <pcl/features/normal_3d.h>
+#include <pcl/filters/voxel_grid.h>
+#include <pcl/search/kdtree.h>
 #include <pcl_conversions/pcl_conversions.h>
 
 #include <geometry_msgs/Transform.h>
 #include <sensor_msgs/PointCloud2.h>
+#include <std_srvs/SetBool.h>
 #include <tf2_ros/static_transform_broadcaster.h>
 
 #include "fetchit_icp/ICPMatching.h"
+#include "fetchit_icp/TemplateCache.h"
+#include "fetchit_icp/MultiTemplateMatch.h"
 #include "fetchit_icp/TemplateMatch.h"
+#include "fetchit_icp/TrackedPose.h"
+
+// parses "x y z roll pitch yaw" launch param strings into a transform
+tf::Transform pose_string_to_tf(const std::string& pose_string);
+
+// a template served by name, with its own pose defaults and cached data
+struct NamedTemplate {
+    std::string name;
+    std::string frame;
+    tf::Transform initial_estimate;
+    tf::Transform offset;
+    TemplateCache cache;
+    int level;
+    double radius;
+};
 
 class TemplateMatcher {
     public:
         TemplateMatcher(ros::NodeHandle& nh, std::string& matching_frame, std::string& pcl_topic,
                                  std::string& template_file, tf::Transform& initial_estimate,
                                  tf::Transform& template_offset, std::string& template_frame, bool visualize,
-                                 bool debug, bool latch, bool pre_processed_cloud);
+                                 bool debug, bool latch, bool pre_processed_cloud, int template_level = 0);
 
         // handles requests to match a template CAD model (in PCD form) to a point cloud from a point cloud topic
         bool handle_match_template(fetchit_icp::TemplateMatch::Request& req, fetchit_icp::TemplateMatch::Response& res);
 
+        // matches several named templates against one shared, preprocessed target cloud in parallel
+        bool handle_match_templates(fetchit_icp::MultiTemplateMatch::Request& req,
+                                    fetchit_icp::MultiTemplateMatch::Response& res);
+
+        // enables or disables continuous tracking, tracking locks on after the next successful match
+        bool handle_set_tracking(std_srvs::SetBool::Request& req, std_srvs::SetBool::Response& res);
+
     protected:
+        // maps the precomputed template cache, or builds it in memory if the cache is missing or stale
+        bool load_template(const std::string& template_filepath, NamedTemplate& entry);
+
+        // gets the target cloud (fresh from pcl_topic_ or from the request) in the matching frame
+        bool get_target_cloud(const sensor_msgs::PointCloud2& provided_cloud,
+                              pcl::PointCloud<pcl::PointXYZRGB>& target_cloud);
+
+        // point-to-plane ICP of one template against the shared target, thread safe
+        void match_named_template(const NamedTemplate& entry, const tf::Transform& initial_estimate,
+                                  const pcl::PointCloud<pcl::PointNormal>::ConstPtr& target,
+                                  const pcl::search::KdTree<pcl::PointNormal>::Ptr& target_tree,
+                                  fetchit_icp::TemplateMatchResult& result);
+
+        // re-registers the locked template on incoming frames, warm-started from the previous pose
+        void track_callback(const sensor_msgs::PointCloud2ConstPtr& msg);
+
+        // point-to-point ICP of target points (matching frame) against a cached template level, refines pose in place
+        bool track_icp(const pcl::PointCloud<pcl::PointXYZRGB>& target, const TemplateLevel& level, tf::Transform& pose,
+                       double& confidence, double& match_error);
+
+        // publishes the tracked pose stream and, if visualizing, the template frame
+        void publish_tracked_pose(const ros::Time& stamp, double confidence, double match_error);
+
         ros::NodeHandle matcher_nh_;
         std::string matching_frame_;
         std::string template_frame_;
@@ -29,8 +80,16 @@ class TemplateMatcher {
         tf::Transform initial_estimate_;
         tf::Transform template_offset_;
         pcl::PointCloud<pcl::PointXYZRGB>::Ptr template_cloud_;
+        boost::shared_ptr<NamedTemplate> primary_template_;
+        std::map<std::string, boost::shared_ptr<NamedTemplate> > templates_;
         ros::ServiceClient icp_client_;
         ros::ServiceServer pose_srv_;
+        ros::ServiceServer multi_pose_srv_;
+        int icp_iterations_;
+        double icp_max_distance_;
+        double icp_trans_epsilon_;
+        double icp_fit_epsilon_;
+        double target_leaf_size_;
         bool viz_;
         bool debug_;
         bool latched_initial_estimate_;
@@ -39,5 +98,19 @@ class TemplateMatcher {
         ros::Publisher pub_targ_;
         ros::Publisher pub_mtemp_;
 
+        // tracking mode
+        bool tracking_enabled_;
+        bool tracking_locked_;
+        int tracking_frame_skip_;
+        int tracking_frame_count_;
+        int tracking_level_;
+        int tracking_iterations_;
+        double tracking_max_dist_;
+        double tracking_min_confidence_;
+        tf::Transform tracked_pose_;
+        ros::Subscriber track_sub_;
+        ros::Publisher pub_tracked_;
+        ros::ServiceServer tracking_srv_;
+
         tf2_ros::StaticTransformBroadcaster static_broadcaster;
 };
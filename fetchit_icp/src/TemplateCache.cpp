@@ -0,0 +1,320 @@
+#include "fetchit_icp/TemplateCache.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <pcl/features/normal_3d.h>
+#include <pcl/filters/voxel_grid.h>
+#include <pcl/search/kdtree.h>
+
+namespace {
+
+const char CACHE_MAGIC[8] = {'F','I','T','T','C','A','C','H'};
+
+size_t align8(size_t offset) {
+    return (offset + 7) & ~static_cast<size_t>(7);
+}
+
+// recursively orders indices so that the median of every range is its kd-tree node
+void buildImplicitKdTree(const pcl::PointCloud<pcl::PointXYZ>& cloud, std::vector<int>& order,
+                         std::vector<uint8_t>& split_dims, int lo, int hi) {
+    if (hi - lo <= 0) {
+        return;
+    }
+
+    // splits along the axis of largest extent
+    float min_pt[3] = {1e9f, 1e9f, 1e9f};
+    float max_pt[3] = {-1e9f, -1e9f, -1e9f};
+    for (int i = lo; i < hi; i++) {
+        const pcl::PointXYZ& p = cloud.points[order[i]];
+        min_pt[0] = std::min(min_pt[0], p.x); max_pt[0] = std::max(max_pt[0], p.x);
+        min_pt[1] = std::min(min_pt[1], p.y); max_pt[1] = std::max(max_pt[1], p.y);
+        min_pt[2] = std::min(min_pt[2], p.z); max_pt[2] = std::max(max_pt[2], p.z);
+    }
+    uint8_t dim = 0;
+    for (uint8_t d = 1; d < 3; d++) {
+        if (max_pt[d] - min_pt[d] > max_pt[dim] - min_pt[dim]) {
+            dim = d;
+        }
+    }
+
+    int mid = lo + (hi - lo)/2;
+    std::nth_element(order.begin() + lo, order.begin() + mid, order.begin() + hi,
+                     [&cloud, dim](int a, int b) {
+                         return cloud.points[a].data[dim] < cloud.points[b].data[dim];
+                     });
+    split_dims[mid] = dim;
+    buildImplicitKdTree(cloud, order, split_dims, lo, mid);
+    buildImplicitKdTree(cloud, order, split_dims, mid + 1, hi);
+}
+
+}
+
+int TemplateLevel::nearest(const float* query, float max_dist_sqr, float& dist_sqr) const {
+    int best = -1;
+    dist_sqr = max_dist_sqr;
+    nearest(0, num_points, query, best, dist_sqr);
+    return best;
+}
+
+void TemplateLevel::nearest(uint32_t lo, uint32_t hi, const float* query, int& best, float& best_dist_sqr) const {
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo)/2;
+        const float* p = points + 3*mid;
+        float dx = p[0] - query[0];
+        float dy = p[1] - query[1];
+        float dz = p[2] - query[2];
+        float d = dx*dx + dy*dy + dz*dz;
+        if (d < best_dist_sqr) {
+            best_dist_sqr = d;
+            best = static_cast<int>(mid);
+        }
+
+        // descends into the near side first, then visits the far side only if the split plane is closer than the
+        // best distance found on the near side
+        uint8_t dim = split_dims[mid];
+        float diff = query[dim] - p[dim];
+        if (diff < 0) {
+            nearest(lo, mid, query, best, best_dist_sqr);
+            if (diff*diff >= best_dist_sqr) {
+                return;
+            }
+            lo = mid + 1;
+        } else {
+            nearest(mid + 1, hi, query, best, best_dist_sqr);
+            if (diff*diff >= best_dist_sqr) {
+                return;
+            }
+            hi = mid;
+        }
+    }
+}
+
+void TemplateLevel::toCloud(pcl::PointCloud<pcl::PointXYZRGB>& cloud) const {
+    cloud.clear();
+    cloud.points.resize(num_points);
+    for (uint32_t i = 0; i < num_points; i++) {
+        cloud.points[i].x = points[3*i];
+        cloud.points[i].y = points[3*i + 1];
+        cloud.points[i].z = points[3*i + 2];
+    }
+    cloud.width = num_points;
+    cloud.height = 1;
+    cloud.is_dense = true;
+}
+
+TemplateCache::TemplateCache() : mapped_data_(NULL), mapped_size_(0) {}
+
+TemplateCache::~TemplateCache() {
+    release();
+}
+
+std::vector<float> TemplateCache::defaultLeafSizes() {
+    // level 0 is the template as sampled from CAD, coarser levels serve fast or warm-started matching
+    std::vector<float> leaf_sizes;
+    leaf_sizes.push_back(0.0f);
+    leaf_sizes.push_back(0.02f);
+    leaf_sizes.push_back(0.04f);
+    return leaf_sizes;
+}
+
+bool TemplateCache::sourceStamp(const std::string& source_file, uint64_t& size, int64_t& mtime) {
+    struct stat st;
+    if (stat(source_file.c_str(), &st) != 0) {
+        return false;
+    }
+    size = static_cast<uint64_t>(st.st_size);
+    mtime = static_cast<int64_t>(st.st_mtime);
+    return true;
+}
+
+void TemplateCache::build(const pcl::PointCloud<pcl::PointXYZ>& cloud, const std::vector<float>& leaf_sizes,
+                          uint64_t source_size, int64_t source_mtime, std::vector<char>& buffer) {
+    pcl::PointCloud<pcl::PointXYZ>::Ptr source(new pcl::PointCloud<pcl::PointXYZ>(cloud));
+
+    std::vector<TemplateCacheLevelHeader> level_headers(leaf_sizes.size());
+    std::vector<std::vector<char> > level_data(leaf_sizes.size());
+    size_t offset = align8(sizeof(TemplateCacheHeader) + leaf_sizes.size()*sizeof(TemplateCacheLevelHeader));
+
+    for (size_t l = 0; l < leaf_sizes.size(); l++) {
+        // voxel pyramid level
+        pcl::PointCloud<pcl::PointXYZ>::Ptr level_cloud(new pcl::PointCloud<pcl::PointXYZ>);
+        if (leaf_sizes[l] > 0) {
+            pcl::VoxelGrid<pcl::PointXYZ> grid;
+            grid.setInputCloud(source);
+            grid.setLeafSize(leaf_sizes[l], leaf_sizes[l], leaf_sizes[l]);
+            grid.filter(*level_cloud);
+        } else {
+            *level_cloud = *source;
+        }
+        size_t n = level_cloud->size();
+
+        // normals, the radius scales with the level resolution
+        float resolution = std::max(leaf_sizes[l], 0.01f);
+        pcl::search::KdTree<pcl::PointXYZ>::Ptr tree(new pcl::search::KdTree<pcl::PointXYZ>);
+        pcl::PointCloud<pcl::Normal>::Ptr normals(new pcl::PointCloud<pcl::Normal>);
+        pcl::NormalEstimation<pcl::PointXYZ, pcl::Normal> ne;
+        ne.setInputCloud(level_cloud);
+        ne.setSearchMethod(tree);
+        ne.setRadiusSearch(2.5f*resolution);
+        ne.compute(*normals);
+
+        // implicit kd-tree ordering
+        std::vector<int> order(n);
+        for (size_t i = 0; i < n; i++) {
+            order[i] = static_cast<int>(i);
+        }
+        std::vector<uint8_t> split_dims(n, 0);
+        buildImplicitKdTree(*level_cloud, order, split_dims, 0, static_cast<int>(n));
+
+        // serializes the level in kd-tree order
+        size_t points_bytes = align8(3*n*sizeof(float));
+        size_t split_bytes = align8(n*sizeof(uint8_t));
+        std::vector<char>& data = level_data[l];
+        data.assign(2*points_bytes + split_bytes, 0);
+        float* points_out = reinterpret_cast<float*>(&data[0]);
+        float* normals_out = reinterpret_cast<float*>(&data[points_bytes]);
+        uint8_t* split_out = reinterpret_cast<uint8_t*>(&data[2*points_bytes]);
+        for (size_t i = 0; i < n; i++) {
+            const pcl::PointXYZ& p = level_cloud->points[order[i]];
+            const pcl::Normal& nrm = normals->points[order[i]];
+            points_out[3*i] = p.x;
+            points_out[3*i + 1] = p.y;
+            points_out[3*i + 2] = p.z;
+            // undefined normals (isolated points) are stored as zero vectors
+            bool valid_normal = pcl_isfinite(nrm.normal_x) && pcl_isfinite(nrm.normal_y) && pcl_isfinite(nrm.normal_z);
+            normals_out[3*i] = valid_normal ? nrm.normal_x : 0.0f;
+            normals_out[3*i + 1] = valid_normal ? nrm.normal_y : 0.0f;
+            normals_out[3*i + 2] = valid_normal ? nrm.normal_z : 0.0f;
+            split_out[i] = split_dims[i];
+        }
+
+        TemplateCacheLevelHeader& level_header = level_headers[l];
+        std::memset(&level_header, 0, sizeof(level_header));
+        level_header.leaf_size = leaf_sizes[l];
+        level_header.num_points = static_cast<uint32_t>(n);
+        level_header.points_offset = offset;
+        level_header.normals_offset = offset + points_bytes;
+        level_header.split_dims_offset = offset + 2*points_bytes;
+        offset += data.size();
+    }
+
+    // assembles header, level table and level data
+    TemplateCacheHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, CACHE_MAGIC, sizeof(header.magic));
+    header.version = VERSION;
+    header.num_levels = static_cast<uint32_t>(leaf_sizes.size());
+    header.source_size = source_size;
+    header.source_mtime = source_mtime;
+
+    buffer.assign(offset, 0);
+    std::memcpy(&buffer[0], &header, sizeof(header));
+    if (!level_headers.empty()) {
+        std::memcpy(&buffer[sizeof(header)], &level_headers[0], level_headers.size()*sizeof(TemplateCacheLevelHeader));
+    }
+    for (size_t l = 0; l < level_data.size(); l++) {
+        if (!level_data[l].empty()) {
+            std::memcpy(&buffer[level_headers[l].points_offset], &level_data[l][0], level_data[l].size());
+        }
+    }
+}
+
+bool TemplateCache::write(const std::string& cache_file, const std::vector<char>& buffer) {
+    std::ofstream out(cache_file.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+    if (!out.is_open()) {
+        return false;
+    }
+    out.write(buffer.data(), buffer.size());
+    return out.good();
+}
+
+bool TemplateCache::map(const std::string& cache_file, uint64_t source_size, int64_t source_mtime) {
+    release();
+
+    int fd = open(cache_file.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < static_cast<off_t>(sizeof(TemplateCacheHeader))) {
+        close(fd);
+        return false;
+    }
+    void* data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        return false;
+    }
+    mapped_data_ = data;
+    mapped_size_ = static_cast<size_t>(st.st_size);
+
+    if (!parse(static_cast<const char*>(mapped_data_), mapped_size_, source_size, source_mtime, true)) {
+        release();
+        return false;
+    }
+    return true;
+}
+
+bool TemplateCache::adopt(std::vector<char>& buffer) {
+    release();
+    owned_data_.swap(buffer);
+    if (!parse(owned_data_.data(), owned_data_.size(), 0, 0, false)) {
+        release();
+        return false;
+    }
+    return true;
+}
+
+void TemplateCache::release() {
+    if (mapped_data_ != NULL) {
+        munmap(mapped_data_, mapped_size_);
+        mapped_data_ = NULL;
+        mapped_size_ = 0;
+    }
+    owned_data_.clear();
+    levels_.clear();
+}
+
+bool TemplateCache::parse(const char* data, size_t size, uint64_t source_size, int64_t source_mtime,
+                          bool check_stamp) {
+    if (size < sizeof(TemplateCacheHeader)) {
+        return false;
+    }
+    const TemplateCacheHeader* header = reinterpret_cast<const TemplateCacheHeader*>(data);
+    if (std::memcmp(header->magic, CACHE_MAGIC, sizeof(header->magic)) != 0 || header->version != VERSION) {
+        return false;
+    }
+    if (check_stamp && (header->source_size != source_size || header->source_mtime != source_mtime)) {
+        return false;
+    }
+    if (size < sizeof(TemplateCacheHeader) + header->num_levels*sizeof(TemplateCacheLevelHeader)) {
+        return false;
+    }
+
+    const TemplateCacheLevelHeader* level_headers =
+            reinterpret_cast<const TemplateCacheLevelHeader*>(data + sizeof(TemplateCacheHeader));
+    levels_.resize(header->num_levels);
+    for (uint32_t l = 0; l < header->num_levels; l++) {
+        const TemplateCacheLevelHeader& lh = level_headers[l];
+        uint64_t n = lh.num_points;
+        if (lh.points_offset + 3*n*sizeof(float) > size || lh.normals_offset + 3*n*sizeof(float) > size ||
+            lh.split_dims_offset + n > size) {
+            levels_.clear();
+            return false;
+        }
+        TemplateLevel& level = levels_[l];
+        level.leaf_size = lh.leaf_size;
+        level.num_points = lh.num_points;
+        level.points = reinterpret_cast<const float*>(data + lh.points_offset);
+        level.normals = reinterpret_cast<const float*>(data + lh.normals_offset);
+        level.split_dims = reinterpret_cast<const uint8_t*>(data + lh.split_dims_offset);
+    }
+    return true;
+}
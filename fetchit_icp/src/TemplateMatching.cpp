@@ -1,9 +1,26 @@
 #include "fetchit_icp/TemplateMatching.h"
 
+#include <Eigen/Geometry>
+#include <boost/thread/thread.hpp>
+#include <pcl/common/transforms.h>
+
+tf::Transform pose_string_to_tf(const std::string& pose_string) {
+    // "x y z roll pitch yaw", rotation as used by the template_matcher_node params
+    std::vector<float> pose;
+    std::istringstream pose_string_stream(pose_string);
+    for(std::string value_string; pose_string_stream >> value_string;)
+        pose.push_back(std::stof(value_string));
+    pose.resize(6, 0.0f);
+    tf::Transform transform;
+    transform.setOrigin(tf::Vector3(pose[0],pose[1],pose[2]));
+    transform.setRotation(tf::Quaternion(pose[4],pose[5],pose[3]));
+    return transform;
+}
+
 TemplateMatcher::TemplateMatcher(ros::NodeHandle& nh, std::string& matching_frame, std::string& pcl_topic,
                                  std::string& template_file, tf::Transform& initial_estimate,
                                  tf::Transform& template_offset, std::string& template_frame, bool visualize,
-                                 bool debug, bool latch, bool pre_processed_cloud) {
+                                 bool debug, bool latch, bool pre_processed_cloud, int template_level) {
     matcher_nh_ = nh;
     matching_frame_ = matching_frame;
     pcl_topic_ = pcl_topic;
@@ -20,12 +37,60 @@ TemplateMatcher::TemplateMatcher(ros::NodeHandle& nh, std::string& matching_fram
     std::string templates_path = ros::package::getPath("fetchit_icp")+"/cad_models/";
     std::string template_filepath = templates_path+template_file;
 
-    // loads template cloud
-    template_cloud_ = boost::make_shared<pcl::PointCloud<pcl::PointXYZRGB>>();
-    if (pcl::io::loadPCDFile<pcl::PointXYZRGB>(template_filepath,*template_cloud_) < 0) {
+    // loads template cloud, it is also served by name for multi-template requests
+    primary_template_ = boost::make_shared<NamedTemplate>();
+    primary_template_->name = template_file.substr(0, template_file.rfind(".pcd"));
+    pnh.getParam("template_name", primary_template_->name);
+    primary_template_->frame = template_frame_;
+    primary_template_->initial_estimate = initial_estimate_;
+    primary_template_->offset = template_offset_;
+    primary_template_->level = template_level;
+    if (!load_template(template_filepath, *primary_template_)) {
         ROS_ERROR("Could not load template PCD.");
         exit(-1);
     }
+    template_cloud_ = boost::make_shared<pcl::PointCloud<pcl::PointXYZRGB>>();
+    primary_template_->cache.level(primary_template_->level).toCloud(*template_cloud_);
+    templates_[primary_template_->name] = primary_template_;
+
+    // loads additional named templates, each a struct with file, initial_estimate, offset, frame and level
+    XmlRpc::XmlRpcValue template_list;
+    if (pnh.getParam("templates", template_list) && template_list.getType() == XmlRpc::XmlRpcValue::TypeArray) {
+        for (int i = 0; i < template_list.size(); i++) {
+            XmlRpc::XmlRpcValue& item = template_list[i];
+            if (item.getType() != XmlRpc::XmlRpcValue::TypeStruct || !item.hasMember("name")
+                || !item.hasMember("file")) {
+                ROS_WARN("Skipping template %d, it needs at least a name and a file.", i);
+                continue;
+            }
+            boost::shared_ptr<NamedTemplate> entry = boost::make_shared<NamedTemplate>();
+            entry->name = static_cast<std::string>(item["name"]);
+            entry->frame = item.hasMember("frame") ? static_cast<std::string>(item["frame"]) : entry->name + "_pose";
+            entry->initial_estimate = pose_string_to_tf(
+                    item.hasMember("initial_estimate") ? static_cast<std::string>(item["initial_estimate"])
+                                                       : "0 0 0 0 0 0");
+            entry->offset = pose_string_to_tf(
+                    item.hasMember("offset") ? static_cast<std::string>(item["offset"]) : "0 0 0 0 0 0");
+            entry->level = item.hasMember("level") ? static_cast<int>(item["level"]) : 0;
+            if (!load_template(templates_path + static_cast<std::string>(item["file"]), *entry)) {
+                ROS_ERROR("Could not load template PCD for %s.", entry->name.c_str());
+                continue;
+            }
+            templates_[entry->name] = entry;
+        }
+    }
+
+    // in-process ICP and target preprocessing params for multi-template matching
+    icp_iterations_ = 200;
+    icp_max_distance_ = 0.5;
+    icp_trans_epsilon_ = 1e-10;
+    icp_fit_epsilon_ = 1e-10;
+    target_leaf_size_ = 0.01;
+    pnh.getParam("icp_iterations", icp_iterations_);
+    pnh.getParam("icp_max_distance", icp_max_distance_);
+    pnh.getParam("icp_trans_epsilon", icp_trans_epsilon_);
+    pnh.getParam("icp_fit_epsilon", icp_fit_epsilon_);
+    pnh.getParam("target_leaf_size", target_leaf_size_);
 
     // creates service client to request ICP matches
     icp_client_ = matcher_nh_.serviceClient<fetchit_icp::ICPMatch>("/icp_match_clouds");
@@ -37,24 +102,77 @@ TemplateMatcher::TemplateMatcher(ros::NodeHandle& nh, std::string& matching_fram
 
     // creates service handler for template matching
     pose_srv_ = pnh.advertiseService("match_template", &TemplateMatcher::handle_match_template, this);
+    multi_pose_srv_ = pnh.advertiseService("match_templates", &TemplateMatcher::handle_match_templates, this);
+
+    // tracking mode params, tracking locks on after the first successful match
+    tracking_enabled_ = false;
+    tracking_locked_ = false;
+    tracking_frame_skip_ = 1;
+    tracking_frame_count_ = 0;
+    tracking_level_ = 1;
+    tracking_iterations_ = 10;
+    tracking_max_dist_ = 0.02;
+    tracking_min_confidence_ = 0.3;
+    pnh.getParam("tracking", tracking_enabled_);
+    pnh.getParam("tracking_frame_skip", tracking_frame_skip_);
+    pnh.getParam("tracking_level", tracking_level_);
+    pnh.getParam("tracking_iterations", tracking_iterations_);
+    pnh.getParam("tracking_max_dist", tracking_max_dist_);
+    pnh.getParam("tracking_min_confidence", tracking_min_confidence_);
+    tracking_frame_skip_ = std::max(tracking_frame_skip_, 1);
+    if (tracking_level_ < 0 || tracking_level_ >= static_cast<int>(primary_template_->cache.numLevels())) {
+        ROS_WARN("Tracking level %d not in cache, using level 0.", tracking_level_);
+        tracking_level_ = 0;
+    }
+
+    pub_tracked_ = pnh.advertise<fetchit_icp::TrackedPose>("tracked_pose", 1);
+    tracking_srv_ = pnh.advertiseService("set_tracking", &TemplateMatcher::handle_set_tracking, this);
+    if (tracking_enabled_) {
+        track_sub_ = matcher_nh_.subscribe(pcl_topic_, 1, &TemplateMatcher::track_callback, this);
+    }
 }
 
-bool TemplateMatcher::handle_match_template(fetchit_icp::TemplateMatch::Request& req, fetchit_icp::TemplateMatch::Response& res) {
-    // declare data structures
-    pcl::PointCloud<pcl::PointXYZRGB>::Ptr target_cloud(new pcl::PointCloud<pcl::PointXYZRGB>);
-    pcl::PointCloud<pcl::PointXYZRGB>::Ptr matched_template_cloud(new pcl::PointCloud<pcl::PointXYZRGB>);
+bool TemplateMatcher::load_template(const std::string& template_filepath, NamedTemplate& entry) {
+    uint64_t source_size;
+    int64_t source_mtime;
+    if (!TemplateCache::sourceStamp(template_filepath, source_size, source_mtime)) {
+        return false;
+    }
 
-    tf::Transform initial_estimate;
-    if (latched_initial_estimate_) {
-        initial_estimate = initial_estimate_;
-    } else {
-        tf::transformMsgToTF(req.initial_estimate,initial_estimate);
+    std::string::size_type ext = template_filepath.rfind(".pcd");
+    std::string cache_filepath = (ext == std::string::npos ? template_filepath : template_filepath.substr(0, ext))
+                                 + ".tcache";
+    if (!entry.cache.map(cache_filepath, source_size, source_mtime)) {
+        ROS_WARN("No up to date template cache at %s, building it in memory. Run template_cache_builder to "
+                 "precompute it.", cache_filepath.c_str());
+        pcl::PointCloud<pcl::PointXYZ> cloud;
+        if (pcl::io::loadPCDFile<pcl::PointXYZ>(template_filepath, cloud) < 0) {
+            return false;
+        }
+        std::vector<char> buffer;
+        TemplateCache::build(cloud, TemplateCache::defaultLeafSizes(), source_size, source_mtime, buffer);
+        if (!entry.cache.adopt(buffer)) {
+            return false;
+        }
     }
 
-    // prepares point cloud for matching by transforming by initial_estimate
-    pcl::PointCloud<pcl::PointXYZRGB>::Ptr _transformed_template_cloud(new pcl::PointCloud<pcl::PointXYZRGB>);
-    pcl_ros::transformPointCloud(*template_cloud_,*_transformed_template_cloud,initial_estimate);
+    if (entry.level < 0 || entry.level >= static_cast<int>(entry.cache.numLevels())) {
+        ROS_WARN("Template level %d not in cache for %s, using level 0.", entry.level, entry.name.c_str());
+        entry.level = 0;
+    }
+
+    // bounding radius of the template about its origin, used to crop target clouds
+    entry.radius = 0;
+    const TemplateLevel& level = entry.cache.level(0);
+    for (uint32_t i = 0; i < level.num_points; i++) {
+        const float* p = level.points + 3*i;
+        entry.radius = std::max(entry.radius, std::sqrt(static_cast<double>(p[0]*p[0] + p[1]*p[1] + p[2]*p[2])));
+    }
+    return true;
+}
 
+bool TemplateMatcher::get_target_cloud(const sensor_msgs::PointCloud2& provided_cloud,
+                                       pcl::PointCloud<pcl::PointXYZRGB>& target_cloud) {
     sensor_msgs::PointCloud2 target_cloud_msg;
     if (!pre_processed_cloud_) {
         ros::Time request_time = ros::Time::now();
@@ -74,16 +192,36 @@ bool TemplateMatcher::handle_match_template(fetchit_icp::TemplateMatch::Request&
             }
         }
     } else {
-        // gets pre-processed point cloud from template match request
-        target_cloud_msg = req.target_cloud;
+        // gets pre-processed point cloud from the request
+        target_cloud_msg = provided_cloud;
     }
-    pcl::fromROSMsg(target_cloud_msg,*target_cloud);
+    pcl::fromROSMsg(target_cloud_msg,target_cloud);
 
     // transforms point cloud to the matching frame
-    //if (matching_frame_ != target_cloud_msg.header.frame_id) {
-    pcl_ros::transformPointCloud(matching_frame_, ros::Time(0), *target_cloud, target_cloud_msg.header.frame_id,
-                                     *target_cloud, tf_);
-    //}
+    pcl_ros::transformPointCloud(matching_frame_, ros::Time(0), target_cloud, target_cloud_msg.header.frame_id,
+                                 target_cloud, tf_);
+    return true;
+}
+
+bool TemplateMatcher::handle_match_template(fetchit_icp::TemplateMatch::Request& req, fetchit_icp::TemplateMatch::Response& res) {
+    // declare data structures
+    pcl::PointCloud<pcl::PointXYZRGB>::Ptr target_cloud(new pcl::PointCloud<pcl::PointXYZRGB>);
+    pcl::PointCloud<pcl::PointXYZRGB>::Ptr matched_template_cloud(new pcl::PointCloud<pcl::PointXYZRGB>);
+
+    tf::Transform initial_estimate;
+    if (latched_initial_estimate_) {
+        initial_estimate = initial_estimate_;
+    } else {
+        tf::transformMsgToTF(req.initial_estimate,initial_estimate);
+    }
+
+    // prepares point cloud for matching by transforming by initial_estimate
+    pcl::PointCloud<pcl::PointXYZRGB>::Ptr _transformed_template_cloud(new pcl::PointCloud<pcl::PointXYZRGB>);
+    pcl_ros::transformPointCloud(*template_cloud_,*_transformed_template_cloud,initial_estimate);
+
+    if (!get_target_cloud(req.target_cloud, *target_cloud)) {
+        return false;
+    }
 
     // prepares sensor_msgs to make ICP request
     sensor_msgs::PointCloud2 template_msg;
@@ -138,6 +276,13 @@ bool TemplateMatcher::handle_match_template(fetchit_icp::TemplateMatch::Request&
     final_pose_stamped.transform.rotation.z = final_rot.z();
     final_pose_stamped.transform.rotation.w = final_rot.w();
 
+    // locks tracking on the new match
+    if (tracking_enabled_) {
+        tracked_pose_ = icp_refinement * initial_estimate;
+        tracking_locked_ = true;
+        tracking_frame_count_ = 0;
+    }
+
     // visualizes the matched point cloud and final estimated pose
     if (viz_)
     {
@@ -154,3 +299,346 @@ bool TemplateMatcher::handle_match_template(fetchit_icp::TemplateMatch::Request&
     res.match_error = template_matching_error;
     return true;
 }
+
+bool TemplateMatcher::handle_match_templates(fetchit_icp::MultiTemplateMatch::Request& req,
+                                             fetchit_icp::MultiTemplateMatch::Response& res) {
+    res.results.resize(req.template_names.size());
+
+    // resolves the requested templates and their initial estimates
+    std::vector<boost::shared_ptr<NamedTemplate> > entries(req.template_names.size());
+    std::vector<tf::Transform> initial_estimates(req.template_names.size());
+    for (size_t i = 0; i < req.template_names.size(); i++) {
+        res.results[i].template_name = req.template_names[i];
+        res.results[i].success = false;
+        std::map<std::string, boost::shared_ptr<NamedTemplate> >::iterator it = templates_.find(req.template_names[i]);
+        if (it == templates_.end()) {
+            ROS_ERROR("Unknown template %s.", req.template_names[i].c_str());
+            continue;
+        }
+        entries[i] = it->second;
+        if (!latched_initial_estimate_ && i < req.initial_estimates.size()) {
+            tf::transformMsgToTF(req.initial_estimates[i], initial_estimates[i]);
+        } else {
+            initial_estimates[i] = it->second->initial_estimate;
+        }
+    }
+
+    // fetches and transforms the target once for all templates
+    pcl::PointCloud<pcl::PointXYZRGB> target_cloud;
+    if (!get_target_cloud(req.target_cloud, target_cloud)) {
+        return false;
+    }
+
+    // crops to the neighbourhoods of the requested templates
+    pcl::PointCloud<pcl::PointNormal>::Ptr target(new pcl::PointCloud<pcl::PointNormal>);
+    target->reserve(target_cloud.size());
+    for (size_t j = 0; j < target_cloud.size(); j++) {
+        const pcl::PointXYZRGB& p = target_cloud.points[j];
+        if (!pcl_isfinite(p.x) || !pcl_isfinite(p.y) || !pcl_isfinite(p.z)) {
+            continue;
+        }
+        tf::Vector3 q(p.x, p.y, p.z);
+        for (size_t i = 0; i < entries.size(); i++) {
+            if (!entries[i]) {
+                continue;
+            }
+            double crop_radius = entries[i]->radius + icp_max_distance_;
+            if ((q - initial_estimates[i].getOrigin()).length2() <= crop_radius*crop_radius) {
+                pcl::PointNormal pn;
+                pn.x = p.x;
+                pn.y = p.y;
+                pn.z = p.z;
+                target->push_back(pn);
+                break;
+            }
+        }
+    }
+
+    // downsamples, then estimates normals and the search tree shared by every match
+    if (target_leaf_size_ > 0 && !target->empty()) {
+        pcl::PointCloud<pcl::PointNormal>::Ptr cropped = target;
+        target = boost::make_shared<pcl::PointCloud<pcl::PointNormal>>();
+        pcl::VoxelGrid<pcl::PointNormal> grid;
+        grid.setInputCloud(cropped);
+        grid.setLeafSize(target_leaf_size_, target_leaf_size_, target_leaf_size_);
+        grid.filter(*target);
+    }
+    if (target->size() < 3) {
+        ROS_ERROR("Not enough target points near the requested templates.");
+        return false;
+    }
+    pcl::search::KdTree<pcl::PointNormal>::Ptr target_tree(new pcl::search::KdTree<pcl::PointNormal>);
+    target_tree->setInputCloud(target);
+    pcl::NormalEstimation<pcl::PointNormal, pcl::PointNormal> ne;
+    ne.setInputCloud(target);
+    ne.setSearchMethod(target_tree);
+    ne.setRadiusSearch(std::max(2.5*target_leaf_size_, 0.025));
+    ne.compute(*target);
+
+    if (debug_) {
+        sensor_msgs::PointCloud2 target_msg;
+        pcl::toROSMsg(*target, target_msg);
+        target_msg.header.frame_id = matching_frame_;
+        pub_targ_.publish(target_msg);
+    }
+
+    // runs the matches in parallel, each thread writes only its own result
+    boost::thread_group match_threads;
+    pcl::PointCloud<pcl::PointNormal>::ConstPtr const_target = target;
+    for (size_t i = 0; i < entries.size(); i++) {
+        if (entries[i]) {
+            match_threads.create_thread(boost::bind(&TemplateMatcher::match_named_template, this,
+                                                    boost::cref(*entries[i]), boost::cref(initial_estimates[i]),
+                                                    boost::cref(const_target), boost::cref(target_tree),
+                                                    boost::ref(res.results[i])));
+        }
+    }
+    match_threads.join_all();
+
+    // visualizes the final estimated poses
+    if (viz_) {
+        std::vector<geometry_msgs::TransformStamped> poses;
+        for (size_t i = 0; i < res.results.size(); i++) {
+            if (res.results[i].success) {
+                poses.push_back(res.results[i].template_pose);
+            }
+        }
+        static_broadcaster.sendTransform(poses);
+    }
+    return true;
+}
+
+void TemplateMatcher::match_named_template(const NamedTemplate& entry, const tf::Transform& initial_estimate,
+                                           const pcl::PointCloud<pcl::PointNormal>::ConstPtr& target,
+                                           const pcl::search::KdTree<pcl::PointNormal>::Ptr& target_tree,
+                                           fetchit_icp::TemplateMatchResult& result) {
+    // builds the template with cached normals, placed at the initial estimate
+    const TemplateLevel& level = entry.cache.level(entry.level);
+    pcl::PointCloud<pcl::PointNormal> template_cloud;
+    template_cloud.resize(level.num_points);
+    for (uint32_t i = 0; i < level.num_points; i++) {
+        pcl::PointNormal& p = template_cloud.points[i];
+        p.x = level.points[3*i];
+        p.y = level.points[3*i + 1];
+        p.z = level.points[3*i + 2];
+        p.normal_x = level.normals[3*i];
+        p.normal_y = level.normals[3*i + 1];
+        p.normal_z = level.normals[3*i + 2];
+    }
+    tf::Vector3 initial_origin = initial_estimate.getOrigin();
+    tf::Quaternion initial_rotation = initial_estimate.getRotation();
+    Eigen::Affine3f initial_affine = Eigen::Translation3f(initial_origin.x(), initial_origin.y(), initial_origin.z())
+            * Eigen::Quaternionf(initial_rotation.w(), initial_rotation.x(), initial_rotation.y(), initial_rotation.z());
+    pcl::PointCloud<pcl::PointNormal>::Ptr source(new pcl::PointCloud<pcl::PointNormal>);
+    pcl::transformPointCloudWithNormals(template_cloud, *source, initial_affine);
+
+    // point-to-plane ICP reusing the shared target search tree
+    pcl::IterativeClosestPointWithNormals<pcl::PointNormal, pcl::PointNormal> icp;
+    icp.setInputSource(source);
+    icp.setInputTarget(target);
+    icp.setSearchMethodTarget(target_tree, true);
+    icp.setMaximumIterations(icp_iterations_);
+    icp.setMaxCorrespondenceDistance(icp_max_distance_);
+    icp.setTransformationEpsilon(icp_trans_epsilon_);
+    icp.setEuclideanFitnessEpsilon(icp_fit_epsilon_);
+    pcl::PointCloud<pcl::PointNormal> matched;
+    try {
+        icp.align(matched);
+    } catch (...) {
+        ROS_ERROR("Could not match template %s for given params.", entry.name.c_str());
+        return;
+    }
+    if (!icp.hasConverged()) {
+        ROS_WARN("ICP did not converge for template %s.", entry.name.c_str());
+        return;
+    }
+
+    // calculates the final estimated tf in the matching frame
+    Eigen::Matrix4f icp_tf = icp.getFinalTransformation();
+    tf::Transform icp_refinement(tf::Matrix3x3(icp_tf(0,0),icp_tf(0,1),icp_tf(0,2),
+                                               icp_tf(1,0),icp_tf(1,1),icp_tf(1,2),
+                                               icp_tf(2,0),icp_tf(2,1),icp_tf(2,2)),
+                                 tf::Vector3(icp_tf(0,3),icp_tf(1,3),icp_tf(2,3)));
+    tf::Transform tf_final = icp_refinement * initial_estimate * entry.offset;
+    tf::transformTFToMsg(tf_final, result.template_pose.transform);
+    result.template_pose.header.stamp = ros::Time::now();
+    result.template_pose.header.frame_id = matching_frame_;
+    result.template_pose.child_frame_id = entry.frame;
+    result.match_error = icp.getFitnessScore();
+    result.success = true;
+}
+
+bool TemplateMatcher::handle_set_tracking(std_srvs::SetBool::Request& req, std_srvs::SetBool::Response& res) {
+    tracking_enabled_ = req.data;
+    tracking_locked_ = false;
+    if (tracking_enabled_) {
+        track_sub_ = matcher_nh_.subscribe(pcl_topic_, 1, &TemplateMatcher::track_callback, this);
+        res.message = "Tracking enabled, locks on after the next successful match.";
+    } else {
+        track_sub_.shutdown();
+        res.message = "Tracking disabled.";
+    }
+    res.success = true;
+    return true;
+}
+
+void TemplateMatcher::track_callback(const sensor_msgs::PointCloud2ConstPtr& msg) {
+    if (!tracking_enabled_ || !tracking_locked_) {
+        return;
+    }
+    if (++tracking_frame_count_ % tracking_frame_skip_ != 0) {
+        return;
+    }
+
+    // gets the camera pose in the matching frame at capture time
+    tf::StampedTransform camera_tf;
+    try {
+        tf_.waitForTransform(matching_frame_, msg->header.frame_id, msg->header.stamp, ros::Duration(0.1));
+        tf_.lookupTransform(matching_frame_, msg->header.frame_id, msg->header.stamp, camera_tf);
+    } catch (tf::TransformException& ex) {
+        ROS_WARN_THROTTLE(1.0, "Skipping tracking frame: %s", ex.what());
+        return;
+    }
+
+    // transforms and crops the target in one pass, keeping only points that can lie on the template
+    pcl::PointCloud<pcl::PointXYZRGB> cloud;
+    pcl::fromROSMsg(*msg, cloud);
+    pcl::PointCloud<pcl::PointXYZRGB> target;
+    target.reserve(cloud.size()/4);
+    tf::Vector3 center = tracked_pose_.getOrigin();
+    double crop_radius = primary_template_->radius + tracking_max_dist_;
+    double crop_radius_sqr = crop_radius*crop_radius;
+    for (size_t i = 0; i < cloud.size(); i++) {
+        const pcl::PointXYZRGB& p = cloud.points[i];
+        if (!pcl_isfinite(p.x) || !pcl_isfinite(p.y) || !pcl_isfinite(p.z)) {
+            continue;
+        }
+        tf::Vector3 q = camera_tf * tf::Vector3(p.x, p.y, p.z);
+        if ((q - center).length2() > crop_radius_sqr) {
+            continue;
+        }
+        pcl::PointXYZRGB tp = p;
+        tp.x = q.x();
+        tp.y = q.y();
+        tp.z = q.z();
+        target.push_back(tp);
+    }
+
+    // thins the target to the tracking level resolution
+    const TemplateLevel& level = primary_template_->cache.level(tracking_level_);
+    if (level.leaf_size > 0 && !target.empty()) {
+        pcl::PointCloud<pcl::PointXYZRGB>::Ptr cropped(new pcl::PointCloud<pcl::PointXYZRGB>(target));
+        pcl::VoxelGrid<pcl::PointXYZRGB> grid;
+        grid.setInputCloud(cropped);
+        grid.setLeafSize(level.leaf_size, level.leaf_size, level.leaf_size);
+        grid.filter(target);
+    }
+
+    double confidence = 0;
+    double match_error = 0;
+    tf::Transform pose = tracked_pose_;
+    if (track_icp(target, level, pose, confidence, match_error) && confidence >= tracking_min_confidence_) {
+        tracked_pose_ = pose;
+    } else {
+        ROS_WARN("Lost template track (confidence %f), a full match is needed to re-lock.", confidence);
+        tracking_locked_ = false;
+    }
+    publish_tracked_pose(msg->header.stamp, confidence, match_error);
+}
+
+bool TemplateMatcher::track_icp(const pcl::PointCloud<pcl::PointXYZRGB>& target, const TemplateLevel& level,
+                                tf::Transform& pose, double& confidence, double& match_error) {
+    confidence = 0;
+    match_error = 0;
+    if (target.size() < 3) {
+        return false;
+    }
+
+    const float max_dist_sqr = static_cast<float>(tracking_max_dist_*tracking_max_dist_);
+    Eigen::Matrix3Xf src(3, target.size());
+    Eigen::Matrix3Xf dst(3, target.size());
+    int inliers = 0;
+    double error_sum = 0;
+    for (int iter = 0; iter < tracking_iterations_; iter++) {
+        // correspondences are found in the template frame so the cached kd-tree is used as is
+        tf::Transform inverse = pose.inverse();
+        inliers = 0;
+        error_sum = 0;
+        for (size_t i = 0; i < target.size(); i++) {
+            tf::Vector3 q = inverse * tf::Vector3(target.points[i].x, target.points[i].y, target.points[i].z);
+            float query[3] = {static_cast<float>(q.x()), static_cast<float>(q.y()), static_cast<float>(q.z())};
+            float dist_sqr;
+            int nearest = level.nearest(query, max_dist_sqr, dist_sqr);
+            if (nearest < 0) {
+                continue;
+            }
+            src.col(inliers) = Eigen::Vector3f(level.points[3*nearest], level.points[3*nearest + 1],
+                                               level.points[3*nearest + 2]);
+            dst.col(inliers) = Eigen::Vector3f(query[0], query[1], query[2]);
+            error_sum += dist_sqr;
+            inliers++;
+        }
+        if (inliers < 3) {
+            return false;
+        }
+
+        // rigid update in the template frame, applied on the right of the current pose
+        Eigen::Matrix4f update = Eigen::umeyama(src.leftCols(inliers), dst.leftCols(inliers), false);
+        tf::Transform update_tf(tf::Matrix3x3(update(0,0),update(0,1),update(0,2),
+                                              update(1,0),update(1,1),update(1,2),
+                                              update(2,0),update(2,1),update(2,2)),
+                                tf::Vector3(update(0,3),update(1,3),update(2,3)));
+        pose = pose * update_tf;
+
+        if (update_tf.getOrigin().length() < 1e-4 && update_tf.getRotation().getAngle() < 1e-3) {
+            break;
+        }
+    }
+
+    // confidence counts template points with target support, so clutter inside the crop does not lower it
+    pcl::search::KdTree<pcl::PointXYZRGB> target_tree;
+    target_tree.setInputCloud(target.makeShared());
+    std::vector<int> index(1);
+    std::vector<float> dist_sqr(1);
+    int supported = 0;
+    for (uint32_t i = 0; i < level.num_points; i++) {
+        tf::Vector3 q = pose * tf::Vector3(level.points[3*i], level.points[3*i + 1], level.points[3*i + 2]);
+        pcl::PointXYZRGB query;
+        query.x = q.x();
+        query.y = q.y();
+        query.z = q.z();
+        if (target_tree.nearestKSearch(query, 1, index, dist_sqr) > 0 && dist_sqr[0] <= max_dist_sqr) {
+            supported++;
+        }
+    }
+    confidence = level.num_points > 0 ? static_cast<double>(supported)/level.num_points : 0;
+    match_error = error_sum/inliers;
+    return true;
+}
+
+void TemplateMatcher::publish_tracked_pose(const ros::Time& stamp, double confidence, double match_error) {
+    tf::Transform tf_final = tracked_pose_ * template_offset_;
+    tf::Vector3 final_trans = tf_final.getOrigin();
+    tf::Quaternion final_rot = tf_final.getRotation();
+
+    fetchit_icp::TrackedPose tracked;
+    tracked.template_pose.header.stamp = stamp;
+    tracked.template_pose.header.frame_id = matching_frame_;
+    tracked.template_pose.child_frame_id = template_frame_;
+    tracked.template_pose.transform.translation.x = final_trans.x();
+    tracked.template_pose.transform.translation.y = final_trans.y();
+    tracked.template_pose.transform.translation.z = final_trans.z();
+    tracked.template_pose.transform.rotation.x = final_rot.x();
+    tracked.template_pose.transform.rotation.y = final_rot.y();
+    tracked.template_pose.transform.rotation.z = final_rot.z();
+    tracked.template_pose.transform.rotation.w = final_rot.w();
+    tracked.confidence = confidence;
+    tracked.match_error = match_error;
+    tracked.locked = tracking_locked_;
+    pub_tracked_.publish(tracked);
+
+    // keeps the template frame current for tf consumers
+    if (viz_ && tracking_locked_) {
+        static_broadcaster.sendTransform(tracked.template_pose);
+    }
+}
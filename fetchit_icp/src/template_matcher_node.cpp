@@ -17,6 +17,7 @@ int main(int argc, char** argv){
     bool debug = true;
     bool latched = true;
     bool pre_processed_cloud = false;
+    int template_level = 0;
 
     // gets roslaunch params
     pnh.getParam("matching_frame", matching_frame);
@@ -29,38 +30,25 @@ int main(int argc, char** argv){
     pnh.getParam("debug", debug);
     pnh.getParam("latch_initial", latched);
     pnh.getParam("pre_processed_cloud", pre_processed_cloud);
+    pnh.getParam("template_level", template_level);
 
     // gets the initial_estimate for schunk corner from the launch
     tf::Transform initial_estimate;
     tf::Transform template_offset;
 
     // initializes a tf for the initial_estimate
-    std::vector<float> pose;
-    std::istringstream initial_estimate_string_stream(initial_estimate_string);
-    for(std::string value_string; initial_estimate_string_stream >> value_string;)
-        pose.push_back(std::stof(value_string));
-    initial_estimate.setOrigin(tf::Vector3(pose[0],pose[1],pose[2]));
-    initial_estimate.setRotation(tf::Quaternion(pose[4],pose[5],pose[3]));
+    initial_estimate = pose_string_to_tf(initial_estimate_string);
 
     // initializes a tf for the template_offset
-    std::vector<float> offset;
-    std::istringstream offset_string_stream(template_offset_string);
-    for(std::string value_string; offset_string_stream >> value_string;)
-        offset.push_back(std::stof(value_string));
-    template_offset.setOrigin(tf::Vector3(offset[0],offset[1],offset[2]));
-    template_offset.setRotation(tf::Quaternion(offset[4],offset[5],offset[3]));
+    template_offset = pose_string_to_tf(template_offset_string);
 
     // starts a template matcher
     TemplateMatcher matcher(nh,matching_frame,pcl_topic,template_file,initial_estimate,template_offset,template_frame,
-                            visualize,debug,latched,pre_processed_cloud);
+                            visualize,debug,latched,pre_processed_cloud,template_level);
 
     try{
-        ros::Rate loop_rate(5);
-        while (ros::ok())
-        {
-            ros::spinOnce();
-            loop_rate.sleep();
-        }
+        // callbacks run as clouds arrive, so tracking keeps up with the camera
+        ros::spin();
     }catch(std::runtime_error& e){
         ROS_ERROR("template_matcher_node exception: %s", e.what());
         return -1;
@@ -1,3 +1,9 @@
+#include <algorithm>
+#include <random>
+#include <unordered_map>
+
+#include <boost/bind.hpp>
+#include <boost/thread/thread.hpp>
 #include <ros/ros.h>
 #include <pcl/visualization/pcl_visualizer.h>
 #include <pcl/io/pcd_io.h>
@@ -12,13 +18,7 @@
 #include <pcl/filters/voxel_grid.h>
 #include <pcl/console/print.h>
 #include <pcl/console/parse.h>
-
-inline double
-uniform_deviate (int seed)
-{
-  double ran = seed * (1.0 / (RAND_MAX + 1.0));
-  return ran;
-}
+#include <pcl/console/time.h>
 
 inline void
 randomPointTriangle (float a1, float a2, float a3, float b1, float b2, float b3, float c1, float c2, float c3,
@@ -41,102 +41,213 @@ randomPointTriangle (float a1, float a2, float a3, float b1, float b2, float b3,
   p[2] = c3;
 }
 
-inline void
-randPSurface (vtkPolyData * polydata, std::vector<double> * cumulativeAreas, double totalArea, Eigen::Vector3f& p, bool calcNormal, Eigen::Vector3f& n, bool calcColor, Eigen::Vector3f& c)
+// triangle corners (and corner colors) copied out of vtk so sampling threads never touch the polydata
+struct SampledTriangle
 {
-  float r = static_cast<float> (uniform_deviate (rand ()) * totalArea);
+  Eigen::Vector3f a, b, c;
+  Eigen::Vector3f ca, cb, cc;
+  Eigen::Vector3f normal;
+  double area;
+  size_t n_samples;
+  size_t first_sample;
+};
+
+// triangles per RNG block, each block is seeded from (seed, block index) so results do not depend on thread count
+const size_t triangles_per_block = 256;
 
-  std::vector<double>::iterator low = std::lower_bound (cumulativeAreas->begin (), cumulativeAreas->end (), r);
-  vtkIdType el = vtkIdType (low - cumulativeAreas->begin ());
+void
+extractTriangles (vtkSmartPointer<vtkPolyData> polydata, bool calc_color, std::vector<SampledTriangle>& triangles,
+                  double& total_area)
+{
+  polydata->BuildCells ();
+  vtkSmartPointer<vtkCellArray> cells = polydata->GetPolys ();
+  vtkUnsignedCharArray *const colors = vtkUnsignedCharArray::SafeDownCast (polydata->GetPointData ()->GetScalars ());
+  bool has_colors = colors && colors->GetNumberOfComponents () == 3;
+  if (calc_color && !has_colors)
+    PCL_WARN ("Mesh has no vertex colors, or vertex colors are not RGB!");
 
+  triangles.resize (cells->GetNumberOfCells ());
+  total_area = 0;
   double A[3], B[3], C[3];
-  vtkIdType npts = 0;
-  vtkIdType *ptIds = nullptr;
-  polydata->GetCellPoints (el, npts, ptIds);
-  polydata->GetPoint (ptIds[0], A);
-  polydata->GetPoint (ptIds[1], B);
-  polydata->GetPoint (ptIds[2], C);
-  if (calcNormal)
+  vtkIdType npts = 0, *ptIds = nullptr;
+  size_t cellId = 0;
+  for (cells->InitTraversal (); cells->GetNextCell (npts, ptIds); cellId++)
   {
+    SampledTriangle& t = triangles[cellId];
+    polydata->GetPoint (ptIds[0], A);
+    polydata->GetPoint (ptIds[1], B);
+    polydata->GetPoint (ptIds[2], C);
+    t.a = Eigen::Vector3f (A[0], A[1], A[2]);
+    t.b = Eigen::Vector3f (B[0], B[1], B[2]);
+    t.c = Eigen::Vector3f (C[0], C[1], C[2]);
     // OBJ: Vertices are stored in a counter-clockwise order by default
-    Eigen::Vector3f v1 = Eigen::Vector3f (A[0], A[1], A[2]) - Eigen::Vector3f (C[0], C[1], C[2]);
-    Eigen::Vector3f v2 = Eigen::Vector3f (B[0], B[1], B[2]) - Eigen::Vector3f (C[0], C[1], C[2]);
-    n = v1.cross (v2);
-    n.normalize ();
-  }
-  float r1 = static_cast<float> (uniform_deviate (rand ()));
-  float r2 = static_cast<float> (uniform_deviate (rand ()));
-  randomPointTriangle (float (A[0]), float (A[1]), float (A[2]),
-                       float (B[0]), float (B[1]), float (B[2]),
-                       float (C[0]), float (C[1]), float (C[2]), r1, r2, p);
-
-  if (calcColor)
-  {
-    vtkUnsignedCharArray *const colors = vtkUnsignedCharArray::SafeDownCast (polydata->GetPointData ()->GetScalars ());
-    if (colors && colors->GetNumberOfComponents () == 3)
+    t.normal = (t.a - t.c).cross (t.b - t.c);
+    t.normal.normalize ();
+    t.area = vtkTriangle::TriangleArea (A, B, C);
+    total_area += t.area;
+    t.ca = t.cb = t.cc = Eigen::Vector3f::Zero ();
+    if (calc_color && has_colors)
     {
       double cA[3], cB[3], cC[3];
       colors->GetTuple (ptIds[0], cA);
       colors->GetTuple (ptIds[1], cB);
       colors->GetTuple (ptIds[2], cC);
-
-      randomPointTriangle (float (cA[0]), float (cA[1]), float (cA[2]),
-                           float (cB[0]), float (cB[1]), float (cB[2]),
-                           float (cC[0]), float (cC[1]), float (cC[2]), r1, r2, c);
-    }
-    else
-    {
-      static bool printed_once = false;
-      if (!printed_once)
-        PCL_WARN ("Mesh has no vertex colors, or vertex colors are not RGB!");
-      printed_once = true;
+      t.ca = Eigen::Vector3f (cA[0], cA[1], cA[2]);
+      t.cb = Eigen::Vector3f (cB[0], cB[1], cB[2]);
+      t.cc = Eigen::Vector3f (cC[0], cC[1], cC[2]);
     }
   }
+  triangles.resize (cellId);
 }
 
+// stratified allocation: every triangle gets its area share of samples, the remainder goes to the largest fractions
 void
-uniform_sampling (vtkSmartPointer<vtkPolyData> polydata, size_t n_samples, bool calc_normal, bool calc_color, pcl::PointCloud<pcl::PointXYZRGBNormal> & cloud_out)
+allocateSamples (std::vector<SampledTriangle>& triangles, double total_area, size_t n_samples)
 {
-  polydata->BuildCells ();
-  vtkSmartPointer<vtkCellArray> cells = polydata->GetPolys ();
+  std::vector<std::pair<double, size_t> > remainders (triangles.size ());
+  size_t allocated = 0;
+  for (size_t i = 0; i < triangles.size (); i++)
+  {
+    double share = total_area > 0 ? n_samples * triangles[i].area / total_area : 0;
+    triangles[i].n_samples = static_cast<size_t> (std::floor (share));
+    allocated += triangles[i].n_samples;
+    remainders[i] = std::make_pair (share - triangles[i].n_samples, i);
+  }
+  size_t missing = n_samples > allocated ? n_samples - allocated : 0;
+  missing = std::min (missing, remainders.size ());
+  std::partial_sort (remainders.begin (), remainders.begin () + missing, remainders.end (),
+                     std::greater<std::pair<double, size_t> > ());
+  for (size_t i = 0; i < missing; i++)
+    triangles[remainders[i].second].n_samples++;
 
-  double p1[3], p2[3], p3[3], totalArea = 0;
-  std::vector<double> cumulativeAreas (cells->GetNumberOfCells (), 0);
-  vtkIdType npts = 0, *ptIds = nullptr;
-  size_t cellId = 0;
-  for (cells->InitTraversal (); cells->GetNextCell (npts, ptIds); cellId++)
+  size_t first_sample = 0;
+  for (size_t i = 0; i < triangles.size (); i++)
+  {
+    triangles[i].first_sample = first_sample;
+    first_sample += triangles[i].n_samples;
+  }
+}
+
+void
+sampleBlocks (const std::vector<SampledTriangle>* triangles, size_t first_block, size_t block_stride,
+              unsigned int seed, bool calc_normal, bool calc_color, pcl::PointCloud<pcl::PointXYZRGBNormal>* cloud_out)
+{
+  std::mt19937 rng;
+  std::uniform_real_distribution<float> uniform (0.0f, 1.0f);
+  size_t n_blocks = (triangles->size () + triangles_per_block - 1) / triangles_per_block;
+  for (size_t block = first_block; block < n_blocks; block += block_stride)
   {
-    polydata->GetPoint (ptIds[0], p1);
-    polydata->GetPoint (ptIds[1], p2);
-    polydata->GetPoint (ptIds[2], p3);
-    totalArea += vtkTriangle::TriangleArea (p1, p2, p3);
-    cumulativeAreas[cellId] = totalArea;
+    std::seed_seq block_seed {seed, static_cast<unsigned int> (block)};
+    rng.seed (block_seed);
+    size_t end = std::min (triangles->size (), (block + 1) * triangles_per_block);
+    for (size_t t = block * triangles_per_block; t < end; t++)
+    {
+      const SampledTriangle& tri = (*triangles)[t];
+      for (size_t s = 0; s < tri.n_samples; s++)
+      {
+        float r1 = uniform (rng);
+        float r2 = uniform (rng);
+        Eigen::Vector3f p;
+        randomPointTriangle (tri.a[0], tri.a[1], tri.a[2], tri.b[0], tri.b[1], tri.b[2],
+                             tri.c[0], tri.c[1], tri.c[2], r1, r2, p);
+        pcl::PointXYZRGBNormal& out = cloud_out->points[tri.first_sample + s];
+        out.x = p[0];
+        out.y = p[1];
+        out.z = p[2];
+        if (calc_normal)
+        {
+          out.normal_x = tri.normal[0];
+          out.normal_y = tri.normal[1];
+          out.normal_z = tri.normal[2];
+        }
+        if (calc_color)
+        {
+          Eigen::Vector3f c;
+          randomPointTriangle (tri.ca[0], tri.ca[1], tri.ca[2], tri.cb[0], tri.cb[1], tri.cb[2],
+                               tri.cc[0], tri.cc[1], tri.cc[2], r1, r2, c);
+          out.r = static_cast<uint8_t>(c[0]);
+          out.g = static_cast<uint8_t>(c[1]);
+          out.b = static_cast<uint8_t>(c[2]);
+        }
+      }
+    }
   }
+}
+
+void
+uniform_sampling (std::vector<SampledTriangle>& triangles, double total_area, size_t n_samples, bool calc_normal,
+                  bool calc_color, unsigned int seed, unsigned int n_threads,
+                  pcl::PointCloud<pcl::PointXYZRGBNormal> & cloud_out)
+{
+  allocateSamples (triangles, total_area, n_samples);
 
   cloud_out.points.resize (n_samples);
   cloud_out.width = static_cast<pcl::uint32_t> (n_samples);
   cloud_out.height = 1;
 
-  for (size_t i = 0; i < n_samples; i++)
+  // blocks are interleaved over threads, every sample slot is written by exactly one thread
+  n_threads = std::max (n_threads, 1u);
+  boost::thread_group threads;
+  for (unsigned int i = 0; i < n_threads; i++)
+    threads.create_thread (boost::bind (&sampleBlocks, &triangles, i, n_threads, seed, calc_normal, calc_color,
+                                        &cloud_out));
+  threads.join_all ();
+}
+
+inline int64_t
+cellKey (int x, int y, int z)
+{
+  // 21 bits per axis is plenty for CAD models sampled at millimetre spacing
+  return ((static_cast<int64_t> (x) & 0x1FFFFF) << 42) | ((static_cast<int64_t> (y) & 0x1FFFFF) << 21) |
+         (static_cast<int64_t> (z) & 0x1FFFFF);
+}
+
+// dart throwing over a dense stratified sample: keeps candidates in a seeded random order if no kept point is
+// closer than radius, so the result has the target spacing without a voxel grid pass
+void
+poisson_disk_filter (const pcl::PointCloud<pcl::PointXYZRGBNormal>& candidates, float radius, unsigned int seed,
+                     pcl::PointCloud<pcl::PointXYZRGBNormal>& cloud_out)
+{
+  std::vector<size_t> order (candidates.size ());
+  for (size_t i = 0; i < order.size (); i++)
+    order[i] = i;
+  std::mt19937 rng (seed);
+  std::shuffle (order.begin (), order.end (), rng);
+
+  // hash grid with cells of size radius, only the 27 neighbouring cells need checking
+  const float inv_cell = 1.0f / radius;
+  const float radius_sqr = radius * radius;
+  std::unordered_map<int64_t, std::vector<size_t> > grid;
+  cloud_out.clear ();
+  for (size_t o = 0; o < order.size (); o++)
   {
-    Eigen::Vector3f p;
-    Eigen::Vector3f n (0, 0, 0);
-    Eigen::Vector3f c (0, 0, 0);
-    randPSurface (polydata, &cumulativeAreas, totalArea, p, calc_normal, n, calc_color, c);
-    cloud_out.points[i].x = p[0];
-    cloud_out.points[i].y = p[1];
-    cloud_out.points[i].z = p[2];
-    if (calc_normal)
+    const pcl::PointXYZRGBNormal& p = candidates.points[order[o]];
+    Eigen::Vector3i cell (static_cast<int> (std::floor (p.x * inv_cell)), static_cast<int> (std::floor (p.y * inv_cell)),
+                          static_cast<int> (std::floor (p.z * inv_cell)));
+    bool accepted = true;
+    for (int dx = -1; dx <= 1 && accepted; dx++)
+      for (int dy = -1; dy <= 1 && accepted; dy++)
+        for (int dz = -1; dz <= 1 && accepted; dz++)
+        {
+          std::unordered_map<int64_t, std::vector<size_t> >::const_iterator it =
+              grid.find (cellKey (cell[0] + dx, cell[1] + dy, cell[2] + dz));
+          if (it == grid.end ())
+            continue;
+          for (size_t k = 0; k < it->second.size (); k++)
+          {
+            const pcl::PointXYZRGBNormal& q = cloud_out.points[it->second[k]];
+            float d = (p.x - q.x) * (p.x - q.x) + (p.y - q.y) * (p.y - q.y) + (p.z - q.z) * (p.z - q.z);
+            if (d < radius_sqr)
+            {
+              accepted = false;
+              break;
+            }
+          }
+        }
+    if (accepted)
     {
-      cloud_out.points[i].normal_x = n[0];
-      cloud_out.points[i].normal_y = n[1];
-      cloud_out.points[i].normal_z = n[2];
-    }
-    if (calc_color)
-    {
-      cloud_out.points[i].r = static_cast<uint8_t>(c[0]);
-      cloud_out.points[i].g = static_cast<uint8_t>(c[1]);
-      cloud_out.points[i].b = static_cast<uint8_t>(c[2]);
+      grid[cellKey (cell[0], cell[1], cell[2])].push_back (cloud_out.size ());
+      cloud_out.push_back (p);
     }
   }
 }
@@ -147,6 +258,9 @@ using namespace pcl::console;
 
 const int default_number_samples = 100000;
 const float default_leaf_size = 0.01f;
+const int default_seed = 0;
+// candidates per radius^2 of surface area drawn before Poisson-disk elimination
+const float poisson_oversampling = 8.0f;
 
 void
 printHelp (int, char **argv)
@@ -160,6 +274,12 @@ printHelp (int, char **argv)
               "                     -leaf_size X  = the XYZ leaf size for the VoxelGrid -- for data reduction (default: ");
   print_value ("%f", default_leaf_size);
   print_info (" m)\n");
+  print_info ("                     -poisson_radius X = keep a Poisson-disk subset with minimum spacing X instead of voxel filtering\n");
+  print_info ("                     -seed X = random seed, output is identical for any thread count (default: ");
+  print_value ("%d", default_seed);
+  print_info (")\n");
+  print_info ("                     -threads X = number of sampling threads (default: hardware concurrency)\n");
+  print_info ("                     -ascii = write an ascii pcd instead of a binary one\n");
   print_info ("                     -write_normals = flag to write normals to the output pcd\n");
   print_info ("                     -write_colors  = flag to write colors to the output pcd\n");
   print_info (
@@ -186,6 +306,13 @@ main (int argc, char **argv)
   parse_argument (argc, argv, "-n_samples", SAMPLE_POINTS_);
   float leaf_size = default_leaf_size;
   parse_argument (argc, argv, "-leaf_size", leaf_size);
+  float poisson_radius = 0.0f;
+  parse_argument (argc, argv, "-poisson_radius", poisson_radius);
+  int seed = default_seed;
+  parse_argument (argc, argv, "-seed", seed);
+  int n_threads = static_cast<int> (boost::thread::hardware_concurrency ());
+  parse_argument (argc, argv, "-threads", n_threads);
+  const bool write_ascii = find_switch (argc, argv, "-ascii");
   bool vis_result = ! find_switch (argc, argv, "-no_vis_result");
   const bool write_normals = find_switch (argc, argv, "-write_normals");
   const bool write_colors = find_switch (argc, argv, "-write_colors");
@@ -230,16 +357,40 @@ main (int argc, char **argv)
   triangleMapper->Update ();
   polydata1 = triangleMapper->GetInput ();
 
-  pcl::PointCloud<pcl::PointXYZRGBNormal>::Ptr cloud_1 (new pcl::PointCloud<pcl::PointXYZRGBNormal>);
-  uniform_sampling (polydata1, SAMPLE_POINTS_, write_normals, write_colors, *cloud_1);
+  TicToc tt;
+  tt.tic ();
+  std::vector<SampledTriangle> triangles;
+  double total_area;
+  extractTriangles (polydata1, write_colors, triangles, total_area);
+
+  // in Poisson-disk mode the sample count follows from the requested spacing
+  size_t n_samples = static_cast<size_t> (std::max (SAMPLE_POINTS_, 0));
+  if (poisson_radius > 0)
+    n_samples = std::max (n_samples, static_cast<size_t> (std::ceil (poisson_oversampling * total_area /
+                                                                     (poisson_radius * poisson_radius))));
 
-  // Voxelgrid
-  VoxelGrid<PointXYZRGBNormal> grid_;
-  grid_.setInputCloud (cloud_1);
-  grid_.setLeafSize (leaf_size, leaf_size, leaf_size);
+  pcl::PointCloud<pcl::PointXYZRGBNormal>::Ptr cloud_1 (new pcl::PointCloud<pcl::PointXYZRGBNormal>);
+  uniform_sampling (triangles, total_area, n_samples, write_normals, write_colors, static_cast<unsigned int> (seed),
+                    static_cast<unsigned int> (std::max (n_threads, 1)), *cloud_1);
 
   pcl::PointCloud<pcl::PointXYZRGBNormal>::Ptr voxel_cloud (new pcl::PointCloud<pcl::PointXYZRGBNormal>);
-  grid_.filter (*voxel_cloud);
+  if (poisson_radius > 0)
+  {
+    poisson_disk_filter (*cloud_1, poisson_radius, static_cast<unsigned int> (seed), *voxel_cloud);
+  }
+  else
+  {
+    // Voxelgrid
+    VoxelGrid<PointXYZRGBNormal> grid_;
+    grid_.setInputCloud (cloud_1);
+    grid_.setLeafSize (leaf_size, leaf_size, leaf_size);
+    grid_.filter (*voxel_cloud);
+  }
+  print_info ("Sampled %zu points from %zu triangles, kept ", n_samples, triangles.size ());
+  print_value ("%zu", voxel_cloud->size ());
+  print_info (" in ");
+  print_value ("%g", tt.toc ());
+  print_info (" ms\n");
 
   /*if (vis_result)
   {
@@ -252,27 +403,27 @@ main (int argc, char **argv)
 
   if (write_normals && write_colors)
   {
-    savePCDFileASCII (argv[pcd_file_indices[0]], *voxel_cloud);
+    savePCDFile (argv[pcd_file_indices[0]], *voxel_cloud, !write_ascii);
   }
   else if (write_normals)
   {
     pcl::PointCloud<pcl::PointNormal>::Ptr cloud_xyzn (new pcl::PointCloud<pcl::PointNormal>);
     // Strip uninitialized colors from cloud:
     pcl::copyPointCloud (*voxel_cloud, *cloud_xyzn);
-    savePCDFileASCII (argv[pcd_file_indices[0]], *cloud_xyzn);
+    savePCDFile (argv[pcd_file_indices[0]], *cloud_xyzn, !write_ascii);
   }
   else if (write_colors)
   {
     pcl::PointCloud<pcl::PointXYZRGB>::Ptr cloud_xyzrgb (new pcl::PointCloud<pcl::PointXYZRGB>);
     // Strip uninitialized normals from cloud:
     pcl::copyPointCloud (*voxel_cloud, *cloud_xyzrgb);
-    savePCDFileASCII (argv[pcd_file_indices[0]], *cloud_xyzrgb);
+    savePCDFile (argv[pcd_file_indices[0]], *cloud_xyzrgb, !write_ascii);
   }
   else // !write_normals && !write_colors
   {
     pcl::PointCloud<pcl::PointXYZ>::Ptr cloud_xyz (new pcl::PointCloud<pcl::PointXYZ>);
     // Strip uninitialized normals and colors from cloud:
     pcl::copyPointCloud (*voxel_cloud, *cloud_xyz);
-    savePCDFileASCII (argv[pcd_file_indices[0]], *cloud_xyz);
+    savePCDFile (argv[pcd_file_indices[0]], *cloud_xyz, !write_ascii);
   }
 }
\ No newline at end of file
@@ -0,0 +1,97 @@
+#include <ros/package.h>
+#include <pcl/io/pcd_io.h>
+#include <pcl/console/print.h>
+#include <pcl/console/parse.h>
+#include <pcl/console/time.h>
+
+#include "fetchit_icp/TemplateCache.h"
+
+using namespace pcl::console;
+
+// templates used by the fetchit detectors, rebuilt when no files are given
+const char* default_templates[] = {"bin.pcd", "bin_minimal.pcd", "corner.pcd", "handle.pcd", "schuck.pcd"};
+
+void
+printHelp (int, char **argv)
+{
+  print_error ("Syntax is: %s [template1.pcd template2.pcd ...] <options>\n", argv[0]);
+  print_info ("  builds a .tcache next to every template (default: all fetchit_icp cad_models)\n");
+  print_info ("  where options are:\n");
+  print_info ("                     -leaf_sizes X,Y,.. = voxel sizes of the pyramid levels, 0 keeps the raw template (default: ");
+  std::vector<float> leaf_sizes = TemplateCache::defaultLeafSizes ();
+  for (size_t i = 0; i < leaf_sizes.size (); i++)
+    print_value ("%s%g", i == 0 ? "" : ",", leaf_sizes[i]);
+  print_info (")\n");
+}
+
+std::string
+cacheFilename (const std::string& template_file)
+{
+  std::string::size_type ext = template_file.rfind (".pcd");
+  return (ext == std::string::npos ? template_file : template_file.substr (0, ext)) + ".tcache";
+}
+
+/* ---[ */
+int
+main (int argc, char **argv)
+{
+  print_info ("Precompute template pyramids, normals and kd-tree order. For more information, use: %s -h\n",
+              argv[0]);
+  if (find_switch (argc, argv, "-h"))
+  {
+    printHelp (argc, argv);
+    return (0);
+  }
+
+  std::vector<float> leaf_sizes = TemplateCache::defaultLeafSizes ();
+  if (find_switch (argc, argv, "-leaf_sizes"))
+  {
+    leaf_sizes.clear ();
+    parse_x_arguments (argc, argv, "-leaf_sizes", leaf_sizes);
+  }
+
+  std::vector<std::string> template_files;
+  std::vector<int> pcd_file_indices = parse_file_extension_argument (argc, argv, ".pcd");
+  for (size_t i = 0; i < pcd_file_indices.size (); i++)
+    template_files.push_back (argv[pcd_file_indices[i]]);
+  if (template_files.empty ())
+  {
+    std::string templates_path = ros::package::getPath ("fetchit_icp") + "/cad_models/";
+    for (size_t i = 0; i < sizeof (default_templates)/sizeof (default_templates[0]); i++)
+      template_files.push_back (templates_path + default_templates[i]);
+  }
+
+  int failures = 0;
+  for (size_t i = 0; i < template_files.size (); i++)
+  {
+    TicToc tt;
+    tt.tic ();
+
+    uint64_t source_size;
+    int64_t source_mtime;
+    pcl::PointCloud<pcl::PointXYZ> cloud;
+    if (!TemplateCache::sourceStamp (template_files[i], source_size, source_mtime) ||
+        pcl::io::loadPCDFile<pcl::PointXYZ> (template_files[i], cloud) < 0)
+    {
+      print_error ("Could not load template %s\n", template_files[i].c_str ());
+      failures++;
+      continue;
+    }
+
+    std::vector<char> buffer;
+    TemplateCache::build (cloud, leaf_sizes, source_size, source_mtime, buffer);
+    std::string cache_file = cacheFilename (template_files[i]);
+    if (!TemplateCache::write (cache_file, buffer))
+    {
+      print_error ("Could not write template cache %s\n", cache_file.c_str ());
+      failures++;
+      continue;
+    }
+    print_info ("Wrote ");
+    print_value ("%s", cache_file.c_str ());
+    print_info (" (%zu levels, %zu bytes) in ", leaf_sizes.size (), buffer.size ());
+    print_value ("%g", tt.toc ());
+    print_info (" ms\n");
+  }
+  return (failures == 0 ? 0 : -1);
+}
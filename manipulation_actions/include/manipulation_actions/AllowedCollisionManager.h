@@ -0,0 +1,90 @@
+#ifndef MANIPULATION_ACTIONS_ALLOWED_COLLISION_MANAGER_H
+#define MANIPULATION_ACTIONS_ALLOWED_COLLISION_MANAGER_H
+
+// Boost
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+
+// C++
+#include <string>
+#include <vector>
+
+// ROS
+#include <moveit/collision_detection/collision_matrix.h>
+#include <moveit_msgs/ApplyPlanningScene.h>
+#include <moveit_msgs/GetPlanningScene.h>
+#include <ros/ros.h>
+
+/**
+ * @brief Keeps a mirror of the planning scene's allowed collision matrix and applies entry changes to it.
+ *
+ * The matrix is fetched from the planning scene once, and again only after an update fails.  Entry changes are
+ * made on the mirror, changes that would not alter it are dropped, and changes from callers that arrive within the
+ * coalescing window are applied together in one synchronous apply_planning_scene call.  MoveIt! replaces the whole
+ * matrix from a planning scene diff, so the full mirrored matrix is what gets sent.
+ */
+class AllowedCollisionManager
+{
+
+public:
+    static constexpr double DEFAULT_COALESCE_WINDOW = 0.02;
+
+    /**
+     * @param n node handle used for the planning scene service clients
+     * @param coalesce_window time to wait for further changes before applying an update, in seconds
+     */
+    AllowedCollisionManager(ros::NodeHandle &n, double coalesce_window = DEFAULT_COALESCE_WINDOW);
+
+    /**
+     * @brief Allow or disallow collisions between every pair of names and links.
+     *
+     * Blocks until the planning scene has applied the change (or a batch including it).  Thread safe.
+     * @param names collision object (or "<octomap>") names
+     * @param links robot link names
+     * @param allowed true to allow collisions
+     * @return true if the change is in effect in the planning scene
+     */
+    bool setEntries(const std::vector<std::string> &names, const std::vector<std::string> &links, bool allowed);
+
+    /**
+     * @brief Force the mirror to be fetched from the planning scene before the next update.
+     */
+    void invalidate();
+
+private:
+    struct Entry
+    {
+        std::string name;
+        std::string link;
+        bool allowed;
+    };
+
+    struct Batch
+    {
+        std::vector<Entry> entries;
+        bool done;
+        bool success;
+
+        Batch() : done(false), success(false) {}
+    };
+
+    bool fetch();
+
+    bool projectedEntry(const std::string &name, const std::string &link) const;
+
+    ros::ServiceClient planning_scene_client;
+    ros::ServiceClient apply_planning_scene_client;
+
+    double coalesce_window;
+
+    boost::mutex mutex;
+    boost::condition_variable applied_condition;
+    collision_detection::AllowedCollisionMatrix acm;  // what the planning scene currently has
+    bool synced;
+    bool leading;  // a caller is waiting out the coalescing window and will send the collected changes
+    boost::shared_ptr<Batch> collecting;  // changes waiting for the next update
+    boost::shared_ptr<Batch> in_flight;  // changes being sent to the planning scene
+};
+
+#endif  // MANIPULATION_ACTIONS_ALLOWED_COLLISION_MANAGER_H
@@ -9,9 +9,11 @@
 #include <boost/thread/mutex.hpp>
 #include <math.h>
 
+#include "fetchit_icp/TrackedPose.h"
 #include "manipulation_actions/ApproachSchunkAction.h"
 #include "manipulation_actions/AttachSimpleGeometry.h"
 #include "manipulation_actions/DetachFromBase.h"
+#include "manipulation_actions/ParallelPlanner.h"
 
 class ApproachSchunk {
     public:
@@ -21,6 +23,10 @@ class ApproachSchunk {
         void executeApproachSchunk( const manipulation_actions::ApproachSchunkGoalConstPtr& goal);
 
     private:
+        // stores the latest pose from the schunk template tracker
+        void trackedPoseCallback(const fetchit_icp::TrackedPose::ConstPtr& msg);
+        // gets the tracked template pose in base_link if it is locked, confident and recent
+        bool getTrackedTemplatePose(geometry_msgs::TransformStamped& base_link_to_template_pose);
         // attaches schunk collision objects
         bool addSchunkCollisionObjects();
         // removes schunk collision objects
@@ -46,6 +52,7 @@ class ApproachSchunk {
         tf2_ros::StaticTransformBroadcaster static_broadcaster_;
         moveit::planning_interface::MoveGroupInterface* arm_group_;
         moveit::planning_interface::PlanningSceneInterface* planning_scene_interface_;
+        ParallelPlanner* planner_;
         bool attach_arbitrary_object_;
         float motion_speed_scale_factor_;
         actionlib::SimpleActionServer<manipulation_actions::ApproachSchunkAction> approach_schunk_server_;
@@ -56,6 +63,13 @@ class ApproachSchunk {
         ros::ServiceClient attach_simple_geometry_client_;
         ros::ServiceClient detach_simple_geometry_client_;
 
+        // schunk template tracking
+        ros::Subscriber tracked_pose_sub_;
+        fetchit_icp::TrackedPose tracked_pose_;
+        boost::mutex tracked_pose_mutex_;
+        double tracked_pose_timeout_;
+        double min_tracking_confidence_;
+
         // schunk collision object related
         tf2::Transform template_offset_to_schunk_corner_;
 
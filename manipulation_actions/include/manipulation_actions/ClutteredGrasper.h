@@ -16,6 +16,7 @@
 #include <geometry_msgs/PoseArray.h>
 #include <manipulation_actions/AttachArbitraryObject.h>
 #include <manipulation_actions/BinPickAction.h>
+#include <manipulation_actions/ToggleGripperCollisions.h>
 #include <moveit/move_group_interface/move_group_interface.h>
 #include <moveit/planning_scene_interface/planning_scene_interface.h>
 #include <moveit/planning_scene_monitor/planning_scene_monitor.h>
@@ -85,14 +86,13 @@ private:
     ros::Publisher box_pose_publisher;
     ros::Publisher current_grasp_publisher;
     ros::Publisher sample_cloud_publisher;
-    ros::Publisher planning_scene_publisher_;
     ros::Subscriber cloud_subscriber_;
     ros::Subscriber objects_subscriber_;
     ros::Subscriber grasp_feedback_subscriber_;
 
     // services
     ros::ServiceClient attach_arbitrary_object_client;
-    ros::ServiceClient planning_scene_client_;
+    ros::ServiceClient toggle_gripper_collisions_client_;
     ros::ServiceClient cartesian_path_client;
 
     // actionlib
@@ -121,8 +121,6 @@ private:
 
     bool cloud_received_;
 
-    std::vector<std::string> gripper_names_;
-
     geometry_msgs::Vector3 box_dims;
     double box_error_threshold;
 };
@@ -5,21 +5,27 @@
 #include <boost/thread/mutex.hpp>
 
 // C++
+#include <algorithm>
 #include <fstream>
 #include <iostream>
 
 // ROS
+#include <manipulation_actions/AllowedCollisionManager.h>
+#include <manipulation_actions/ApplySceneOperations.h>
 #include <manipulation_actions/AttachArbitraryObject.h>
 #include <manipulation_actions/AttachSimpleGeometry.h>
 #include <manipulation_actions/AttachToBase.h>
+#include <manipulation_actions/ConvexHullGenerator.h>
 #include <manipulation_actions/DetachFromBase.h>
 #include <manipulation_actions/ToggleGripperCollisions.h>
 #include <moveit/collision_detection/collision_matrix.h>
 #include <moveit/move_group_interface/move_group_interface.h>
 #include <moveit/planning_scene_interface/planning_scene_interface.h>
+#include <moveit_msgs/ApplyPlanningScene.h>
 #include <moveit_msgs/GetPlanningScene.h>
 #include <moveit_msgs/PlanningScene.h>
 #include <rail_manipulation_msgs/SegmentedObjectList.h>
+#include <ros/callback_queue.h>
 #include <ros/ros.h>
 #include <sensor_msgs/point_cloud_conversion.h>
 #include <std_srvs/Empty.h>
@@ -39,11 +45,16 @@ private:
 
     ros::NodeHandle n, pnh;
 
+    // gripper collision toggles are served on their own threads so toggles from several clients can be coalesced
+    ros::NodeHandle toggle_nh;
+    ros::CallbackQueue toggle_queue;
+    ros::AsyncSpinner *toggle_spinner;
+
     // topics
-    ros::Publisher planning_scene_publisher;
 //    ros::Subscriber objects_subscriber;
 
     // services
+    ros::ServiceServer apply_operations_server;
     ros::ServiceServer attach_simple_geometry_server;
     ros::ServiceServer detach_all_server;
     ros::ServiceServer attach_arbitrary_server;
@@ -54,11 +65,12 @@ private:
     ros::ServiceServer reattach_held_to_base_server;
     ros::ServiceServer toggle_gripper_collisions_server;
     ros::ServiceServer clear_unattached_server;
-    ros::ServiceClient planning_scene_client;
+    ros::ServiceClient apply_planning_scene_client;
 
     // MoveIt interfaces
     moveit::planning_interface::MoveGroupInterface *arm_group;
     moveit::planning_interface::PlanningSceneInterface *planning_scene_interface;
+    AllowedCollisionManager *acm_manager;
 
     boost::mutex objects_mutex;
     rail_manipulation_msgs::SegmentedObjectList object_list; //the last received object list
@@ -66,6 +78,11 @@ private:
     std::vector<std::string> base_attached_objects;  // the names of objects that are attached to the robot base
     std::vector<std::string> unattached_objects;  // the names of all unattached objects in the planning scene
     std::vector<std::string> touch_links;  // end-effector touch links
+    std::vector<std::string> gripper_names;  // gripper links that collision toggles apply to
+
+    // segmented objects are modeled by their convex hull when it can be computed, otherwise by their bounding box
+    bool use_convex_hulls;
+    ConvexHullGenerator hull_generator;
 
 
     // TF
@@ -74,6 +91,19 @@ private:
 
 //    void objectsCallback(const rail_manipulation_msgs::SegmentedObjectList &msg);
 
+    /**
+     * @brief Apply a batch of scene operations as a single planning scene diff.
+     *
+     * The diff goes through the synchronous apply_planning_scene service, so the operations are in effect when this
+     * returns true.  The attached and unattached object names are only updated if the diff was applied.
+     * @param operations add, remove, attach, and detach operations, in order
+     * @return true if the planning scene applied the diff
+     */
+    bool applyOperations(const std::vector<manipulation_actions::SceneOperation> &operations);
+
+    bool applyOperationsCallback(manipulation_actions::ApplySceneOperations::Request &req,
+        manipulation_actions::ApplySceneOperations::Response &res);
+
     bool detachAllObjects(std_srvs::Empty::Request &req, std_srvs::Empty::Response &res);
 
     bool clearAll(std_srvs::Empty::Request &req, std_srvs::Empty::Response &res);
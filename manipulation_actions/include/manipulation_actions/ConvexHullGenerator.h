@@ -0,0 +1,63 @@
+#ifndef MANIPULATION_ACTIONS_CONVEX_HULL_GENERATOR_H
+#define MANIPULATION_ACTIONS_CONVEX_HULL_GENERATOR_H
+
+// C++
+#include <vector>
+
+// ROS
+#include <geometry_msgs/Pose.h>
+#include <pcl_conversions/pcl_conversions.h>
+#include <sensor_msgs/PointCloud2.h>
+#include <shape_msgs/Mesh.h>
+
+// PCL
+#include <pcl/point_cloud.h>
+#include <pcl/point_types.h>
+#include <pcl/Vertices.h>
+
+/**
+ * @brief Builds convex hull collision meshes from object point clouds, with a hard triangle budget.
+ *
+ * The cloud is voxel filtered before the hull is computed.  If the hull has more triangles than the budget, the
+ * hull vertices are thinned by farthest point sampling (a hull over V vertices has at most 2V - 4 triangles), and the
+ * thinned hull is scaled about its centroid just enough to contain every vertex of the full hull again, so the mesh
+ * never under-approximates the observed object.
+ */
+class ConvexHullGenerator
+{
+
+public:
+    static constexpr int DEFAULT_MAX_TRIANGLES = 64;
+    static constexpr double DEFAULT_LEAF_SIZE = 0.005;
+
+    ConvexHullGenerator(int max_triangles = DEFAULT_MAX_TRIANGLES, double leaf_size = DEFAULT_LEAF_SIZE);
+
+    /**
+     * @brief Compute a convex hull mesh for a point cloud.
+     * @param cloud object point cloud
+     * @param mesh hull mesh, with vertices relative to pose
+     * @param pose mesh pose in the cloud frame (the hull centroid, with no rotation)
+     * @return false if the cloud does not span a volume (e.g. too few or coplanar points)
+     */
+    bool generate(const sensor_msgs::PointCloud2 &cloud, shape_msgs::Mesh &mesh, geometry_msgs::Pose &pose) const;
+
+    bool generate(const pcl::PointCloud<pcl::PointXYZ>::ConstPtr &cloud, shape_msgs::Mesh &mesh,
+        geometry_msgs::Pose &pose) const;
+
+    int getMaxTriangles() const { return max_triangles; }
+
+private:
+    /**
+     * @brief Select up to count points, each as far as possible from the ones selected before it.
+     */
+    static pcl::PointCloud<pcl::PointXYZ>::Ptr farthestPoints(const pcl::PointCloud<pcl::PointXYZ> &points,
+        size_t count);
+
+    static bool hull(const pcl::PointCloud<pcl::PointXYZ>::ConstPtr &points, pcl::PointCloud<pcl::PointXYZ> &vertices,
+        std::vector<pcl::Vertices> &triangles);
+
+    int max_triangles;
+    double leaf_size;
+};
+
+#endif  // MANIPULATION_ACTIONS_CONVEX_HULL_GENERATOR_H
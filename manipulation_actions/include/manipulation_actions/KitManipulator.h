@@ -15,6 +15,8 @@
 #include <manipulation_actions/AttachSimpleGeometry.h>
 #include <manipulation_actions/KitManipAction.h>
 #include <manipulation_actions/LinearMoveAction.h>
+#include <manipulation_actions/ParallelPlanner.h>
+#include <manipulation_actions/ReachabilityMap.h>
 #include <manipulation_actions/ScoredPose.h>
 #include <manipulation_actions/StoreObjectAction.h>
 #include <manipulation_actions/ToggleGripperCollisions.h>
@@ -78,6 +80,7 @@ private:
     // MoveIt interfaces
     moveit::planning_interface::MoveGroupInterface *arm_group;
     moveit::planning_interface::PlanningSceneInterface *planning_scene_interface;
+    ParallelPlanner *planner;
 
     // preset poses
     std::vector<geometry_msgs::PoseStamped> kit_pick_poses;
@@ -85,6 +88,11 @@ private:
     size_t current_grasp_pose;
 
     size_t store_pose_attempts;
+    size_t store_race_candidates;  // place candidates planned to concurrently
+
+    // precomputed arm reachability, used to order place candidates before planning
+    ReachabilityMap reachability_map;
+    double reachability_weight;
 
     bool attach_arbitrary_object;
 
@@ -0,0 +1,170 @@
+#ifndef MANIPULATION_ACTIONS_PARALLEL_PLANNER_H
+#define MANIPULATION_ACTIONS_PARALLEL_PLANNER_H
+
+// Boost
+#include <boost/scoped_ptr.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+
+// C++
+#include <string>
+#include <vector>
+
+// ROS
+#include <geometry_msgs/PoseStamped.h>
+#include <manipulation_actions/PathPostProcessor.h>
+#include <manipulation_actions/TrajectoryCache.h>
+#include <moveit/move_group_interface/move_group_interface.h>
+#include <moveit/planning_interface/planning_interface.h>
+#include <moveit/planning_scene_monitor/planning_scene_monitor.h>
+#include <moveit/robot_model_loader/robot_model_loader.h>
+#include <moveit_msgs/Constraints.h>
+#include <moveit_msgs/RobotState.h>
+#include <pluginlib/class_loader.h>
+#include <ros/ros.h>
+#include <sensor_msgs/JointState.h>
+
+/**
+ * @brief Races several motion planning requests against each other and keeps the best solution.
+ *
+ * One request is made for every combination of goal candidate, planner configuration, and seed (repeated requests of
+ * the same planner differ only by their random seed), in goal order, up to a request limit.  All requests are solved
+ * concurrently in this process, by the same planning plugin move_group uses, on a snapshot of the current planning
+ * scene.  When the first solution arrives, the others get a short window to finish; the shortest finished solution
+ * (in joint space) wins and the rest are terminated.  The winning path is shortcut, smoothed, and time parameterized
+ * (see PathPostProcessor) so that it can be sent straight to MoveGroupInterface::execute.
+ *
+ * Requests that name their goal are cached by goal ID and start state.  A cached path is moved onto the current start
+ * state and used without planning if every waypoint is still valid in the planning scene and it still ends at one of
+ * the goals; otherwise it is dropped and the goal is planned for (and cached) again.
+ */
+class ParallelPlanner
+{
+
+public:
+    static constexpr double DEFAULT_RACE_WINDOW = 0.05;
+    static constexpr int DEFAULT_SEEDS = 2;
+    static constexpr int DEFAULT_MAX_REQUESTS = 8;
+
+    /**
+     * @param pnh node handle for the race parameters (race_planners, race_seeds, race_window, race_max_requests) and
+     * cache parameters (use_trajectory_cache, trajectory_cache_resolution, trajectory_cache_capacity), and
+     * post-processing parameters (post_process_plans, shortcut_iterations, smoothing_passes,
+     * post_processing_check_resolution)
+     * @param group_name planning group
+     */
+    ParallelPlanner(ros::NodeHandle &pnh, const std::string &group_name = "arm");
+
+    ~ParallelPlanner();
+
+    /**
+     * @return false if the robot model or planning plugin could not be loaded
+     */
+    bool isReady() const { return planner_manager != NULL; }
+
+    /**
+     * @brief Plan from a given start state instead of the current one, until reset.
+     * @param start_state start state, as a diff to the current state if is_diff is set
+     */
+    void setStartState(const moveit_msgs::RobotState &start_state);
+
+    void setStartStateToCurrentState();
+
+    /**
+     * @brief Plan to whichever of a set of goals can be reached first.
+     * @param goals goal constraints, best first
+     * @param plan winning plan, starting at the start state
+     * @param planning_time time limit for every request
+     * @param max_velocity_scaling_factor velocity scaling for the time parameterization
+     * @param goal_index if not NULL, set to the index of the goal the plan reaches
+     * @param goal_id names the goals for the trajectory cache, empty to always plan
+     * @return SUCCESS, or the error of the first request if no request succeeded
+     */
+    moveit::planning_interface::MoveItErrorCode plan(const std::vector<moveit_msgs::Constraints> &goals,
+        moveit::planning_interface::MoveGroupInterface::Plan &plan, double planning_time,
+        double max_velocity_scaling_factor = 1.0, size_t *goal_index = NULL, const std::string &goal_id = "");
+
+    /**
+     * @brief Plan to whichever of a set of link poses can be reached first.
+     */
+    moveit::planning_interface::MoveItErrorCode plan(const std::vector<geometry_msgs::PoseStamped> &poses,
+        const std::string &link, moveit::planning_interface::MoveGroupInterface::Plan &plan, double planning_time,
+        double max_velocity_scaling_factor = 1.0, size_t *goal_index = NULL, const std::string &goal_id = "");
+
+    /**
+     * @brief Plan to a single link pose.
+     */
+    moveit::planning_interface::MoveItErrorCode plan(const geometry_msgs::PoseStamped &pose, const std::string &link,
+        moveit::planning_interface::MoveGroupInterface::Plan &plan, double planning_time,
+        double max_velocity_scaling_factor = 1.0, const std::string &goal_id = "");
+
+    /**
+     * @brief Plan to a joint configuration of the group.
+     */
+    moveit::planning_interface::MoveItErrorCode plan(const sensor_msgs::JointState &joints,
+        moveit::planning_interface::MoveGroupInterface::Plan &plan, double planning_time,
+        double max_velocity_scaling_factor = 1.0, const std::string &goal_id = "");
+
+    /**
+     * @brief Goal constraints for a link pose, with MoveGroupInterface's default tolerances.
+     */
+    static moveit_msgs::Constraints poseGoal(const geometry_msgs::PoseStamped &pose, const std::string &link);
+
+private:
+    struct Race
+    {
+        std::vector<planning_interface::PlanningContextPtr> contexts;
+        std::vector<planning_interface::MotionPlanResponse> responses;
+        size_t finished;
+        bool solved;
+
+        Race() : finished(0), solved(false) {}
+    };
+
+    void solve(Race *race, size_t index);
+
+    /**
+     * @brief Move a cached path onto the start state and check it against the scene and goals.
+     *
+     * Every segment, including the one from the start state to the first cached waypoint, is checked at the post
+     * processor's check resolution.
+     * @return NULL if any segment is invalid or the path no longer ends at one of the goals
+     */
+    robot_trajectory::RobotTrajectoryPtr reuse(const robot_trajectory::RobotTrajectory &path,
+        const planning_scene::PlanningSceneConstPtr &scene, const robot_state::RobotState &start,
+        const std::vector<moveit_msgs::Constraints> &goals, size_t &goal_index) const;
+
+    /**
+     * @brief Post-process and time parameterize a path, and convert it to a plan.
+     * @param cached the path comes from the cache, so it is already shortcut and smoothed
+     */
+    bool toPlan(robot_trajectory::RobotTrajectory &trajectory, const planning_scene::PlanningScene &scene,
+        double max_velocity_scaling_factor, bool cached, moveit::planning_interface::MoveGroupInterface::Plan &plan);
+
+    static double pathLength(const robot_trajectory::RobotTrajectory &trajectory);
+
+    robot_model_loader::RobotModelLoaderPtr robot_model_loader;
+    planning_scene_monitor::PlanningSceneMonitorPtr planning_scene_monitor;
+    boost::scoped_ptr<pluginlib::ClassLoader<planning_interface::PlannerManager> > planner_loader;
+    planning_interface::PlannerManagerPtr planner_manager;
+
+    std::string group_name;
+    std::vector<std::string> planner_ids;
+    int seeds;
+    int max_requests;
+    double race_window;
+
+    moveit_msgs::RobotState start_state;  // empty diff for the current state
+
+    TrajectoryCache trajectory_cache;
+    bool use_trajectory_cache;
+
+    PathPostProcessor post_processor;
+    bool post_process_plans;
+
+    boost::mutex race_mutex;  // one race at a time, the planning scene snapshot is shared by its requests
+    boost::mutex result_mutex;
+    boost::condition_variable result_condition;
+};
+
+#endif  // MANIPULATION_ACTIONS_PARALLEL_PLANNER_H
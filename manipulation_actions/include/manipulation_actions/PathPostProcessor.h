@@ -0,0 +1,86 @@
+#ifndef MANIPULATION_ACTIONS_PATH_POST_PROCESSOR_H
+#define MANIPULATION_ACTIONS_PATH_POST_PROCESSOR_H
+
+// C++
+#include <string>
+#include <vector>
+
+// ROS
+#include <moveit/planning_scene/planning_scene.h>
+#include <moveit/robot_trajectory/robot_trajectory.h>
+#include <random_numbers/random_numbers.h>
+
+/**
+ * @brief Shortens, smooths, and time parameterizes planned paths.
+ *
+ * Randomized shortcutting replaces stretches of the path with straight joint space segments, and smoothing then
+ * subdivides the path and pulls each waypoint halfway towards the midpoint of its neighbors (converging on a B-spline
+ * of the waypoints).  Every change is kept only if the segments it creates are valid in the planning scene, checked
+ * at a fixed joint space resolution.  The result is time parameterized for the fastest motion within the robot's
+ * velocity and acceleration limits, falling back to iterative parabolic time parameterization if the time optimal
+ * trajectory strays into an invalid state.
+ */
+class PathPostProcessor
+{
+
+public:
+    static constexpr int DEFAULT_SHORTCUT_ITERATIONS = 100;
+    static constexpr int DEFAULT_SMOOTHING_PASSES = 3;
+    static constexpr double DEFAULT_CHECK_RESOLUTION = 0.02;
+
+    /**
+     * @param shortcut_iterations number of random shortcuts tried
+     * @param smoothing_passes number of subdivide and smooth passes
+     * @param check_resolution largest joint space step between validity checks along a segment
+     */
+    PathPostProcessor(int shortcut_iterations = DEFAULT_SHORTCUT_ITERATIONS,
+        int smoothing_passes = DEFAULT_SMOOTHING_PASSES, double check_resolution = DEFAULT_CHECK_RESOLUTION);
+
+    /**
+     * @brief Shortcut and smooth a path, then time parameterize it, logging the execution time saved.
+     * @param trajectory path of a single planning group, replaced by the processed trajectory
+     * @param scene planning scene the path is valid in
+     * @param max_velocity_scaling_factor velocity scaling for the time parameterization
+     * @return false if the path could not be time parameterized
+     */
+    bool process(robot_trajectory::RobotTrajectory &trajectory, const planning_scene::PlanningScene &scene,
+        double max_velocity_scaling_factor);
+
+    /**
+     * @brief Time parameterize a path without changing its waypoints, time optimally if the result stays valid.
+     * @param time_optimal set to whether the time optimal parameterization was used
+     * @return false if the path could not be time parameterized
+     */
+    bool parameterize(robot_trajectory::RobotTrajectory &trajectory, const planning_scene::PlanningScene &scene,
+        double max_velocity_scaling_factor, bool *time_optimal = NULL) const;
+
+    /**
+     * @return execution time of a time parameterized trajectory
+     */
+    static double duration(const robot_trajectory::RobotTrajectory &trajectory);
+
+    /**
+     * @brief Check the straight joint space segment between two group configurations, excluding its start.
+     * @param state scratch state, with everything outside the group as along the path
+     */
+    bool segmentValid(const std::vector<double> &from, const std::vector<double> &to, robot_state::RobotState &state,
+        const planning_scene::PlanningScene &scene, const std::string &group_name) const;
+
+private:
+    void shortcut(std::vector<std::vector<double> > &waypoints, robot_state::RobotState &state,
+        const planning_scene::PlanningScene &scene, const std::string &group_name);
+
+    void smooth(std::vector<std::vector<double> > &waypoints, robot_state::RobotState &state,
+        const planning_scene::PlanningScene &scene, const std::string &group_name) const;
+
+    bool trajectoryValid(const robot_trajectory::RobotTrajectory &trajectory,
+        const planning_scene::PlanningScene &scene) const;
+
+    random_numbers::RandomNumberGenerator rng;
+
+    int shortcut_iterations;
+    int smoothing_passes;
+    double check_resolution;
+};
+
+#endif  // MANIPULATION_ACTIONS_PATH_POST_PROCESSOR_H
@@ -0,0 +1,90 @@
+#ifndef MANIPULATION_ACTIONS_REACHABILITY_MAP_H
+#define MANIPULATION_ACTIONS_REACHABILITY_MAP_H
+
+// C++
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+// ROS
+#include <geometry_msgs/Pose.h>
+
+/**
+ * @brief On-disk layout of a reachability map (.rmap), little-endian, followed directly by the cell array.
+ */
+struct ReachabilityMapHeader
+{
+    char magic[8];  // "FETCHRMP"
+    uint32_t version;
+    uint32_t dims[3];  // voxels along x, y, z
+    uint32_t azimuth_bins;  // approach direction bins around base_link's z axis
+    uint32_t elevation_bins;  // approach direction bins, uniform in the z component of the direction
+    float origin[3];  // base_link position of the minimum corner of the grid
+    float resolution;  // voxel edge length
+    float reference_height;  // torso_lift_joint position the map was built at
+    uint32_t reserved;
+};
+
+/**
+ * @brief Read-only, memory-mapped map from wrist poses (relative to base_link) to arm reachability.
+ *
+ * Each cell is a voxel of wrist_roll_link positions paired with a bin of approach directions (the wrist x axis).
+ * Roll about the approach direction is not discretized, since the Fetch wrist roll joint is continuous and turns the
+ * wrist about exactly that axis.  A cell holds 0 if no collision-free arm configuration reached it while the map was
+ * built, and otherwise the best manipulability index seen there, scaled to 1-255.  Lookups are a constant time index
+ * computation into the mapped file.
+ */
+class ReachabilityMap
+{
+
+public:
+    static const uint32_t VERSION = 1;
+
+    ReachabilityMap();
+
+    ~ReachabilityMap();
+
+    /**
+     * @brief Memory map a reachability map file.
+     * @param file path to a .rmap file written by build_reachability_map
+     * @return false if the file is missing, truncated, or from a different format version
+     */
+    bool load(const std::string &file);
+
+    bool isLoaded() const { return cells != NULL; }
+
+    /**
+     * @brief Look up the reachability of a wrist_roll_link pose.
+     * @param pose wrist pose in base_link
+     * @param torso_height current torso_lift_joint position, poses are shifted by its offset from the map's
+     * @return 0 if the pose was never reached (or is outside the map), otherwise the normalized manipulability (0, 1]
+     */
+    double getScore(const geometry_msgs::Pose &pose, double torso_height) const;
+
+    /**
+     * @brief Compute the cell index of a wrist position and approach direction.
+     * @return false if the position lies outside the grid
+     */
+    static bool cellIndex(const ReachabilityMapHeader &header, double x, double y, double z,
+        double approach_x, double approach_y, double approach_z, size_t &index);
+
+    static size_t cellCount(const ReachabilityMapHeader &header);
+
+    /**
+     * @brief Write a map to disk, filling in the header's magic and version.
+     */
+    static bool write(const std::string &file, ReachabilityMapHeader header, const std::vector<uint8_t> &cells);
+
+private:
+    ReachabilityMap(const ReachabilityMap &);
+    ReachabilityMap &operator=(const ReachabilityMap &);
+
+    void release();
+
+    void *mapped_data;
+    size_t mapped_size;
+    const ReachabilityMapHeader *header;
+    const uint8_t *cells;
+};
+
+#endif  // MANIPULATION_ACTIONS_REACHABILITY_MAP_H
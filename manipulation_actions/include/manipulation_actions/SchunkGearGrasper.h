@@ -13,6 +13,7 @@
 #include <manipulation_actions/SchunkGraspAction.h>
 #include <manipulation_actions/SchunkRetrieveAction.h>
 #include <manipulation_actions/LinearMoveAction.h>
+#include <manipulation_actions/ParallelPlanner.h>
 #include <moveit_msgs/GetCartesianPath.h>
 #include <moveit/move_group_interface/move_group_interface.h>
 #include <moveit/planning_scene_interface/planning_scene_interface.h>
@@ -70,6 +71,7 @@ private:
     // MoveIt interfaces
     moveit::planning_interface::MoveGroupInterface *arm_group;
     moveit::planning_interface::PlanningSceneInterface *planning_scene_interface;
+    ParallelPlanner *planner;
 
     // preset poses
     std::vector<geometry_msgs::PoseStamped> grasp_poses;
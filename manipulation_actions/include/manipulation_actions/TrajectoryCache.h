@@ -0,0 +1,67 @@
+#ifndef MANIPULATION_ACTIONS_TRAJECTORY_CACHE_H
+#define MANIPULATION_ACTIONS_TRAJECTORY_CACHE_H
+
+// C++
+#include <list>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+// ROS
+#include <moveit/robot_trajectory/robot_trajectory.h>
+
+/**
+ * @brief Planned paths for recurring motions, keyed by a goal ID and the quantized start joint state.
+ *
+ * Start states that fall in the same cell of a uniform joint space grid share an entry.  The cache only stores and
+ * finds paths; whoever uses a path is responsible for checking that it still starts at the current state, is valid in
+ * the current planning scene, and reaches the current goal.  When full, the oldest entry is evicted.
+ */
+class TrajectoryCache
+{
+
+public:
+    static constexpr double DEFAULT_RESOLUTION = 0.05;
+    static constexpr int DEFAULT_CAPACITY = 64;
+
+    /**
+     * @param resolution edge length of a start state cell, in joint units (radians for the Fetch arm)
+     * @param capacity maximum number of stored paths
+     */
+    TrajectoryCache(double resolution = DEFAULT_RESOLUTION, size_t capacity = DEFAULT_CAPACITY);
+
+    /**
+     * @brief Find the path stored for a goal from a start in the same cell.
+     * @param goal_id caller chosen name of the goal
+     * @param start planning group positions of the start state
+     * @return NULL if nothing is stored
+     */
+    robot_trajectory::RobotTrajectoryConstPtr lookup(const std::string &goal_id,
+        const std::vector<double> &start) const;
+
+    /**
+     * @brief Store a path, replacing any path stored for the same goal and start cell.
+     */
+    void store(const std::string &goal_id, const std::vector<double> &start,
+        const robot_trajectory::RobotTrajectoryConstPtr &path);
+
+    void erase(const std::string &goal_id, const std::vector<double> &start);
+
+    void clear();
+
+    size_t size() const { return entries.size(); }
+
+private:
+    typedef std::pair<std::string, std::vector<int> > Key;
+
+    Key makeKey(const std::string &goal_id, const std::vector<double> &start) const;
+
+    std::map<Key, robot_trajectory::RobotTrajectoryConstPtr> entries;
+    std::list<Key> insertion_order;  // oldest first
+
+    double resolution;
+    size_t capacity;
+};
+
+#endif  // MANIPULATION_ACTIONS_TRAJECTORY_CACHE_H
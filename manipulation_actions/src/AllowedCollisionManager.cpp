@@ -0,0 +1,142 @@
+#include <manipulation_actions/AllowedCollisionManager.h>
+
+using std::string;
+using std::vector;
+
+const double AllowedCollisionManager::DEFAULT_COALESCE_WINDOW;
+
+AllowedCollisionManager::AllowedCollisionManager(ros::NodeHandle &n, double coalesce_window) :
+    coalesce_window(coalesce_window),
+    synced(false),
+    leading(false),
+    collecting(new Batch)
+{
+  planning_scene_client = n.serviceClient<moveit_msgs::GetPlanningScene>("/get_planning_scene");
+  apply_planning_scene_client = n.serviceClient<moveit_msgs::ApplyPlanningScene>("/apply_planning_scene");
+}
+
+bool AllowedCollisionManager::setEntries(const vector<string> &names, const vector<string> &links, bool allowed)
+{
+  boost::mutex::scoped_lock lock(mutex);
+
+  // changes being sent are not in the mirror yet, so wait for them before comparing against it
+  while (in_flight)
+    applied_condition.wait(lock);
+
+  if (!synced && !fetch())
+    return false;
+
+  // only the entries that would change anything are queued
+  boost::shared_ptr<Batch> batch = collecting;
+  size_t queued = 0;
+  for (size_t i = 0; i < names.size(); i ++)
+  {
+    for (size_t j = 0; j < links.size(); j ++)
+    {
+      if (projectedEntry(names[i], links[j]) != allowed)
+      {
+        Entry entry;
+        entry.name = names[i];
+        entry.link = links[j];
+        entry.allowed = allowed;
+        batch->entries.push_back(entry);
+        queued ++;
+      }
+    }
+  }
+  if (queued == 0)
+    return true;
+
+  while (!batch->done)
+  {
+    if (leading || in_flight)
+    {
+      applied_condition.wait(lock);
+      continue;
+    }
+
+    // nobody else will send the collected changes, so this caller waits for more and sends them
+    leading = true;
+    if (coalesce_window > 0)
+    {
+      lock.unlock();
+      ros::Duration(coalesce_window).sleep();
+      lock.lock();
+    }
+    in_flight = collecting;
+    collecting.reset(new Batch);
+    leading = false;
+
+    bool success = synced || fetch();
+    if (success)
+    {
+      collision_detection::AllowedCollisionMatrix updated_acm(acm);
+      for (size_t i = 0; i < in_flight->entries.size(); i ++)
+      {
+        updated_acm.setEntry(in_flight->entries[i].name, in_flight->entries[i].link, in_flight->entries[i].allowed);
+      }
+
+      moveit_msgs::ApplyPlanningScene apply_planning_scene;
+      updated_acm.getMessage(apply_planning_scene.request.scene.allowed_collision_matrix);
+      apply_planning_scene.request.scene.is_diff = true;
+      apply_planning_scene.request.scene.robot_state.is_diff = true;
+
+      lock.unlock();
+      success = apply_planning_scene_client.call(apply_planning_scene) && apply_planning_scene.response.success;
+      lock.lock();
+
+      if (success)
+      {
+        acm = updated_acm;
+      }
+      else
+      {
+        ROS_WARN("Could not apply %lu allowed collision matrix entries to the planning scene!",
+            in_flight->entries.size());
+        synced = false;
+      }
+    }
+
+    in_flight->success = success;
+    in_flight->done = true;
+    in_flight.reset();
+    applied_condition.notify_all();
+  }
+
+  return batch->success;
+}
+
+void AllowedCollisionManager::invalidate()
+{
+  boost::mutex::scoped_lock lock(mutex);
+  synced = false;
+}
+
+bool AllowedCollisionManager::fetch()
+{
+  moveit_msgs::GetPlanningScene planning_scene_srv;
+  planning_scene_srv.request.components.components = moveit_msgs::PlanningSceneComponents::ALLOWED_COLLISION_MATRIX;
+  if (!planning_scene_client.call(planning_scene_srv))
+  {
+    ROS_WARN("Could not get the allowed collision matrix from the planning scene!");
+    return false;
+  }
+
+  acm = collision_detection::AllowedCollisionMatrix(planning_scene_srv.response.scene.allowed_collision_matrix);
+  synced = true;
+  return true;
+}
+
+bool AllowedCollisionManager::projectedEntry(const string &name, const string &link) const
+{
+  // the latest queued change wins over the mirror
+  for (size_t i = collecting->entries.size(); i > 0; i --)
+  {
+    const Entry &entry = collecting->entries[i - 1];
+    if (entry.name == name && entry.link == link)
+      return entry.allowed;
+  }
+
+  collision_detection::AllowedCollision::Type type;
+  return acm.getEntry(name, link, type) && type == collision_detection::AllowedCollision::ALWAYS;
+}
@@ -21,6 +21,7 @@ ApproachSchunk::ApproachSchunk(ros::NodeHandle& nh, std::string object_frame, st
     // preps moveit
     arm_group_ = new moveit::planning_interface::MoveGroupInterface("arm");
     arm_group_->startStateMonitor();
+    planner_ = new ParallelPlanner(pnh_);
 
     // preps planning scene for adding collision objects as needed
     planning_scene_interface_ = new moveit::planning_interface::PlanningSceneInterface();
@@ -28,6 +29,16 @@ ApproachSchunk::ApproachSchunk(ros::NodeHandle& nh, std::string object_frame, st
     attach_simple_geometry_client_ = nh_.serviceClient<manipulation_actions::AttachSimpleGeometry>("/collision_scene_manager/attach_simple_geometry");
     detach_simple_geometry_client_ = nh_.serviceClient<manipulation_actions::DetachFromBase>("/collision_scene_manager/detach_from_base");
 
+    // uses the schunk tracker's pose when it is current, instead of the last static template_pose
+    std::string tracked_pose_topic = "/schunk_template_matcher_node/tracked_pose";
+    tracked_pose_timeout_ = 1.0;
+    min_tracking_confidence_ = 0.3;
+    pnh_.getParam("tracked_pose_topic", tracked_pose_topic);
+    pnh_.getParam("tracked_pose_timeout", tracked_pose_timeout_);
+    pnh_.getParam("min_tracking_confidence", min_tracking_confidence_);
+    tracked_pose_.locked = false;
+    tracked_pose_sub_ = nh_.subscribe(tracked_pose_topic, 1, &ApproachSchunk::trackedPoseCallback, this);
+
     // approach_schunk_server_ = new actionlib::SimpleActionServer<manipulation_actions::ApproachSchunkAction>(nh, "approach_schunk", boost::bind(&ApproachSchunk::executeApproachSchunk, this, _1), false);
     approach_schunk_server_.start();
     ROS_INFO("schunk arm approach node ready!!!");
@@ -238,15 +249,52 @@ void ApproachSchunk::executeApproachSchunk(const manipulation_actions::ApproachS
     return;
 }
 
-bool ApproachSchunk::addSchunkCollisionObjects() {
-    // gets the schunk corner in base_link
-    geometry_msgs::TransformStamped base_link_to_template_pose;
+void ApproachSchunk::trackedPoseCallback(const fetchit_icp::TrackedPose::ConstPtr& msg) {
+    boost::mutex::scoped_lock lock(tracked_pose_mutex_);
+    tracked_pose_ = *msg;
+}
+
+bool ApproachSchunk::getTrackedTemplatePose(geometry_msgs::TransformStamped& base_link_to_template_pose) {
+    geometry_msgs::TransformStamped template_pose;
+    {
+        boost::mutex::scoped_lock lock(tracked_pose_mutex_);
+        if (!tracked_pose_.locked || tracked_pose_.confidence < min_tracking_confidence_
+            || ros::Time::now() - tracked_pose_.template_pose.header.stamp > ros::Duration(tracked_pose_timeout_)) {
+            return false;
+        }
+        template_pose = tracked_pose_.template_pose;
+    }
+
+    // the tracker reports in its matching frame, so express the pose in base_link
+    geometry_msgs::TransformStamped base_link_to_matching_frame;
     try{
-        base_link_to_template_pose = tf_buffer_.lookupTransform("base_link","template_pose",ros::Time(0),ros::Duration(1.0));
+        base_link_to_matching_frame = tf_buffer_.lookupTransform("base_link",template_pose.header.frame_id,ros::Time(0),
+                                                                 ros::Duration(0.1));
     } catch (tf2::TransformException ex) {
-        ROS_ERROR("%s",ex.what());
+        ROS_WARN("%s",ex.what());
         return false;
     }
+    tf2::Transform base_link_to_matching_frame_tf, matching_frame_to_template_tf;
+    tf2::fromMsg(base_link_to_matching_frame.transform, base_link_to_matching_frame_tf);
+    tf2::fromMsg(template_pose.transform, matching_frame_to_template_tf);
+    transformTF2ToMsg(base_link_to_matching_frame_tf * matching_frame_to_template_tf, base_link_to_template_pose,
+                      template_pose.header.stamp, "base_link", template_pose.child_frame_id);
+    return true;
+}
+
+bool ApproachSchunk::addSchunkCollisionObjects() {
+    // gets the schunk corner in base_link, from the tracker if it is locked or else from the last match
+    geometry_msgs::TransformStamped base_link_to_template_pose;
+    if (getTrackedTemplatePose(base_link_to_template_pose)) {
+        ROS_INFO("Using tracked schunk template pose.");
+    } else {
+        try{
+            base_link_to_template_pose = tf_buffer_.lookupTransform("base_link","template_pose",ros::Time(0),ros::Duration(1.0));
+        } catch (tf2::TransformException ex) {
+            ROS_ERROR("%s",ex.what());
+            return false;
+        }
+    }
     tf2::Transform base_link_to_template_offset;
     tf2::fromMsg(base_link_to_template_pose.transform,base_link_to_template_offset);
     tf2::Transform base_link_to_schunk_corner = base_link_to_template_offset * template_offset_to_schunk_corner_;
@@ -540,18 +588,25 @@ bool ApproachSchunk::planToPose(geometry_msgs::PoseStamped& pose, std::string& p
     for (int num_attempts = 0; num_attempts < max_planning_attempts; num_attempts++) {
         ROS_INFO("Planning path to %s pose. Attempt: %d/%d", pose_name.c_str(), num_attempts + 1, max_planning_attempts);
 
-        // preps moveit
-        arm_group_->setPlannerId("arm[RRTConnectkConfigDefault]");
-        arm_group_->setPlanningTime(1.5);
-        arm_group_->setStartStateToCurrentState();
-        if (motion_speed_scale_factor_ != 1.0)
-            arm_group_->setMaxVelocityScalingFactor(motion_speed_scale_factor_);
-
-        // sets the planning goal
-        arm_group_->setPoseTarget(pose, pose_frame);
-
-        // plans to the target pose
-        moveit::planning_interface::MoveItErrorCode plan_result = arm_group_->plan(pose_plan);
+        moveit::planning_interface::MoveItErrorCode plan_result;
+        if (planner_->isReady()) {
+            // races planners and seeds to the target pose
+            plan_result = planner_->plan(pose, pose_frame, pose_plan, 1.5, motion_speed_scale_factor_,
+                                         "approach_schunk_" + pose_name);
+        } else {
+            // preps moveit
+            arm_group_->setPlannerId("arm[RRTConnectkConfigDefault]");
+            arm_group_->setPlanningTime(1.5);
+            arm_group_->setStartStateToCurrentState();
+            if (motion_speed_scale_factor_ != 1.0)
+                arm_group_->setMaxVelocityScalingFactor(motion_speed_scale_factor_);
+
+            // sets the planning goal
+            arm_group_->setPoseTarget(pose, pose_frame);
+
+            // plans to the target pose
+            plan_result = arm_group_->plan(pose_plan);
+        }
 
         // checks the results
         if (approach_schunk_server_.isPreemptRequested()) {
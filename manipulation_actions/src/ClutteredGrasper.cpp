@@ -22,18 +22,14 @@ ClutteredGrasper::ClutteredGrasper() :
 
   cloud_received_ = false;
 
-  gripper_names_.push_back("gripper_link");
-  gripper_names_.push_back("l_gripper_finger_link");
-  gripper_names_.push_back("r_gripper_finger_link");
-
   cloud_subscriber_ = n_.subscribe(cloud_topic, 1, &ClutteredGrasper::cloudCallback, this);
   objects_subscriber_ = n_.subscribe(segmentation_topic, 1, &ClutteredGrasper::objectsCallback, this);
-  planning_scene_publisher_ = n_.advertise<moveit_msgs::PlanningScene>("/planning_scene", 1);
 
   arm_group = new moveit::planning_interface::MoveGroupInterface("arm");
   arm_group->startStateMonitor();
 
-  planning_scene_client_ = n_.serviceClient<moveit_msgs::GetPlanningScene>("/get_planning_scene");
+  toggle_gripper_collisions_client_ = n_.serviceClient<manipulation_actions::ToggleGripperCollisions>
+      ("/collision_scene_manager/toggle_gripper_collisions");
   attach_arbitrary_object_client =
       n_.serviceClient<manipulation_actions::AttachArbitraryObject>("collision_scene_manager/attach_arbitrary_object");
   cartesian_path_client = n_.serviceClient<moveit_msgs::GetCartesianPath>("/compute_cartesian_path");
@@ -133,25 +129,13 @@ void ClutteredGrasper::executeBlind(const manipulation_actions::BinPickGoalConst
     gripper_client.sendGoal(gripper_goal);
     gripper_client.waitForResult(ros::Duration(5.0));
 
-    //disable collision between gripper links and object
-    moveit_msgs::GetPlanningScene planning_scene_srv;
-    planning_scene_srv.request.components.components = moveit_msgs::PlanningSceneComponents::ALLOWED_COLLISION_MATRIX;
-
-    if (!planning_scene_client_.call(planning_scene_srv))
-    {
-      ROS_INFO("Could not get the current planning scene!");
-    }
-    else
+    // disable collisions between gripper links and octomap
+    manipulation_actions::ToggleGripperCollisions toggle_srv;
+    toggle_srv.request.object_name = manipulation_actions::ToggleGripperCollisions::Request::OCTOMAP_NAME;
+    toggle_srv.request.enable_collisions = true;
+    if (!toggle_gripper_collisions_client_.call(toggle_srv))
     {
-      collision_detection::AllowedCollisionMatrix acm(planning_scene_srv.response.scene.allowed_collision_matrix);
-      // disable collisions between gripper links and octomap
-      acm.setEntry("<octomap>", gripper_names_, true);
-      moveit_msgs::PlanningScene planning_scene_update;
-      acm.getMessage(planning_scene_update.allowed_collision_matrix);
-      planning_scene_update.is_diff = true;
-      planning_scene_publisher_.publish(planning_scene_update);
-
-      ros::Duration(0.5).sleep(); //delay for publish to go through
+      ROS_INFO("Could not update the collisions in the current planning scene!");
     }
 
 
@@ -185,20 +169,10 @@ void ClutteredGrasper::executeBlind(const manipulation_actions::BinPickGoalConst
     }
 
     // re-enable gripper collision with octomap
-    planning_scene_srv.request.components.components = moveit_msgs::PlanningSceneComponents::ALLOWED_COLLISION_MATRIX;
-    if (!planning_scene_client_.call(planning_scene_srv))
+    toggle_srv.request.enable_collisions = false;
+    if (!toggle_gripper_collisions_client_.call(toggle_srv))
     {
-      ROS_INFO("Could not get the current planning scene!");
-    }
-    else
-    {
-      collision_detection::AllowedCollisionMatrix acm(planning_scene_srv.response.scene.allowed_collision_matrix);
-      acm.setEntry("<octomap>", gripper_names_, false);
-
-      moveit_msgs::PlanningScene planning_scene_update;
-      acm.getMessage(planning_scene_update.allowed_collision_matrix);
-      planning_scene_update.is_diff = true;
-      planning_scene_publisher_.publish(planning_scene_update);
+      ROS_INFO("Could not update the collisions in the current planning scene!");
     }
   }
   else
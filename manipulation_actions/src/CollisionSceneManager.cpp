@@ -7,13 +7,22 @@ using std::vector;
 
 CollisionSceneManager::CollisionSceneManager() :
     pnh("~"),
+    toggle_nh("~"),
     tf_listener(tf_buffer)
 {
 //  pnh.param<bool>("debug", debug, true);
+  double coalesce_window;
+  int max_hull_triangles;
+  pnh.param<double>("acm_coalesce_window", coalesce_window, AllowedCollisionManager::DEFAULT_COALESCE_WINDOW);
+  pnh.param<bool>("use_convex_hulls", use_convex_hulls, true);
+  pnh.param<int>("max_hull_triangles", max_hull_triangles, ConvexHullGenerator::DEFAULT_MAX_TRIANGLES);
+  hull_generator = ConvexHullGenerator(max_hull_triangles);
 
   arm_group = new moveit::planning_interface::MoveGroupInterface("arm");
   arm_group->startStateMonitor();
   planning_scene_interface = new moveit::planning_interface::PlanningSceneInterface();
+  apply_planning_scene_client = n.serviceClient<moveit_msgs::ApplyPlanningScene>("/apply_planning_scene");
+  acm_manager = new AllowedCollisionManager(n, coalesce_window);
 
   touch_links.clear();
   touch_links.emplace_back("r_gripper_finger_link");
@@ -22,6 +31,11 @@ CollisionSceneManager::CollisionSceneManager() :
   touch_links.emplace_back("wrist_roll_link");
   touch_links.emplace_back("wrist_flex_link");
 
+  gripper_names.emplace_back("gripper_link");
+  gripper_names.emplace_back("l_gripper_finger_link");
+  gripper_names.emplace_back("r_gripper_finger_link");
+
+  apply_operations_server = pnh.advertiseService("apply_operations", &CollisionSceneManager::applyOperationsCallback, this);
   attach_simple_geometry_server = pnh.advertiseService("attach_simple_geometry", &CollisionSceneManager::attachSimpleGeometry, this);
   detach_all_server = pnh.advertiseService("detach_objects", &CollisionSceneManager::detachAllObjects, this);
   attach_arbitrary_server= pnh.advertiseService("attach_arbitrary_object", &CollisionSceneManager::attachArbitraryObject, this);
@@ -32,11 +46,11 @@ CollisionSceneManager::CollisionSceneManager() :
   detach_named_base_server = pnh.advertiseService("detach_from_base", &CollisionSceneManager::detachListFromBase, this);
   reattach_held_to_base_server =
       pnh.advertiseService("reattach_held_to_base", &CollisionSceneManager::reattachHeldToBase, this);
-  toggle_gripper_collisions_server = pnh.advertiseService("toggle_gripper_collisions",
+  toggle_nh.setCallbackQueue(&toggle_queue);
+  toggle_gripper_collisions_server = toggle_nh.advertiseService("toggle_gripper_collisions",
       &CollisionSceneManager::toggleGripperCollisions, this);
-  planning_scene_client = n.serviceClient<moveit_msgs::GetPlanningScene>("/get_planning_scene");
-
-  planning_scene_publisher = n.advertise<moveit_msgs::PlanningScene>("/planning_scene", 1);
+  toggle_spinner = new ros::AsyncSpinner(2, &toggle_queue);
+  toggle_spinner->start();
 //  objects_subscriber = n.subscribe("rail_segmentation/segmented_objects", 1, &CollisionSceneManager::objectsCallback, this);
 }
 
@@ -67,6 +81,120 @@ CollisionSceneManager::CollisionSceneManager() :
 //  }
 //}
 
+bool CollisionSceneManager::applyOperationsCallback(manipulation_actions::ApplySceneOperations::Request &req,
+    manipulation_actions::ApplySceneOperations::Response &res)
+{
+  res.success = applyOperations(req.operations);
+  return true;
+}
+
+bool CollisionSceneManager::applyOperations(const vector<manipulation_actions::SceneOperation> &operations)
+{
+  if (operations.empty())
+    return true;
+
+  moveit_msgs::ApplyPlanningScene apply_planning_scene;
+  moveit_msgs::PlanningScene &diff = apply_planning_scene.request.scene;
+  diff.is_diff = true;
+  diff.robot_state.is_diff = true;
+
+  // work on copies of the object names, they are only kept if the diff goes through
+  vector<string> gripper_objects = attached_objects;
+  vector<string> base_objects = base_attached_objects;
+  vector<string> world_objects = unattached_objects;
+
+  for (size_t i = 0; i < operations.size(); i ++)
+  {
+    const manipulation_actions::SceneOperation &op = operations[i];
+    const string &id = op.object.id;
+    bool attached = std::find(gripper_objects.begin(), gripper_objects.end(), id) != gripper_objects.end()
+        || std::find(base_objects.begin(), base_objects.end(), id) != base_objects.end();
+
+    // MoveIt! processes attached objects in order, and all of them before the world objects
+    if (attached && op.operation != manipulation_actions::SceneOperation::ADD)
+    {
+      moveit_msgs::AttachedCollisionObject detach;
+      detach.object.id = id;
+      detach.object.operation = moveit_msgs::CollisionObject::REMOVE;
+      diff.robot_state.attached_collision_objects.push_back(detach);
+      gripper_objects.erase(std::remove(gripper_objects.begin(), gripper_objects.end(), id), gripper_objects.end());
+      base_objects.erase(std::remove(base_objects.begin(), base_objects.end(), id), base_objects.end());
+      world_objects.push_back(id);
+    }
+
+    if (op.operation == manipulation_actions::SceneOperation::ADD)
+    {
+      moveit_msgs::CollisionObject obj = op.object;
+      obj.operation = moveit_msgs::CollisionObject::ADD;
+      diff.world.collision_objects.push_back(obj);
+      if (std::find(world_objects.begin(), world_objects.end(), id) == world_objects.end())
+      {
+        world_objects.push_back(id);
+      }
+    }
+    else if (op.operation == manipulation_actions::SceneOperation::REMOVE)
+    {
+      moveit_msgs::CollisionObject obj;
+      obj.id = id;
+      obj.operation = moveit_msgs::CollisionObject::REMOVE;
+      diff.world.collision_objects.push_back(obj);
+    }
+    else if (op.operation == manipulation_actions::SceneOperation::ATTACH)
+    {
+      moveit_msgs::AttachedCollisionObject attach;
+      attach.link_name = op.link.empty() ? arm_group->getEndEffectorLink() : op.link;
+      attach.object = op.object;
+      attach.object.operation = moveit_msgs::CollisionObject::ADD;
+      if (op.use_touch_links)
+      {
+        attach.touch_links = touch_links;
+      }
+
+      // an object added earlier in this batch would not be in the world yet, so it is attached with its geometry
+      for (size_t j = 0; j < diff.world.collision_objects.size(); j ++)
+      {
+        if (diff.world.collision_objects[j].id == id
+            && diff.world.collision_objects[j].operation == moveit_msgs::CollisionObject::ADD)
+        {
+          if (attach.object.primitives.empty() && attach.object.meshes.empty())
+          {
+            attach.object = diff.world.collision_objects[j];
+          }
+          diff.world.collision_objects.erase(diff.world.collision_objects.begin() + j);
+          break;
+        }
+      }
+      diff.robot_state.attached_collision_objects.push_back(attach);
+
+      if (attach.link_name == "base_link")
+      {
+        base_objects.push_back(id);
+      }
+      else
+      {
+        gripper_objects.push_back(id);
+      }
+    }
+
+    if (op.operation == manipulation_actions::SceneOperation::REMOVE
+        || op.operation == manipulation_actions::SceneOperation::ATTACH)
+    {
+      world_objects.erase(std::remove(world_objects.begin(), world_objects.end(), id), world_objects.end());
+    }
+  }
+
+  if (!apply_planning_scene_client.call(apply_planning_scene) || !apply_planning_scene.response.success)
+  {
+    ROS_WARN("Could not apply %lu scene operations to the planning scene!", operations.size());
+    return false;
+  }
+
+  attached_objects = gripper_objects;
+  base_attached_objects = base_objects;
+  unattached_objects = world_objects;
+  return true;
+}
+
 bool CollisionSceneManager::attachSimpleGeometry(manipulation_actions::AttachSimpleGeometry::Request &req,
     manipulation_actions::AttachSimpleGeometry::Response &res)
 {
@@ -104,6 +232,7 @@ bool CollisionSceneManager::attachSimpleGeometry(manipulation_actions::AttachSim
     bool collision = false;
     do
     {
+      collision = false;
       for (unsigned int i = 0; i < attached_objects.size(); i++)
       {
         if (ss.str() == attached_objects[i])
@@ -114,7 +243,6 @@ bool CollisionSceneManager::attachSimpleGeometry(manipulation_actions::AttachSim
       }
     } while (collision);
     obj.id = ss.str();
-    attached_objects.push_back(obj.id);
   }
   else if (req.location == manipulation_actions::AttachSimpleGeometryRequest::BASE)
   {
@@ -122,6 +250,7 @@ bool CollisionSceneManager::attachSimpleGeometry(manipulation_actions::AttachSim
     bool collision = false;
     do
     {
+      collision = false;
       for (unsigned int i = 0; i < base_attached_objects.size(); i ++)
       {
         if (ss.str() == base_attached_objects[i])
@@ -132,33 +261,24 @@ bool CollisionSceneManager::attachSimpleGeometry(manipulation_actions::AttachSim
       }
     } while (collision);
     obj.id = ss.str();
-    base_attached_objects.push_back(obj.id);
   }
 
-  // add object to collision scene
-  vector<moveit_msgs::CollisionObject> objs;
-  objs.push_back(obj);
-
-  planning_scene_interface->addCollisionObjects(objs);
-
-  // give this time to propagate
-  ros::Duration(0.25).sleep();
-
+  // add the object to the collision scene already attached
+  vector<manipulation_actions::SceneOperation> operations(1);
+  operations[0].operation = manipulation_actions::SceneOperation::ATTACH;
+  operations[0].object = obj;
   if (req.location == manipulation_actions::AttachSimpleGeometryRequest::END_EFFECTOR)
   {
-    if (req.use_touch_links)
-    {
-      arm_group->attachObject(obj.id, arm_group->getEndEffectorLink(), touch_links);
-    }
-    else
-    {
-      arm_group->attachObject(obj.id, arm_group->getEndEffectorLink());
-    }
+    operations[0].use_touch_links = req.use_touch_links;
+    if (!applyOperations(operations))
+      return false;
     ROS_INFO("Attached object %s to gripper", obj.id.c_str());
   }
   else if (req.location == manipulation_actions::AttachSimpleGeometryRequest::BASE)
   {
-    arm_group->attachObject(obj.id, "base_link");
+    operations[0].link = "base_link";
+    if (!applyOperations(operations))
+      return false;
     ROS_INFO("Attached object %s to base_link", obj.id.c_str());
   }
 
@@ -173,25 +293,25 @@ bool CollisionSceneManager::clearAll(std_srvs::Empty::Request &req, std_srvs::Em
 
 void CollisionSceneManager::clearUnattachedObjects()
 {
-  unattached_objects.clear();  //clear list of unattached scene object names
   vector<string> previous_objects = planning_scene_interface->getKnownObjectNames();
-  if (!attached_objects.empty())
+  vector<manipulation_actions::SceneOperation> operations;
+  for (size_t i = 0; i < previous_objects.size(); i ++)
   {
-    //don't remove the attached object
-    for (int i = 0; i < previous_objects.size(); i ++)
-    {
-      for (size_t j = 0; j < attached_objects.size(); j ++)
-      {
-        if (previous_objects[i] == attached_objects[j])
-        {
-          previous_objects.erase(previous_objects.begin() + i);
-          i --;
-          break;
-        }
-      }
-    }
+    //don't remove the attached objects
+    if (std::find(attached_objects.begin(), attached_objects.end(), previous_objects[i]) != attached_objects.end()
+        || std::find(base_attached_objects.begin(), base_attached_objects.end(), previous_objects[i])
+            != base_attached_objects.end())
+      continue;
+
+    manipulation_actions::SceneOperation op;
+    op.operation = manipulation_actions::SceneOperation::REMOVE;
+    op.object.id = previous_objects[i];
+    operations.push_back(op);
+  }
+  if (applyOperations(operations))
+  {
+    unattached_objects.clear();  //clear list of unattached scene object names
   }
-  planning_scene_interface->removeCollisionObjects(previous_objects);
 }
 
 moveit_msgs::CollisionObject CollisionSceneManager::collisionFromSegmentedObject(
@@ -215,15 +335,25 @@ moveit_msgs::CollisionObject CollisionSceneManager::collisionFromSegmentedObject
   obj.id = ss.str();
 
 
-  //set object shape
-  shape_msgs::SolidPrimitive bounding_volume;
-  bounding_volume.type = shape_msgs::SolidPrimitive::BOX;
-  bounding_volume.dimensions.resize(3);
-  bounding_volume.dimensions[shape_msgs::SolidPrimitive::BOX_X] = msg.bounding_volume.dimensions.x;
-  bounding_volume.dimensions[shape_msgs::SolidPrimitive::BOX_Y] = msg.bounding_volume.dimensions.y;
-  bounding_volume.dimensions[shape_msgs::SolidPrimitive::BOX_Z] = msg.bounding_volume.dimensions.z;
-  obj.primitives.push_back(bounding_volume);
-  obj.primitive_poses.push_back(msg.bounding_volume.pose.pose);
+  //set object shape, falling back to the bounding volume for flat or sparse clouds
+  shape_msgs::Mesh hull;
+  geometry_msgs::Pose hull_pose;
+  if (use_convex_hulls && hull_generator.generate(msg.point_cloud, hull, hull_pose))
+  {
+    obj.meshes.push_back(hull);
+    obj.mesh_poses.push_back(hull_pose);
+  }
+  else
+  {
+    shape_msgs::SolidPrimitive bounding_volume;
+    bounding_volume.type = shape_msgs::SolidPrimitive::BOX;
+    bounding_volume.dimensions.resize(3);
+    bounding_volume.dimensions[shape_msgs::SolidPrimitive::BOX_X] = msg.bounding_volume.dimensions.x;
+    bounding_volume.dimensions[shape_msgs::SolidPrimitive::BOX_Y] = msg.bounding_volume.dimensions.y;
+    bounding_volume.dimensions[shape_msgs::SolidPrimitive::BOX_Z] = msg.bounding_volume.dimensions.z;
+    obj.primitives.push_back(bounding_volume);
+    obj.primitive_poses.push_back(msg.bounding_volume.pose.pose);
+  }
   obj.operation = moveit_msgs::CollisionObject::ADD;
 
   return obj;
@@ -232,125 +362,95 @@ moveit_msgs::CollisionObject CollisionSceneManager::collisionFromSegmentedObject
 bool CollisionSceneManager::attachGripper(manipulation_actions::AttachToBase::Request &req,
     manipulation_actions::AttachToBase::Response &res)
 {
-  vector<moveit_msgs::CollisionObject> objs;
-  moveit_msgs::CollisionObject obj = collisionFromSegmentedObject(req.segmented_object, "_gripper");
-  attached_objects.push_back(obj.id);
-  objs.push_back(obj);
-
-  planning_scene_interface->addCollisionObjects(objs);
-
-  // give this time to propagate
-  ros::Duration(0.25).sleep();
+  vector<manipulation_actions::SceneOperation> operations(1);
+  operations[0].operation = manipulation_actions::SceneOperation::ATTACH;
+  operations[0].object = collisionFromSegmentedObject(req.segmented_object, "_gripper");
+  operations[0].use_touch_links = true;
 
   ROS_INFO("Attaching object to end-effector link of the robot.");
 
-  arm_group->attachObject(obj.id, arm_group->getEndEffectorLink(), touch_links);
-
-  return true;
+  return applyOperations(operations);
 }
 
 bool CollisionSceneManager::attachBase(manipulation_actions::AttachToBase::Request &req,
     manipulation_actions::AttachToBase::Response &res)
 {
-  vector<moveit_msgs::CollisionObject> objs;
-  moveit_msgs::CollisionObject obj = collisionFromSegmentedObject(req.segmented_object, "_base");
-  base_attached_objects.push_back(obj.id);
-  objs.push_back(obj);
+  vector<manipulation_actions::SceneOperation> operations(1);
+  operations[0].operation = manipulation_actions::SceneOperation::ATTACH;
+  operations[0].object = collisionFromSegmentedObject(req.segmented_object, "_base");
+  operations[0].link = "base_link";
 
-  planning_scene_interface->addCollisionObjects(objs);
+  ROS_INFO("Attaching object %s to base link of the robot.", operations[0].object.id.c_str());
 
-  // give this time to propagate
-  ros::Duration(0.25).sleep();
-
-
-  ROS_INFO("Attaching object %s to base link of the robot.", obj.id.c_str());
-  arm_group->attachObject(obj.id, "base_link");
-
-  return true;
+  return applyOperations(operations);
 }
 
 bool CollisionSceneManager::detachBase(std_srvs::Empty::Request &req, std_srvs::Empty::Response &res)
 {
+  vector<manipulation_actions::SceneOperation> operations(base_attached_objects.size());
   for (size_t i = 0; i < base_attached_objects.size(); i ++)
   {
-    arm_group->detachObject(base_attached_objects[i]);
+    operations[i].operation = manipulation_actions::SceneOperation::REMOVE;
+    operations[i].object.id = base_attached_objects[i];
   }
-  planning_scene_interface->removeCollisionObjects(base_attached_objects);
-  base_attached_objects.clear();
 
-  return true;
+  return applyOperations(operations);
 }
 
 bool CollisionSceneManager::detachListFromBase(manipulation_actions::DetachFromBase::Request &req,
     manipulation_actions::DetachFromBase::Response &res)
 {
-  vector<string> remove_objects;
+  vector<manipulation_actions::SceneOperation> operations;
   bool all_found = true;
   for (size_t i = 0; i < req.object_names.size(); i ++)
   {
-    bool found = false;
-    for (size_t j = 0; j < base_attached_objects.size(); j ++)
+    bool found = std::find(base_attached_objects.begin(), base_attached_objects.end(), req.object_names[i])
+        != base_attached_objects.end();
+    if (found)
     {
-      if (req.object_names[i] == base_attached_objects[j])
-      {
-        found = true;
-        base_attached_objects.erase(base_attached_objects.begin() + j);
-        remove_objects.push_back(req.object_names[i]);
-        arm_group->detachObject(req.object_names[i]);
-	ros::Duration(0.5).sleep();
-        break;
-      }
+      manipulation_actions::SceneOperation op;
+      op.operation = manipulation_actions::SceneOperation::REMOVE;
+      op.object.id = req.object_names[i];
+      operations.push_back(op);
     }
-    if (!found)
+    else
     {
       ROS_INFO("Could not find collision object with name %s in planning scene!", req.object_names[i].c_str());
     }
     all_found = all_found && found;
   }
 
-  ros::Duration(0.5).sleep();
-
-  if (!remove_objects.empty())
-  {
-    planning_scene_interface->removeCollisionObjects(remove_objects);
-  }
-
-  ros::Duration(0.5).sleep();
-
-  res.result = all_found;
+  res.result = applyOperations(operations) && all_found;
   return true;
 }
 
 bool CollisionSceneManager::reattachHeldToBase(std_srvs::Empty::Request &req, std_srvs::Empty::Response &res)
 {
   // Iterate through the objects that are attached to the arm and attach them
-  // to the base instead
-  for (int i = 0; i < attached_objects.size(); i ++)
+  // to the base instead (attaching detaches them from the arm first)
+  vector<manipulation_actions::SceneOperation> operations(attached_objects.size());
+  for (size_t i = 0; i < attached_objects.size(); i ++)
   {
-    arm_group->detachObject(attached_objects[i]);
-
-    base_attached_objects.push_back(attached_objects[i]);
-    arm_group->attachObject(attached_objects[i], "base_link");
+    operations[i].operation = manipulation_actions::SceneOperation::ATTACH;
+    operations[i].object.id = attached_objects[i];
+    operations[i].link = "base_link";
 
     ROS_INFO_STREAM("Scene object " << attached_objects[i] << " detached from the arm and added to base");
   }
 
-  // Clear out the attached arm objects
-  attached_objects.clear();
-
-  return true;
+  return applyOperations(operations);
 }
 
 bool CollisionSceneManager::detachAllObjects(std_srvs::Empty::Request &req, std_srvs::Empty::Response &res)
 {
-  for (int i = 0; i < attached_objects.size(); i ++)
+  vector<manipulation_actions::SceneOperation> operations(attached_objects.size());
+  for (size_t i = 0; i < attached_objects.size(); i ++)
   {
-    arm_group->detachObject(attached_objects[i]);
+    operations[i].operation = manipulation_actions::SceneOperation::REMOVE;
+    operations[i].object.id = attached_objects[i];
   }
-  planning_scene_interface->removeCollisionObjects(attached_objects);
-  attached_objects.clear();
 
-  return true;
+  return applyOperations(operations);
 }
 
 bool CollisionSceneManager::attachArbitraryObject(manipulation_actions::AttachArbitraryObject::Request &req,
@@ -439,80 +539,50 @@ bool CollisionSceneManager::attachArbitraryObject(manipulation_actions::AttachAr
   }
   collision_objects[0].id = obj_name.str();
   collision_objects[0].primitives.push_back(shape);
-  planning_scene_interface->addCollisionObjects(collision_objects);
-
-  ros::Duration(0.5).sleep();
 
-  arm_group->attachObject(obj_name.str(), "gripper_link", touch_links);
-  attached_objects.push_back(obj_name.str());
+  vector<manipulation_actions::SceneOperation> operations(1);
+  operations[0].operation = manipulation_actions::SceneOperation::ATTACH;
+  operations[0].object = collision_objects[0];
+  operations[0].link = "gripper_link";
+  operations[0].use_touch_links = true;
 
-  return true;
+  return applyOperations(operations);
 }
 
 bool  CollisionSceneManager::toggleGripperCollisions(manipulation_actions::ToggleGripperCollisions::Request &req,
     manipulation_actions::ToggleGripperCollisions::Response &res)
 {
-  // Get the planning scene
-  moveit_msgs::GetPlanningScene planning_scene_srv;
-  planning_scene_srv.request.components.components = moveit_msgs::PlanningSceneComponents::ALLOWED_COLLISION_MATRIX;
-
-  // Set the gripper link names
-  std::vector<string> gripper_names;
-  gripper_names.emplace_back("gripper_link");
-  gripper_names.emplace_back("l_gripper_finger_link");
-  gripper_names.emplace_back("r_gripper_finger_link");
+  if (req.object_name == manipulation_actions::ToggleGripperCollisions::Request::ALL_OBJECTS_NAME)
+  {
+    ROS_INFO("Enabling collisions between gripper and all objects");
+  }
 
-  if (!planning_scene_client.call(planning_scene_srv))
+  // Determine the list of objects to allow collisions with based on the request
+  std::vector<string> collision_objects;
+  if (req.object_name == manipulation_actions::ToggleGripperCollisions::Request::OCTOMAP_NAME)
   {
-    ROS_WARN("Could not get the current planning scene! Not updating gripper collisions...");
-    return false;
+    collision_objects.emplace_back("<octomap>");
+  }
+  else if (req.object_name == manipulation_actions::ToggleGripperCollisions::Request::ALL_OBJECTS_NAME)
+  {
+    collision_objects = planning_scene_interface->getKnownObjectNames();
   }
   else
   {
-    // Get the collision matrix
-    collision_detection::AllowedCollisionMatrix acm(planning_scene_srv.response.scene.allowed_collision_matrix);
-
-    if (req.object_name == manipulation_actions::ToggleGripperCollisions::Request::ALL_OBJECTS_NAME)
-    {
-      ROS_INFO("Enabling collisions between gripper and all objects");
-    }
-
-    // Determine the list of objects to allow collisions with based on the request
-    std::vector<string> collision_objects;
-    if (req.object_name == manipulation_actions::ToggleGripperCollisions::Request::OCTOMAP_NAME)
-    {
-      collision_objects.emplace_back("<octomap>");
-    }
-    else
-    {
-      std::vector<string> known_objects = planning_scene_interface->getKnownObjectNames();
-      for (size_t i = 0; i < known_objects.size(); i++)
-      {
-        if (known_objects[i] == req.object_name
-            || req.object_name == manipulation_actions::ToggleGripperCollisions::Request::ALL_OBJECTS_NAME)
-        {
-          collision_objects.emplace_back(known_objects[i]);
-        }
-      }
-    }
-
-    // Set the ACM to the state dictated by the request
-    for (size_t i = 0; i < collision_objects.size(); i++)
-    {
-      ROS_INFO("Collision enabled for %s", collision_objects[i].c_str());
-      acm.setEntry(collision_objects[i], gripper_names, req.enable_collisions);
-    }
-
-    // Send out the planning scene update
-    moveit_msgs::PlanningScene planning_scene_update;
-    acm.getMessage(planning_scene_update.allowed_collision_matrix);
-    planning_scene_update.is_diff = true;
-    planning_scene_publisher.publish(planning_scene_update);
+    collision_objects.emplace_back(req.object_name);
+  }
 
-    // Sleep for the publish to go through
-    ros::Duration(0.5).sleep();
-    return true;
+  // Set the mirrored ACM to the state dictated by the request, which is in effect once this returns
+  if (!acm_manager->setEntries(collision_objects, gripper_names, req.enable_collisions))
+  {
+    ROS_WARN("Could not update the gripper collisions in the planning scene!");
+    return false;
+  }
+  for (size_t i = 0; i < collision_objects.size(); i++)
+  {
+    ROS_INFO("Collision enabled for %s", collision_objects[i].c_str());
   }
+  return true;
 }
 
 
@@ -0,0 +1,189 @@
+#include <manipulation_actions/ConvexHullGenerator.h>
+
+// Eigen
+#include <Eigen/Geometry>
+
+// PCL
+#include <pcl/filters/voxel_grid.h>
+#include <pcl/surface/convex_hull.h>
+
+// C++
+#include <algorithm>
+#include <limits>
+
+using std::vector;
+
+const int ConvexHullGenerator::DEFAULT_MAX_TRIANGLES;
+const double ConvexHullGenerator::DEFAULT_LEAF_SIZE;
+
+ConvexHullGenerator::ConvexHullGenerator(int max_triangles, double leaf_size) :
+    max_triangles(std::max(4, max_triangles)),
+    leaf_size(leaf_size)
+{
+}
+
+bool ConvexHullGenerator::generate(const sensor_msgs::PointCloud2 &cloud, shape_msgs::Mesh &mesh,
+    geometry_msgs::Pose &pose) const
+{
+  pcl::PointCloud<pcl::PointXYZ>::Ptr pcl_cloud(new pcl::PointCloud<pcl::PointXYZ>);
+  pcl::fromROSMsg(cloud, *pcl_cloud);
+  return generate(pcl_cloud, mesh, pose);
+}
+
+bool ConvexHullGenerator::generate(const pcl::PointCloud<pcl::PointXYZ>::ConstPtr &cloud, shape_msgs::Mesh &mesh,
+    geometry_msgs::Pose &pose) const
+{
+  pcl::PointCloud<pcl::PointXYZ>::Ptr filtered(new pcl::PointCloud<pcl::PointXYZ>);
+  if (leaf_size > 0)
+  {
+    pcl::VoxelGrid<pcl::PointXYZ> voxel_grid;
+    voxel_grid.setInputCloud(cloud);
+    voxel_grid.setLeafSize(leaf_size, leaf_size, leaf_size);
+    voxel_grid.filter(*filtered);
+  }
+  else
+  {
+    *filtered = *cloud;
+  }
+  if (filtered->size() < 4)
+    return false;
+
+  pcl::PointCloud<pcl::PointXYZ>::Ptr full_vertices(new pcl::PointCloud<pcl::PointXYZ>);
+  vector<pcl::Vertices> triangles;
+  if (!hull(filtered, *full_vertices, triangles))
+    return false;
+
+  // thin the hull until it fits the triangle budget
+  pcl::PointCloud<pcl::PointXYZ> vertices = *full_vertices;
+  size_t vertex_count = max_triangles / 2 + 2;
+  while (triangles.size() > static_cast<size_t>(max_triangles) && vertex_count >= 4)
+  {
+    pcl::PointCloud<pcl::PointXYZ>::Ptr thinned = farthestPoints(*full_vertices, vertex_count);
+    if (!hull(thinned, vertices, triangles))
+      return false;
+    vertex_count --;
+  }
+  if (triangles.size() > static_cast<size_t>(max_triangles))
+    return false;
+
+  Eigen::Vector3f centroid = Eigen::Vector3f::Zero();
+  for (size_t i = 0; i < vertices.size(); i ++)
+  {
+    centroid += vertices[i].getVector3fMap();
+  }
+  centroid /= vertices.size();
+
+  // outward face normals and offsets from the centroid, used to grow a thinned hull back over the full one
+  float scale = 1.0;
+  for (size_t i = 0; i < triangles.size(); i ++)
+  {
+    Eigen::Vector3f v0 = vertices[triangles[i].vertices[0]].getVector3fMap() - centroid;
+    Eigen::Vector3f v1 = vertices[triangles[i].vertices[1]].getVector3fMap() - centroid;
+    Eigen::Vector3f v2 = vertices[triangles[i].vertices[2]].getVector3fMap() - centroid;
+    Eigen::Vector3f normal = (v1 - v0).cross(v2 - v0);
+    if (normal.norm() < std::numeric_limits<float>::epsilon())
+      continue;
+    normal.normalize();
+    float offset = normal.dot(v0);
+    if (offset < 0)
+    {
+      normal = -normal;
+      offset = -offset;
+      std::swap(triangles[i].vertices[1], triangles[i].vertices[2]);
+    }
+    if (offset < std::numeric_limits<float>::epsilon() || vertices.size() == full_vertices->size())
+      continue;
+
+    for (size_t j = 0; j < full_vertices->size(); j ++)
+    {
+      scale = std::max(scale, normal.dot(full_vertices->points[j].getVector3fMap() - centroid) / offset);
+    }
+  }
+
+  pose.position.x = centroid.x();
+  pose.position.y = centroid.y();
+  pose.position.z = centroid.z();
+  pose.orientation.x = 0;
+  pose.orientation.y = 0;
+  pose.orientation.z = 0;
+  pose.orientation.w = 1;
+
+  mesh.vertices.resize(vertices.size());
+  for (size_t i = 0; i < vertices.size(); i ++)
+  {
+    Eigen::Vector3f vertex = scale*(vertices[i].getVector3fMap() - centroid);
+    mesh.vertices[i].x = vertex.x();
+    mesh.vertices[i].y = vertex.y();
+    mesh.vertices[i].z = vertex.z();
+  }
+  mesh.triangles.resize(triangles.size());
+  for (size_t i = 0; i < triangles.size(); i ++)
+  {
+    for (size_t j = 0; j < 3; j ++)
+    {
+      mesh.triangles[i].vertex_indices[j] = triangles[i].vertices[j];
+    }
+  }
+
+  return true;
+}
+
+pcl::PointCloud<pcl::PointXYZ>::Ptr ConvexHullGenerator::farthestPoints(const pcl::PointCloud<pcl::PointXYZ> &points,
+    size_t count)
+{
+  pcl::PointCloud<pcl::PointXYZ>::Ptr selected(new pcl::PointCloud<pcl::PointXYZ>);
+  if (points.empty())
+    return selected;
+
+  // start from the point farthest from the mean, so the first pick is an extreme of the hull
+  Eigen::Vector3f mean = Eigen::Vector3f::Zero();
+  for (size_t i = 0; i < points.size(); i ++)
+  {
+    mean += points[i].getVector3fMap();
+  }
+  mean /= points.size();
+
+  vector<float> distances(points.size());
+  size_t next = 0;
+  for (size_t i = 0; i < points.size(); i ++)
+  {
+    distances[i] = (points[i].getVector3fMap() - mean).squaredNorm();
+    if (distances[i] > distances[next])
+      next = i;
+  }
+  std::fill(distances.begin(), distances.end(), std::numeric_limits<float>::max());
+
+  while (selected->size() < std::min(count, points.size()))
+  {
+    selected->push_back(points[next]);
+    size_t farthest = next;
+    for (size_t i = 0; i < points.size(); i ++)
+    {
+      distances[i] = std::min(distances[i], (points[i].getVector3fMap() - points[next].getVector3fMap()).squaredNorm());
+      if (distances[i] > distances[farthest])
+        farthest = i;
+    }
+    next = farthest;
+  }
+
+  return selected;
+}
+
+bool ConvexHullGenerator::hull(const pcl::PointCloud<pcl::PointXYZ>::ConstPtr &points,
+    pcl::PointCloud<pcl::PointXYZ> &vertices, vector<pcl::Vertices> &triangles)
+{
+  pcl::ConvexHull<pcl::PointXYZ> convex_hull;
+  convex_hull.setInputCloud(points);
+  convex_hull.setDimension(3);
+  convex_hull.reconstruct(vertices, triangles);
+
+  // qhull reports degenerate (flat) input by returning nothing
+  if (triangles.empty() || vertices.size() < 4)
+    return false;
+  for (size_t i = 0; i < triangles.size(); i ++)
+  {
+    if (triangles[i].vertices.size() != 3)
+      return false;
+  }
+  return true;
+}
@@ -18,17 +18,28 @@ KitManipulator::KitManipulator() :
     kit_place_server(pnh, "place_kit_base", boost::bind(&KitManipulator::executeKitPlace, this, _1), false),
     kit_base_pick_server(pnh, "pick_kit_base", boost::bind(&KitManipulator::executeKitBasePick, this, _1), false)
 {
-  int pose_attempts;
+  int pose_attempts, race_candidates;
   pnh.param<double>("low_place_height", low_place_height, 0.13);
   pnh.param<double>("high_place_height", high_place_height, 0.2);
   pnh.param<int>("store_pose_attempts", pose_attempts, 10);
+  pnh.param<int>("store_race_candidates", race_candidates, 4);
   pnh.param<bool>("add_object", attach_arbitrary_object, false);
   pnh.param("plan_final_execution", plan_mode, false);
   pnh.param<bool>("debug", debug, true);
   pnh.param<bool>("pause_for_verification", pause_for_verification, false);
   pnh.param<double>("gripper_closed_value", gripper_closed_value, 0.005);
+  pnh.param<double>("reachability_weight", reachability_weight, 0.5);
+
+  string reachability_map_file;
+  pnh.param<string>("reachability_map", reachability_map_file, "");
+  if (!reachability_map_file.empty() && !reachability_map.load(reachability_map_file))
+  {
+    ROS_WARN("Could not load reachability map %s, place candidates will not be ordered by reachability.",
+             reachability_map_file.c_str());
+  }
 
   store_pose_attempts = static_cast<size_t>(pose_attempts);
+  store_race_candidates = static_cast<size_t>(std::max(1, race_candidates));
 
   object_place_pose_debug = pnh.advertise<geometry_msgs::PoseStamped>("object_place_debug", 1);
   place_pose_bin_debug = pnh.advertise<geometry_msgs::PoseStamped>("place_bin_debug", 1);
@@ -49,6 +60,8 @@ KitManipulator::KitManipulator() :
 
   planning_scene_interface = new moveit::planning_interface::PlanningSceneInterface();
 
+  planner = new ParallelPlanner(pnh);
+
   initPickPoses();
 
   store_object_server.start();
@@ -152,12 +165,27 @@ void KitManipulator::executeKitPick(const manipulation_actions::KitManipGoalCons
     kit_approach_pose.pose.orientation = kit_goal_pose.pose.orientation;
 
     // plan and move to approach pose
-    arm_group->setPlannerId("arm[RRTConnectkConfigDefault]");
-    arm_group->setPlanningTime(1.5);
-    arm_group->setStartStateToCurrentState();
-    arm_group->setPoseTarget(kit_approach_pose, "wrist_roll_link");
+    moveit_msgs::MoveItErrorCodes error_code;
+    if (planner->isReady())
+    {
+      stringstream goal_id;
+      goal_id << "kit_pick_approach_" << i;
+      moveit::planning_interface::MoveGroupInterface::Plan approach_plan;
+      error_code = planner->plan(kit_approach_pose, "wrist_roll_link", approach_plan, 1.5, 1.0, goal_id.str());
+      if (error_code.val == moveit_msgs::MoveItErrorCodes::SUCCESS)
+      {
+        error_code = arm_group->execute(approach_plan);
+      }
+    }
+    else
+    {
+      arm_group->setPlannerId("arm[RRTConnectkConfigDefault]");
+      arm_group->setPlanningTime(1.5);
+      arm_group->setStartStateToCurrentState();
+      arm_group->setPoseTarget(kit_approach_pose, "wrist_roll_link");
 
-    moveit_msgs::MoveItErrorCodes error_code = arm_group->move();
+      error_code = arm_group->move();
+    }
     if (error_code.val == moveit_msgs::MoveItErrorCodes::PREEMPTED)
     {
       ROS_INFO("Preempted while moving to approach pose. Will try again");
@@ -436,8 +464,6 @@ void KitManipulator::executeKitPick(const manipulation_actions::KitManipGoalCons
     kit_pick_server.setAborted(result);
     }*/
 
-  ros::Duration(2.0).sleep();  // let MoveIt! catch up after adding collision objects (this can be very slow)
-
   // linear move up
   manipulation_actions::LinearMoveGoal raise_goal;
   geometry_msgs::TransformStamped current_gripper_pose = tf_buffer.lookupTransform("base_link", "gripper_link",
@@ -528,8 +554,6 @@ void KitManipulator::executeKitPlace(const manipulation_actions::KitManipGoalCon
     ROS_INFO("Could not call moveit collision scene manager service!");
   }
 
-  ros::Duration(1.0).sleep();
-
   // attach right kit to base object
   manipulation_actions::AttachSimpleGeometry collision;
   collision.request.name = "kit_base";
@@ -960,12 +984,56 @@ void KitManipulator::executeStore(const manipulation_actions::StoreObjectGoalCon
   // execute best executable pose
   geometry_msgs::TransformStamped bin_to_base = tf_buffer.lookupTransform("base_link", "kit_frame",
                                                                           ros::Time(0), ros::Duration(1.0));
+  double torso_height = 0;
+  if (reachability_map.isLoaded())
+  {
+    robot_state::RobotStatePtr current_state = arm_group->getCurrentState();
+    if (current_state)
+    {
+      torso_height = current_state->getVariablePosition("torso_lift_joint");
+    }
+  }
   bool execution_failed = true;
   double lower_height = low_place_height;
   for (size_t attempt = 0; attempt < 2; attempt++)
   {
-    int attempts = 0;
+    // candidates at this height in base_link, reordered so that the arm most likely reaches the first ones
+    vector<ScoredPose> base_place_poses;
     for (size_t i = 0; i < sorted_place_poses.size(); i++)
+    {
+      ScoredPose candidate = sorted_place_poses[i];
+      tf2::doTransform(sorted_place_poses[i].pose, candidate.pose, bin_to_base);
+      candidate.pose.header.frame_id = "base_link";
+      candidate.pose.pose.position.z += attempt * (high_place_height - low_place_height);
+
+      // filtering kinematically infeasible grasps
+      if (candidate.pose.pose.position.x < 0 || candidate.pose.pose.position.z < 0.457)
+      {
+        continue;
+      }
+
+      if (reachability_map.isLoaded())
+      {
+        // poses the map never reached are kept, but only tried after every reached one (scores are below 2 pi)
+        double reachability = reachability_map.getScore(candidate.pose.pose, torso_height);
+        if (reachability > 0)
+        {
+          candidate.score += reachability_weight * (1 - reachability);
+        }
+        else
+        {
+          candidate.score += 2 * M_PI;
+        }
+      }
+      base_place_poses.push_back(candidate);
+    }
+    std::stable_sort(base_place_poses.begin(), base_place_poses.end());
+
+    // candidates are removed from the front as they are tried
+    size_t attempts = 0;
+    stringstream store_goal_id;
+    store_goal_id << "store_" << static_cast<int>(goal->challenge_object.object) << "_" << attempt;
+    while (!base_place_poses.empty())
     {
       if (store_object_server.isPreemptRequested())
       {
@@ -975,17 +1043,36 @@ void KitManipulator::executeStore(const manipulation_actions::StoreObjectGoalCon
         return;
       }
 
-      place_pose_base.header.frame_id = "base_link";
-      tf2::doTransform(sorted_place_poses[i].pose, place_pose_base, bin_to_base);
-      place_pose_base.header.frame_id = "base_link";
-      place_pose_base.pose.position.z += attempt * (high_place_height - low_place_height);
-
-      // filtering kinematically infeasible grasps
-      if (place_pose_base.pose.position.x < 0 || place_pose_base.pose.position.z < 0.457)
+      size_t candidate = 0;
+      moveit::planning_interface::MoveGroupInterface::Plan place_plan;
+      if (planner->isReady())
       {
-        continue;
+        // plan to the best few candidates at once, losing candidates stay in the queue
+        vector<geometry_msgs::PoseStamped> race_poses;
+        for (size_t i = 0; i < base_place_poses.size() && race_poses.size() < store_race_candidates; i++)
+        {
+          race_poses.push_back(base_place_poses[i].pose);
+        }
+        ROS_INFO("Planning to the next %lu place poses...", race_poses.size());
+        moveit::planning_interface::MoveItErrorCode plan_result = planner->plan(race_poses,
+            arm_group->getEndEffectorLink(), place_plan, 1.5, 1.0, &candidate, store_goal_id.str());
+        if (plan_result.val != moveit_msgs::MoveItErrorCodes::SUCCESS)
+        {
+          ROS_WARN("Could not plan to any of the %lu place poses, MoveIt! error code: %d", race_poses.size(),
+                   plan_result.val);
+          base_place_poses.erase(base_place_poses.begin(), base_place_poses.begin() + race_poses.size());
+          attempts += race_poses.size();
+          if (attempts > store_pose_attempts)
+          {
+            break;
+          }
+          continue;
+        }
       }
 
+      place_pose_base = base_place_poses[candidate].pose;
+      base_place_poses.erase(base_place_poses.begin() + candidate);
+
       attempts ++;
 
       if (debug)
@@ -994,12 +1081,20 @@ void KitManipulator::executeStore(const manipulation_actions::StoreObjectGoalCon
       }
 
       ROS_INFO("Moving to place pose...");
-      arm_group->setPlannerId("arm[RRTConnectkConfigDefault]");
-      arm_group->setPlanningTime(1.5);
-      arm_group->setStartStateToCurrentState();
-      arm_group->setPoseTarget(place_pose_base);
+      moveit::planning_interface::MoveItErrorCode move_result;
+      if (planner->isReady())
+      {
+        move_result = arm_group->execute(place_plan);
+      }
+      else
+      {
+        arm_group->setPlannerId("arm[RRTConnectkConfigDefault]");
+        arm_group->setPlanningTime(1.5);
+        arm_group->setStartStateToCurrentState();
+        arm_group->setPoseTarget(place_pose_base);
 
-      moveit::planning_interface::MoveItErrorCode move_result = arm_group->move();
+        move_result = arm_group->move();
+      }
       std::cout << "MoveIt! error code: " << move_result.val << std::endl;
       if (move_result.val == moveit_msgs::MoveItErrorCodes::SUCCESS)
       {
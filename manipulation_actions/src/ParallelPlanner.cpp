@@ -0,0 +1,427 @@
+#include <manipulation_actions/ParallelPlanner.h>
+
+// Boost
+#include <boost/thread/thread.hpp>
+
+// C++
+#include <algorithm>
+#include <limits>
+
+// ROS
+#include <moveit/kinematic_constraints/kinematic_constraint.h>
+#include <moveit/kinematic_constraints/utils.h>
+#include <moveit/robot_state/conversions.h>
+#include <moveit/trajectory_processing/iterative_time_parameterization.h>
+
+using std::string;
+using std::vector;
+
+const double ParallelPlanner::DEFAULT_RACE_WINDOW;
+const int ParallelPlanner::DEFAULT_SEEDS;
+const int ParallelPlanner::DEFAULT_MAX_REQUESTS;
+
+ParallelPlanner::ParallelPlanner(ros::NodeHandle &pnh, const string &group_name) :
+    group_name(group_name)
+{
+  vector<string> default_planners;
+  default_planners.push_back("RRTConnectkConfigDefault");
+  default_planners.push_back("BKPIECEkConfigDefault");
+  string planner_namespace;
+  double cache_resolution;
+  int cache_capacity;
+  int shortcut_iterations;
+  int smoothing_passes;
+  double check_resolution;
+  pnh.param<vector<string> >("race_planners", planner_ids, default_planners);
+  pnh.param<int>("race_seeds", seeds, DEFAULT_SEEDS);
+  pnh.param<int>("race_max_requests", max_requests, DEFAULT_MAX_REQUESTS);
+  pnh.param<double>("race_window", race_window, DEFAULT_RACE_WINDOW);
+  pnh.param<string>("race_planner_namespace", planner_namespace, "/move_group");
+  pnh.param<bool>("use_trajectory_cache", use_trajectory_cache, true);
+  pnh.param<double>("trajectory_cache_resolution", cache_resolution, TrajectoryCache::DEFAULT_RESOLUTION);
+  pnh.param<int>("trajectory_cache_capacity", cache_capacity, TrajectoryCache::DEFAULT_CAPACITY);
+  pnh.param<bool>("post_process_plans", post_process_plans, true);
+  pnh.param<int>("shortcut_iterations", shortcut_iterations, PathPostProcessor::DEFAULT_SHORTCUT_ITERATIONS);
+  pnh.param<int>("smoothing_passes", smoothing_passes, PathPostProcessor::DEFAULT_SMOOTHING_PASSES);
+  pnh.param<double>("post_processing_check_resolution", check_resolution,
+      PathPostProcessor::DEFAULT_CHECK_RESOLUTION);
+  if (planner_ids.empty())
+  {
+    planner_ids = default_planners;
+  }
+  seeds = std::max(1, seeds);
+  max_requests = std::max(1, max_requests);
+  start_state.is_diff = true;
+  trajectory_cache = TrajectoryCache(cache_resolution, static_cast<size_t>(std::max(1, cache_capacity)));
+  post_processor = PathPostProcessor(shortcut_iterations, smoothing_passes, check_resolution);
+
+  robot_model_loader.reset(new robot_model_loader::RobotModelLoader("robot_description"));
+  robot_model::RobotModelConstPtr robot_model = robot_model_loader->getModel();
+  if (!robot_model || !robot_model->hasJointModelGroup(group_name))
+  {
+    ROS_WARN("Could not load group %s from the robot model, plans will not be raced.", group_name.c_str());
+    return;
+  }
+
+  // the same plugin and planner configurations move_group plans with
+  ros::NodeHandle planner_nh(planner_namespace);
+  string plugin_name;
+  planner_nh.param<string>("planning_plugin", plugin_name, "ompl_interface/OMPLPlanner");
+  try
+  {
+    planner_loader.reset(new pluginlib::ClassLoader<planning_interface::PlannerManager>("moveit_core",
+        "planning_interface::PlannerManager"));
+    planning_interface::PlannerManagerPtr manager = planner_loader->createUniqueInstance(plugin_name);
+    if (!manager->initialize(robot_model, planner_nh.getNamespace()))
+    {
+      ROS_WARN("Could not initialize planning plugin %s, plans will not be raced.", plugin_name.c_str());
+      return;
+    }
+    planner_manager = manager;
+  }
+  catch (pluginlib::PluginlibException &ex)
+  {
+    ROS_WARN("Could not load planning plugin %s, plans will not be raced: %s", plugin_name.c_str(), ex.what());
+    return;
+  }
+
+  planning_scene_monitor.reset(new planning_scene_monitor::PlanningSceneMonitor(robot_model_loader));
+}
+
+ParallelPlanner::~ParallelPlanner()
+{
+  // instances have to go before the loader unloads their library
+  planner_manager.reset();
+}
+
+void ParallelPlanner::setStartState(const moveit_msgs::RobotState &start_state)
+{
+  boost::mutex::scoped_lock race_lock(race_mutex);
+  this->start_state = start_state;
+}
+
+void ParallelPlanner::setStartStateToCurrentState()
+{
+  boost::mutex::scoped_lock race_lock(race_mutex);
+  start_state = moveit_msgs::RobotState();
+  start_state.is_diff = true;
+}
+
+moveit::planning_interface::MoveItErrorCode ParallelPlanner::plan(const vector<moveit_msgs::Constraints> &goals,
+    moveit::planning_interface::MoveGroupInterface::Plan &plan, double planning_time,
+    double max_velocity_scaling_factor, size_t *goal_index, const string &goal_id)
+{
+  if (!isReady() || goals.empty())
+    return moveit::planning_interface::MoveItErrorCode(moveit_msgs::MoveItErrorCodes::FAILURE);
+
+  boost::mutex::scoped_lock race_lock(race_mutex);
+  ros::WallTime start_time = ros::WallTime::now();
+
+  if (!planning_scene_monitor->requestPlanningSceneState())
+  {
+    ROS_WARN("Could not get the planning scene for the planner race.");
+    return moveit::planning_interface::MoveItErrorCode(moveit_msgs::MoveItErrorCodes::FAILURE);
+  }
+  planning_scene::PlanningSceneConstPtr scene;
+  {
+    planning_scene_monitor::LockedPlanningSceneRO locked_scene(planning_scene_monitor);
+    scene = locked_scene;
+  }
+
+  robot_state::RobotState start_robot_state(scene->getCurrentState());
+  moveit::core::robotStateMsgToRobotState(scene->getTransforms(), start_state, start_robot_state);
+  start_robot_state.update();
+
+  bool cached = use_trajectory_cache && !goal_id.empty();
+  vector<double> start;
+  if (cached)
+  {
+    start_robot_state.copyJointGroupPositions(group_name, start);
+    robot_trajectory::RobotTrajectoryConstPtr stored = trajectory_cache.lookup(goal_id, start);
+    if (stored)
+    {
+      size_t reached_goal;
+      robot_trajectory::RobotTrajectoryPtr reused = reuse(*stored, scene, start_robot_state, goals, reached_goal);
+      if (reused && toPlan(*reused, *scene, max_velocity_scaling_factor, true, plan))
+      {
+        plan.planning_time_ = (ros::WallTime::now() - start_time).toSec();
+        if (goal_index != NULL)
+        {
+          *goal_index = reached_goal;
+        }
+        ROS_INFO("Trajectory cache: reusing the path to %s (%.3f s).", goal_id.c_str(), plan.planning_time_);
+        return moveit::planning_interface::MoveItErrorCode(moveit_msgs::MoveItErrorCodes::SUCCESS);
+      }
+      ROS_INFO("Trajectory cache: the path to %s is no longer valid, replanning.", goal_id.c_str());
+      trajectory_cache.erase(goal_id, start);
+    }
+  }
+
+  // goals in ranked order, so the request limit cuts the worst goals first
+  Race race;
+  vector<size_t> request_goals;
+  vector<string> request_planners;
+  moveit_msgs::MoveItErrorCodes first_error;
+  first_error.val = moveit_msgs::MoveItErrorCodes::PLANNING_FAILED;
+  for (size_t i = 0; i < goals.size() && race.contexts.size() < static_cast<size_t>(max_requests); i ++)
+  {
+    for (int seed = 0; seed < seeds && race.contexts.size() < static_cast<size_t>(max_requests); seed ++)
+    {
+      for (size_t j = 0; j < planner_ids.size() && race.contexts.size() < static_cast<size_t>(max_requests); j ++)
+      {
+        planning_interface::MotionPlanRequest request;
+        request.group_name = group_name;
+        request.planner_id = planner_ids[j];
+        request.goal_constraints.push_back(goals[i]);
+        request.start_state = start_state;
+        request.num_planning_attempts = 1;
+        request.allowed_planning_time = planning_time;
+        request.max_velocity_scaling_factor = max_velocity_scaling_factor;
+
+        moveit_msgs::MoveItErrorCodes error_code;
+        planning_interface::PlanningContextPtr context = planner_manager->getPlanningContext(scene, request,
+            error_code);
+        if (!context)
+        {
+          if (race.contexts.empty() && i == 0)
+            first_error = error_code;
+          continue;
+        }
+        race.contexts.push_back(context);
+        request_goals.push_back(i);
+        request_planners.push_back(planner_ids[j]);
+      }
+    }
+  }
+  if (race.contexts.empty())
+    return moveit::planning_interface::MoveItErrorCode(first_error.val);
+
+  race.responses.resize(race.contexts.size());
+  boost::thread_group threads;
+  for (size_t i = 0; i < race.contexts.size(); i ++)
+  {
+    threads.create_thread(boost::bind(&ParallelPlanner::solve, this, &race, i));
+  }
+
+  {
+    boost::unique_lock<boost::mutex> lock(result_mutex);
+    while (race.finished < race.contexts.size() && !race.solved)
+    {
+      result_condition.wait(lock);
+    }
+    if (race.solved)
+    {
+      boost::system_time deadline = boost::get_system_time()
+          + boost::posix_time::microseconds(static_cast<int64_t>(race_window*1000000));
+      while (race.finished < race.contexts.size() && result_condition.timed_wait(lock, deadline)) {}
+    }
+  }
+  for (size_t i = 0; i < race.contexts.size(); i ++)
+  {
+    race.contexts[i]->terminate();
+  }
+  threads.join_all();
+
+  // shortest successful path, ties go to the better ranked goal
+  size_t best = race.contexts.size();
+  double best_length = std::numeric_limits<double>::max();
+  for (size_t i = 0; i < race.responses.size(); i ++)
+  {
+    const planning_interface::MotionPlanResponse &response = race.responses[i];
+    if (response.error_code_.val != moveit_msgs::MoveItErrorCodes::SUCCESS || !response.trajectory_
+        || response.trajectory_->empty())
+    {
+      continue;
+    }
+    double length = pathLength(*response.trajectory_);
+    if (length < best_length)
+    {
+      best = i;
+      best_length = length;
+    }
+  }
+
+  if (best == race.contexts.size())
+  {
+    ROS_INFO("Planner race: none of %lu requests solved (%.3f s).", race.contexts.size(),
+        (ros::WallTime::now() - start_time).toSec());
+    return moveit::planning_interface::MoveItErrorCode(race.responses[0].error_code_.val);
+  }
+
+  // post-processed in place, so the cache keeps the processed path
+  if (!toPlan(*race.responses[best].trajectory_, *scene, max_velocity_scaling_factor, false, plan))
+  {
+    ROS_WARN("Could not time parameterize the winning plan.");
+    return moveit::planning_interface::MoveItErrorCode(moveit_msgs::MoveItErrorCodes::FAILURE);
+  }
+  plan.planning_time_ = (ros::WallTime::now() - start_time).toSec();
+  if (cached)
+  {
+    trajectory_cache.store(goal_id, start, race.responses[best].trajectory_);
+  }
+  if (goal_index != NULL)
+  {
+    *goal_index = request_goals[best];
+  }
+
+  size_t solved = 0;
+  for (size_t i = 0; i < race.responses.size(); i ++)
+  {
+    if (race.responses[i].error_code_.val == moveit_msgs::MoveItErrorCodes::SUCCESS)
+      solved ++;
+  }
+  ROS_INFO("Planner race: %lu of %lu requests solved, goal %lu with %s won (%.3f s).", solved,
+      race.contexts.size(), request_goals[best], request_planners[best].c_str(), plan.planning_time_);
+
+  return moveit::planning_interface::MoveItErrorCode(moveit_msgs::MoveItErrorCodes::SUCCESS);
+}
+
+moveit::planning_interface::MoveItErrorCode ParallelPlanner::plan(const vector<geometry_msgs::PoseStamped> &poses,
+    const string &link, moveit::planning_interface::MoveGroupInterface::Plan &plan, double planning_time,
+    double max_velocity_scaling_factor, size_t *goal_index, const string &goal_id)
+{
+  vector<moveit_msgs::Constraints> goals(poses.size());
+  for (size_t i = 0; i < poses.size(); i ++)
+  {
+    goals[i] = poseGoal(poses[i], link);
+  }
+  return this->plan(goals, plan, planning_time, max_velocity_scaling_factor, goal_index, goal_id);
+}
+
+moveit::planning_interface::MoveItErrorCode ParallelPlanner::plan(const geometry_msgs::PoseStamped &pose,
+    const string &link, moveit::planning_interface::MoveGroupInterface::Plan &plan, double planning_time,
+    double max_velocity_scaling_factor, const string &goal_id)
+{
+  vector<moveit_msgs::Constraints> goals(1, poseGoal(pose, link));
+  return this->plan(goals, plan, planning_time, max_velocity_scaling_factor, NULL, goal_id);
+}
+
+moveit::planning_interface::MoveItErrorCode ParallelPlanner::plan(const sensor_msgs::JointState &joints,
+    moveit::planning_interface::MoveGroupInterface::Plan &plan, double planning_time,
+    double max_velocity_scaling_factor, const string &goal_id)
+{
+  if (!isReady())
+    return moveit::planning_interface::MoveItErrorCode(moveit_msgs::MoveItErrorCodes::FAILURE);
+
+  // only the group joints that are given are constrained
+  const robot_model::JointModelGroup *group = robot_model_loader->getModel()->getJointModelGroup(group_name);
+  vector<moveit_msgs::Constraints> goals(1);
+  for (size_t i = 0; i < joints.name.size() && i < joints.position.size(); i ++)
+  {
+    if (!group->hasJointModel(joints.name[i]))
+      continue;
+
+    // same default joint tolerance as MoveGroupInterface
+    moveit_msgs::JointConstraint joint_constraint;
+    joint_constraint.joint_name = joints.name[i];
+    joint_constraint.position = joints.position[i];
+    joint_constraint.tolerance_above = 1e-4;
+    joint_constraint.tolerance_below = 1e-4;
+    joint_constraint.weight = 1.0;
+    goals[0].joint_constraints.push_back(joint_constraint);
+  }
+  if (goals[0].joint_constraints.empty())
+    return moveit::planning_interface::MoveItErrorCode(moveit_msgs::MoveItErrorCodes::INVALID_GOAL_CONSTRAINTS);
+
+  return this->plan(goals, plan, planning_time, max_velocity_scaling_factor, NULL, goal_id);
+}
+
+moveit_msgs::Constraints ParallelPlanner::poseGoal(const geometry_msgs::PoseStamped &pose, const string &link)
+{
+  return kinematic_constraints::constructGoalConstraints(link, pose, 1e-4, 1e-3);
+}
+
+void ParallelPlanner::solve(Race *race, size_t index)
+{
+  planning_interface::MotionPlanResponse response;
+  race->contexts[index]->solve(response);
+
+  boost::mutex::scoped_lock lock(result_mutex);
+  race->responses[index] = response;
+  race->finished ++;
+  if (response.error_code_.val == moveit_msgs::MoveItErrorCodes::SUCCESS)
+  {
+    race->solved = true;
+  }
+  result_condition.notify_all();
+}
+
+robot_trajectory::RobotTrajectoryPtr ParallelPlanner::reuse(const robot_trajectory::RobotTrajectory &path,
+    const planning_scene::PlanningSceneConstPtr &scene, const robot_state::RobotState &start,
+    const vector<moveit_msgs::Constraints> &goals, size_t &goal_index) const
+{
+  if (path.empty())
+    return robot_trajectory::RobotTrajectoryPtr();
+
+  // only the group moves along the path, everything else (torso, attached objects) stays as it is at the start
+  const robot_model::JointModelGroup *group = start.getJointModelGroup(group_name);
+  robot_trajectory::RobotTrajectoryPtr trajectory(new robot_trajectory::RobotTrajectory(
+      start.getRobotModel(), group_name));
+  vector<double> previous, positions;
+  start.copyJointGroupPositions(group, previous);
+  robot_state::RobotState scratch(start);
+  for (size_t i = 0; i < path.getWayPointCount(); i ++)
+  {
+    robot_state::RobotStatePtr state(new robot_state::RobotState(start));
+    if (i > 0)
+    {
+      // the start may be anywhere within the cache resolution of the cached start, so its segment is checked too
+      path.getWayPoint(i).copyJointGroupPositions(group, positions);
+      if (!post_processor.segmentValid(previous, positions, scratch, *scene, group_name))
+        return robot_trajectory::RobotTrajectoryPtr();
+      state->setJointGroupPositions(group, positions);
+      previous = positions;
+    }
+    state->update();
+    if (i == 0 && (!state->satisfiesBounds(group) || !scene->isStateValid(*state, group_name)))
+      return robot_trajectory::RobotTrajectoryPtr();
+    trajectory->addSuffixWayPoint(state, 0);
+  }
+
+  for (size_t i = 0; i < goals.size(); i ++)
+  {
+    kinematic_constraints::KinematicConstraintSet goal_constraints(start.getRobotModel());
+    goal_constraints.add(goals[i], scene->getTransforms());
+    if (goal_constraints.decide(trajectory->getLastWayPoint()).satisfied)
+    {
+      goal_index = i;
+      return trajectory;
+    }
+  }
+  return robot_trajectory::RobotTrajectoryPtr();
+}
+
+bool ParallelPlanner::toPlan(robot_trajectory::RobotTrajectory &trajectory, const planning_scene::PlanningScene &scene,
+    double max_velocity_scaling_factor, bool cached, moveit::planning_interface::MoveGroupInterface::Plan &plan)
+{
+  if (!post_process_plans)
+  {
+    trajectory_processing::IterativeParabolicTimeParameterization time_parameterization;
+    if (!time_parameterization.computeTimeStamps(trajectory, max_velocity_scaling_factor))
+      return false;
+  }
+  else if (cached)
+  {
+    // cached paths were shortcut and smoothed when they were planned
+    if (!post_processor.parameterize(trajectory, scene, max_velocity_scaling_factor))
+      return false;
+  }
+  else if (!post_processor.process(trajectory, scene, max_velocity_scaling_factor))
+  {
+    return false;
+  }
+
+  moveit::core::robotStateToRobotStateMsg(trajectory.getFirstWayPoint(), plan.start_state_);
+  trajectory.getRobotTrajectoryMsg(plan.trajectory_);
+  return true;
+}
+
+double ParallelPlanner::pathLength(const robot_trajectory::RobotTrajectory &trajectory)
+{
+  double length = 0;
+  for (size_t i = 1; i < trajectory.getWayPointCount(); i ++)
+  {
+    length += trajectory.getWayPoint(i).distance(trajectory.getWayPoint(i - 1), trajectory.getGroup());
+  }
+  return length;
+}
@@ -0,0 +1,193 @@
+#include <manipulation_actions/PathPostProcessor.h>
+
+// C++
+#include <algorithm>
+#include <cmath>
+
+// ROS
+#include <moveit/trajectory_processing/iterative_time_parameterization.h>
+#include <moveit/trajectory_processing/time_optimal_trajectory_generation.h>
+
+using std::string;
+using std::vector;
+
+const int PathPostProcessor::DEFAULT_SHORTCUT_ITERATIONS;
+const int PathPostProcessor::DEFAULT_SMOOTHING_PASSES;
+const double PathPostProcessor::DEFAULT_CHECK_RESOLUTION;
+
+// subdivision stops once a path has this many waypoints
+static const size_t MAX_SMOOTHED_WAYPOINTS = 256;
+
+// largest joint space deviation of the time optimal trajectory's corner blends, and its sampling period
+static const double TIME_OPTIMAL_PATH_TOLERANCE = 0.01;
+static const double TIME_OPTIMAL_RESAMPLE_DT = 0.1;
+
+PathPostProcessor::PathPostProcessor(int shortcut_iterations, int smoothing_passes, double check_resolution) :
+    shortcut_iterations(std::max(0, shortcut_iterations)),
+    smoothing_passes(std::max(0, smoothing_passes)),
+    check_resolution(check_resolution > 0 ? check_resolution : DEFAULT_CHECK_RESOLUTION)
+{
+}
+
+bool PathPostProcessor::process(robot_trajectory::RobotTrajectory &trajectory,
+    const planning_scene::PlanningScene &scene, double max_velocity_scaling_factor)
+{
+  const robot_model::JointModelGroup *group = trajectory.getGroup();
+  if (trajectory.empty() || group == NULL)
+    return false;
+  const string &group_name = trajectory.getGroupName();
+
+  // the path as planned, with the default time parameterization, to report against
+  trajectory_processing::IterativeParabolicTimeParameterization parabolic;
+  robot_trajectory::RobotTrajectory original = trajectory;
+  double original_duration = 0;
+  if (parabolic.computeTimeStamps(original, max_velocity_scaling_factor))
+  {
+    original_duration = duration(original);
+  }
+
+  vector<vector<double> > waypoints(trajectory.getWayPointCount());
+  for (size_t i = 0; i < waypoints.size(); i ++)
+  {
+    trajectory.getWayPoint(i).copyJointGroupPositions(group, waypoints[i]);
+  }
+  size_t original_waypoints = waypoints.size();
+
+  robot_state::RobotState start_state(trajectory.getFirstWayPoint());
+  robot_state::RobotState state(start_state);
+  shortcut(waypoints, state, scene, group_name);
+  smooth(waypoints, state, scene, group_name);
+
+  trajectory.clear();
+  for (size_t i = 0; i < waypoints.size(); i ++)
+  {
+    robot_state::RobotStatePtr waypoint(new robot_state::RobotState(start_state));
+    waypoint->setJointGroupPositions(group, waypoints[i]);
+    waypoint->update();
+    trajectory.addSuffixWayPoint(waypoint, 0);
+  }
+
+  bool optimal;
+  if (!parameterize(trajectory, scene, max_velocity_scaling_factor, &optimal))
+    return false;
+
+  double processed_duration = duration(trajectory);
+  ROS_INFO("Path post-processing: %lu -> %lu waypoints, execution time %.2f s -> %.2f s (%.2f s saved, %s timing).",
+      original_waypoints, waypoints.size(), original_duration, processed_duration,
+      original_duration - processed_duration, optimal ? "time optimal" : "parabolic");
+  return true;
+}
+
+bool PathPostProcessor::parameterize(robot_trajectory::RobotTrajectory &trajectory,
+    const planning_scene::PlanningScene &scene, double max_velocity_scaling_factor, bool *time_optimal) const
+{
+  // corner blends are not part of the validated path, so fall back to parabolic timing if one is invalid
+  robot_trajectory::RobotTrajectory path = trajectory;
+  trajectory_processing::TimeOptimalTrajectoryGeneration optimal_parameterization(TIME_OPTIMAL_PATH_TOLERANCE,
+      TIME_OPTIMAL_RESAMPLE_DT);
+  bool optimal = optimal_parameterization.computeTimeStamps(trajectory, max_velocity_scaling_factor)
+      && trajectoryValid(trajectory, scene);
+  if (time_optimal != NULL)
+  {
+    *time_optimal = optimal;
+  }
+  if (optimal)
+    return true;
+
+  trajectory = path;
+  trajectory_processing::IterativeParabolicTimeParameterization parabolic;
+  return parabolic.computeTimeStamps(trajectory, max_velocity_scaling_factor);
+}
+
+double PathPostProcessor::duration(const robot_trajectory::RobotTrajectory &trajectory)
+{
+  double total = 0;
+  for (size_t i = 0; i < trajectory.getWayPointCount(); i ++)
+  {
+    total += trajectory.getWayPointDurationFromPrevious(i);
+  }
+  return total;
+}
+
+void PathPostProcessor::shortcut(vector<vector<double> > &waypoints, robot_state::RobotState &state,
+    const planning_scene::PlanningScene &scene, const string &group_name)
+{
+  for (int i = 0; i < shortcut_iterations && waypoints.size() > 2; i ++)
+  {
+    int from = rng.uniformInteger(0, static_cast<int>(waypoints.size()) - 3);
+    int to = rng.uniformInteger(from + 2, static_cast<int>(waypoints.size()) - 1);
+    if (segmentValid(waypoints[from], waypoints[to], state, scene, group_name))
+    {
+      waypoints.erase(waypoints.begin() + from + 1, waypoints.begin() + to);
+    }
+  }
+}
+
+void PathPostProcessor::smooth(vector<vector<double> > &waypoints, robot_state::RobotState &state,
+    const planning_scene::PlanningScene &scene, const string &group_name) const
+{
+  const robot_model::JointModelGroup *group = state.getJointModelGroup(group_name);
+  for (int pass = 0; pass < smoothing_passes && waypoints.size() > 2; pass ++)
+  {
+    // midpoints lie on segments that are already valid, and give the corners room to be rounded off
+    if (2*waypoints.size() - 1 <= MAX_SMOOTHED_WAYPOINTS)
+    {
+      vector<vector<double> > subdivided;
+      subdivided.reserve(2*waypoints.size() - 1);
+      for (size_t i = 0; i < waypoints.size(); i ++)
+      {
+        subdivided.push_back(waypoints[i]);
+        if (i + 1 < waypoints.size())
+        {
+          vector<double> midpoint(waypoints[i].size());
+          group->interpolate(waypoints[i].data(), waypoints[i + 1].data(), 0.5, midpoint.data());
+          subdivided.push_back(midpoint);
+        }
+      }
+      waypoints.swap(subdivided);
+    }
+
+    vector<double> midpoint(waypoints[0].size());
+    vector<double> candidate(waypoints[0].size());
+    for (size_t i = 1; i + 1 < waypoints.size(); i ++)
+    {
+      group->interpolate(waypoints[i - 1].data(), waypoints[i + 1].data(), 0.5, midpoint.data());
+      group->interpolate(waypoints[i].data(), midpoint.data(), 0.5, candidate.data());
+      if (segmentValid(waypoints[i - 1], candidate, state, scene, group_name)
+          && segmentValid(candidate, waypoints[i + 1], state, scene, group_name))
+      {
+        waypoints[i] = candidate;
+      }
+    }
+  }
+}
+
+bool PathPostProcessor::segmentValid(const vector<double> &from, const vector<double> &to,
+    robot_state::RobotState &state, const planning_scene::PlanningScene &scene, const string &group_name) const
+{
+  const robot_model::JointModelGroup *group = state.getJointModelGroup(group_name);
+  int steps = std::max(1, static_cast<int>(ceil(group->distance(from.data(), to.data()) / check_resolution)));
+  vector<double> position(from.size());
+  for (int i = 1; i <= steps; i ++)
+  {
+    group->interpolate(from.data(), to.data(), static_cast<double>(i) / steps, position.data());
+    state.setJointGroupPositions(group, position);
+    state.update();
+    if (!state.satisfiesBounds(group) || !scene.isStateValid(state, group_name))
+      return false;
+  }
+  return true;
+}
+
+bool PathPostProcessor::trajectoryValid(const robot_trajectory::RobotTrajectory &trajectory,
+    const planning_scene::PlanningScene &scene) const
+{
+  for (size_t i = 0; i < trajectory.getWayPointCount(); i ++)
+  {
+    const robot_state::RobotState &waypoint = trajectory.getWayPoint(i);
+    if (!waypoint.satisfiesBounds(trajectory.getGroup())
+        || !scene.isStateValid(waypoint, trajectory.getGroupName()))
+      return false;
+  }
+  return true;
+}
@@ -0,0 +1,156 @@
+#include <manipulation_actions/ReachabilityMap.h>
+
+// C++
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+
+// POSIX
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// ROS
+#include <ros/ros.h>
+
+using std::string;
+using std::vector;
+
+const uint32_t ReachabilityMap::VERSION;
+
+static const char MAP_MAGIC[8] = {'F', 'E', 'T', 'C', 'H', 'R', 'M', 'P'};
+
+ReachabilityMap::ReachabilityMap() :
+    mapped_data(NULL),
+    mapped_size(0),
+    header(NULL),
+    cells(NULL)
+{
+}
+
+ReachabilityMap::~ReachabilityMap()
+{
+  release();
+}
+
+bool ReachabilityMap::load(const string &file)
+{
+  release();
+
+  int fd = open(file.c_str(), O_RDONLY);
+  if (fd < 0)
+    return false;
+  struct stat st;
+  if (fstat(fd, &st) != 0 || st.st_size < static_cast<off_t>(sizeof(ReachabilityMapHeader)))
+  {
+    close(fd);
+    return false;
+  }
+  void *data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (data == MAP_FAILED)
+    return false;
+
+  mapped_data = data;
+  mapped_size = st.st_size;
+
+  const ReachabilityMapHeader *file_header = static_cast<const ReachabilityMapHeader *>(mapped_data);
+  if (std::memcmp(file_header->magic, MAP_MAGIC, sizeof(MAP_MAGIC)) != 0 || file_header->version != VERSION
+      || file_header->resolution <= 0 || file_header->azimuth_bins == 0 || file_header->elevation_bins == 0
+      || mapped_size != sizeof(ReachabilityMapHeader) + cellCount(*file_header))
+  {
+    ROS_WARN("Reachability map %s is corrupt or from a different version.", file.c_str());
+    release();
+    return false;
+  }
+
+  header = file_header;
+  cells = static_cast<const uint8_t *>(mapped_data) + sizeof(ReachabilityMapHeader);
+  return true;
+}
+
+double ReachabilityMap::getScore(const geometry_msgs::Pose &pose, double torso_height) const
+{
+  if (!isLoaded())
+    return 0;
+
+  // the wrist x axis is the approach direction
+  double qx = pose.orientation.x;
+  double qy = pose.orientation.y;
+  double qz = pose.orientation.z;
+  double qw = pose.orientation.w;
+  double norm = qx*qx + qy*qy + qz*qz + qw*qw;
+  if (norm == 0)
+    return 0;
+  double approach_x = (qw*qw + qx*qx - qy*qy - qz*qz) / norm;
+  double approach_y = 2*(qx*qy + qw*qz) / norm;
+  double approach_z = 2*(qx*qz - qw*qy) / norm;
+
+  // the torso lifts the whole arm straight up in base_link
+  double z = pose.position.z - (torso_height - header->reference_height);
+
+  size_t index;
+  if (!cellIndex(*header, pose.position.x, pose.position.y, z, approach_x, approach_y, approach_z, index))
+    return 0;
+  return cells[index] / 255.0;
+}
+
+bool ReachabilityMap::cellIndex(const ReachabilityMapHeader &header, double x, double y, double z,
+    double approach_x, double approach_y, double approach_z, size_t &index)
+{
+  double position[3] = {x, y, z};
+  size_t voxel = 0;
+  for (size_t i = 0; i < 3; i ++)
+  {
+    double offset = floor((position[i] - header.origin[i]) / header.resolution);
+    if (offset < 0 || offset >= header.dims[i])
+      return false;
+    voxel = voxel*header.dims[i] + static_cast<size_t>(offset);
+  }
+
+  double azimuth = (atan2(approach_y, approach_x) + M_PI) / (2*M_PI);
+  double elevation = (std::max(-1.0, std::min(1.0, approach_z)) + 1) / 2;
+  size_t azimuth_bin = std::min(static_cast<size_t>(azimuth*header.azimuth_bins),
+      static_cast<size_t>(header.azimuth_bins - 1));
+  size_t elevation_bin = std::min(static_cast<size_t>(elevation*header.elevation_bins),
+      static_cast<size_t>(header.elevation_bins - 1));
+
+  index = (voxel*header.azimuth_bins + azimuth_bin)*header.elevation_bins + elevation_bin;
+  return true;
+}
+
+size_t ReachabilityMap::cellCount(const ReachabilityMapHeader &header)
+{
+  return static_cast<size_t>(header.dims[0])*header.dims[1]*header.dims[2]*header.azimuth_bins
+      *header.elevation_bins;
+}
+
+bool ReachabilityMap::write(const string &file, ReachabilityMapHeader header, const vector<uint8_t> &cells)
+{
+  std::memcpy(header.magic, MAP_MAGIC, sizeof(MAP_MAGIC));
+  header.version = VERSION;
+  header.reserved = 0;
+  if (cells.size() != cellCount(header))
+    return false;
+
+  std::ofstream out(file.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+  if (!out.is_open())
+    return false;
+  out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+  out.write(reinterpret_cast<const char *>(cells.data()), cells.size());
+  return out.good();
+}
+
+void ReachabilityMap::release()
+{
+  if (mapped_data != NULL)
+  {
+    munmap(mapped_data, mapped_size);
+  }
+  mapped_data = NULL;
+  mapped_size = 0;
+  header = NULL;
+  cells = NULL;
+}
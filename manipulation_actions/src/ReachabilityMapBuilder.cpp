@@ -0,0 +1,145 @@
+#include <manipulation_actions/ReachabilityMap.h>
+
+// C++
+#include <algorithm>
+#include <cmath>
+
+// ROS
+#include <moveit/kinematics_metrics/kinematics_metrics.h>
+#include <moveit/planning_scene/planning_scene.h>
+#include <moveit/robot_model_loader/robot_model_loader.h>
+#include <ros/ros.h>
+
+using std::string;
+using std::vector;
+
+/**
+ * Offline tool that builds the reachability map used to order place candidates.  Random collision-free arm
+ * configurations are sampled with the torso fixed, and every wrist pose they reach marks its cell with the best
+ * manipulability index seen there.  Needs robot_description on the parameter server, but no running robot.
+ */
+int main(int argc, char **argv)
+{
+  ros::init(argc, argv, "build_reachability_map");
+  ros::NodeHandle pnh("~");
+
+  string output, group_name, tip_link;
+  double torso_height, resolution;
+  double x_min, x_max, y_min, y_max, z_min, z_max;
+  int samples, azimuth_bins, elevation_bins;
+  pnh.param<string>("output", output, "fetch_arm.rmap");
+  pnh.param<string>("group", group_name, "arm");
+  pnh.param<string>("tip_link", tip_link, "wrist_roll_link");
+  pnh.param<double>("torso_height", torso_height, 0.0);
+  pnh.param<double>("resolution", resolution, 0.05);
+  pnh.param<double>("x_min", x_min, -0.6);
+  pnh.param<double>("x_max", x_max, 1.4);
+  pnh.param<double>("y_min", y_min, -1.2);
+  pnh.param<double>("y_max", y_max, 1.2);
+  pnh.param<double>("z_min", z_min, -0.2);
+  pnh.param<double>("z_max", z_max, 2.0);
+  pnh.param<int>("samples", samples, 5000000);
+  pnh.param<int>("azimuth_bins", azimuth_bins, 8);
+  pnh.param<int>("elevation_bins", elevation_bins, 4);
+
+  if (resolution <= 0 || x_max <= x_min || y_max <= y_min || z_max <= z_min || azimuth_bins < 1
+      || elevation_bins < 1)
+  {
+    ROS_ERROR("Invalid reachability map bounds or discretization.");
+    return EXIT_FAILURE;
+  }
+
+  robot_model_loader::RobotModelLoader robot_model_loader("robot_description");
+  robot_model::RobotModelConstPtr robot_model = robot_model_loader.getModel();
+  if (!robot_model)
+  {
+    ROS_ERROR("Could not load the robot model from robot_description.");
+    return EXIT_FAILURE;
+  }
+  const robot_model::JointModelGroup *group = robot_model->getJointModelGroup(group_name);
+  if (group == NULL || !robot_model->hasLinkModel(tip_link))
+  {
+    ROS_ERROR("Robot model has no group %s or link %s.", group_name.c_str(), tip_link.c_str());
+    return EXIT_FAILURE;
+  }
+
+  planning_scene::PlanningScene planning_scene(robot_model);
+  kinematics_metrics::KinematicsMetrics kinematics_metrics(robot_model);
+  robot_state::RobotState state(robot_model);
+  state.setToDefaultValues();
+  if (robot_model->hasJointModel("torso_lift_joint"))
+  {
+    state.setVariablePosition("torso_lift_joint", torso_height);
+  }
+
+  ReachabilityMapHeader header;
+  header.origin[0] = x_min;
+  header.origin[1] = y_min;
+  header.origin[2] = z_min;
+  header.dims[0] = static_cast<uint32_t>(ceil((x_max - x_min) / resolution));
+  header.dims[1] = static_cast<uint32_t>(ceil((y_max - y_min) / resolution));
+  header.dims[2] = static_cast<uint32_t>(ceil((z_max - z_min) / resolution));
+  header.azimuth_bins = azimuth_bins;
+  header.elevation_bins = elevation_bins;
+  header.resolution = resolution;
+  header.reference_height = torso_height;
+
+  // best manipulability per cell, negative if never reached
+  vector<float> best(ReachabilityMap::cellCount(header), -1);
+  float max_manipulability = 0;
+  size_t valid_samples = 0;
+
+  collision_detection::CollisionRequest collision_request;
+  collision_request.group_name = group_name;
+  for (int i = 0; i < samples && ros::ok(); i ++)
+  {
+    if (i > 0 && i % (samples / 10 + 1) == 0)
+    {
+      ROS_INFO("Sampled %d of %d configurations...", i, samples);
+    }
+
+    state.setToRandomPositions(group);
+    state.update();
+
+    collision_detection::CollisionResult collision_result;
+    planning_scene.checkSelfCollision(collision_request, collision_result, state);
+    if (collision_result.collision)
+      continue;
+
+    double manipulability;
+    if (!kinematics_metrics.getManipulabilityIndex(state, group, manipulability))
+      continue;
+
+    const Eigen::Vector3d position = state.getGlobalLinkTransform(tip_link).translation();
+    const Eigen::Vector3d approach = state.getGlobalLinkTransform(tip_link).linear().col(0);
+    size_t index;
+    if (!ReachabilityMap::cellIndex(header, position.x(), position.y(), position.z(), approach.x(), approach.y(),
+        approach.z(), index))
+      continue;
+
+    best[index] = std::max(best[index], static_cast<float>(manipulability));
+    max_manipulability = std::max(max_manipulability, static_cast<float>(manipulability));
+    valid_samples ++;
+  }
+
+  vector<uint8_t> cells(best.size(), 0);
+  size_t reached = 0;
+  for (size_t i = 0; i < best.size(); i ++)
+  {
+    if (best[i] < 0)
+      continue;
+    float normalized = max_manipulability > 0 ? best[i] / max_manipulability : 0;
+    cells[i] = static_cast<uint8_t>(1 + lround(254*normalized));
+    reached ++;
+  }
+
+  if (!ReachabilityMap::write(output, header, cells))
+  {
+    ROS_ERROR("Could not write reachability map %s.", output.c_str());
+    return EXIT_FAILURE;
+  }
+  ROS_INFO("Wrote %s: %lu collision-free samples reached %lu of %lu cells (%lu bytes).", output.c_str(),
+      valid_samples, reached, cells.size(), sizeof(header) + cells.size());
+
+  return EXIT_SUCCESS;
+}
@@ -47,6 +47,8 @@ SchunkGearGrasper::SchunkGearGrasper() :
 
   planning_scene_interface = new moveit::planning_interface::PlanningSceneInterface();
 
+  planner = new ParallelPlanner(pnh);
+
   // initGraspPoses();
 
   schunk_gear_grasp_server.start();
@@ -368,7 +370,6 @@ void SchunkGearGrasper::executeSchunkGearRetrieve(const manipulation_actions::Sc
         schunk_gear_retrieve_server.setAborted(result);
         return;
       }
-      ros::Duration(2.0).sleep();  // let MoveIt! catch up after adding collision objects (this can be very slow)
   }
 
   result.error_code = manipulation_actions::SchunkRetrieveResult::SUCCESS;
@@ -534,16 +535,24 @@ bool SchunkGearGrasper::planToPose(geometry_msgs::PoseStamped& goal_pose,
   {
     ROS_INFO("Planning path to pose. Attempt: %d/%d", num_attempts + 1, max_planning_attempts);
 
-    arm_group->setPlannerId("arm[RRTConnectkConfigDefault]");
-    arm_group->setPlanningTime(1.5);
-    arm_group->setStartStateToCurrentState();
-    //        if (motion_speed_scale_factor_ != 1.0)
-    //            arm_group_->setMaxVelocityScalingFactor(motion_speed_scale_factor);
     ROS_INFO("Goal pose frame: %s", goal_pose.header.frame_id.c_str());
-    arm_group->setPoseTarget(goal_pose, "wrist_roll_link");
 
     // plans to the target pose
-    moveit::planning_interface::MoveItErrorCode plan_result = arm_group->plan(pose_plan);
+    moveit::planning_interface::MoveItErrorCode plan_result;
+    if (planner->isReady())
+    {
+      plan_result = planner->plan(goal_pose, "wrist_roll_link", pose_plan, 1.5, 1.0, "schunk_gear_approach");
+    }
+    else
+    {
+      arm_group->setPlannerId("arm[RRTConnectkConfigDefault]");
+      arm_group->setPlanningTime(1.5);
+      arm_group->setStartStateToCurrentState();
+      //        if (motion_speed_scale_factor_ != 1.0)
+      //            arm_group_->setMaxVelocityScalingFactor(motion_speed_scale_factor);
+      arm_group->setPoseTarget(goal_pose, "wrist_roll_link");
+      plan_result = arm_group->plan(pose_plan);
+    }
 
     // checks the results
     if (schunk_gear_grasp_server.isPreemptRequested())
@@ -0,0 +1,68 @@
+#include <manipulation_actions/TrajectoryCache.h>
+
+// C++
+#include <algorithm>
+#include <cmath>
+
+using std::string;
+using std::vector;
+
+const double TrajectoryCache::DEFAULT_RESOLUTION;
+const int TrajectoryCache::DEFAULT_CAPACITY;
+
+TrajectoryCache::TrajectoryCache(double resolution, size_t capacity) :
+    resolution(resolution > 0 ? resolution : DEFAULT_RESOLUTION),
+    capacity(std::max(static_cast<size_t>(1), capacity))
+{
+}
+
+robot_trajectory::RobotTrajectoryConstPtr TrajectoryCache::lookup(const string &goal_id,
+    const vector<double> &start) const
+{
+  std::map<Key, robot_trajectory::RobotTrajectoryConstPtr>::const_iterator entry = entries.find(makeKey(goal_id,
+      start));
+  if (entry == entries.end())
+    return robot_trajectory::RobotTrajectoryConstPtr();
+  return entry->second;
+}
+
+void TrajectoryCache::store(const string &goal_id, const vector<double> &start,
+    const robot_trajectory::RobotTrajectoryConstPtr &path)
+{
+  Key key = makeKey(goal_id, start);
+  if (entries.find(key) == entries.end())
+  {
+    insertion_order.push_back(key);
+    if (insertion_order.size() > capacity)
+    {
+      entries.erase(insertion_order.front());
+      insertion_order.pop_front();
+    }
+  }
+  entries[key] = path;
+}
+
+void TrajectoryCache::erase(const string &goal_id, const vector<double> &start)
+{
+  Key key = makeKey(goal_id, start);
+  if (entries.erase(key) > 0)
+  {
+    insertion_order.remove(key);
+  }
+}
+
+void TrajectoryCache::clear()
+{
+  entries.clear();
+  insertion_order.clear();
+}
+
+TrajectoryCache::Key TrajectoryCache::makeKey(const string &goal_id, const vector<double> &start) const
+{
+  Key key(goal_id, vector<int>(start.size()));
+  for (size_t i = 0; i < start.size(); i ++)
+  {
+    key.second[i] = static_cast<int>(floor(start[i] / resolution));
+  }
+  return key;
+}
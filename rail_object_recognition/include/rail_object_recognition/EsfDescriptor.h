@@ -0,0 +1,23 @@
+#ifndef RAIL_OBJECT_RECOGNITION_ESF_DESCRIPTOR_H
+#define RAIL_OBJECT_RECOGNITION_ESF_DESCRIPTOR_H
+
+#include <stdint.h>
+#include <vector>
+#include <pcl/point_cloud.h>
+#include <pcl/point_types.h>
+#include <sensor_msgs/PointCloud2.h>
+
+// length of the ESF descriptor used by the parts classifier
+const int ESF_DESCRIPTOR_LENGTH = 640;
+
+// computes the 640-bin ESF descriptor of a cloud, all zeros if the cloud is empty
+void computeEsfDescriptor(const pcl::PointCloud<pcl::PointXYZ>::Ptr& cloud, std::vector<double>& descriptor);
+
+// computes descriptors for all clouds on num_threads threads (0 uses every core), one slot per cloud
+void computeEsfDescriptors(const std::vector<pcl::PointCloud<pcl::PointXYZ>::Ptr>& clouds,
+                           std::vector<std::vector<double> >& descriptors, unsigned int num_threads = 0);
+
+// 64-bit FNV-1a hash over the layout and point data of a cloud message, used as the descriptor cache key
+uint64_t cloudFingerprint(const sensor_msgs::PointCloud2& cloud);
+
+#endif
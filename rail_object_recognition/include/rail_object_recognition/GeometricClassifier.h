@@ -0,0 +1,63 @@
+#ifndef RAIL_OBJECT_RECOGNITION_GEOMETRIC_CLASSIFIER_H
+#define RAIL_OBJECT_RECOGNITION_GEOMETRIC_CLASSIFIER_H
+
+#include <string>
+#include <vector>
+#include <pcl/point_cloud.h>
+#include <pcl/point_types.h>
+
+// oriented bounding box features of a segmented part, extents sorted so that length >= width >= height
+enum GeometricFeature
+{
+    FEATURE_LENGTH,
+    FEATURE_WIDTH,
+    FEATURE_HEIGHT,
+    FEATURE_WIDTH_RATIO,   // width / length
+    FEATURE_HEIGHT_RATIO,  // height / length
+    FEATURE_DENSITY,       // points per square meter of the length x width face
+    NUM_GEOMETRIC_FEATURES
+};
+
+// parameter names of the features, in GeometricFeature order
+extern const char* GEOMETRIC_FEATURE_NAMES[NUM_GEOMETRIC_FEATURES];
+
+// one class described by a range on each feature, unbounded unless set
+struct GeometricRule
+{
+    GeometricRule();
+
+    std::string name;
+    int class_index;    // column of the class in the recognition output
+    double confidence;  // probability reported for the class when the rule fires
+    double min[NUM_GEOMETRIC_FEATURES];
+    double max[NUM_GEOMETRIC_FEATURES];
+
+    // whether every feature is in range, with each bound loosened by margin times its value (features are >= 0)
+    bool matches(const std::vector<double>& features, double margin = 0.0) const;
+};
+
+// first recognition stage, classifies the parts that are unambiguous from their bounding box alone
+class GeometricClassifier
+{
+    public:
+        GeometricClassifier();
+
+        void addRule(const GeometricRule& rule) { rules_.push_back(rule); }
+        const std::vector<GeometricRule>& rules() const { return rules_; }
+
+        // relative slack by which a rule of another class must miss the features for a confident result
+        void setMargin(double margin) { margin_ = margin; }
+
+        // PCA oriented bounding box features of a cloud, all zeros if it has fewer than 3 points
+        static void computeFeatures(const pcl::PointCloud<pcl::PointXYZ>& cloud, std::vector<double>& features);
+
+        // returns true and fills num_classes probabilities if exactly one rule matches and no rule of another class
+        // comes within the margin, otherwise the cloud needs the full classifier
+        bool classify(const std::vector<double>& features, int num_classes, std::vector<double>& probabilities) const;
+
+    private:
+        std::vector<GeometricRule> rules_;
+        double margin_;
+};
+
+#endif
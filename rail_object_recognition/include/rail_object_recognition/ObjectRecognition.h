@@ -6,10 +6,16 @@
 #include <pcl/common/common.h>
 #include<iostream>
 #include<string>
+#include<deque>
+#include<map>
+#include<vector>
 #include<sensor_msgs/PointCloud2.h>
 #include "rail_object_recognition/PartsQuery.h"
 #include "rail_object_recognition/Descriptor.h"
 #include "rail_object_recognition/ExtractPointCloud.h"
+#include "rail_object_recognition/EsfDescriptor.h"
+#include "rail_object_recognition/GeometricClassifier.h"
+#include "rail_object_recognition/PartsClassifier.h"
 
 class ObjectRecognition{
     public:
@@ -18,7 +24,20 @@ class ObjectRecognition{
         ros::NodeHandle nh_, pnh_;
         ros::ServiceServer object_recognition_service_;
         ros::ServiceClient parts_classifier_client_;
+        PartsClassifier parts_classifier_;
+        GeometricClassifier geometric_classifier_;
+        bool geometric_cascade_;
+        int num_classes_;
+
+        // descriptors of recently seen clouds keyed by cloud fingerprint, evicted oldest first
+        std::map<uint64_t, std::vector<double> > descriptor_cache_;
+        std::deque<uint64_t> descriptor_cache_order_;
+        int descriptor_cache_size_;
+        int num_threads_;
 
         void initializeServices();
+        void loadGeometricRules();
+        bool classifyDescriptors(const std::vector<pcl::PointCloud<pcl::PointXYZ>::Ptr>& clouds,
+                                 const std::vector<uint64_t>& fingerprints, std::vector<std::vector<double> >& probabilities);
         bool serviceCallback(rail_object_recognition::ExtractPointCloud::Request &req, rail_object_recognition::ExtractPointCloud::Response &res);
 };
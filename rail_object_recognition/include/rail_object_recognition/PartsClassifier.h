@@ -0,0 +1,61 @@
+#ifndef RAIL_OBJECT_RECOGNITION_PARTS_CLASSIFIER_H
+#define RAIL_OBJECT_RECOGNITION_PARTS_CLASSIFIER_H
+
+#include <string>
+#include <vector>
+
+// evaluates a parts classifier exported by export_parts_classifier.py, matching the pickled model's predict_proba
+class PartsClassifier
+{
+    public:
+        PartsClassifier();
+
+        // loads an exported model, returns false if the file is missing or malformed
+        bool load(const std::string& model_filepath);
+
+        bool isLoaded() const { return loaded_; }
+        int numFeatures() const { return num_features_; }
+        int numClasses() const { return num_classes_; }
+        const std::vector<double>& classes() const { return classes_; }
+
+        // class probabilities of one descriptor, in the order of classes()
+        void predictProba(const std::vector<double>& descriptor, std::vector<double>& probabilities) const;
+
+    private:
+        enum ScalerType { SCALER_NONE, SCALER_STANDARD, SCALER_MINMAX };
+        enum ModelType { MODEL_FOREST, MODEL_LINEAR, MODEL_KNN };
+
+        // one tree stored as parallel node arrays, leaves have left == -1
+        struct Tree
+        {
+            std::vector<int> left, right, feature;
+            std::vector<double> threshold;
+            std::vector<double> distribution;  // num_classes per node
+        };
+
+        void scale(const std::vector<double>& descriptor, std::vector<double>& features) const;
+        void predictForest(const std::vector<double>& features, std::vector<double>& probabilities) const;
+        void predictLinear(const std::vector<double>& features, std::vector<double>& probabilities) const;
+        void predictKnn(const std::vector<double>& features, std::vector<double>& probabilities) const;
+
+        bool loaded_;
+        int num_features_;
+        int num_classes_;
+        std::vector<double> classes_;
+
+        ScalerType scaler_type_;
+        std::vector<double> scaler_a_;  // standard: mean, minmax: scale
+        std::vector<double> scaler_b_;  // standard: scale, minmax: min
+
+        ModelType model_type_;
+        std::vector<Tree> trees_;
+        bool multinomial_;
+        std::vector<double> coef_;      // rows x num_features
+        std::vector<double> intercept_;
+        int k_;
+        bool distance_weights_;
+        std::vector<int> sample_labels_;
+        std::vector<double> samples_;   // num samples x num_features
+};
+
+#endif
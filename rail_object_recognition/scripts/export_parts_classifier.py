@@ -0,0 +1,122 @@
+#!/usr/bin/env python
+# Export a pickled parts classifier to the plain text format evaluated by the C++ recognition node
+#
+#   rosrun rail_object_recognition export_parts_classifier.py model/best_classifier.pkl --expected data/dataset.csv
+#   rosrun rail_object_recognition parts_classifier_eval model/best_classifier.parts data/dataset.csv \
+#       model/best_classifier.expected.csv
+#
+# Supports StandardScaler/MinMaxScaler feature scaling with random forest, extra trees, decision tree, logistic
+# regression and euclidean kNN classifiers.
+
+from __future__ import print_function
+
+import argparse
+import os
+import pickle
+
+import numpy as np
+
+
+FORMAT_VERSION = 1
+
+
+def write_array(out, values):
+    out.write(" ".join(repr(float(v)) for v in np.ravel(values)) + "\n")
+
+
+def export_scaler(out, scaler, num_features):
+    name = type(scaler).__name__
+    if scaler is None:
+        out.write("scaler none\n")
+    elif name == "StandardScaler":
+        mean = scaler.mean_ if scaler.mean_ is not None else np.zeros(num_features)
+        scale = scaler.scale_ if scaler.scale_ is not None else np.ones(num_features)
+        out.write("scaler standard\n")
+        write_array(out, mean)
+        write_array(out, scale)
+    elif name == "MinMaxScaler":
+        out.write("scaler minmax\n")
+        write_array(out, scaler.scale_)
+        write_array(out, scaler.min_)
+    else:
+        raise ValueError("Unsupported feature scaler: {}".format(name))
+
+
+def export_tree(out, tree, num_classes):
+    out.write("tree {}\n".format(tree.node_count))
+    values = tree.value.reshape(tree.node_count, -1)
+    for node in range(tree.node_count):
+        # leaves store the class distribution normalized like DecisionTreeClassifier.predict_proba
+        distribution = values[node]
+        total = distribution.sum()
+        if total > 0:
+            distribution = distribution / total
+        out.write("{} {} {} {} ".format(tree.children_left[node], tree.children_right[node],
+                                        tree.feature[node], repr(float(tree.threshold[node]))))
+        write_array(out, distribution)
+
+
+def export_classifier(out, classifier, num_classes):
+    name = type(classifier).__name__
+    if name in ("RandomForestClassifier", "ExtraTreesClassifier"):
+        out.write("model forest {}\n".format(len(classifier.estimators_)))
+        for estimator in classifier.estimators_:
+            export_tree(out, estimator.tree_, num_classes)
+    elif name == "DecisionTreeClassifier":
+        out.write("model forest 1\n")
+        export_tree(out, classifier.tree_, num_classes)
+    elif name == "LogisticRegression":
+        # mirrors the one-vs-rest / multinomial choice LogisticRegression.predict_proba makes
+        multi_class = getattr(classifier, "multi_class", "auto")
+        multinomial = multi_class == "multinomial" or (multi_class in ("auto", "deprecated") and num_classes > 2
+                                                       and getattr(classifier, "solver", "lbfgs") != "liblinear")
+        out.write("model linear {} {}\n".format("multinomial" if multinomial else "ovr",
+                                                classifier.coef_.shape[0]))
+        for row in range(classifier.coef_.shape[0]):
+            write_array(out, classifier.coef_[row])
+        write_array(out, classifier.intercept_)
+    elif name == "KNeighborsClassifier":
+        if classifier.effective_metric_ not in ("euclidean", "minkowski") or \
+                classifier.effective_metric_params_.get("p", 2) != 2:
+            raise ValueError("Only euclidean kNN classifiers are supported")
+        samples = classifier._fit_X
+        out.write("model knn {} {} {}\n".format(classifier.n_neighbors, classifier.weights, samples.shape[0]))
+        for sample, label in zip(samples, classifier._y):
+            out.write("{} ".format(int(label)))
+            write_array(out, sample)
+    else:
+        raise ValueError("Unsupported classifier: {}".format(name))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__)
+    parser.add_argument("model_filepath", help="pickled dict with feature_normalization_scalar and classifier")
+    parser.add_argument("--output", help="exported model (default: model_filepath with a .parts extension)")
+    parser.add_argument("--expected", metavar="DATASET_CSV",
+                        help="also write the pickled model's predict_proba on a dataset, for parts_classifier_eval")
+    args = parser.parse_args()
+
+    dic = pickle.load(open(args.model_filepath, "rb"))
+    scaler = dic["feature_normalization_scalar"]
+    classifier = dic["classifier"]
+    num_features = classifier.n_features_in_ if hasattr(classifier, "n_features_in_") else classifier.n_features_
+    num_classes = len(classifier.classes_)
+
+    output = args.output or os.path.splitext(args.model_filepath)[0] + ".parts"
+    with open(output, "w") as out:
+        out.write("parts_classifier {} {} {}\n".format(FORMAT_VERSION, num_features, num_classes))
+        write_array(out, classifier.classes_)
+        export_scaler(out, scaler, num_features)
+        export_classifier(out, classifier, num_classes)
+    print("Wrote {}".format(output))
+
+    if args.expected:
+        data = np.genfromtxt(args.expected, delimiter=",", skip_header=1)[:, 2:]
+        features = scaler.transform(data) if scaler is not None else data
+        expected = os.path.splitext(output)[0] + ".expected.csv"
+        np.savetxt(expected, classifier.predict_proba(features), delimiter=",", fmt="%.17g")
+        print("Wrote {}".format(expected))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,84 @@
+#include "rail_object_recognition/EsfDescriptor.h"
+
+#include <algorithm>
+#include <boost/bind.hpp>
+#include <boost/thread/thread.hpp>
+#include <pcl/features/esf.h>
+
+using namespace std;
+
+void computeEsfDescriptor(const pcl::PointCloud<pcl::PointXYZ>::Ptr& cloud, vector<double>& descriptor)
+{
+    descriptor.assign(ESF_DESCRIPTOR_LENGTH, 0.0);
+    if (cloud->empty())
+    {
+        return;
+    }
+
+    pcl::ESFEstimation<pcl::PointXYZ, pcl::ESFSignature640> esf;
+    esf.setInputCloud(cloud);
+    pcl::PointCloud<pcl::ESFSignature640>::Ptr esfSignature(new pcl::PointCloud<pcl::ESFSignature640>);
+    esf.compute(*esfSignature);
+    if (esfSignature->empty())
+    {
+        return;
+    }
+
+    for(int d=0; d<ESF_DESCRIPTOR_LENGTH; d++){
+        descriptor[d] = esfSignature->points[0].histogram[d];
+    }
+}
+
+// computes every stride-th descriptor starting at first
+static void computeEsfDescriptorRange(const vector<pcl::PointCloud<pcl::PointXYZ>::Ptr>* clouds,
+                                      vector<vector<double> >* descriptors, size_t first, size_t stride)
+{
+    for (size_t i = first; i < clouds->size(); i += stride)
+    {
+        computeEsfDescriptor((*clouds)[i], (*descriptors)[i]);
+    }
+}
+
+void computeEsfDescriptors(const vector<pcl::PointCloud<pcl::PointXYZ>::Ptr>& clouds,
+                           vector<vector<double> >& descriptors, unsigned int num_threads)
+{
+    descriptors.resize(clouds.size());
+    if (num_threads == 0)
+    {
+        num_threads = boost::thread::hardware_concurrency();
+    }
+    num_threads = max(1u, min(num_threads, static_cast<unsigned int>(clouds.size())));
+
+    boost::thread_group threads;
+    for (unsigned int t = 0; t < num_threads; t++)
+    {
+        threads.create_thread(boost::bind(&computeEsfDescriptorRange, &clouds, &descriptors, t, num_threads));
+    }
+    threads.join_all();
+}
+
+uint64_t cloudFingerprint(const sensor_msgs::PointCloud2& cloud)
+{
+    uint64_t hash = 14695981039346656037ULL;
+    const uint64_t prime = 1099511628211ULL;
+
+    uint32_t layout[4] = {cloud.width, cloud.height, cloud.point_step, static_cast<uint32_t>(cloud.fields.size())};
+    const uint8_t* bytes = reinterpret_cast<const uint8_t*>(layout);
+    for (size_t i = 0; i < sizeof(layout); i++)
+    {
+        hash = (hash ^ bytes[i]) * prime;
+    }
+    for (size_t i = 0; i < cloud.fields.size(); i++)
+    {
+        for (size_t c = 0; c < cloud.fields[i].name.size(); c++)
+        {
+            hash = (hash ^ static_cast<uint8_t>(cloud.fields[i].name[c])) * prime;
+        }
+        hash = (hash ^ static_cast<uint8_t>(cloud.fields[i].offset)) * prime;
+    }
+    for (size_t i = 0; i < cloud.data.size(); i++)
+    {
+        hash = (hash ^ cloud.data[i]) * prime;
+    }
+    return hash;
+}
@@ -0,0 +1,112 @@
+#include "rail_object_recognition/GeometricClassifier.h"
+
+#include <algorithm>
+#include <functional>
+#include <limits>
+#include <Eigen/Eigenvalues>
+#include <pcl/common/centroid.h>
+
+using namespace std;
+
+const char* GEOMETRIC_FEATURE_NAMES[NUM_GEOMETRIC_FEATURES] =
+    {"length", "width", "height", "width_ratio", "height_ratio", "density"};
+
+GeometricRule::GeometricRule() : class_index(-1), confidence(0.9)
+{
+    fill(min, min + NUM_GEOMETRIC_FEATURES, -numeric_limits<double>::infinity());
+    fill(max, max + NUM_GEOMETRIC_FEATURES, numeric_limits<double>::infinity());
+}
+
+bool GeometricRule::matches(const vector<double>& features, double margin) const
+{
+    for (int f = 0; f < NUM_GEOMETRIC_FEATURES; f++)
+    {
+        if (features[f] < min[f]*(1.0 - margin) || features[f] > max[f]*(1.0 + margin))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+GeometricClassifier::GeometricClassifier() : margin_(0.1)
+{
+}
+
+void GeometricClassifier::computeFeatures(const pcl::PointCloud<pcl::PointXYZ>& cloud, vector<double>& features)
+{
+    features.assign(NUM_GEOMETRIC_FEATURES, 0.0);
+    if (cloud.size() < 3)
+    {
+        return;
+    }
+
+    // principal axes of the points, then their extents along each axis
+    Eigen::Matrix3f covariance;
+    Eigen::Vector4f centroid;
+    pcl::computeMeanAndCovarianceMatrix(cloud, covariance, centroid);
+    Eigen::SelfAdjointEigenSolver<Eigen::Matrix3f> solver(covariance);
+    Eigen::Matrix3f axes = solver.eigenvectors();
+
+    Eigen::Vector3f min_pt = Eigen::Vector3f::Constant(numeric_limits<float>::max());
+    Eigen::Vector3f max_pt = -min_pt;
+    for (size_t i = 0; i < cloud.size(); i++)
+    {
+        Eigen::Vector3f projected = axes.transpose()*(cloud[i].getVector3fMap() - centroid.head<3>());
+        min_pt = min_pt.cwiseMin(projected);
+        max_pt = max_pt.cwiseMax(projected);
+    }
+    double extents[3] = {max_pt[0] - min_pt[0], max_pt[1] - min_pt[1], max_pt[2] - min_pt[2]};
+    sort(extents, extents + 3, greater<double>());
+
+    features[FEATURE_LENGTH] = extents[0];
+    features[FEATURE_WIDTH] = extents[1];
+    features[FEATURE_HEIGHT] = extents[2];
+    if (extents[0] > 0)
+    {
+        features[FEATURE_WIDTH_RATIO] = extents[1]/extents[0];
+        features[FEATURE_HEIGHT_RATIO] = extents[2]/extents[0];
+    }
+    if (extents[0]*extents[1] > 0)
+    {
+        features[FEATURE_DENSITY] = cloud.size()/(extents[0]*extents[1]);
+    }
+}
+
+bool GeometricClassifier::classify(const vector<double>& features, int num_classes, vector<double>& probabilities) const
+{
+    const GeometricRule* match = NULL;
+    for (size_t i = 0; i < rules_.size(); i++)
+    {
+        if (rules_[i].class_index < 0 || rules_[i].class_index >= num_classes || !rules_[i].matches(features))
+        {
+            continue;
+        }
+        if (match && match->class_index != rules_[i].class_index)
+        {
+            return false;
+        }
+        if (!match || rules_[i].confidence > match->confidence)
+        {
+            match = &rules_[i];
+        }
+    }
+    if (!match)
+    {
+        return false;
+    }
+
+    // a near miss by another class means the box alone can't tell them apart
+    for (size_t i = 0; i < rules_.size(); i++)
+    {
+        if (rules_[i].class_index != match->class_index && rules_[i].matches(features, margin_))
+        {
+            return false;
+        }
+    }
+
+    double remainder = num_classes > 1 ? (1.0 - match->confidence)/(num_classes - 1) : 0.0;
+    probabilities.assign(num_classes, remainder);
+    probabilities[match->class_index] = num_classes > 1 ? match->confidence : 1.0;
+    return true;
+}
@@ -5,6 +5,38 @@ using namespace std;
 ObjectRecognition::ObjectRecognition() : pnh_("~")
 {
     ROS_INFO("In the constructor of object recognition class");
+    pnh_.param("descriptor_cache_size", descriptor_cache_size_, 256);
+    pnh_.param("num_threads", num_threads_, 0);
+
+    // classifies in-process when an exported model is available, otherwise through parts_classifier.py
+    bool native_classifier;
+    pnh_.param("native_classifier", native_classifier, false);
+    if (native_classifier)
+    {
+        string model_filepath;
+        pnh_.param<string>("model_filepath", model_filepath, "");
+        if (parts_classifier_.load(model_filepath))
+        {
+            ROS_INFO("Loaded parts classifier %s", model_filepath.c_str());
+        }
+        else
+        {
+            ROS_WARN("Could not load exported parts classifier '%s', falling back to the classify_parts service",
+                     model_filepath.c_str());
+        }
+    }
+
+    // bounding box rules in front of the descriptor classifier, columns must match the classifier's classes
+    pnh_.param("num_classes", num_classes_, 6);
+    if (parts_classifier_.isLoaded())
+    {
+        num_classes_ = parts_classifier_.numClasses();
+    }
+    double geometric_margin;
+    pnh_.param("geometric_cascade", geometric_cascade_, false);
+    pnh_.param("geometric_margin", geometric_margin, 0.1);
+    geometric_classifier_.setMargin(geometric_margin);
+    loadGeometricRules();
     initializeServices();
 }
 
@@ -15,42 +47,208 @@ void ObjectRecognition::initializeServices()
     parts_classifier_client_ = nh_.serviceClient<rail_object_recognition::PartsQuery>("/rail_object_recognition/classify_parts");
 }
 
+// reads an int or double parameter value
+static bool toDouble(XmlRpc::XmlRpcValue& value, double& result)
+{
+    if (value.getType() == XmlRpc::XmlRpcValue::TypeInt)
+    {
+        result = static_cast<int>(value);
+        return true;
+    }
+    if (value.getType() == XmlRpc::XmlRpcValue::TypeDouble)
+    {
+        result = static_cast<double>(value);
+        return true;
+    }
+    return false;
+}
+
+void ObjectRecognition::loadGeometricRules()
+{
+    // each rule is a struct with name, class_index, optional confidence and [min, max] ranges on any feature
+    XmlRpc::XmlRpcValue rule_list;
+    if (!pnh_.getParam("geometric_rules", rule_list) || rule_list.getType() != XmlRpc::XmlRpcValue::TypeArray)
+    {
+        return;
+    }
+    for (int i = 0; i < rule_list.size(); i++)
+    {
+        XmlRpc::XmlRpcValue& item = rule_list[i];
+        if (item.getType() != XmlRpc::XmlRpcValue::TypeStruct || !item.hasMember("class_index"))
+        {
+            ROS_WARN("Skipping geometric rule %d, it needs at least a class_index.", i);
+            continue;
+        }
+        GeometricRule rule;
+        rule.name = item.hasMember("name") ? static_cast<string>(item["name"]) : "";
+        rule.class_index = static_cast<int>(item["class_index"]);
+        bool valid = !item.hasMember("confidence") || toDouble(item["confidence"], rule.confidence);
+        for (int f = 0; f < NUM_GEOMETRIC_FEATURES; f++)
+        {
+            if (!item.hasMember(GEOMETRIC_FEATURE_NAMES[f]))
+            {
+                continue;
+            }
+            XmlRpc::XmlRpcValue& range = item[GEOMETRIC_FEATURE_NAMES[f]];
+            if (range.getType() != XmlRpc::XmlRpcValue::TypeArray || range.size() != 2
+                || !toDouble(range[0], rule.min[f]) || !toDouble(range[1], rule.max[f]))
+            {
+                valid = false;
+                break;
+            }
+        }
+        if (!valid || rule.class_index < 0 || rule.class_index >= num_classes_)
+        {
+            ROS_WARN("Skipping geometric rule %d (%s), ranges must be [min, max] numbers and class_index below %d.",
+                     i, rule.name.c_str(), num_classes_);
+            continue;
+        }
+        geometric_classifier_.addRule(rule);
+    }
+    ROS_INFO("Loaded %lu geometric rules", geometric_classifier_.rules().size());
+}
+
 bool ObjectRecognition::serviceCallback(rail_object_recognition::ExtractPointCloud::Request &req, rail_object_recognition::ExtractPointCloud::Response &res)
 {
     ROS_INFO("Object Recognition Service Callback Activated");
-    rail_object_recognition::PartsQuery parts_query_srv;
     int number_of_objects = req.clouds.size();
+    vector<pcl::PointCloud<pcl::PointXYZ>::Ptr> clouds(number_of_objects);
     for(int i=0; i<number_of_objects; i++)
     {
-        vector<double> desc;
-        rail_object_recognition::Descriptor desc_message;
-        pcl::PointCloud<pcl::PointXYZ>::Ptr input_cloud(new pcl::PointCloud<pcl::PointXYZ>);
-        pcl::fromROSMsg(req.clouds[i], *input_cloud);
+        clouds[i].reset(new pcl::PointCloud<pcl::PointXYZ>);
+        pcl::fromROSMsg(req.clouds[i], *clouds[i]);
+    }
+
+    // cheap first stage, only ambiguous clouds go on to descriptors and the full classifier
+    ros::WallTime geometric_start = ros::WallTime::now();
+    vector<vector<double> > probabilities(number_of_objects);
+    res.stages.assign(number_of_objects, rail_object_recognition::ExtractPointCloud::Response::STAGE_DESCRIPTOR);
+    vector<int> remaining_indices;
+    for(int i=0; i<number_of_objects; i++)
+    {
+        vector<double> features;
+        if (geometric_cascade_ && !geometric_classifier_.rules().empty())
+        {
+            GeometricClassifier::computeFeatures(*clouds[i], features);
+            if (geometric_classifier_.classify(features, num_classes_, probabilities[i]))
+            {
+                res.stages[i] = rail_object_recognition::ExtractPointCloud::Response::STAGE_GEOMETRIC;
+                continue;
+            }
+        }
+        remaining_indices.push_back(i);
+    }
+    res.geometric_latency = (ros::WallTime::now() - geometric_start).toSec();
 
-        pcl::ESFEstimation<pcl::PointXYZ, pcl::ESFSignature640> esf;
-        esf.setInputCloud(input_cloud);
-        pcl::PointCloud<pcl::ESFSignature640>::Ptr esfSignature(new pcl::PointCloud<pcl::ESFSignature640>);
-        esf.compute(*esfSignature);
+    ros::WallTime descriptor_start = ros::WallTime::now();
+    res.descriptor_latency = 0;
+    if (!remaining_indices.empty())
+    {
+        vector<pcl::PointCloud<pcl::PointXYZ>::Ptr> remaining_clouds;
+        vector<uint64_t> fingerprints;
+        for(size_t j=0; j<remaining_indices.size(); j++)
+        {
+            remaining_clouds.push_back(clouds[remaining_indices[j]]);
+            fingerprints.push_back(cloudFingerprint(req.clouds[remaining_indices[j]]));
+        }
+        vector<vector<double> > remaining_probabilities;
+        if (!classifyDescriptors(remaining_clouds, fingerprints, remaining_probabilities))
+        {
+            ROS_INFO("Failure in determining object classes");
+            return false;
+        }
+        for(size_t j=0; j<remaining_indices.size(); j++)
+        {
+            probabilities[remaining_indices[j]] = remaining_probabilities[j];
+        }
+        res.descriptor_latency = (ros::WallTime::now() - descriptor_start).toSec();
+    }
+
+    res.classes_of_parts.clear();
+    for(int i=0; i<number_of_objects; i++)
+    {
+        res.classes_of_parts.insert(res.classes_of_parts.end(), probabilities[i].begin(), probabilities[i].end());
+    }
+    ROS_INFO("Success in determining object classes: %lu of %d by bounding box in %.1f ms, %lu by descriptor in %.1f ms",
+             number_of_objects - remaining_indices.size(), number_of_objects, 1000*res.geometric_latency,
+             remaining_indices.size(), 1000*res.descriptor_latency);
+    return true;
+}
+
+bool ObjectRecognition::classifyDescriptors(const vector<pcl::PointCloud<pcl::PointXYZ>::Ptr>& clouds,
+                                            const vector<uint64_t>& fingerprints, vector<vector<double> >& probabilities)
+{
+    int number_of_objects = clouds.size();
 
-        for(int d=0; d<640; d++){
-            desc.push_back(esfSignature->points[0].histogram[d]);
+    // looks up cached descriptors, everything else is computed concurrently
+    vector<vector<double> > descriptors(number_of_objects);
+    vector<int> uncached_indices;
+    vector<pcl::PointCloud<pcl::PointXYZ>::Ptr> uncached_clouds;
+    for(int i=0; i<number_of_objects; i++)
+    {
+        map<uint64_t, vector<double> >::const_iterator cached = descriptor_cache_.find(fingerprints[i]);
+        if (cached != descriptor_cache_.end())
+        {
+            descriptors[i] = cached->second;
+            continue;
         }
+        uncached_indices.push_back(i);
+        uncached_clouds.push_back(clouds[i]);
+    }
+    ROS_INFO("Computing %lu descriptors, %lu cached", uncached_indices.size(),
+             number_of_objects - uncached_indices.size());
 
-        desc_message.descriptor = desc;
-        parts_query_srv.request.descriptors.push_back(desc_message);
+    vector<vector<double> > computed;
+    computeEsfDescriptors(uncached_clouds, computed, num_threads_);
+    for(size_t j=0; j<uncached_indices.size(); j++)
+    {
+        int i = uncached_indices[j];
+        descriptors[i] = computed[j];
+        if (descriptor_cache_size_ > 0 && descriptor_cache_.find(fingerprints[i]) == descriptor_cache_.end())
+        {
+            descriptor_cache_[fingerprints[i]] = computed[j];
+            descriptor_cache_order_.push_back(fingerprints[i]);
+            if (descriptor_cache_order_.size() > static_cast<size_t>(descriptor_cache_size_))
+            {
+                descriptor_cache_.erase(descriptor_cache_order_.front());
+                descriptor_cache_order_.pop_front();
+            }
+        }
     }
 
-    if(parts_classifier_client_.call(parts_query_srv)){
-        ROS_INFO("Success in determining object classes");
-        res.classes_of_parts = parts_query_srv.response.parts_classes;
+    probabilities.resize(number_of_objects);
+    if (parts_classifier_.isLoaded())
+    {
+        for(int i=0; i<number_of_objects; i++)
+        {
+            parts_classifier_.predictProba(descriptors[i], probabilities[i]);
+        }
         return true;
     }
-    else{
-        ROS_INFO("Failure in determining object classes");
+
+    rail_object_recognition::PartsQuery parts_query_srv;
+    for(int i=0; i<number_of_objects; i++)
+    {
+        rail_object_recognition::Descriptor desc_message;
+        desc_message.descriptor = descriptors[i];
+        parts_query_srv.request.descriptors.push_back(desc_message);
+    }
+    if (!parts_classifier_client_.call(parts_query_srv))
+    {
         return false;
     }
-
-    return false;
+    const vector<double>& parts_classes = parts_query_srv.response.parts_classes;
+    if (parts_classes.size() != static_cast<size_t>(number_of_objects*num_classes_))
+    {
+        ROS_ERROR("classify_parts returned %lu probabilities for %d objects, expected %d classes each",
+                  parts_classes.size(), number_of_objects, num_classes_);
+        return false;
+    }
+    for(int i=0; i<number_of_objects; i++)
+    {
+        probabilities[i].assign(parts_classes.begin() + i*num_classes_, parts_classes.begin() + (i + 1)*num_classes_);
+    }
+    return true;
 }
 
 
@@ -0,0 +1,308 @@
+#include "rail_object_recognition/PartsClassifier.h"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <utility>
+
+using namespace std;
+
+PartsClassifier::PartsClassifier() :
+    loaded_(false), num_features_(0), num_classes_(0), scaler_type_(SCALER_NONE), model_type_(MODEL_FOREST),
+    multinomial_(false), k_(0), distance_weights_(false)
+{
+}
+
+static bool readArray(ifstream& in, size_t size, vector<double>& values)
+{
+    values.resize(size);
+    for (size_t i = 0; i < size; i++)
+    {
+        if (!(in >> values[i]))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool PartsClassifier::load(const string& model_filepath)
+{
+    loaded_ = false;
+    ifstream in(model_filepath.c_str());
+    string tag, type;
+    int version;
+    if (!(in >> tag >> version >> num_features_ >> num_classes_) || tag != "parts_classifier" || version != 1
+        || num_features_ <= 0 || num_classes_ <= 0 || !readArray(in, num_classes_, classes_))
+    {
+        return false;
+    }
+
+    if (!(in >> tag >> type) || tag != "scaler")
+    {
+        return false;
+    }
+    if (type == "none")
+    {
+        scaler_type_ = SCALER_NONE;
+    }
+    else if (type == "standard" || type == "minmax")
+    {
+        scaler_type_ = (type == "standard") ? SCALER_STANDARD : SCALER_MINMAX;
+        if (!readArray(in, num_features_, scaler_a_) || !readArray(in, num_features_, scaler_b_))
+        {
+            return false;
+        }
+    }
+    else
+    {
+        return false;
+    }
+
+    if (!(in >> tag >> type) || tag != "model")
+    {
+        return false;
+    }
+    if (type == "forest")
+    {
+        model_type_ = MODEL_FOREST;
+        int num_trees;
+        if (!(in >> num_trees) || num_trees <= 0)
+        {
+            return false;
+        }
+        trees_.assign(num_trees, Tree());
+        for (int t = 0; t < num_trees; t++)
+        {
+            Tree& tree = trees_[t];
+            int num_nodes;
+            if (!(in >> tag >> num_nodes) || tag != "tree" || num_nodes <= 0)
+            {
+                return false;
+            }
+            tree.left.resize(num_nodes);
+            tree.right.resize(num_nodes);
+            tree.feature.resize(num_nodes);
+            tree.threshold.resize(num_nodes);
+            tree.distribution.resize(num_nodes*num_classes_);
+            for (int n = 0; n < num_nodes; n++)
+            {
+                if (!(in >> tree.left[n] >> tree.right[n] >> tree.feature[n] >> tree.threshold[n]))
+                {
+                    return false;
+                }
+                for (int c = 0; c < num_classes_; c++)
+                {
+                    if (!(in >> tree.distribution[n*num_classes_ + c]))
+                    {
+                        return false;
+                    }
+                }
+                if (tree.left[n] >= num_nodes || tree.right[n] >= num_nodes || tree.feature[n] >= num_features_
+                    || (tree.left[n] >= 0 && (tree.right[n] < 0 || tree.feature[n] < 0)))
+                {
+                    return false;
+                }
+            }
+        }
+    }
+    else if (type == "linear")
+    {
+        model_type_ = MODEL_LINEAR;
+        string mode;
+        int rows;
+        if (!(in >> mode >> rows) || (rows != 1 && rows != num_classes_)
+            || !readArray(in, rows*num_features_, coef_) || !readArray(in, rows, intercept_))
+        {
+            return false;
+        }
+        multinomial_ = (mode == "multinomial");
+    }
+    else if (type == "knn")
+    {
+        model_type_ = MODEL_KNN;
+        string weights;
+        int num_samples;
+        if (!(in >> k_ >> weights >> num_samples) || k_ <= 0 || num_samples < k_)
+        {
+            return false;
+        }
+        distance_weights_ = (weights == "distance");
+        sample_labels_.resize(num_samples);
+        samples_.resize(num_samples*num_features_);
+        for (int s = 0; s < num_samples; s++)
+        {
+            if (!(in >> sample_labels_[s]) || sample_labels_[s] < 0 || sample_labels_[s] >= num_classes_)
+            {
+                return false;
+            }
+            for (int f = 0; f < num_features_; f++)
+            {
+                if (!(in >> samples_[s*num_features_ + f]))
+                {
+                    return false;
+                }
+            }
+        }
+    }
+    else
+    {
+        return false;
+    }
+
+    loaded_ = true;
+    return true;
+}
+
+void PartsClassifier::predictProba(const vector<double>& descriptor, vector<double>& probabilities) const
+{
+    vector<double> features;
+    scale(descriptor, features);
+    probabilities.assign(num_classes_, 0.0);
+    switch (model_type_)
+    {
+        case MODEL_FOREST:
+            predictForest(features, probabilities);
+            break;
+        case MODEL_LINEAR:
+            predictLinear(features, probabilities);
+            break;
+        case MODEL_KNN:
+            predictKnn(features, probabilities);
+            break;
+    }
+}
+
+void PartsClassifier::scale(const vector<double>& descriptor, vector<double>& features) const
+{
+    features.assign(num_features_, 0.0);
+    for (int f = 0; f < num_features_ && f < static_cast<int>(descriptor.size()); f++)
+    {
+        // same operation order as the sklearn scalers, so the results are bit-identical
+        if (scaler_type_ == SCALER_STANDARD)
+        {
+            features[f] = (descriptor[f] - scaler_a_[f])/scaler_b_[f];
+        }
+        else if (scaler_type_ == SCALER_MINMAX)
+        {
+            features[f] = descriptor[f]*scaler_a_[f] + scaler_b_[f];
+        }
+        else
+        {
+            features[f] = descriptor[f];
+        }
+    }
+}
+
+void PartsClassifier::predictForest(const vector<double>& features, vector<double>& probabilities) const
+{
+    for (size_t t = 0; t < trees_.size(); t++)
+    {
+        const Tree& tree = trees_[t];
+        int node = 0;
+        while (tree.left[node] >= 0)
+        {
+            // sklearn trees split on float32 features against double thresholds
+            float value = static_cast<float>(features[tree.feature[node]]);
+            node = (value <= tree.threshold[node]) ? tree.left[node] : tree.right[node];
+        }
+        for (int c = 0; c < num_classes_; c++)
+        {
+            probabilities[c] += tree.distribution[node*num_classes_ + c];
+        }
+    }
+    for (int c = 0; c < num_classes_; c++)
+    {
+        probabilities[c] /= trees_.size();
+    }
+}
+
+void PartsClassifier::predictLinear(const vector<double>& features, vector<double>& probabilities) const
+{
+    size_t rows = intercept_.size();
+    vector<double> decision(rows);
+    for (size_t r = 0; r < rows; r++)
+    {
+        double sum = 0;
+        for (int f = 0; f < num_features_; f++)
+        {
+            sum += features[f]*coef_[r*num_features_ + f];
+        }
+        decision[r] = sum + intercept_[r];
+    }
+
+    if (multinomial_)
+    {
+        // softmax, a binary model scores [-d, d]
+        if (rows == 1)
+        {
+            decision.insert(decision.begin(), -decision[0]);
+        }
+        double max_decision = *max_element(decision.begin(), decision.end());
+        double total = 0;
+        for (int c = 0; c < num_classes_; c++)
+        {
+            probabilities[c] = exp(decision[c] - max_decision);
+            total += probabilities[c];
+        }
+        for (int c = 0; c < num_classes_; c++)
+        {
+            probabilities[c] /= total;
+        }
+    }
+    else if (rows == 1)
+    {
+        double p = 1.0/(1.0 + exp(-decision[0]));
+        probabilities[0] = 1.0 - p;
+        probabilities[1] = p;
+    }
+    else
+    {
+        // one-vs-rest sigmoids normalized to sum to one
+        double total = 0;
+        for (int c = 0; c < num_classes_; c++)
+        {
+            probabilities[c] = 1.0/(1.0 + exp(-decision[c]));
+            total += probabilities[c];
+        }
+        for (int c = 0; c < num_classes_; c++)
+        {
+            probabilities[c] /= total;
+        }
+    }
+}
+
+void PartsClassifier::predictKnn(const vector<double>& features, vector<double>& probabilities) const
+{
+    size_t num_samples = sample_labels_.size();
+    vector<pair<double, int> > distances(num_samples);
+    for (size_t s = 0; s < num_samples; s++)
+    {
+        double sum = 0;
+        for (int f = 0; f < num_features_; f++)
+        {
+            double d = features[f] - samples_[s*num_features_ + f];
+            sum += d*d;
+        }
+        distances[s] = make_pair(sqrt(sum), static_cast<int>(s));
+    }
+    partial_sort(distances.begin(), distances.begin() + k_, distances.end());
+
+    // distance weighting gives exact matches all the weight, like sklearn
+    bool exact_match = distance_weights_ && distances[0].first == 0;
+    double total = 0;
+    for (int i = 0; i < k_; i++)
+    {
+        double weight = 1.0;
+        if (distance_weights_)
+        {
+            weight = exact_match ? (distances[i].first == 0 ? 1.0 : 0.0) : 1.0/distances[i].first;
+        }
+        probabilities[sample_labels_[distances[i].second]] += weight;
+        total += weight;
+    }
+    for (int c = 0; c < num_classes_; c++)
+    {
+        probabilities[c] /= total;
+    }
+}
@@ -0,0 +1,113 @@
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <pcl/io/pcd_io.h>
+#include <pcl/console/print.h>
+#include <pcl/console/parse.h>
+#include <pcl/console/time.h>
+#include "rail_object_recognition/EsfDescriptor.h"
+
+using namespace std;
+using namespace pcl::console;
+
+void printHelp(int, char **argv)
+{
+    print_error("Syntax is: %s manifest.csv output.csv <options>\n", argv[0]);
+    print_info("  manifest.csv lists one training cloud per line as: object_name,label,cloud.pcd\n");
+    print_info("  (relative cloud paths are resolved against the manifest directory)\n");
+    print_info("  output.csv is written in the data/dataset.csv format: Objects,Labels,640 x Features\n");
+    print_info("  where options are:\n");
+    print_info("                     -threads X = number of threads, 0 uses every core (default: 0)\n");
+}
+
+string directoryOf(const string& path)
+{
+    string::size_type slash = path.rfind('/');
+    return slash == string::npos ? "" : path.substr(0, slash + 1);
+}
+
+int main(int argc, char** argv)
+{
+    print_info("Compute ESF descriptors for a training set. For more information, use: %s -h\n", argv[0]);
+    vector<int> csv_file_indices = parse_file_extension_argument(argc, argv, ".csv");
+    if (find_switch(argc, argv, "-h") || csv_file_indices.size() != 2)
+    {
+        printHelp(argc, argv);
+        return (find_switch(argc, argv, "-h") ? 0 : -1);
+    }
+    int num_threads = 0;
+    parse_argument(argc, argv, "-threads", num_threads);
+
+    string manifest_file = argv[csv_file_indices[0]];
+    string output_file = argv[csv_file_indices[1]];
+    ifstream manifest(manifest_file.c_str());
+    if (!manifest)
+    {
+        print_error("Could not open manifest %s\n", manifest_file.c_str());
+        return -1;
+    }
+
+    // loads every listed cloud
+    vector<string> objects, labels;
+    vector<pcl::PointCloud<pcl::PointXYZ>::Ptr> clouds;
+    string line;
+    while (getline(manifest, line))
+    {
+        stringstream fields(line);
+        string object, label, cloud_file;
+        if (!getline(fields, object, ',') || !getline(fields, label, ',') || !getline(fields, cloud_file))
+        {
+            continue;
+        }
+        if (!cloud_file.empty() && cloud_file[0] != '/')
+        {
+            cloud_file = directoryOf(manifest_file) + cloud_file;
+        }
+
+        pcl::PointCloud<pcl::PointXYZ>::Ptr cloud(new pcl::PointCloud<pcl::PointXYZ>);
+        if (pcl::io::loadPCDFile<pcl::PointXYZ>(cloud_file, *cloud) < 0)
+        {
+            print_warn("Skipping %s, could not load %s\n", object.c_str(), cloud_file.c_str());
+            continue;
+        }
+        objects.push_back(object);
+        labels.push_back(label);
+        clouds.push_back(cloud);
+    }
+
+    TicToc tt;
+    tt.tic();
+    vector<vector<double> > descriptors;
+    computeEsfDescriptors(clouds, descriptors, num_threads);
+    print_info("Computed ");
+    print_value("%lu", descriptors.size());
+    print_info(" descriptors in ");
+    print_value("%g", tt.toc());
+    print_info(" ms\n");
+
+    ofstream output(output_file.c_str());
+    if (!output)
+    {
+        print_error("Could not write %s\n", output_file.c_str());
+        return -1;
+    }
+    output << "Objects,Labels";
+    for (int d = 0; d < ESF_DESCRIPTOR_LENGTH; d++)
+    {
+        output << ",Features";
+    }
+    output << "\n";
+    output.precision(12);
+    for (size_t i = 0; i < descriptors.size(); i++)
+    {
+        output << objects[i] << "," << labels[i];
+        for (size_t d = 0; d < descriptors[i].size(); d++)
+        {
+            output << "," << descriptors[i][d];
+        }
+        output << "\n";
+    }
+    return 0;
+}
@@ -0,0 +1,168 @@
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <pcl/io/pcd_io.h>
+#include <pcl/console/print.h>
+#include <pcl/console/parse.h>
+#include "rail_object_recognition/GeometricClassifier.h"
+
+using namespace std;
+using namespace pcl::console;
+
+void printHelp(int, char **argv)
+{
+    print_error("Syntax is: %s manifest.csv rules.yaml <options>\n", argv[0]);
+    print_info("  manifest.csv lists one training cloud per line as: object_name,label,cloud.pcd\n");
+    print_info("  (relative cloud paths are resolved against the manifest directory)\n");
+    print_info("  rules.yaml is written as a geometric_rules parameter for the recognition node, one rule per label\n");
+    print_info("  where options are:\n");
+    print_info("                     -first_label X = label of the classifier's first output column (default: 1)\n");
+    print_info("                     -padding X = relative slack added to each observed range (default: 0.05)\n");
+    print_info("                     -confidence X = probability reported when a rule fires (default: 0.9)\n");
+    print_info("                     -margin X = margin used when checking the rules on the training set (default: 0.1)\n");
+    print_info("                     -density = also bound point density, only if training and run-time views match\n");
+}
+
+string directoryOf(const string& path)
+{
+    string::size_type slash = path.rfind('/');
+    return slash == string::npos ? "" : path.substr(0, slash + 1);
+}
+
+int main(int argc, char** argv)
+{
+    print_info("Fit bounding box rules for the geometric recognition stage. For more information, use: %s -h\n", argv[0]);
+    vector<int> csv_file_indices = parse_file_extension_argument(argc, argv, ".csv");
+    vector<int> yaml_file_indices = parse_file_extension_argument(argc, argv, ".yaml");
+    if (find_switch(argc, argv, "-h") || csv_file_indices.size() != 1 || yaml_file_indices.size() != 1)
+    {
+        printHelp(argc, argv);
+        return (find_switch(argc, argv, "-h") ? 0 : -1);
+    }
+    int first_label = 1;
+    double padding = 0.05, confidence = 0.9, margin = 0.1;
+    parse_argument(argc, argv, "-first_label", first_label);
+    parse_argument(argc, argv, "-padding", padding);
+    parse_argument(argc, argv, "-confidence", confidence);
+    parse_argument(argc, argv, "-margin", margin);
+    int num_bounded_features = find_switch(argc, argv, "-density") ? NUM_GEOMETRIC_FEATURES : FEATURE_DENSITY;
+
+    string manifest_file = argv[csv_file_indices[0]];
+    ifstream manifest(manifest_file.c_str());
+    if (!manifest)
+    {
+        print_error("Could not open manifest %s\n", manifest_file.c_str());
+        return -1;
+    }
+
+    // features of every listed cloud, grouped into one rule per label
+    map<int, GeometricRule> rules;
+    vector<int> labels;
+    vector<vector<double> > samples;
+    string line;
+    while (getline(manifest, line))
+    {
+        stringstream fields(line);
+        string object, label, cloud_file;
+        if (!getline(fields, object, ',') || !getline(fields, label, ',') || !getline(fields, cloud_file))
+        {
+            continue;
+        }
+        if (!cloud_file.empty() && cloud_file[0] != '/')
+        {
+            cloud_file = directoryOf(manifest_file) + cloud_file;
+        }
+
+        pcl::PointCloud<pcl::PointXYZ> cloud;
+        if (pcl::io::loadPCDFile<pcl::PointXYZ>(cloud_file, cloud) < 0)
+        {
+            print_warn("Skipping %s, could not load %s\n", object.c_str(), cloud_file.c_str());
+            continue;
+        }
+        vector<double> features;
+        GeometricClassifier::computeFeatures(cloud, features);
+
+        int label_value = atoi(label.c_str());
+        if (rules.find(label_value) == rules.end())
+        {
+            GeometricRule& rule = rules[label_value];
+            rule.name = object;
+            rule.class_index = label_value - first_label;
+            rule.confidence = confidence;
+            for (int f = 0; f < num_bounded_features; f++)
+            {
+                rule.min[f] = features[f];
+                rule.max[f] = features[f];
+            }
+        }
+        GeometricRule& rule = rules[label_value];
+        for (int f = 0; f < num_bounded_features; f++)
+        {
+            rule.min[f] = min(rule.min[f], features[f]);
+            rule.max[f] = max(rule.max[f], features[f]);
+        }
+        labels.push_back(label_value);
+        samples.push_back(features);
+    }
+
+    GeometricClassifier classifier;
+    classifier.setMargin(margin);
+    int num_classes = 0;
+    for (map<int, GeometricRule>::iterator it = rules.begin(); it != rules.end(); ++it)
+    {
+        for (int f = 0; f < num_bounded_features; f++)
+        {
+            it->second.min[f] *= 1.0 - padding;
+            it->second.max[f] *= 1.0 + padding;
+        }
+        classifier.addRule(it->second);
+        num_classes = max(num_classes, it->second.class_index + 1);
+    }
+
+    // how much of the training set the rules settle on their own, the rest falls through to ESF
+    map<int, int> total, confident, wrong;
+    for (size_t i = 0; i < samples.size(); i++)
+    {
+        vector<double> probabilities;
+        total[labels[i]]++;
+        if (classifier.classify(samples[i], num_classes, probabilities))
+        {
+            confident[labels[i]]++;
+            int prediction = max_element(probabilities.begin(), probabilities.end()) - probabilities.begin();
+            wrong[labels[i]] += (prediction != labels[i] - first_label);
+        }
+    }
+    for (map<int, GeometricRule>::iterator it = rules.begin(); it != rules.end(); ++it)
+    {
+        print_info("%s: ", it->second.name.c_str());
+        print_value("%d", confident[it->first]);
+        print_info(" of %d classified by bounding box, ", total[it->first]);
+        print_value("%d", wrong[it->first]);
+        print_info(" wrong\n");
+    }
+
+    ofstream output(argv[yaml_file_indices[0]]);
+    if (!output)
+    {
+        print_error("Could not write %s\n", argv[yaml_file_indices[0]]);
+        return -1;
+    }
+    output.precision(6);
+    output << "geometric_rules:\n";
+    for (map<int, GeometricRule>::iterator it = rules.begin(); it != rules.end(); ++it)
+    {
+        const GeometricRule& rule = it->second;
+        output << "  - name: " << rule.name << "\n";
+        output << "    class_index: " << rule.class_index << "\n";
+        output << "    confidence: " << rule.confidence << "\n";
+        for (int f = 0; f < num_bounded_features; f++)
+        {
+            output << "    " << GEOMETRIC_FEATURE_NAMES[f] << ": [" << rule.min[f] << ", " << rule.max[f] << "]\n";
+        }
+    }
+    return 0;
+}
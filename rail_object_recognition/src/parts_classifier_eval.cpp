@@ -0,0 +1,118 @@
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "rail_object_recognition/PartsClassifier.h"
+
+using namespace std;
+
+// reads comma separated rows, skipping the first skip_columns fields of each row
+static void readCsv(const string& filename, bool header, size_t skip_columns, vector<vector<double> >& rows,
+                    vector<string>* skipped = NULL)
+{
+    ifstream in(filename.c_str());
+    string line;
+    if (header)
+    {
+        getline(in, line);
+    }
+    while (getline(in, line))
+    {
+        stringstream fields(line);
+        string field;
+        vector<double> row;
+        for (size_t column = 0; getline(fields, field, ','); column++)
+        {
+            if (column < skip_columns)
+            {
+                if (skipped && column == skip_columns - 1)
+                {
+                    skipped->push_back(field);
+                }
+                continue;
+            }
+            row.push_back(atof(field.c_str()));
+        }
+        if (!row.empty())
+        {
+            rows.push_back(row);
+        }
+    }
+}
+
+static size_t argmax(const vector<double>& values)
+{
+    size_t best = 0;
+    for (size_t i = 1; i < values.size(); i++)
+    {
+        if (values[i] > values[best])
+        {
+            best = i;
+        }
+    }
+    return best;
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 3)
+    {
+        printf("Usage: %s model.parts dataset.csv [expected.csv]\n", argv[0]);
+        printf("  evaluates an exported parts classifier on a dataset (data/dataset.csv layout), optionally\n");
+        printf("  comparing against the probabilities written by export_parts_classifier.py --expected\n");
+        return -1;
+    }
+
+    PartsClassifier classifier;
+    if (!classifier.load(argv[1]))
+    {
+        printf("Could not load model %s\n", argv[1]);
+        return -1;
+    }
+
+    vector<vector<double> > descriptors, expected;
+    vector<string> labels;
+    readCsv(argv[2], true, 2, descriptors, &labels);
+    if (argc > 3)
+    {
+        readCsv(argv[3], false, 0, expected);
+        if (expected.size() != descriptors.size())
+        {
+            printf("Expected %lu rows of probabilities, found %lu\n", descriptors.size(), expected.size());
+            return -1;
+        }
+    }
+
+    size_t correct = 0, same_prediction = 0;
+    double max_difference = 0;
+    for (size_t i = 0; i < descriptors.size(); i++)
+    {
+        vector<double> probabilities;
+        classifier.predictProba(descriptors[i], probabilities);
+        size_t prediction = argmax(probabilities);
+        if (classifier.classes()[prediction] == atof(labels[i].c_str()))
+        {
+            correct++;
+        }
+        if (!expected.empty())
+        {
+            same_prediction += (argmax(expected[i]) == prediction);
+            for (size_t c = 0; c < probabilities.size() && c < expected[i].size(); c++)
+            {
+                max_difference = fmax(max_difference, fabs(probabilities[c] - expected[i][c]));
+            }
+        }
+    }
+
+    printf("Accuracy: %lu / %lu\n", correct, descriptors.size());
+    if (!expected.empty())
+    {
+        printf("Same prediction as the pickled model: %lu / %lu, max probability difference %g\n",
+               same_prediction, descriptors.size(), max_difference);
+        return same_prediction == descriptors.size() ? 0 : 1;
+    }
+    return 0;
+}
@@ -2,6 +2,7 @@
 #define RAIL_SEGMENTATION_TOOLS_MERGER_H_
 
 // ROS
+#include <pcl_conversions/pcl_conversions.h>
 #include <pcl_ros/point_cloud.h>
 #include <pcl_ros/transforms.h>
 #include <rail_manipulation_msgs/ProcessSegmentedObjects.h>
@@ -11,6 +12,7 @@
 #include <sensor_msgs/PointCloud2.h>
 #include <sensor_msgs/point_cloud_conversion.h>
 #include <visualization_msgs/MarkerArray.h>
+#include "rail_segmentation_tools/SegmentFeatures.h"
 
 // PCL
 #include <pcl/common/common.h>
@@ -27,9 +29,24 @@
 #include <pcl/segmentation/region_growing_rgb.h>
 #include <pcl/segmentation/sac_segmentation.h>
 
+// Boost
+#include <boost/bind.hpp>
+#include <boost/thread/thread.hpp>
+
 // C++ Standard Library
 #include <fstream>
 #include <string>
+#include <vector>
+
+/*!
+ * \brief A segment decoded once per merge request, with its bounding box and a lazily built kd-tree.
+ */
+struct CachedSegment
+{
+  pcl::PointCloud<pcl::PointXYZRGB>::Ptr cloud;
+  pcl::KdTreeFLANN<pcl::PointXYZRGB>::Ptr kdtree;
+  pcl::PointXYZRGB min_pt, max_pt;
+};
 
 class Merger
 {
@@ -43,6 +60,14 @@ private:
   bool mergeCallback(rail_manipulation_msgs::ProcessSegmentedObjects::Request &req,
       rail_manipulation_msgs::ProcessSegmentedObjects::Response &res);
 
+  static size_t findRoot(std::vector<size_t> &parent, size_t i);
+
+  bool withinMergeDistance(CachedSegment &a, CachedSegment &b);
+
+  static void calculateMergedFeatures(const std::vector<size_t> &merged_indices,
+      const std::vector<pcl::PointCloud<pcl::PointXYZRGB>::Ptr> &merged_clouds,
+      std::vector<rail_manipulation_msgs::SegmentedObject> &merged_objects, unsigned int first, unsigned int stride);
+
   double merge_dst;
   double color_delta;
 
@@ -52,7 +77,6 @@ private:
   ros::Publisher segmented_objects_pub;
   ros::Publisher markers_pub;
   ros::ServiceServer merge_srv;
-  ros::ServiceClient calculate_featuers_client;
 };
 
 #endif
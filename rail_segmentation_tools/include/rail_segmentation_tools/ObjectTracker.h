@@ -0,0 +1,90 @@
+#ifndef RAIL_SEGMENTATION_TOOLS_OBJECT_TRACKER_H_
+#define RAIL_SEGMENTATION_TOOLS_OBJECT_TRACKER_H_
+
+// ROS
+#include <rail_manipulation_msgs/SegmentedObjectList.h>
+#include <rail_segmentation_tools/TrackedObjectList.h>
+#include <ros/ros.h>
+#include <tf/transform_listener.h>
+
+// C++ Standard Library
+#include <string>
+#include <vector>
+
+/*!
+ * \brief Track state of one object, with positions in the fixed frame.
+ */
+struct ObjectTrack
+{
+  unsigned int id;
+  tf::Vector3 position;
+  tf::Vector3 velocity;
+  tf::Vector3 reported_position;        // position when the object was last reported as changed
+  double extents[3];                    // bounding volume dimensions, largest first
+  double reported_extents[3];
+  double cielab[3];
+  ros::Time stamp;
+  int misses;                           // consecutive lists the track went unmatched in
+};
+
+/*!
+ * \brief Gives segmented objects identities that persist across segmentation results.
+ *
+ * Each incoming list is associated with the existing tracks greedily by a cost combining the distance from the
+ * constant velocity prediction, the change in sorted bounding volume extents and the CIELAB color difference, each
+ * gated by its own limit. Positions are tracked in a fixed frame so base and head motion do not look like object
+ * motion. Every published object carries its track id and a changed flag that is set for new objects and whenever
+ * the object has moved or changed size beyond a tolerance since it was last reported as changed. Tracks that go
+ * unmatched are reported as removed, and are kept for a few lists so a briefly occluded object gets its id back.
+ */
+class ObjectTracker
+{
+public:
+  static constexpr double DEFAULT_MAX_DISTANCE = 0.1;
+  static constexpr double DEFAULT_MAX_EXTENT_CHANGE = 0.05;
+  static constexpr double DEFAULT_MAX_COLOR_DISTANCE = 25.0;
+  static constexpr double DEFAULT_POSITION_TOLERANCE = 0.01;
+  static constexpr double DEFAULT_EXTENT_TOLERANCE = 0.01;
+  static constexpr double DEFAULT_VELOCITY_GAIN = 0.5;
+  static constexpr int DEFAULT_MAX_MISSES = 3;
+
+  ObjectTracker();
+
+private:
+  void objectsCallback(const rail_manipulation_msgs::SegmentedObjectList &list);
+
+  /*!
+   * \brief Look up the transform from the list frame to the fixed frame.
+   */
+  bool lookupFrame(const std_msgs::Header &header, tf::StampedTransform &transform);
+
+  /*!
+   * \brief Association cost of an object with a track, negative if any gate is exceeded.
+   */
+  double associationCost(const ObjectTrack &track, const tf::Vector3 &position, const double extents[3],
+      const double cielab[3], double dt) const;
+
+  static void sortedExtents(const rail_manipulation_msgs::SegmentedObject &object, double extents[3]);
+
+  static void objectColor(const rail_manipulation_msgs::SegmentedObject &object, double cielab[3]);
+
+  std::string fixed_frame;
+  double max_distance;
+  double max_extent_change;
+  double max_color_distance;
+  double position_tolerance;
+  double extent_tolerance;
+  double velocity_gain;
+  int max_misses;
+
+  std::vector<ObjectTrack> tracks;
+  std::vector<unsigned int> published_ids;
+  unsigned int next_id;
+
+  ros::NodeHandle n, pn;
+  tf::TransformListener tf_listener;
+  ros::Subscriber objects_sub;
+  ros::Publisher tracked_objects_pub;
+};
+
+#endif
@@ -0,0 +1,43 @@
+#ifndef RAIL_SEGMENTATION_TOOLS_SEGMENT_FEATURES_H_
+#define RAIL_SEGMENTATION_TOOLS_SEGMENT_FEATURES_H_
+
+// ROS
+#include <pcl_conversions/pcl_conversions.h>
+#include <rail_manipulation_msgs/SegmentedObject.h>
+#include <visualization_msgs/Marker.h>
+
+// PCL
+#include <pcl/point_cloud.h>
+#include <pcl/point_types.h>
+
+/*!
+ * \brief Segmented object features computed in-process from an already decoded point cloud.
+ *
+ * Fills in the same fields as rail_segmentation's calculate_features service (point cloud, marker, center,
+ * centroid, dimensions, oriented bounding volume and average RGB/CIELAB color) without a round trip.
+ */
+class SegmentFeatures
+{
+public:
+  static constexpr double MARKER_SCALE = 0.01;
+  static constexpr double DOWNSAMPLE_LEAF_SIZE = 0.01;
+
+  /*!
+   * \brief Calculate all features of an object from its point cloud, which must not be empty.
+   */
+  static void calculate(const pcl::PointCloud<pcl::PointXYZRGB>::ConstPtr &cloud,
+      rail_manipulation_msgs::SegmentedObject &object);
+
+  /*!
+   * \brief Create a downsampled cube list marker colored with the given average color.
+   */
+  static visualization_msgs::Marker createMarker(const pcl::PointCloud<pcl::PointXYZRGB>::ConstPtr &cloud,
+      double r, double g, double b);
+
+  /*!
+   * \brief Convert an sRGB color (0-255 per channel) to CIELAB under the D65 white point.
+   */
+  static void rgbToCielab(double r, double g, double b, double &l, double &a, double &lab_b);
+};
+
+#endif
@@ -0,0 +1,113 @@
+#ifndef RAIL_SEGMENTATION_TOOLS_SEGMENTATION_CACHE_H_
+#define RAIL_SEGMENTATION_TOOLS_SEGMENTATION_CACHE_H_
+
+// ROS
+#include <pcl_conversions/pcl_conversions.h>
+#include <pcl_ros/transforms.h>
+#include <rail_manipulation_msgs/ProcessSegmentedObjects.h>
+#include <rail_manipulation_msgs/SegmentedObjectList.h>
+#include <rail_manipulation_msgs/SegmentObjects.h>
+#include <ros/ros.h>
+#include <sensor_msgs/PointCloud2.h>
+#include <std_srvs/Empty.h>
+#include <tf/transform_listener.h>
+
+// PCL
+#include <pcl/filters/filter.h>
+#include <pcl/filters/voxel_grid.h>
+#include <pcl/octree/octree_pointcloud_changedetector.h>
+#include <pcl/point_types.h>
+#include <pcl/point_cloud.h>
+
+// C++ Standard Library
+#include <set>
+#include <string>
+#include <vector>
+
+/*!
+ * \brief Change-gated proxy for rail_segmentation.
+ *
+ * Keeps the last segmentation result together with the (downsampled) cloud it came from, expressed in a fixed
+ * frame so that base and head motion are compensated through TF. A segmentation request re-segments only when
+ * octree change detection finds more than a fixed number of voxels added or removed between the current and cached
+ * clouds, or when the base has moved relative to the frame the cached objects are expressed in; otherwise the cached
+ * object list is returned. The voxel count is absolute, so one small part changing is caught however large the frame.
+ */
+class SegmentationCache
+{
+public:
+  static constexpr double DEFAULT_RESOLUTION = 0.02;
+  // two frames of a static table scene differ by at most 2 voxels of 4+ points from depth noise alone, while a 3 cm
+  // part changes at least 5; with 2 points per voxel the noise alone reaches 35
+  static constexpr int DEFAULT_MAX_CHANGED_VOXELS = 4;
+  static constexpr int DEFAULT_MIN_POINTS_PER_VOXEL = 4;
+  static constexpr double DEFAULT_MAX_BASE_TRANSLATION = 0.01;
+  static constexpr double DEFAULT_MAX_BASE_ROTATION = 0.02;
+  static constexpr double DEFAULT_CLOUD_TIMEOUT = 1.0;
+
+  SegmentationCache();
+
+private:
+  void cloudCallback(const sensor_msgs::PointCloud2ConstPtr &msg);
+
+  bool segmentCallback(rail_manipulation_msgs::SegmentObjects::Request &req,
+      rail_manipulation_msgs::SegmentObjects::Response &res);
+
+  /*!
+   * \brief Return the cached objects without publishing them, fails instead of re-segmenting if the scene changed.
+   */
+  bool cachedCallback(rail_manipulation_msgs::SegmentObjects::Request &req,
+      rail_manipulation_msgs::SegmentObjects::Response &res);
+
+  bool clearCallback(std_srvs::Empty::Request &req, std_srvs::Empty::Response &res);
+
+  /*!
+   * \brief Downsample the latest cloud and transform it into the fixed frame, fails if no recent cloud exists.
+   */
+  bool prepareCloud(pcl::PointCloud<pcl::PointXYZ>::Ptr &cloud);
+
+  /*!
+   * \brief Look up the current pose of the given frame in the fixed frame.
+   */
+  bool lookupFrame(const std::string &frame, tf::StampedTransform &transform);
+
+  /*!
+   * \brief Check the base motion and the octree change between the current and cached clouds.
+   */
+  bool sceneUnchanged(const pcl::PointCloud<pcl::PointXYZ>::Ptr &cloud);
+
+  /*!
+   * \brief Count the octree voxels occupied by new_cloud but not by old_cloud.
+   */
+  size_t countNewVoxels(const pcl::PointCloud<pcl::PointXYZ>::Ptr &old_cloud,
+      const pcl::PointCloud<pcl::PointXYZ>::Ptr &new_cloud);
+
+  std::string fixed_frame;
+  double resolution;
+  int max_changed_voxels;
+  int min_points_per_voxel;
+  double max_base_translation;
+  double max_base_rotation;
+  double cloud_timeout;
+  bool merge;
+  bool republish_segmented_objects;
+
+  sensor_msgs::PointCloud2ConstPtr latest_cloud;
+
+  bool cache_valid;
+  pcl::PointCloud<pcl::PointXYZ>::Ptr cached_cloud;
+  rail_manipulation_msgs::SegmentedObjectList cached_objects;
+  tf::StampedTransform cached_objects_frame;
+
+  ros::NodeHandle n, pn;
+  tf::TransformListener tf_listener;
+  ros::Subscriber cloud_sub;
+  ros::Publisher segmented_objects_pub;
+  ros::ServiceServer segment_srv;
+  ros::ServiceServer cached_srv;
+  ros::ServiceServer clear_srv;
+  ros::ServiceClient segment_client;
+  ros::ServiceClient merge_client;
+};
+
+#endif
@@ -0,0 +1,115 @@
+#ifndef RAIL_SEGMENTATION_TOOLS_TABLE_PLANE_ESTIMATOR_H_
+#define RAIL_SEGMENTATION_TOOLS_TABLE_PLANE_ESTIMATOR_H_
+
+// Eigen
+#include <Eigen/Core>
+#include <Eigen/Geometry>
+
+// PCL
+#include <pcl/point_cloud.h>
+#include <pcl/point_types.h>
+
+// C++ Standard Library
+#include <vector>
+
+/*!
+ * \brief Warm-started estimator for the dominant plane perpendicular to an axis, e.g. a table top.
+ *
+ * Each call samples the cloud (every few rows and columns of an organized cloud, a strided subset otherwise),
+ * transforms the samples into the estimation frame and crops them to the workspace bounds. The previous plane is
+ * then refined by iteratively reweighted least squares over the points in a band around it. RANSAC on the samples
+ * is only run when there is no previous plane or the refined one loses its inliers or tilts past the angle limit.
+ */
+class TablePlaneEstimator
+{
+public:
+  static constexpr double DEFAULT_DISTANCE_THRESHOLD = 0.01;
+  static constexpr double DEFAULT_INLIER_BAND = 0.03;
+  static constexpr double DEFAULT_EPS_ANGLE = 0.15;
+  static constexpr int DEFAULT_ROW_STRIDE = 8;
+  static constexpr int DEFAULT_COLUMN_STRIDE = 8;
+  static constexpr int DEFAULT_MAX_SAMPLES = 5000;
+  static constexpr int DEFAULT_MIN_INLIERS = 200;
+  static constexpr double DEFAULT_MIN_INLIER_RATIO = 0.5;
+  static constexpr int DEFAULT_REFINE_ITERATIONS = 3;
+  static constexpr int DEFAULT_RANSAC_ITERATIONS = 100;
+
+  /*!
+   * \brief A plane n.p + d = 0 with the normal n on the side of the axis.
+   */
+  struct Plane
+  {
+    Eigen::Vector4f coefficients;
+    Eigen::Vector3f center;  // centroid of the inliers
+    int inliers;
+    bool warm_started;       // refined from the previous plane without RANSAC
+
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+  };
+
+  TablePlaneEstimator();
+
+  void setAxis(const Eigen::Vector3f &axis) { axis_ = axis.normalized(); }
+  void setEpsAngle(double eps_angle) { eps_angle_ = eps_angle; }
+  void setDistanceThreshold(double distance_threshold) { distance_threshold_ = distance_threshold; }
+  void setInlierBand(double inlier_band) { inlier_band_ = inlier_band; }
+  void setSampling(int row_stride, int column_stride, int max_samples);
+  void setMinInliers(int min_inliers, double min_inlier_ratio);
+  void setIterations(int refine_iterations, int ransac_iterations);
+  void setBounds(const Eigen::Vector3f &min_pt, const Eigen::Vector3f &max_pt);
+
+  /*!
+   * \brief Forget the previous plane, so the next estimate runs RANSAC.
+   */
+  void reset() { has_previous_ = false; }
+
+  /*!
+   * \brief Estimate the plane in the frame given by transform (cloud frame to estimation frame).
+   *
+   * Returns false if neither the warm start nor RANSAC finds a plane with enough inliers, keeping the previous plane
+   * as the seed for the next call.
+   */
+  template<typename PointT>
+  bool estimate(const pcl::PointCloud<PointT> &cloud, const Eigen::Affine3f &transform, Plane &plane);
+
+  /*!
+   * \brief Signed distance of a point from a plane, positive on the side of the normal.
+   */
+  static float distance(const Eigen::Vector4f &coefficients, const Eigen::Vector3f &point)
+  {
+    return coefficients.head<3>().dot(point) + coefficients[3];
+  }
+
+private:
+  template<typename PointT>
+  void addSample(const PointT &point, const Eigen::Affine3f &transform);
+
+  /*!
+   * \brief Reweighted least squares from a seed plane, false if it ends with too few inliers or too much tilt.
+   */
+  bool refine(const Eigen::Vector4f &seed, Plane &plane) const;
+
+  /*!
+   * \brief RANSAC for a plane within eps_angle of the axis, followed by refinement.
+   */
+  bool ransac(Plane &plane) const;
+
+  Eigen::Vector3f axis_;
+  double eps_angle_;
+  double distance_threshold_;
+  double inlier_band_;
+  int row_stride_, column_stride_, max_samples_;
+  int min_inliers_;
+  double min_inlier_ratio_;
+  int refine_iterations_, ransac_iterations_;
+  Eigen::Vector3f min_pt_, max_pt_;
+
+  std::vector<Eigen::Vector3f, Eigen::aligned_allocator<Eigen::Vector3f> > samples_;
+  bool has_previous_;
+  Plane previous_;
+
+public:
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+};
+
+#endif
@@ -0,0 +1,48 @@
+#ifndef RAIL_SEGMENTATION_TOOLS_TABLE_PLANE_PUBLISHER_H_
+#define RAIL_SEGMENTATION_TOOLS_TABLE_PLANE_PUBLISHER_H_
+
+// ROS
+#include <pcl_conversions/pcl_conversions.h>
+#include <rail_segmentation_tools/TablePlane.h>
+#include <ros/ros.h>
+#include <sensor_msgs/PointCloud2.h>
+#include <tf/transform_listener.h>
+#include <tf_conversions/tf_eigen.h>
+#include "rail_segmentation_tools/TablePlaneEstimator.h"
+
+// PCL
+#include <pcl/point_types.h>
+#include <pcl/point_cloud.h>
+
+// C++ Standard Library
+#include <string>
+
+/*!
+ * \brief Publishes the table plane under the camera as a latched, stamped topic shared by the perception nodes.
+ *
+ * Every incoming cloud (at most one per min_period) is sampled and fit with a TablePlaneEstimator in the given
+ * frame, so consumers read the current table instead of running their own plane segmentation.
+ */
+class TablePlanePublisher
+{
+public:
+  static constexpr double DEFAULT_MIN_PERIOD = 0.1;
+
+  TablePlanePublisher();
+
+private:
+  void cloudCallback(const sensor_msgs::PointCloud2ConstPtr &msg);
+
+  std::string frame;
+  double min_period;
+  ros::Time last_estimate_time;
+
+  TablePlaneEstimator estimator;
+
+  ros::NodeHandle n, pn;
+  tf::TransformListener tf_listener;
+  ros::Subscriber cloud_sub;
+  ros::Publisher table_plane_pub;
+};
+
+#endif
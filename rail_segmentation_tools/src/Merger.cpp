@@ -19,8 +19,6 @@ Merger::Merger() : pn("~")
   segmented_objects_pub =
       n.advertise<rail_manipulation_msgs::SegmentedObjectList>("rail_segmentation/segmented_objects", 1, true);
   markers_pub = pn.advertise<visualization_msgs::MarkerArray>("markers", 1, true);
-  calculate_featuers_client =
-      n.serviceClient<rail_manipulation_msgs::ProcessSegmentedObjects>("rail_segmentation/calculate_features");
   merge_srv = pn.advertiseService("merge_objects", &Merger::mergeCallback, this);
 }
 
@@ -31,103 +29,111 @@ bool Merger::mergeCallback(rail_manipulation_msgs::ProcessSegmentedObjects::Requ
   input_list.header = req.segmented_objects.header;
   input_list.cleared = req.segmented_objects.cleared;
   input_list.objects = req.segmented_objects.objects;
-  vector<rail_manipulation_msgs::SegmentedObject> merged_objects;
 
   for (size_t i = 0; i < input_list.objects.size(); i ++)
   {
     std::cout << input_list.objects[i].cielab[1] << ", " << input_list.objects[i].cielab[2] << std::endl;
   }
 
-  bool merging = true;
-  while (merging && input_list.objects.size() > 1)
+  // decode each object once, the kd-trees are built on first use
+  size_t num_objects = input_list.objects.size();
+  vector<CachedSegment> segments(num_objects);
+  for (size_t i = 0; i < num_objects; i++)
+  {
+    segments[i].cloud.reset(new pcl::PointCloud<pcl::PointXYZRGB>);
+    pcl::fromROSMsg(input_list.objects[i].point_cloud, *segments[i].cloud);
+    if (!segments[i].cloud->empty())
+    {
+      pcl::getMinMax3D(*segments[i].cloud, segments[i].min_pt, segments[i].max_pt);
+    }
+  }
+
+  // single pass over all pairs, merges are resolved transitively with union-find
+  vector<size_t> parent(num_objects);
+  vector<size_t> component_size(num_objects, 1);
+  for (size_t i = 0; i < num_objects; i++)
+  {
+    parent[i] = i;
+  }
+  std::cout << "Checking for merges over input list size: " << num_objects << std::endl;
+  for (size_t i = 0; i < num_objects; i++)
   {
-    std::cout << "Checking for merges over input list size: " << input_list.objects.size() << std::endl;
-    merging = false;
-    for (size_t i = 0; i < input_list.objects.size(); i++)
+    for (size_t j = i + 1; j < num_objects; j++)
     {
-      if (i == input_list.objects.size() - 1)
+      size_t root_i = findRoot(parent, i);
+      size_t root_j = findRoot(parent, j);
+      if (root_i == root_j)
       {
-        merged_objects.push_back(input_list.objects[i]);
-        break;
+        continue;
       }
-      bool merged = false;
-      for (size_t j = i + 1; j < input_list.objects.size(); j++)
+
+      // color check
+      if (pow(input_list.objects[i].cielab[1] - input_list.objects[j].cielab[1], 2)
+          + pow(input_list.objects[i].cielab[2] - input_list.objects[j].cielab[2], 2) >= color_delta)
       {
-        // color check
-        if (pow(input_list.objects[i].cielab[1] - input_list.objects[j].cielab[1], 2)
-            + pow(input_list.objects[i].cielab[2] - input_list.objects[j].cielab[2], 2) < color_delta)
-        {
-          // point cloud distance check for merge
-
-          // convert to pcl point clouds
-          pcl::PointCloud<pcl::PointXYZRGB>::Ptr obj1_cloud(new pcl::PointCloud<pcl::PointXYZRGB>);
-          pcl::PointCloud<pcl::PointXYZRGB>::Ptr obj2_cloud(new pcl::PointCloud<pcl::PointXYZRGB>);
-          pcl::PCLPointCloud2::Ptr temp_cloud(new pcl::PCLPointCloud2);
-          pcl_conversions::toPCL(input_list.objects[i].point_cloud, *temp_cloud);
-          pcl::fromPCLPointCloud2(*temp_cloud, *obj1_cloud);
-          pcl_conversions::toPCL(input_list.objects[j].point_cloud, *temp_cloud);
-          pcl::fromPCLPointCloud2(*temp_cloud, *obj2_cloud);
-
-          // search for minimum distance
-          double min_sqr_dst = std::numeric_limits<double>::max();
-          pcl::KdTreeFLANN<pcl::PointXYZRGB> kdtree;
-          kdtree.setInputCloud(obj1_cloud);
-          for (size_t k = 0; k < obj2_cloud->points.size(); k++)
-          {
-            vector<int> indices;
-            vector<float> sqr_dsts;
-            kdtree.nearestKSearch(obj2_cloud->points[k], 1, indices, sqr_dsts);
-            if (sqr_dsts[0] < min_sqr_dst)
-            {
-              min_sqr_dst = sqr_dsts[0];
-            }
-          }
-
-          if (min_sqr_dst < merge_dst)
-          {
-            std::cout << "Merging: " << i << " - " << j << std::endl;
-
-            rail_manipulation_msgs::SegmentedObject merged_object;
-
-            // merge object point clouds
-            pcl::PointCloud<pcl::PointXYZRGB>::Ptr merged_cloud(new pcl::PointCloud<pcl::PointXYZRGB>);
-            *merged_cloud = *obj1_cloud + *obj2_cloud;
-
-            // fill in message data that doesn't need recalculating
-            pcl::toPCLPointCloud2(*merged_cloud, *temp_cloud);
-            pcl_conversions::fromPCL(*temp_cloud, merged_object.point_cloud);
-            // TODO (enhancement): currently this does not tie in with recognition, so merges will be unrecognized
-            merged_object.recognized = false;
-
-            rail_manipulation_msgs::ProcessSegmentedObjects process_objects;
-            process_objects.request.segmented_objects.objects.push_back(merged_object);
-            if (!calculate_featuers_client.call(process_objects))
-            {
-              ROS_INFO("Could not call service to recalculate merged segmented object features!");
-              return false;
-            }
-            merged_object = process_objects.response.segmented_objects.objects[0];
-
-            merged_objects.push_back(merged_object);
-
-            input_list.objects.erase(input_list.objects.begin() + j);
-
-            merged = true;
-            merging = true;
-            break;
-          }
-        }
+        continue;
       }
 
-      if (!merged)
+      // point cloud distance check for merge
+      if (!withinMergeDistance(segments[i], segments[j]))
       {
-        merged_objects.push_back(input_list.objects[i]);
+        continue;
       }
+
+      std::cout << "Merging: " << i << " - " << j << std::endl;
+      if (component_size[root_i] < component_size[root_j])
+      {
+        std::swap(root_i, root_j);
+      }
+      parent[root_j] = root_i;
+      component_size[root_i] += component_size[root_j];
+    }
+  }
+
+  // builds merged objects, each at the position of its lowest index member
+  vector<int> output_index(num_objects, -1);
+  vector<rail_manipulation_msgs::SegmentedObject> merged_objects;
+  vector<pcl::PointCloud<pcl::PointXYZRGB>::Ptr> merged_clouds;
+  for (size_t i = 0; i < num_objects; i++)
+  {
+    size_t root = findRoot(parent, i);
+    if (component_size[root] == 1)
+    {
+      merged_objects.push_back(input_list.objects[i]);
+      merged_clouds.push_back(pcl::PointCloud<pcl::PointXYZRGB>::Ptr());
+    }
+    else if (output_index[root] < 0)
+    {
+      output_index[root] = merged_objects.size();
+      merged_objects.push_back(rail_manipulation_msgs::SegmentedObject());
+      merged_clouds.push_back(pcl::PointCloud<pcl::PointXYZRGB>::Ptr(
+          new pcl::PointCloud<pcl::PointXYZRGB>(*segments[i].cloud)));
+    }
+    else
+    {
+      *merged_clouds[output_index[root]] += *segments[i].cloud;
     }
+  }
 
-    input_list.objects = merged_objects;
-    merged_objects.clear();
+  // recalculates features of every merged object in-process, spread over threads
+  vector<size_t> merged_indices;
+  for (size_t i = 0; i < merged_objects.size(); i++)
+  {
+    if (merged_clouds[i])
+    {
+      merged_indices.push_back(i);
+    }
+  }
+  unsigned int num_threads = std::max(1u, std::min(boost::thread::hardware_concurrency(),
+      static_cast<unsigned int>(merged_indices.size())));
+  boost::thread_group feature_threads;
+  for (unsigned int t = 0; t < num_threads; t++)
+  {
+    feature_threads.create_thread(boost::bind(&Merger::calculateMergedFeatures, boost::cref(merged_indices),
+        boost::cref(merged_clouds), boost::ref(merged_objects), t, num_threads));
   }
+  feature_threads.join_all();
+  input_list.objects = merged_objects;
 
   res.segmented_objects = input_list;
 
@@ -146,6 +152,77 @@ bool Merger::mergeCallback(rail_manipulation_msgs::ProcessSegmentedObjects::Requ
   return true;
 }
 
+size_t Merger::findRoot(vector<size_t> &parent, size_t i)
+{
+  while (parent[i] != i)
+  {
+    parent[i] = parent[parent[i]];
+    i = parent[i];
+  }
+  return i;
+}
+
+bool Merger::withinMergeDistance(CachedSegment &a, CachedSegment &b)
+{
+  if (a.cloud->empty() || b.cloud->empty())
+  {
+    return false;
+  }
+
+  // bounding box gap is a lower bound on the point distance
+  double gap_sqr = 0;
+  for (int d = 0; d < 3; d++)
+  {
+    double gap = std::max(0.0f, std::max(a.min_pt.data[d] - b.max_pt.data[d],
+                                         b.min_pt.data[d] - a.max_pt.data[d]));
+    gap_sqr += gap * gap;
+  }
+  if (gap_sqr >= merge_dst)
+  {
+    return false;
+  }
+
+  // query the smaller cloud against the larger cloud's kd-tree
+  CachedSegment &indexed = (a.cloud->size() >= b.cloud->size()) ? a : b;
+  CachedSegment &query = (&indexed == &a) ? b : a;
+  if (!indexed.kdtree)
+  {
+    indexed.kdtree.reset(new pcl::KdTreeFLANN<pcl::PointXYZRGB>);
+    indexed.kdtree->setInputCloud(indexed.cloud);
+  }
+
+  // only query points near the indexed box can be close enough, stop at the first one that is
+  double margin = sqrt(merge_dst);
+  vector<int> indices(1);
+  vector<float> sqr_dsts(1);
+  for (size_t k = 0; k < query.cloud->points.size(); k++)
+  {
+    const pcl::PointXYZRGB &p = query.cloud->points[k];
+    if (p.x < indexed.min_pt.x - margin || p.x > indexed.max_pt.x + margin
+        || p.y < indexed.min_pt.y - margin || p.y > indexed.max_pt.y + margin
+        || p.z < indexed.min_pt.z - margin || p.z > indexed.max_pt.z + margin)
+    {
+      continue;
+    }
+    if (indexed.kdtree->nearestKSearch(p, 1, indices, sqr_dsts) > 0 && sqr_dsts[0] < merge_dst)
+    {
+      return true;
+    }
+  }
+  return false;
+}
+void Merger::calculateMergedFeatures(const vector<size_t> &merged_indices,
+    const vector<pcl::PointCloud<pcl::PointXYZRGB>::Ptr> &merged_clouds,
+    vector<rail_manipulation_msgs::SegmentedObject> &merged_objects, unsigned int first, unsigned int stride)
+{
+  for (size_t i = first; i < merged_indices.size(); i += stride)
+  {
+    rail_manipulation_msgs::SegmentedObject &merged_object = merged_objects[merged_indices[i]];
+    SegmentFeatures::calculate(merged_clouds[merged_indices[i]], merged_object);
+    // TODO (enhancement): currently this does not tie in with recognition, so merges will be unrecognized
+    merged_object.recognized = false;
+  }
+}
 
 int main(int argc, char **argv)
 {
@@ -0,0 +1,275 @@
+#include "rail_segmentation_tools/ObjectTracker.h"
+
+// C++ Standard Library
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <limits>
+
+using std::string;
+using std::vector;
+
+//constant definitions (to use in functions with reference parameters, e.g. param())
+const double ObjectTracker::DEFAULT_MAX_DISTANCE;
+const double ObjectTracker::DEFAULT_MAX_EXTENT_CHANGE;
+const double ObjectTracker::DEFAULT_MAX_COLOR_DISTANCE;
+const double ObjectTracker::DEFAULT_POSITION_TOLERANCE;
+const double ObjectTracker::DEFAULT_EXTENT_TOLERANCE;
+const double ObjectTracker::DEFAULT_VELOCITY_GAIN;
+const int ObjectTracker::DEFAULT_MAX_MISSES;
+
+// predictions are not extrapolated further than this, so a long gap between lists does not throw objects away
+static const double MAX_PREDICTION_TIME = 1.0;
+
+/*!
+ * \brief A gated object/track pairing, ordered by cost for greedy assignment.
+ */
+struct Association
+{
+  double cost;
+  size_t track;
+  size_t object;
+
+  bool operator<(const Association &other) const { return cost < other.cost; }
+};
+
+ObjectTracker::ObjectTracker() : pn("~"), next_id(0)
+{
+  // grab any parameters we need
+  string segmentation_topic;
+  pn.param<string>("segmentation_topic", segmentation_topic, "rail_segmentation/segmented_objects");
+  pn.param<string>("fixed_frame", fixed_frame, "odom");
+  pn.param("max_distance", max_distance, DEFAULT_MAX_DISTANCE);
+  pn.param("max_extent_change", max_extent_change, DEFAULT_MAX_EXTENT_CHANGE);
+  pn.param("max_color_distance", max_color_distance, DEFAULT_MAX_COLOR_DISTANCE);
+  pn.param("position_tolerance", position_tolerance, DEFAULT_POSITION_TOLERANCE);
+  pn.param("extent_tolerance", extent_tolerance, DEFAULT_EXTENT_TOLERANCE);
+  pn.param("velocity_gain", velocity_gain, DEFAULT_VELOCITY_GAIN);
+  pn.param("max_misses", max_misses, DEFAULT_MAX_MISSES);
+
+  // setup publishers/subscribers we need
+  tracked_objects_pub = pn.advertise<rail_segmentation_tools::TrackedObjectList>("tracked_objects", 1, true);
+  objects_sub = n.subscribe(segmentation_topic, 1, &ObjectTracker::objectsCallback, this);
+}
+
+void ObjectTracker::objectsCallback(const rail_manipulation_msgs::SegmentedObjectList &list)
+{
+  tf::StampedTransform to_fixed;
+  if (!lookupFrame(list.header, to_fixed))
+  {
+    ROS_INFO("Could not transform segmented objects to %s, skipping this list.", fixed_frame.c_str());
+    return;
+  }
+  ros::Time stamp = list.header.stamp.isZero() ? ros::Time::now() : list.header.stamp;
+
+  // object features in the fixed frame
+  size_t num_objects = list.objects.size();
+  vector<tf::Vector3> positions(num_objects);
+  vector<double> extents(3 * num_objects), colors(3 * num_objects);
+  for (size_t i = 0; i < num_objects; i++)
+  {
+    const geometry_msgs::Point &centroid = list.objects[i].centroid;
+    positions[i] = to_fixed * tf::Vector3(centroid.x, centroid.y, centroid.z);
+    sortedExtents(list.objects[i], &extents[3 * i]);
+    objectColor(list.objects[i], &colors[3 * i]);
+  }
+
+  // greedy assignment, cheapest gated pairs first
+  vector<Association> associations;
+  for (size_t t = 0; t < tracks.size(); t++)
+  {
+    double dt = (stamp - tracks[t].stamp).toSec();
+    for (size_t i = 0; i < num_objects; i++)
+    {
+      Association association;
+      association.cost = associationCost(tracks[t], positions[i], &extents[3 * i], &colors[3 * i], dt);
+      association.track = t;
+      association.object = i;
+      if (association.cost >= 0)
+      {
+        associations.push_back(association);
+      }
+    }
+  }
+  std::sort(associations.begin(), associations.end());
+  vector<int> object_track(num_objects, -1);
+  vector<bool> track_matched(tracks.size(), false);
+  for (size_t a = 0; a < associations.size(); a++)
+  {
+    if (!track_matched[associations[a].track] && object_track[associations[a].object] < 0)
+    {
+      track_matched[associations[a].track] = true;
+      object_track[associations[a].object] = associations[a].track;
+    }
+  }
+
+  rail_segmentation_tools::TrackedObjectList tracked;
+  tracked.header = list.header;
+  tracked.objects = list.objects;
+  tracked.ids.resize(num_objects);
+  tracked.changed.resize(num_objects);
+  for (size_t i = 0; i < num_objects; i++)
+  {
+    bool changed;
+    if (object_track[i] >= 0)
+    {
+      // constant velocity model smoothed over updates
+      ObjectTrack &track = tracks[object_track[i]];
+      double dt = (stamp - track.stamp).toSec();
+      if (dt > 0)
+      {
+        tf::Vector3 measured_velocity = (positions[i] - track.position) / dt;
+        track.velocity = velocity_gain * measured_velocity + (1.0 - velocity_gain) * track.velocity;
+      }
+      track.position = positions[i];
+      std::copy(&extents[3 * i], &extents[3 * i] + 3, track.extents);
+      std::copy(&colors[3 * i], &colors[3 * i] + 3, track.cielab);
+      track.stamp = stamp;
+      track.misses = 0;
+
+      // a track that drops out of the published list is re-reported in full when it comes back
+      changed = std::find(published_ids.begin(), published_ids.end(), track.id) == published_ids.end()
+          || track.position.distance(track.reported_position) > position_tolerance;
+      for (int d = 0; d < 3; d++)
+      {
+        changed = changed || fabs(track.extents[d] - track.reported_extents[d]) > extent_tolerance;
+      }
+    }
+    else
+    {
+      ObjectTrack track;
+      track.id = next_id++;
+      track.position = positions[i];
+      track.velocity = tf::Vector3(0, 0, 0);
+      std::copy(&extents[3 * i], &extents[3 * i] + 3, track.extents);
+      std::copy(&colors[3 * i], &colors[3 * i] + 3, track.cielab);
+      track.stamp = stamp;
+      track.misses = 0;
+      object_track[i] = tracks.size();
+      tracks.push_back(track);
+      track_matched.push_back(true);
+      changed = true;
+    }
+
+    ObjectTrack &track = tracks[object_track[i]];
+    if (changed)
+    {
+      track.reported_position = track.position;
+      std::copy(track.extents, track.extents + 3, track.reported_extents);
+    }
+    tracked.ids[i] = track.id;
+    tracked.changed[i] = changed;
+  }
+
+  // everything published last time and not matched now is removed for consumers
+  for (size_t p = 0; p < published_ids.size(); p++)
+  {
+    if (std::find(tracked.ids.begin(), tracked.ids.end(), published_ids[p]) == tracked.ids.end())
+    {
+      tracked.removed_ids.push_back(published_ids[p]);
+    }
+  }
+  published_ids.assign(tracked.ids.begin(), tracked.ids.end());
+
+  // unmatched tracks coast for a few lists before they are forgotten
+  vector<ObjectTrack> remaining_tracks;
+  for (size_t t = 0; t < tracks.size(); t++)
+  {
+    if (!track_matched[t])
+    {
+      tracks[t].misses++;
+    }
+    if (tracks[t].misses <= max_misses)
+    {
+      remaining_tracks.push_back(tracks[t]);
+    }
+  }
+  tracks.swap(remaining_tracks);
+
+  size_t num_changed = std::count(tracked.changed.begin(), tracked.changed.end(), true);
+  ROS_INFO("Tracked %lu objects, %lu changed, %lu removed.", num_objects, num_changed, tracked.removed_ids.size());
+  tracked_objects_pub.publish(tracked);
+}
+
+bool ObjectTracker::lookupFrame(const std_msgs::Header &header, tf::StampedTransform &transform)
+{
+  try
+  {
+    tf_listener.waitForTransform(fixed_frame, header.frame_id, header.stamp, ros::Duration(0.5));
+    tf_listener.lookupTransform(fixed_frame, header.frame_id, header.stamp, transform);
+  }
+  catch (tf::TransformException &ex)
+  {
+    ROS_INFO("%s", ex.what());
+    return false;
+  }
+  return true;
+}
+
+double ObjectTracker::associationCost(const ObjectTrack &track, const tf::Vector3 &position, const double extents[3],
+    const double cielab[3], double dt) const
+{
+  tf::Vector3 predicted = track.position + track.velocity * std::max(0.0, std::min(dt, MAX_PREDICTION_TIME));
+  double distance = position.distance(predicted);
+  if (distance > max_distance)
+  {
+    return -1;
+  }
+
+  double extent_change = 0;
+  for (int d = 0; d < 3; d++)
+  {
+    extent_change = std::max(extent_change, fabs(extents[d] - track.extents[d]));
+  }
+  if (extent_change > max_extent_change)
+  {
+    return -1;
+  }
+
+  // color is skipped when either side has none
+  double color_distance = 0;
+  if (!std::isnan(cielab[0]) && !std::isnan(track.cielab[0]))
+  {
+    color_distance = sqrt(pow(cielab[0] - track.cielab[0], 2) + pow(cielab[1] - track.cielab[1], 2)
+        + pow(cielab[2] - track.cielab[2], 2));
+    if (color_distance > max_color_distance)
+    {
+      return -1;
+    }
+  }
+
+  return distance / max_distance + extent_change / max_extent_change + color_distance / max_color_distance;
+}
+
+void ObjectTracker::sortedExtents(const rail_manipulation_msgs::SegmentedObject &object, double extents[3])
+{
+  extents[0] = object.bounding_volume.dimensions.x;
+  extents[1] = object.bounding_volume.dimensions.y;
+  extents[2] = object.bounding_volume.dimensions.z;
+  if (extents[0] == 0 && extents[1] == 0 && extents[2] == 0)
+  {
+    extents[0] = object.width;
+    extents[1] = object.depth;
+    extents[2] = object.height;
+  }
+  std::sort(extents, extents + 3, std::greater<double>());
+}
+
+void ObjectTracker::objectColor(const rail_manipulation_msgs::SegmentedObject &object, double cielab[3])
+{
+  for (int c = 0; c < 3; c++)
+  {
+    cielab[c] = object.cielab.size() == 3 ? object.cielab[c] : std::numeric_limits<double>::quiet_NaN();
+  }
+}
+
+int main(int argc, char **argv)
+{
+  ros::init(argc, argv, "object_tracker");
+
+  ObjectTracker ot;
+
+  ros::spin();
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,159 @@
+#include "rail_segmentation_tools/SegmentFeatures.h"
+
+// PCL
+#include <pcl/common/centroid.h>
+#include <pcl/common/common.h>
+#include <pcl/filters/voxel_grid.h>
+
+// C++ Standard Library
+#include <cmath>
+#include <limits>
+
+//constant definitions (to use in functions with reference parameters, e.g. param())
+const double SegmentFeatures::MARKER_SCALE;
+const double SegmentFeatures::DOWNSAMPLE_LEAF_SIZE;
+
+void SegmentFeatures::calculate(const pcl::PointCloud<pcl::PointXYZRGB>::ConstPtr &cloud,
+    rail_manipulation_msgs::SegmentedObject &object)
+{
+  pcl::toROSMsg(*cloud, object.point_cloud);
+
+  // axis-aligned bounding box
+  Eigen::Vector4f min_pt, max_pt;
+  pcl::getMinMax3D(*cloud, min_pt, max_pt);
+  object.width = max_pt[0] - min_pt[0];
+  object.depth = max_pt[1] - min_pt[1];
+  object.height = max_pt[2] - min_pt[2];
+  object.center.x = (max_pt[0] + min_pt[0]) / 2.0;
+  object.center.y = (max_pt[1] + min_pt[1]) / 2.0;
+  object.center.z = (max_pt[2] + min_pt[2]) / 2.0;
+
+  // centroid and average color
+  Eigen::Vector4f centroid;
+  pcl::compute3DCentroid(*cloud, centroid);
+  object.centroid.x = centroid[0];
+  object.centroid.y = centroid[1];
+  object.centroid.z = centroid[2];
+
+  double r = 0, g = 0, b = 0;
+  for (size_t i = 0; i < cloud->points.size(); i++)
+  {
+    r += cloud->points[i].r;
+    g += cloud->points[i].g;
+    b += cloud->points[i].b;
+  }
+  r /= cloud->points.size();
+  g /= cloud->points.size();
+  b /= cloud->points.size();
+  object.rgb.resize(3);
+  object.rgb[0] = r;
+  object.rgb[1] = g;
+  object.rgb[2] = b;
+  object.cielab.resize(3);
+  rgbToCielab(r, g, b, object.cielab[0], object.cielab[1], object.cielab[2]);
+
+  // oriented bounding box, upright with its x axis along the major axis of the projection onto the xy plane
+  double cxx = 0, cxy = 0, cyy = 0;
+  for (size_t i = 0; i < cloud->points.size(); i++)
+  {
+    double dx = cloud->points[i].x - centroid[0];
+    double dy = cloud->points[i].y - centroid[1];
+    cxx += dx * dx;
+    cxy += dx * dy;
+    cyy += dy * dy;
+  }
+  double yaw = 0.5 * atan2(2.0 * cxy, cxx - cyy);
+  double cos_yaw = cos(yaw);
+  double sin_yaw = sin(yaw);
+  double min_u = std::numeric_limits<double>::max(), max_u = -std::numeric_limits<double>::max();
+  double min_v = std::numeric_limits<double>::max(), max_v = -std::numeric_limits<double>::max();
+  for (size_t i = 0; i < cloud->points.size(); i++)
+  {
+    double u = cos_yaw * cloud->points[i].x + sin_yaw * cloud->points[i].y;
+    double v = -sin_yaw * cloud->points[i].x + cos_yaw * cloud->points[i].y;
+    min_u = std::min(min_u, u);
+    max_u = std::max(max_u, u);
+    min_v = std::min(min_v, v);
+    max_v = std::max(max_v, v);
+  }
+  double center_u = (min_u + max_u) / 2.0;
+  double center_v = (min_v + max_v) / 2.0;
+
+  object.bounding_volume.pose.header = pcl_conversions::fromPCL(cloud->header);
+  object.bounding_volume.pose.pose.position.x = cos_yaw * center_u - sin_yaw * center_v;
+  object.bounding_volume.pose.pose.position.y = sin_yaw * center_u + cos_yaw * center_v;
+  object.bounding_volume.pose.pose.position.z = object.center.z;
+  object.bounding_volume.pose.pose.orientation.z = sin(yaw / 2.0);
+  object.bounding_volume.pose.pose.orientation.w = cos(yaw / 2.0);
+  object.bounding_volume.dimensions.x = max_u - min_u;
+  object.bounding_volume.dimensions.y = max_v - min_v;
+  object.bounding_volume.dimensions.z = object.height;
+  object.orientation = object.bounding_volume.pose.pose.orientation;
+
+  object.marker = createMarker(cloud, r, g, b);
+}
+
+visualization_msgs::Marker SegmentFeatures::createMarker(const pcl::PointCloud<pcl::PointXYZRGB>::ConstPtr &cloud,
+    double r, double g, double b)
+{
+  visualization_msgs::Marker marker;
+  // set header field
+  marker.header = pcl_conversions::fromPCL(cloud->header);
+
+  // default position
+  marker.pose.orientation.w = 1.0;
+
+  // default scale
+  marker.scale.x = MARKER_SCALE;
+  marker.scale.y = MARKER_SCALE;
+  marker.scale.z = MARKER_SCALE;
+
+  // set the type of marker and our color of choice
+  marker.type = visualization_msgs::Marker::CUBE_LIST;
+  marker.color.r = r / 255.0;
+  marker.color.g = g / 255.0;
+  marker.color.b = b / 255.0;
+  marker.color.a = 1.0;
+
+  // downsample point cloud for visualization
+  pcl::PointCloud<pcl::PointXYZRGB> downsampled;
+  pcl::VoxelGrid<pcl::PointXYZRGB> voxel_grid;
+  voxel_grid.setInputCloud(cloud);
+  voxel_grid.setLeafSize(DOWNSAMPLE_LEAF_SIZE, DOWNSAMPLE_LEAF_SIZE, DOWNSAMPLE_LEAF_SIZE);
+  voxel_grid.filter(downsampled);
+
+  // place in the marker message
+  marker.points.resize(downsampled.points.size());
+  for (size_t i = 0; i < downsampled.points.size(); i++)
+  {
+    marker.points[i].x = downsampled.points[i].x;
+    marker.points[i].y = downsampled.points[i].y;
+    marker.points[i].z = downsampled.points[i].z;
+  }
+
+  return marker;
+}
+
+void SegmentFeatures::rgbToCielab(double r, double g, double b, double &l, double &a, double &lab_b)
+{
+  // sRGB to linear RGB
+  double rgb[3] = {r / 255.0, g / 255.0, b / 255.0};
+  for (int i = 0; i < 3; i++)
+  {
+    rgb[i] = (rgb[i] > 0.04045) ? pow((rgb[i] + 0.055) / 1.055, 2.4) : rgb[i] / 12.92;
+  }
+
+  // linear RGB to XYZ, normalized by the D65 white point
+  double xyz[3];
+  xyz[0] = (0.4124 * rgb[0] + 0.3576 * rgb[1] + 0.1805 * rgb[2]) / 0.95047;
+  xyz[1] = (0.2126 * rgb[0] + 0.7152 * rgb[1] + 0.0722 * rgb[2]) / 1.0;
+  xyz[2] = (0.0193 * rgb[0] + 0.1192 * rgb[1] + 0.9505 * rgb[2]) / 1.08883;
+  for (int i = 0; i < 3; i++)
+  {
+    xyz[i] = (xyz[i] > 0.008856) ? cbrt(xyz[i]) : 7.787 * xyz[i] + 16.0 / 116.0;
+  }
+
+  l = 116.0 * xyz[1] - 16.0;
+  a = 500.0 * (xyz[0] - xyz[1]);
+  lab_b = 200.0 * (xyz[1] - xyz[2]);
+}
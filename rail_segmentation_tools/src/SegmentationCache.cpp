@@ -0,0 +1,236 @@
+#include "rail_segmentation_tools/SegmentationCache.h"
+
+using std::string;
+using std::vector;
+
+//constant definitions (to use in functions with reference parameters, e.g. param())
+const double SegmentationCache::DEFAULT_RESOLUTION;
+const int SegmentationCache::DEFAULT_MAX_CHANGED_VOXELS;
+const int SegmentationCache::DEFAULT_MIN_POINTS_PER_VOXEL;
+const double SegmentationCache::DEFAULT_MAX_BASE_TRANSLATION;
+const double SegmentationCache::DEFAULT_MAX_BASE_ROTATION;
+const double SegmentationCache::DEFAULT_CLOUD_TIMEOUT;
+
+SegmentationCache::SegmentationCache() : pn("~"), cache_valid(false)
+{
+  // grab any parameters we need
+  string point_cloud_topic;
+  pn.param<string>("point_cloud_topic", point_cloud_topic, "/head_camera/depth_registered/points");
+  pn.param<string>("fixed_frame", fixed_frame, "odom");
+  pn.param("resolution", resolution, DEFAULT_RESOLUTION);
+  pn.param("max_changed_voxels", max_changed_voxels, DEFAULT_MAX_CHANGED_VOXELS);
+  pn.param("min_points_per_voxel", min_points_per_voxel, DEFAULT_MIN_POINTS_PER_VOXEL);
+  pn.param("max_base_translation", max_base_translation, DEFAULT_MAX_BASE_TRANSLATION);
+  pn.param("max_base_rotation", max_base_rotation, DEFAULT_MAX_BASE_ROTATION);
+  pn.param("cloud_timeout", cloud_timeout, DEFAULT_CLOUD_TIMEOUT);
+  pn.param("merge", merge, false);
+  pn.param("republish_segmented_objects", republish_segmented_objects, true);
+
+  // setup publishers/subscribers we need
+  cloud_sub = n.subscribe(point_cloud_topic, 1, &SegmentationCache::cloudCallback, this);
+  segmented_objects_pub =
+      n.advertise<rail_manipulation_msgs::SegmentedObjectList>("rail_segmentation/segmented_objects", 1, true);
+  segment_client = n.serviceClient<rail_manipulation_msgs::SegmentObjects>("rail_segmentation/segment_objects");
+  merge_client = n.serviceClient<rail_manipulation_msgs::ProcessSegmentedObjects>("merger/merge_objects");
+  segment_srv = pn.advertiseService("segment_objects", &SegmentationCache::segmentCallback, this);
+  cached_srv = pn.advertiseService("cached_objects", &SegmentationCache::cachedCallback, this);
+  clear_srv = pn.advertiseService("clear", &SegmentationCache::clearCallback, this);
+}
+
+void SegmentationCache::cloudCallback(const sensor_msgs::PointCloud2ConstPtr &msg)
+{
+  latest_cloud = msg;
+}
+
+bool SegmentationCache::segmentCallback(rail_manipulation_msgs::SegmentObjects::Request &req,
+    rail_manipulation_msgs::SegmentObjects::Response &res)
+{
+  pcl::PointCloud<pcl::PointXYZ>::Ptr cloud;
+  bool have_cloud = prepareCloud(cloud);
+
+  if (have_cloud && sceneUnchanged(cloud))
+  {
+    ROS_INFO("Scene unchanged, returning cached segmentation of %lu objects.", cached_objects.objects.size());
+    res.segmented_objects = cached_objects;
+    if (republish_segmented_objects)
+    {
+      segmented_objects_pub.publish(res.segmented_objects);
+    }
+    return true;
+  }
+
+  // re-segment
+  cache_valid = false;
+  rail_manipulation_msgs::SegmentObjects segment;
+  if (!segment_client.call(segment))
+  {
+    ROS_INFO("Could not call segmentation service!");
+    return false;
+  }
+  res.segmented_objects = segment.response.segmented_objects;
+
+  if (merge)
+  {
+    rail_manipulation_msgs::ProcessSegmentedObjects process;
+    process.request.segmented_objects = segment.response.segmented_objects;
+    if (merge_client.call(process))
+    {
+      res.segmented_objects = process.response.segmented_objects;
+    }
+    else
+    {
+      ROS_INFO("Could not call segmentation merging service!  Returning unmerged objects.");
+    }
+  }
+
+  // cache the result against the cloud captured before segmenting, which errs towards re-segmenting
+  if (have_cloud && lookupFrame(res.segmented_objects.header.frame_id, cached_objects_frame))
+  {
+    cached_cloud = cloud;
+    cached_objects = res.segmented_objects;
+    cache_valid = true;
+  }
+
+  return true;
+}
+
+bool SegmentationCache::cachedCallback(rail_manipulation_msgs::SegmentObjects::Request &req,
+    rail_manipulation_msgs::SegmentObjects::Response &res)
+{
+  // for background consumers, which must neither trigger segmentation nor feed the segmented objects topic
+  pcl::PointCloud<pcl::PointXYZ>::Ptr cloud;
+  if (!prepareCloud(cloud) || !sceneUnchanged(cloud))
+  {
+    return false;
+  }
+  res.segmented_objects = cached_objects;
+  return true;
+}
+
+bool SegmentationCache::clearCallback(std_srvs::Empty::Request &req, std_srvs::Empty::Response &res)
+{
+  cache_valid = false;
+  return true;
+}
+
+bool SegmentationCache::prepareCloud(pcl::PointCloud<pcl::PointXYZ>::Ptr &cloud)
+{
+  if (!latest_cloud || ros::Time::now() - latest_cloud->header.stamp > ros::Duration(cloud_timeout))
+  {
+    ROS_INFO("No recent point cloud, the scene will be re-segmented.");
+    return false;
+  }
+
+  pcl::PointCloud<pcl::PointXYZ>::Ptr raw_cloud(new pcl::PointCloud<pcl::PointXYZ>);
+  pcl::fromROSMsg(*latest_cloud, *raw_cloud);
+  vector<int> valid_indices;
+  pcl::removeNaNFromPointCloud(*raw_cloud, *raw_cloud, valid_indices);
+
+  // half the octree resolution leaves several points per changed voxel, so single noisy points can be ignored
+  pcl::PointCloud<pcl::PointXYZ>::Ptr downsampled_cloud(new pcl::PointCloud<pcl::PointXYZ>);
+  pcl::VoxelGrid<pcl::PointXYZ> voxel_grid;
+  voxel_grid.setInputCloud(raw_cloud);
+  voxel_grid.setLeafSize(resolution / 2.0, resolution / 2.0, resolution / 2.0);
+  voxel_grid.filter(*downsampled_cloud);
+
+  // compensate for base and head motion by comparing clouds in the fixed frame
+  cloud.reset(new pcl::PointCloud<pcl::PointXYZ>);
+  try
+  {
+    tf_listener.waitForTransform(fixed_frame, latest_cloud->header.frame_id, latest_cloud->header.stamp,
+        ros::Duration(0.5));
+  }
+  catch (tf::TransformException &ex)
+  {
+    ROS_INFO("%s", ex.what());
+  }
+  if (!pcl_ros::transformPointCloud(fixed_frame, *downsampled_cloud, *cloud, tf_listener))
+  {
+    ROS_INFO("Could not transform point cloud to %s, the scene will be re-segmented.", fixed_frame.c_str());
+    return false;
+  }
+  return true;
+}
+
+bool SegmentationCache::lookupFrame(const string &frame, tf::StampedTransform &transform)
+{
+  try
+  {
+    tf_listener.lookupTransform(fixed_frame, frame, ros::Time(0), transform);
+  }
+  catch (tf::TransformException &ex)
+  {
+    ROS_INFO("%s", ex.what());
+    return false;
+  }
+  return true;
+}
+
+bool SegmentationCache::sceneUnchanged(const pcl::PointCloud<pcl::PointXYZ>::Ptr &cloud)
+{
+  if (!cache_valid || cloud->empty() || cached_cloud->empty())
+  {
+    return false;
+  }
+
+  // the cached objects are in the segmentation frame, so they are only valid while that frame stays put
+  tf::StampedTransform objects_frame;
+  if (!lookupFrame(cached_objects.header.frame_id, objects_frame))
+  {
+    return false;
+  }
+  double translation = (objects_frame.getOrigin() - cached_objects_frame.getOrigin()).length();
+  double rotation = objects_frame.getRotation().angleShortestPath(cached_objects_frame.getRotation());
+  if (translation > max_base_translation || rotation > max_base_rotation)
+  {
+    ROS_INFO("Segmentation frame moved %f m, %f rad since the cached segmentation.", translation, rotation);
+    return false;
+  }
+
+  // changes in both directions, so removed objects count as well as new ones; an absolute voxel count, since one
+  // small part is a negligible fraction of the frame
+  size_t added = countNewVoxels(cached_cloud, cloud);
+  size_t removed = countNewVoxels(cloud, cached_cloud);
+  ROS_INFO("Scene change since the cached segmentation: %lu added, %lu removed voxels", added, removed);
+  return added + removed <= static_cast<size_t>(std::max(0, max_changed_voxels));
+}
+
+size_t SegmentationCache::countNewVoxels(const pcl::PointCloud<pcl::PointXYZ>::Ptr &old_cloud,
+    const pcl::PointCloud<pcl::PointXYZ>::Ptr &new_cloud)
+{
+  pcl::octree::OctreePointCloudChangeDetector<pcl::PointXYZ> octree(resolution);
+  octree.setInputCloud(old_cloud);
+  octree.addPointsFromInputCloud();
+  octree.switchBuffers();
+  octree.setInputCloud(new_cloud);
+  octree.addPointsFromInputCloud();
+
+  vector<int> new_indices;
+  octree.getPointIndicesFromNewVoxels(new_indices, min_points_per_voxel);
+
+  // octree voxel keys count from the minimum corner of its bounding box
+  double min_x, min_y, min_z, max_x, max_y, max_z;
+  octree.getBoundingBox(min_x, min_y, min_z, max_x, max_y, max_z);
+  std::set<vector<int> > voxels;
+  for (size_t i = 0; i < new_indices.size(); i++)
+  {
+    const pcl::PointXYZ &point = new_cloud->points[new_indices[i]];
+    vector<int> key(3);
+    key[0] = static_cast<int>((point.x - min_x) / resolution);
+    key[1] = static_cast<int>((point.y - min_y) / resolution);
+    key[2] = static_cast<int>((point.z - min_z) / resolution);
+    voxels.insert(key);
+  }
+  return voxels.size();
+}
+
+int main(int argc, char **argv)
+{
+  ros::init(argc, argv, "segmentation_cache");
+
+  SegmentationCache sc;
+
+  ros::spin();
+
+  return EXIT_SUCCESS;
+}
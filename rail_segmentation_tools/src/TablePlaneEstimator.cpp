@@ -0,0 +1,239 @@
+#include "rail_segmentation_tools/TablePlaneEstimator.h"
+
+// Eigen
+#include <Eigen/Eigenvalues>
+
+// PCL
+#include <pcl/ModelCoefficients.h>
+#include <pcl/PointIndices.h>
+#include <pcl/segmentation/sac_segmentation.h>
+
+// C++ Standard Library
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+using std::max;
+using std::min;
+
+//constant definitions (to use in functions with reference parameters, e.g. param())
+const double TablePlaneEstimator::DEFAULT_DISTANCE_THRESHOLD;
+const double TablePlaneEstimator::DEFAULT_INLIER_BAND;
+const double TablePlaneEstimator::DEFAULT_EPS_ANGLE;
+const int TablePlaneEstimator::DEFAULT_ROW_STRIDE;
+const int TablePlaneEstimator::DEFAULT_COLUMN_STRIDE;
+const int TablePlaneEstimator::DEFAULT_MAX_SAMPLES;
+const int TablePlaneEstimator::DEFAULT_MIN_INLIERS;
+const double TablePlaneEstimator::DEFAULT_MIN_INLIER_RATIO;
+const int TablePlaneEstimator::DEFAULT_REFINE_ITERATIONS;
+const int TablePlaneEstimator::DEFAULT_RANSAC_ITERATIONS;
+
+TablePlaneEstimator::TablePlaneEstimator() :
+    axis_(Eigen::Vector3f::UnitZ()), eps_angle_(DEFAULT_EPS_ANGLE), distance_threshold_(DEFAULT_DISTANCE_THRESHOLD),
+    inlier_band_(DEFAULT_INLIER_BAND), row_stride_(DEFAULT_ROW_STRIDE), column_stride_(DEFAULT_COLUMN_STRIDE),
+    max_samples_(DEFAULT_MAX_SAMPLES), min_inliers_(DEFAULT_MIN_INLIERS), min_inlier_ratio_(DEFAULT_MIN_INLIER_RATIO),
+    refine_iterations_(DEFAULT_REFINE_ITERATIONS), ransac_iterations_(DEFAULT_RANSAC_ITERATIONS),
+    min_pt_(Eigen::Vector3f::Constant(-std::numeric_limits<float>::max())),
+    max_pt_(Eigen::Vector3f::Constant(std::numeric_limits<float>::max())), has_previous_(false)
+{
+}
+
+void TablePlaneEstimator::setSampling(int row_stride, int column_stride, int max_samples)
+{
+  row_stride_ = max(1, row_stride);
+  column_stride_ = max(1, column_stride);
+  max_samples_ = max(1, max_samples);
+}
+
+void TablePlaneEstimator::setMinInliers(int min_inliers, double min_inlier_ratio)
+{
+  min_inliers_ = max(3, min_inliers);
+  min_inlier_ratio_ = min_inlier_ratio;
+}
+
+void TablePlaneEstimator::setIterations(int refine_iterations, int ransac_iterations)
+{
+  refine_iterations_ = max(1, refine_iterations);
+  ransac_iterations_ = max(1, ransac_iterations);
+}
+
+void TablePlaneEstimator::setBounds(const Eigen::Vector3f &min_pt, const Eigen::Vector3f &max_pt)
+{
+  min_pt_ = min_pt;
+  max_pt_ = max_pt;
+}
+
+template<typename PointT>
+void TablePlaneEstimator::addSample(const PointT &point, const Eigen::Affine3f &transform)
+{
+  if (!pcl_isfinite(point.x) || !pcl_isfinite(point.y) || !pcl_isfinite(point.z))
+  {
+    return;
+  }
+  Eigen::Vector3f sample = transform * point.getVector3fMap();
+  if ((sample.array() >= min_pt_.array()).all() && (sample.array() <= max_pt_.array()).all())
+  {
+    samples_.push_back(sample);
+  }
+}
+
+template<typename PointT>
+bool TablePlaneEstimator::estimate(const pcl::PointCloud<PointT> &cloud, const Eigen::Affine3f &transform,
+    Plane &plane)
+{
+  // only the sampled points are transformed, organized clouds are sampled on a row/column grid
+  samples_.clear();
+  if (cloud.isOrganized())
+  {
+    for (size_t row = row_stride_ / 2; row < cloud.height; row += row_stride_)
+    {
+      for (size_t column = column_stride_ / 2; column < cloud.width; column += column_stride_)
+      {
+        addSample(cloud.at(column, row), transform);
+      }
+    }
+  }
+  else
+  {
+    size_t stride = max(static_cast<size_t>(1), cloud.size() / max_samples_);
+    for (size_t i = 0; i < cloud.size(); i += stride)
+    {
+      addSample(cloud[i], transform);
+    }
+  }
+  if (samples_.size() < static_cast<size_t>(min_inliers_))
+  {
+    return false;
+  }
+
+  // a warm start must keep most of the previous support, otherwise the table moved or something covers it
+  bool found = false;
+  if (has_previous_ && refine(previous_.coefficients, plane)
+      && plane.inliers >= min_inlier_ratio_ * previous_.inliers)
+  {
+    plane.warm_started = true;
+    found = true;
+  }
+  else if (ransac(plane))
+  {
+    plane.warm_started = false;
+    found = true;
+  }
+
+  if (found)
+  {
+    previous_ = plane;
+    has_previous_ = true;
+  }
+  return found;
+}
+
+bool TablePlaneEstimator::refine(const Eigen::Vector4f &seed, Plane &plane) const
+{
+  Eigen::Vector4f coefficients = seed;
+  for (int iteration = 0; iteration < refine_iterations_; iteration++)
+  {
+    // Tukey biweights over the band around the current plane
+    double total_weight = 0;
+    Eigen::Vector3d weighted_sum = Eigen::Vector3d::Zero();
+    Eigen::Matrix3d weighted_outer = Eigen::Matrix3d::Zero();
+    int support = 0;
+    for (size_t i = 0; i < samples_.size(); i++)
+    {
+      double r = distance(coefficients, samples_[i]) / inlier_band_;
+      if (fabs(r) >= 1.0)
+      {
+        continue;
+      }
+      double w = (1.0 - r * r) * (1.0 - r * r);
+      Eigen::Vector3d p = samples_[i].cast<double>();
+      total_weight += w;
+      weighted_sum += w * p;
+      weighted_outer += w * p * p.transpose();
+      support++;
+    }
+    if (support < min_inliers_ || total_weight <= 0)
+    {
+      return false;
+    }
+
+    Eigen::Vector3d centroid = weighted_sum / total_weight;
+    Eigen::Matrix3d covariance = weighted_outer / total_weight - centroid * centroid.transpose();
+    Eigen::SelfAdjointEigenSolver<Eigen::Matrix3d> solver(covariance);
+    Eigen::Vector3f normal = solver.eigenvectors().col(0).cast<float>();
+    if (normal.dot(axis_) < 0)
+    {
+      normal = -normal;
+    }
+    coefficients.head<3>() = normal;
+    coefficients[3] = -normal.dot(centroid.cast<float>());
+  }
+
+  if (acos(min(1.0f, coefficients.head<3>().dot(axis_))) > eps_angle_)
+  {
+    return false;
+  }
+
+  // final inliers and their centroid
+  Eigen::Vector3f center = Eigen::Vector3f::Zero();
+  int inliers = 0;
+  for (size_t i = 0; i < samples_.size(); i++)
+  {
+    if (fabs(distance(coefficients, samples_[i])) <= distance_threshold_)
+    {
+      center += samples_[i];
+      inliers++;
+    }
+  }
+  if (inliers < min_inliers_)
+  {
+    return false;
+  }
+
+  plane.coefficients = coefficients;
+  plane.center = center / inliers;
+  plane.inliers = inliers;
+  return true;
+}
+
+bool TablePlaneEstimator::ransac(Plane &plane) const
+{
+  pcl::PointCloud<pcl::PointXYZ>::Ptr sample_cloud(new pcl::PointCloud<pcl::PointXYZ>);
+  sample_cloud->resize(samples_.size());
+  for (size_t i = 0; i < samples_.size(); i++)
+  {
+    sample_cloud->points[i].getVector3fMap() = samples_[i];
+  }
+
+  pcl::SACSegmentation<pcl::PointXYZ> plane_seg;
+  pcl::ModelCoefficients coefficients;
+  pcl::PointIndices inliers;
+  plane_seg.setOptimizeCoefficients(false);
+  plane_seg.setModelType(pcl::SACMODEL_PERPENDICULAR_PLANE);
+  plane_seg.setAxis(axis_);
+  plane_seg.setEpsAngle(eps_angle_);
+  plane_seg.setMethodType(pcl::SAC_RANSAC);
+  plane_seg.setMaxIterations(ransac_iterations_);
+  plane_seg.setDistanceThreshold(distance_threshold_);
+  plane_seg.setInputCloud(sample_cloud);
+  plane_seg.segment(inliers, coefficients);
+  if (coefficients.values.size() != 4 || inliers.indices.size() < static_cast<size_t>(min_inliers_))
+  {
+    return false;
+  }
+
+  Eigen::Vector4f seed(coefficients.values[0], coefficients.values[1], coefficients.values[2],
+      coefficients.values[3]);
+  seed /= seed.head<3>().norm();
+  if (seed.head<3>().dot(axis_) < 0)
+  {
+    seed = -seed;
+  }
+  return refine(seed, plane);
+}
+
+// the point types used by the perception nodes
+template bool TablePlaneEstimator::estimate<pcl::PointXYZ>(const pcl::PointCloud<pcl::PointXYZ> &cloud,
+    const Eigen::Affine3f &transform, Plane &plane);
+template bool TablePlaneEstimator::estimate<pcl::PointXYZRGB>(const pcl::PointCloud<pcl::PointXYZRGB> &cloud,
+    const Eigen::Affine3f &transform, Plane &plane);
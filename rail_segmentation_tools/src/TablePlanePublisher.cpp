@@ -0,0 +1,109 @@
+#include "rail_segmentation_tools/TablePlanePublisher.h"
+
+using std::string;
+
+//constant definitions (to use in functions with reference parameters, e.g. param())
+const double TablePlanePublisher::DEFAULT_MIN_PERIOD;
+
+TablePlanePublisher::TablePlanePublisher() : pn("~")
+{
+  // grab any parameters we need
+  string point_cloud_topic;
+  pn.param<string>("point_cloud_topic", point_cloud_topic, "/head_camera/depth_registered/points");
+  pn.param<string>("frame", frame, "base_link");
+  pn.param("min_period", min_period, DEFAULT_MIN_PERIOD);
+
+  double distance_threshold, inlier_band, eps_angle, min_inlier_ratio;
+  int row_stride, column_stride, max_samples, min_inliers, refine_iterations, ransac_iterations;
+  pn.param("distance_threshold", distance_threshold, TablePlaneEstimator::DEFAULT_DISTANCE_THRESHOLD);
+  pn.param("inlier_band", inlier_band, TablePlaneEstimator::DEFAULT_INLIER_BAND);
+  pn.param("eps_angle", eps_angle, TablePlaneEstimator::DEFAULT_EPS_ANGLE);
+  pn.param("row_stride", row_stride, TablePlaneEstimator::DEFAULT_ROW_STRIDE);
+  pn.param("column_stride", column_stride, TablePlaneEstimator::DEFAULT_COLUMN_STRIDE);
+  pn.param("max_samples", max_samples, TablePlaneEstimator::DEFAULT_MAX_SAMPLES);
+  pn.param("min_inliers", min_inliers, TablePlaneEstimator::DEFAULT_MIN_INLIERS);
+  pn.param("min_inlier_ratio", min_inlier_ratio, TablePlaneEstimator::DEFAULT_MIN_INLIER_RATIO);
+  pn.param("refine_iterations", refine_iterations, TablePlaneEstimator::DEFAULT_REFINE_ITERATIONS);
+  pn.param("ransac_iterations", ransac_iterations, TablePlaneEstimator::DEFAULT_RANSAC_ITERATIONS);
+  estimator.setDistanceThreshold(distance_threshold);
+  estimator.setInlierBand(inlier_band);
+  estimator.setEpsAngle(eps_angle);
+  estimator.setSampling(row_stride, column_stride, max_samples);
+  estimator.setMinInliers(min_inliers, min_inlier_ratio);
+  estimator.setIterations(refine_iterations, ransac_iterations);
+
+  // workspace where a table can be, in frame (the defaults exclude the floor in front of the robot)
+  double min_x, min_y, min_z, max_x, max_y, max_z;
+  pn.param("min_x", min_x, 0.0);
+  pn.param("max_x", max_x, 2.0);
+  pn.param("min_y", min_y, -1.5);
+  pn.param("max_y", max_y, 1.5);
+  pn.param("min_z", min_z, 0.3);
+  pn.param("max_z", max_z, 1.5);
+  estimator.setBounds(Eigen::Vector3f(min_x, min_y, min_z), Eigen::Vector3f(max_x, max_y, max_z));
+
+  // setup publishers/subscribers we need
+  table_plane_pub = pn.advertise<rail_segmentation_tools::TablePlane>("table_plane", 1, true);
+  cloud_sub = n.subscribe(point_cloud_topic, 1, &TablePlanePublisher::cloudCallback, this);
+}
+
+void TablePlanePublisher::cloudCallback(const sensor_msgs::PointCloud2ConstPtr &msg)
+{
+  if (!last_estimate_time.isZero() && msg->header.stamp - last_estimate_time < ros::Duration(min_period))
+  {
+    return;
+  }
+  ros::WallTime start = ros::WallTime::now();
+
+  tf::StampedTransform cloud_transform;
+  try
+  {
+    tf_listener.waitForTransform(frame, msg->header.frame_id, msg->header.stamp, ros::Duration(0.1));
+    tf_listener.lookupTransform(frame, msg->header.frame_id, msg->header.stamp, cloud_transform);
+  }
+  catch (tf::TransformException &ex)
+  {
+    ROS_INFO_THROTTLE(5.0, "%s", ex.what());
+    return;
+  }
+  last_estimate_time = msg->header.stamp;
+
+  // the organized layout is kept so the estimator can sample on the row/column grid
+  pcl::PointCloud<pcl::PointXYZ> cloud;
+  pcl::fromROSMsg(*msg, cloud);
+  Eigen::Affine3d transform;
+  tf::transformTFToEigen(cloud_transform, transform);
+
+  TablePlaneEstimator::Plane plane;
+  if (!estimator.estimate(cloud, transform.cast<float>(), plane))
+  {
+    ROS_WARN_THROTTLE(5.0, "No table plane found in the latest point cloud.");
+    return;
+  }
+
+  rail_segmentation_tools::TablePlane table_plane;
+  table_plane.header.frame_id = frame;
+  table_plane.header.stamp = msg->header.stamp;
+  for (int i = 0; i < 4; i++)
+  {
+    table_plane.plane.coef[i] = plane.coefficients[i];
+  }
+  table_plane.center.x = plane.center.x();
+  table_plane.center.y = plane.center.y();
+  table_plane.center.z = plane.center.z();
+  table_plane.inliers = plane.inliers;
+  table_plane.warm_started = plane.warm_started;
+  table_plane.latency = (ros::WallTime::now() - start).toSec();
+  table_plane_pub.publish(table_plane);
+}
+
+int main(int argc, char **argv)
+{
+  ros::init(argc, argv, "table_plane_publisher");
+
+  TablePlanePublisher tpp;
+
+  ros::spin();
+
+  return EXIT_SUCCESS;
+}
@@ -11,6 +11,7 @@ from task_executor.abstract_step import AbstractStep
 from geometry_msgs.msg import Transform
 from sensor_msgs.msg import PointCloud2
 
+from fetchit_icp.msg import TrackedPose
 from fetchit_icp.srv import TemplateMatch, TemplateMatchRequest
 
 
@@ -18,10 +19,16 @@ class DetectSchunkAction(AbstractStep):
     """
     If the camera is pointing at the corner of the schunk machine and robot localized, call this service
     :const:`DETECT_SCHUNK_SERVICE_NAME` to detect the schunk machine's chuck pose. The service
-    internally calls icp matching to register the matching template.
+    internally calls icp matching to register the matching template. If the
+    template matcher is tracking the schunk, the latest tracked pose from
+    :const:`TRACKED_POSE_TOPIC` is returned instead when it is recent and
+    confident enough.
     """
 
     DETECT_SCHUNK_SERVICE_NAME = '/schunk_template_matcher_node/match_template'
+    TRACKED_POSE_TOPIC = '/schunk_template_matcher_node/tracked_pose'
+    TRACKED_POSE_TIMEOUT = 1.0  # Seconds a tracked pose stays valid
+    TRACKED_POSE_MIN_CONFIDENCE = 0.3
 
     def init(self, name):
         self.name = name
@@ -40,6 +47,14 @@ class DetectSchunkAction(AbstractStep):
         self._detect_schunk_srv.wait_for_service()
         rospy.loginfo(".../schunk_template_matcher_node/match_template connected")
 
+        # Keep the latest tracked pose, if the matcher is tracking
+        self._tracked_pose = None
+        self._tracked_pose_sub = rospy.Subscriber(
+            DetectSchunkAction.TRACKED_POSE_TOPIC,
+            TrackedPose,
+            self._on_tracked_pose
+        )
+
     def run(self):
         """
         The run function for this step
@@ -61,6 +76,17 @@ class DetectSchunkAction(AbstractStep):
         )
         self._stopped = False
 
+        # Use the tracked pose if it is current
+        tracked_pose = self._tracked_pose
+        if tracked_pose is not None \
+                and tracked_pose.locked \
+                and tracked_pose.confidence >= DetectSchunkAction.TRACKED_POSE_MIN_CONFIDENCE \
+                and rospy.Time.now() - tracked_pose.template_pose.header.stamp \
+                < rospy.Duration(DetectSchunkAction.TRACKED_POSE_TIMEOUT):
+            rospy.loginfo("Action {}: Using tracked schunk pose.".format(self.name))
+            yield self.set_succeeded(chuck_approach_pose=tracked_pose.template_pose)
+            raise StopIteration()
+
         # Ask for the schunk detector
         stub_tf = Transform()
         stub_pcl = PointCloud2()
@@ -82,3 +108,6 @@ class DetectSchunkAction(AbstractStep):
 
     def stop(self):
         self._stopped = True
+
+    def _on_tracked_pose(self, msg):
+        self._tracked_pose = msg
@@ -11,7 +11,7 @@ import actionlib
 from task_executor.abstract_step import AbstractStep
 
 from rail_manipulation_msgs.msg import SegmentedObject
-from rail_object_recognition.srv import ExtractPointCloud
+from rail_object_recognition.srv import ExtractPointCloud, ExtractPointCloudResponse
 from manipulation_actions.msg import ChallengeObject
 from task_execution_msgs.srv import GetPartsAtLocation, GetBeliefs, GetSemanticLocations
 
@@ -167,9 +167,16 @@ class RecognizeObjectAction(AbstractStep):
         self._stopped = False
 
         # Send the point clouds of the segmented objects
-        classifications = self._recognize_object_srv(
+        recognition = self._recognize_object_srv(
             clouds=[obj.point_cloud for obj in segmented_objects]
-        ).classes_of_parts
+        )
+        classifications = recognition.classes_of_parts
+        num_geometric = sum(
+            1 for stage in bytearray(recognition.stages) if stage == ExtractPointCloudResponse.STAGE_GEOMETRIC
+        )
+        rospy.loginfo("Action {}: {} of {} objects recognized by bounding box in {:.1f} ms, descriptors took {:.1f} ms"
+                      .format(self.name, num_geometric, len(segmented_objects),
+                              1000 * recognition.geometric_latency, 1000 * recognition.descriptor_latency))
         self.notify_service_called(RecognizeObjectAction.RECOGNIZE_OBJECT_SERVICE_NAME)
         yield self.set_running()
         if self._stopped:
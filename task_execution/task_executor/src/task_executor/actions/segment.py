@@ -14,10 +14,11 @@ from rail_manipulation_msgs.srv import SegmentObjects
 class SegmentAction(AbstractStep):
     """
     Call ``rail_segmentation`` to segment the point cloud and return a list of
-    ``rail_manipulation_msgs/SegmentedObject``
+    ``rail_manipulation_msgs/SegmentedObject``. Requests go through the
+    ``segmentation_cache`` proxy, which only re-segments a changed scene
     """
 
-    SEGMENT_OBJECTS_SERVICE_NAME = "/rail_segmentation/segment_objects"
+    SEGMENT_OBJECTS_SERVICE_NAME = "/segmentation_cache/segment_objects"
 
     def init(self, name):
         self.name = name